@@ -0,0 +1,231 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#include "clairvoyance.h"
+#include "fmt/format.h"
+#include "fmt/os.h"
+#include "synthetic.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace chrono = std::chrono;
+namespace fs = std::filesystem;
+using namespace clairvoyance;
+using namespace clairvoyance::synthetic;
+
+namespace {
+
+//
+// The result of a phase: the best time out of the iterations, and how many
+// pages and bytes it went through.
+//
+
+struct Result_t {
+  std::string_view Scenario;
+  std::string_view Phase;
+  double Seconds = 0;
+  uint64_t Pages = 0;
+  uint64_t Bytes = 0;
+};
+
+//
+// Run a phase a few times and keep the fastest.
+//
+
+template <typename Function_t>
+double Best(const uint64_t Iterations, Function_t &&Function) {
+  double BestSeconds = 0;
+  for (uint64_t Idx = 0; Idx < Iterations; Idx++) {
+    const auto Start = chrono::steady_clock::now();
+    Function();
+    const double Seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+    BestSeconds = Idx == 0 ? Seconds : std::min(BestSeconds, Seconds);
+  }
+
+  return std::max(BestSeconds, 1e-9);
+}
+
+bool Run(const Scenario_t &Scenario, const uint64_t Size,
+         const uint64_t NumberThreads, const uint64_t Iterations,
+         const fs::path &Directory, std::vector<Result_t> &Results) {
+  std::mt19937_64 Rng(Size);
+  DumpBuilder_t Builder;
+  Scenario.Generate(Builder, Size, Rng);
+
+  const fs::path DumpFile = Directory / fmt::format("{}.dmp", Scenario.Name);
+  if (!Builder.Write(DumpFile)) {
+    return false;
+  }
+
+  const uint64_t DumpSize = fs::file_size(DumpFile);
+  const uint64_t TableBytes = Builder.NumberTables() * page::Size;
+
+  //
+  // Open the dump and build the index of its physical memory.
+  //
+
+  const auto &Parse = [&](kdmpparser::KernelDumpParser &DumpParser) {
+    return DumpParser.Parse(DumpFile.string().c_str(),
+                            kdmpparser::ReaderType_t::Mmap,
+                            kdmpparser::PageCache_t::DefaultNumberPages,
+                            NumberThreads);
+  };
+
+  bool Success = true;
+  const double Physmem = Best(Iterations, [&]() {
+    kdmpparser::KernelDumpParser DumpParser;
+    Success = Success && Parse(DumpParser);
+  });
+
+  kdmpparser::KernelDumpParser DumpParser;
+  if (!Success || !Parse(DumpParser)) {
+    fmt::print("Parse of {} failed\n", DumpFile.string());
+    return false;
+  }
+
+  Results.push_back({Scenario.Name, "physmem", Physmem,
+                     Builder.NumberTables(), DumpSize});
+
+  //
+  // Walk the page tables by ranges on a single thread.
+  //
+
+  const uint64_t DirectoryBase = DumpParser.GetDirectoryTableBase();
+  uint64_t NumberPages = 0;
+  const double Walk = Best(Iterations, [&]() {
+    NumberPages = 0;
+    ptables::PageTableWalker_t Walker(DumpParser, DirectoryBase);
+    while (const auto &Range = Walker.NextRange()) {
+      NumberPages += Range->NumberPages;
+    }
+  });
+
+  Results.push_back({Scenario.Name, "walk", Walk, NumberPages, TableBytes});
+
+  //
+  // Build the tape, then write it in the text and binary formats.
+  //
+
+  Visualizer_t Visu;
+  const double Tape = Best(Iterations, [&]() {
+    Visu.Reset();
+    Visu.Parse(DumpParser, DirectoryBase, NumberThreads);
+  });
+
+  const uint64_t TapeSize = Visu.Builder().Size();
+  Results.push_back({Scenario.Name, "tape", Tape, TapeSize, TableBytes});
+
+  for (const auto &[Phase, Format] :
+       {std::pair{std::string_view("write-text"), OutputFormat_t::Text},
+        std::pair{std::string_view("write-binary"), OutputFormat_t::Binary}}) {
+    const fs::path OutFile =
+        Directory / fmt::format("{}.{}.clairvoyance", Scenario.Name, Phase);
+    const double Seconds = Best(Iterations, [&]() {
+      Success = Success && Visu.Write(OutFile, Format, NumberThreads);
+    });
+
+    Results.push_back(
+        {Scenario.Name, Phase, Seconds, TapeSize, fs::file_size(OutFile)});
+    fs::remove(OutFile);
+  }
+
+  fs::remove(DumpFile);
+  return Success;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  uint64_t Size = 64;
+  uint64_t Iterations = 3;
+  uint64_t NumberThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::string_view Only;
+  fs::path JsonFile = "clairvoyance-bench.json";
+  for (int Idx = 1; Idx < argc; Idx++) {
+    const std::string_view Arg(argv[Idx]);
+    if ((Idx + 1) >= argc) {
+      Only = "usage";
+      break;
+    }
+
+    if (Arg == "--size") {
+      Size = std::max(1ull, strtoull(argv[++Idx], nullptr, 0));
+    } else if (Arg == "--iterations") {
+      Iterations = std::max(1ull, strtoull(argv[++Idx], nullptr, 0));
+    } else if (Arg == "--threads") {
+      NumberThreads = std::max(1ull, strtoull(argv[++Idx], nullptr, 0));
+    } else if (Arg == "--scenario") {
+      Only = argv[++Idx];
+    } else if (Arg == "--json") {
+      JsonFile = argv[++Idx];
+    } else {
+      Only = "usage";
+      break;
+    }
+  }
+
+  const bool Known =
+      Only.empty() ||
+      std::any_of(Scenarios.begin(), Scenarios.end(),
+                  [&](const Scenario_t &Scenario) {
+                    return Scenario.Name == Only;
+                  });
+  if (!Known) {
+    fmt::print("./clairvoyance-bench [--size <tables>] [--iterations <n>] "
+               "[--threads <n>] [--scenario <name>] [--json <path>]\n");
+    for (const auto &Scenario : Scenarios) {
+      fmt::print("  scenario {}\n", Scenario.Name);
+    }
+
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Result_t> Results;
+  const fs::path Directory = fs::temp_directory_path();
+  for (const auto &Scenario : Scenarios) {
+    if (!Only.empty() && Scenario.Name != Only) {
+      continue;
+    }
+
+    if (!Run(Scenario, Size, NumberThreads, Iterations, Directory, Results)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  //
+  // Print a summary and write the results for the machines.
+  //
+
+  auto Json = fmt::output_file(JsonFile.string());
+  Json.print("[\n");
+  for (uint64_t Idx = 0; Idx < Results.size(); Idx++) {
+    const auto &Result = Results[Idx];
+    const double PagesPerSecond = double(Result.Pages) / Result.Seconds;
+    const double BytesPerSecond = double(Result.Bytes) / Result.Seconds;
+    fmt::print("{:>22} {:>13}: {:10.6f}s, {:14.0f} pages/s, {:10.1f} MB/s\n",
+               Result.Scenario, Result.Phase, Result.Seconds, PagesPerSecond,
+               BytesPerSecond / (1024. * 1024.));
+    Json.print("  {{\"scenario\": \"{}\", \"phase\": \"{}\", \"size\": {}, "
+               "\"threads\": {}, \"seconds\": {:.9f}, \"pages\": {}, "
+               "\"bytes\": {}, \"pages_per_second\": {:.1f}, "
+               "\"bytes_per_second\": {:.1f}}}{}\n",
+               Result.Scenario, Result.Phase, Size, NumberThreads,
+               Result.Seconds, Result.Pages, Result.Bytes, PagesPerSecond,
+               BytesPerSecond, (Idx + 1) == Results.size() ? "" : ",");
+  }
+
+  Json.print("]\n");
+  fmt::print("Done writing {}\n", JsonFile.string());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#include "entropy.h"
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace chrono = std::chrono;
+namespace entropy = clairvoyance::entropy;
+
+//
+// Time a function and return the number of bytes per second it went through.
+//
+
+template <typename Function_t>
+double Measure(const uint64_t NumberBytes, Function_t &&Function) {
+  const auto Start = chrono::steady_clock::now();
+  Function();
+  const auto Elapsed = chrono::steady_clock::now() - Start;
+  const double Seconds =
+      double(chrono::duration_cast<chrono::nanoseconds>(Elapsed).count()) /
+      1e9;
+  return double(NumberBytes) / std::max(Seconds, 1e-9);
+}
+
+//
+// The textbook version of the entropy of a page.
+//
+
+double ReferenceEntropy(const uint8_t *Page) {
+  std::array<uint64_t, 256> Counts = {};
+  for (uint64_t Idx = 0; Idx < page::Size; Idx++) {
+    Counts[Page[Idx]]++;
+  }
+
+  double Entropy = 0;
+  for (const uint64_t Count : Counts) {
+    if (Count != 0) {
+      const double P = double(Count) / double(page::Size);
+      Entropy -= P * std::log2(P);
+    }
+  }
+
+  return Entropy;
+}
+
+//
+// Check the kernel against the reference on pages with a known distribution
+// of byte values.
+//
+
+bool Check() {
+  std::mt19937_64 Rng(1337);
+  std::vector<uint8_t> Page(page::Size);
+  for (uint64_t NumberValues = 1; NumberValues <= 256; NumberValues *= 2) {
+    for (uint64_t Round = 0; Round < 64; Round++) {
+      const uint8_t Base = uint8_t(Rng());
+      for (auto &Byte : Page) {
+        Byte = uint8_t(Base + (Rng() % NumberValues));
+      }
+
+      if (Round == 0) {
+        memset(Page.data(), NumberValues == 1 ? 0 : Base, page::Size / 2);
+      }
+
+      const double Expected = ReferenceEntropy(Page.data());
+      const double Entropy = entropy::Entropy(Page.data());
+      const bool Uniform = std::all_of(Page.begin(), Page.end(),
+                                       [&](const uint8_t Byte) {
+                                         return Byte == Page[0];
+                                       });
+      if (std::abs(Expected - Entropy) > 1e-3 ||
+          entropy::IsUniform(Page.data()) != Uniform) {
+        fmt::print("Mismatch with {} values: {} vs {}\n", NumberValues,
+                   Expected, Entropy);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (!Check()) {
+    return EXIT_FAILURE;
+  }
+
+  fmt::print("The entropy kernel agrees with the reference\n");
+  if (argc < 2) {
+    fmt::print("./entropy-bench [<dump path> [<threads>]]\n");
+    return EXIT_SUCCESS;
+  }
+
+  kdmpparser::KernelDumpParser DumpParser;
+  if (!DumpParser.Parse(argv[1])) {
+    fmt::print("Parse failed\n");
+    return EXIT_FAILURE;
+  }
+
+  const uint64_t NumberThreads =
+      argc > 2 ? std::max(1ull, strtoull(argv[2], nullptr, 0))
+               : std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<uint64_t> Pas;
+  for (const auto &[Pa, Offset] : DumpParser.GetPhysmem()) {
+    Pas.emplace_back(Pa);
+  }
+
+  const uint64_t NumberBytes = Pas.size() * page::Size;
+
+  //
+  // The sequential read bandwidth is how fast a single thread can go through
+  // the pages of the dump.
+  //
+
+  uint64_t Checksum = 0;
+  const double Read = Measure(NumberBytes, [&]() {
+    for (const uint64_t Pa : Pas) {
+      const uint8_t *Page = DumpParser.GetPhysicalPage(Pa);
+      for (uint64_t Offset = 0; Offset < page::Size;
+           Offset += sizeof(uint64_t)) {
+        uint64_t Value;
+        memcpy(&Value, &Page[Offset], sizeof(Value));
+        Checksum += Value;
+      }
+
+      DumpParser.ReleasePhysicalPage(Pa);
+    }
+  });
+
+  //
+  // Classify every page across threads.
+  //
+
+  std::array<std::atomic<uint64_t>, entropy::NumberContents> Counts = {};
+  const double Classify = Measure(NumberBytes, [&]() {
+    constexpr uint64_t PagesPerChunk = 0x100;
+    std::atomic<uint64_t> NextChunk = 0;
+    auto Worker = [&]() {
+      std::array<uint64_t, entropy::NumberContents> Local = {};
+      for (uint64_t First = (NextChunk++) * PagesPerChunk; First < Pas.size();
+           First = (NextChunk++) * PagesPerChunk) {
+        const uint64_t Last = std::min(First + PagesPerChunk, Pas.size());
+        for (uint64_t Idx = First; Idx < Last; Idx++) {
+          Local[uint64_t(entropy::Classify(DumpParser, Pas[Idx]))]++;
+        }
+      }
+
+      for (uint64_t Idx = 0; Idx < Local.size(); Idx++) {
+        Counts[Idx] += Local[Idx];
+      }
+    };
+
+    std::vector<std::thread> Threads;
+    for (uint64_t Idx = 1; Idx < NumberThreads; Idx++) {
+      Threads.emplace_back(Worker);
+    }
+
+    Worker();
+    for (auto &Thread : Threads) {
+      Thread.join();
+    }
+  });
+
+  constexpr std::array<std::string_view, entropy::NumberContents> Names = {
+      "missing", "zero", "uniform", "[0, 1)", "[1, 2)", "[2, 3)",
+      "[3, 4)",  "[4, 5)", "[5, 6)", "[6, 7)", "[7, 8]"};
+  fmt::print("{} pages (checksum {:#x})\n", Pas.size(), Checksum);
+  for (uint64_t Idx = 0; Idx < Names.size(); Idx++) {
+    fmt::print("  {:>8}: {}\n", Names[Idx], Counts[Idx].load());
+  }
+
+  constexpr double Megabyte = 1024. * 1024.;
+#if defined(__AVX2__)
+  constexpr std::string_view Kernel = "avx2";
+#else
+  constexpr std::string_view Kernel = "scalar";
+#endif
+  fmt::print("  sequential read: {:.1f} MB/s\n", Read / Megabyte);
+  fmt::print("  classify ({}, {} threads): {:.1f} MB/s ({:.2f}x)\n", Kernel,
+             NumberThreads, Classify / Megabyte, Classify / Read);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#include "fmt/format.h"
+#include "hilbert.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace chrono = std::chrono;
+
+//
+// Time a function and return the number of nanoseconds per distance.
+//
+
+template <typename Function_t>
+double Measure(const uint64_t NumberDistances, Function_t &&Function) {
+  const auto Start = chrono::steady_clock::now();
+  Function();
+  const auto Elapsed = chrono::steady_clock::now() - Start;
+  return double(chrono::duration_cast<chrono::nanoseconds>(Elapsed).count()) /
+         double(NumberDistances);
+}
+
+int main(int argc, char *argv[]) {
+  const uint64_t Order = argc > 1 ? strtoull(argv[1], nullptr, 0) : 12;
+  if (Order == 0 || Order > 16) {
+    fmt::print("./hilbert-bench [<order between 1 and 16>]\n");
+    return EXIT_FAILURE;
+  }
+
+  //
+  // Make sure the batch version agrees with the scalar one on every order
+  // that's cheap to check exhaustively.
+  //
+
+  for (uint64_t CheckOrder = 1; CheckOrder <= 10; CheckOrder++) {
+    std::vector<uint64_t> Distances(uint64_t(1) << (2 * CheckOrder));
+    std::iota(Distances.begin(), Distances.end(), 0);
+    std::vector<uint32_t> Xs(Distances.size()), Ys(Distances.size());
+    hilbert::D2xy(Distances, Xs, Ys, CheckOrder);
+    for (uint64_t Distance = 0; Distance < Distances.size(); Distance++) {
+      const auto Point = hilbert::D2xy(Distance, CheckOrder);
+      if (Point.X != Xs[Distance] || Point.Y != Ys[Distance]) {
+        fmt::print("Mismatch at order {} for {:#x}: ({}, {}) vs ({}, {})\n",
+                   CheckOrder, Distance, Point.X, Point.Y, Xs[Distance],
+                   Ys[Distance]);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  //
+  // Make sure the layouts are the smallest ones that fit, right around the
+  // powers of four too, and that the tiles of the packed ones connect.
+  //
+
+  for (uint64_t Exponent = 1; Exponent <= 32; Exponent++) {
+    for (const uint64_t Size :
+         {(uint64_t(1) << Exponent) - 1, uint64_t(1) << Exponent,
+          (uint64_t(1) << Exponent) + 1}) {
+      for (const auto Shape : {hilbert::Shape_t::Square,
+                               hilbert::Shape_t::Packed}) {
+        const auto Layout = hilbert::LayoutFor(Size, Shape);
+        const uint64_t Smaller =
+            Layout.NumberTiles > 1
+                ? (Layout.NumberTiles - 1) << (2 * Layout.Order)
+                : (Layout.Order > 0 ? uint64_t(1) << (2 * Layout.Order - 2)
+                                    : 0);
+        if (Layout.NumberPixels() < Size || Smaller >= Size ||
+            Layout.NumberTiles > 3) {
+          fmt::print("Bad layout for {:#x}: {} tiles of order {}\n", Size,
+                     Layout.NumberTiles, Layout.Order);
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  const hilbert::Layout_t Packed = {4, 3};
+  for (uint64_t Distance = 1; Distance < Packed.NumberPixels(); Distance++) {
+    const auto Previous = hilbert::D2xy(Distance - 1, Packed);
+    const auto Point = hilbert::D2xy(Distance, Packed);
+    const uint64_t Steps = std::max(Previous.X, Point.X) -
+                           std::min(Previous.X, Point.X) +
+                           std::max(Previous.Y, Point.Y) -
+                           std::min(Previous.Y, Point.Y);
+    if (Steps != 1) {
+      fmt::print("The packed layout jumps at {:#x}\n", Distance);
+      return EXIT_FAILURE;
+    }
+  }
+
+  //
+  // Convert every distance of a curve, both ways.
+  //
+
+  std::vector<uint64_t> Distances(uint64_t(1) << (2 * Order));
+  std::iota(Distances.begin(), Distances.end(), 0);
+  std::vector<uint32_t> Xs(Distances.size()), Ys(Distances.size());
+
+  const double Scalar = Measure(Distances.size(), [&]() {
+    for (const uint64_t Distance : Distances) {
+      const auto Point = hilbert::D2xy(Distance, Order);
+      Xs[Distance] = Point.X;
+      Ys[Distance] = Point.Y;
+    }
+  });
+
+  uint64_t Checksum = std::accumulate(Xs.begin(), Xs.end(), uint64_t(0));
+  const double Batch = Measure(Distances.size(), [&]() {
+    constexpr uint64_t BatchSize = 4'096;
+    for (uint64_t Idx = 0; Idx < Distances.size(); Idx += BatchSize) {
+      const uint64_t Size = std::min(BatchSize, Distances.size() - Idx);
+      hilbert::D2xy(std::span(Distances).subspan(Idx, Size),
+                    std::span(Xs).subspan(Idx, Size),
+                    std::span(Ys).subspan(Idx, Size), Order);
+    }
+  });
+
+  Checksum -= std::accumulate(Xs.begin(), Xs.end(), uint64_t(0));
+  fmt::print("Order {} ({} distances), checksum {}\n", Order, Distances.size(),
+             Checksum == 0 ? "ok" : "mismatch");
+  fmt::print("  scalar: {:.2f} ns / distance\n", Scalar);
+#if defined(__AVX2__)
+  fmt::print("  batch (lut + avx2): {:.2f} ns / distance ({:.1f}x)\n", Batch,
+             Scalar / Batch);
+#else
+  fmt::print("  batch (lut): {:.2f} ns / distance ({:.1f}x)\n", Batch,
+             Scalar / Batch);
+#endif
+  return Checksum == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
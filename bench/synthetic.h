@@ -0,0 +1,228 @@
+// Axel '0vercl0k' Souchet - October 15 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string_view>
+#include <vector>
+
+//
+// The synthetic dumps the benchmarks and the checks are run against.
+//
+
+namespace clairvoyance::synthetic {
+
+namespace fs = std::filesystem;
+
+//
+// The bits of the PXEs the generator uses.
+//
+
+constexpr uint64_t Present = ptables::pxe::Present;
+constexpr uint64_t Write = ptables::pxe::Write;
+constexpr uint64_t User = ptables::pxe::UserAccessible;
+constexpr uint64_t LargePage = ptables::pxe::LargePage;
+constexpr uint64_t NoExecute = ptables::pxe::NoExecute;
+
+//
+// Builds a full dump made of page tables only; the pages they map are not in
+// the dump, which doesn't matter to the walk. The tables are stored in a
+// single physical run starting at FirstPfn.
+//
+
+class DumpBuilder_t {
+  static constexpr uint64_t FirstPfn = 0x100;
+
+  std::vector<std::array<uint64_t, 512>> Tables_;
+
+public:
+  //
+  // The PFNs past the tables, for the pages they map.
+  //
+
+  static constexpr uint64_t DataPfn = 0x10'00'00;
+
+  uint64_t NewTable() {
+    Tables_.emplace_back();
+    Tables_.back().fill(0);
+    return FirstPfn + Tables_.size() - 1;
+  }
+
+  void Set(const uint64_t Pfn, const uint64_t Idx, const uint64_t Pfn2,
+           const uint64_t Flags) {
+    Tables_[Pfn - FirstPfn][Idx] = (Pfn2 << 12) | Flags;
+  }
+
+  uint64_t Get(const uint64_t Pfn, const uint64_t Idx) const {
+    return Tables_[Pfn - FirstPfn][Idx];
+  }
+
+  uint64_t NumberTables() const { return Tables_.size(); }
+
+  //
+  // Get the entries of a table, to fill it with arbitrary content.
+  //
+
+  uint64_t *Entries(const uint64_t Pfn) {
+    return Tables_[Pfn - FirstPfn].data();
+  }
+
+  //
+  // Write the dump; the directory base is the first table.
+  //
+
+  bool Write(const fs::path &Filename) const {
+    auto Header = std::make_unique<kdmpparser::HEADER64>();
+    Header->Signature = kdmpparser::HEADER64::ExpectedSignature;
+    Header->ValidDump = kdmpparser::HEADER64::ExpectedValidDump;
+    Header->MajorVersion = 15;
+    Header->MinorVersion = 19041;
+    Header->DirectoryTableBase = FirstPfn * page::Size;
+    Header->DumpType = kdmpparser::DumpType_t::FullDump;
+    Header->PhysicalMemoryBlockBuffer.NumberOfRuns = 1;
+    Header->PhysicalMemoryBlockBuffer.NumberOfPages = Tables_.size();
+    Header->PhysicalMemoryBlockBuffer.Run[0].BasePage = FirstPfn;
+    Header->PhysicalMemoryBlockBuffer.Run[0].PageCount = Tables_.size();
+
+    FILE *File = fopen(Filename.string().c_str(), "wb");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    bool Success = fwrite(Header.get(), 0x2000, 1, File) == 1;
+    for (const auto &Table : Tables_) {
+      Success = Success && fwrite(Table.data(), page::Size, 1, File) == 1;
+    }
+
+    return fclose(File) == 0 && Success;
+  }
+};
+
+//
+// Get a random protection for a leaf entry.
+//
+
+inline uint64_t RandomFlags(std::mt19937_64 &Rng, const uint64_t Base) {
+  const uint64_t Bits = Rng();
+  return Base | ((Bits & 1) ? Write : 0) | ((Bits & 2) ? NoExecute : 0);
+}
+
+//
+// A user address space made of heaps: page tables scattered across the user
+// half, each with a few runs of pages.
+//
+
+inline void SparseUserHeaps(DumpBuilder_t &Dump, const uint64_t Size,
+                            std::mt19937_64 &Rng) {
+  const uint64_t Pml4 = Dump.NewTable();
+  uint64_t NextData = DumpBuilder_t::DataPfn;
+  for (uint64_t Idx = 0; Idx < Size; Idx++) {
+    const uint64_t Pml4Idx = Rng() % 256;
+    if (Dump.Get(Pml4, Pml4Idx) == 0) {
+      Dump.Set(Pml4, Pml4Idx, Dump.NewTable(), Present | Write | User);
+    }
+
+    const uint64_t Pdpt = Dump.Get(Pml4, Pml4Idx) >> 12;
+    const uint64_t PdptIdx = Rng() % 512;
+    if (Dump.Get(Pdpt, PdptIdx) == 0) {
+      Dump.Set(Pdpt, PdptIdx, Dump.NewTable(), Present | Write | User);
+    }
+
+    const uint64_t Pd = Dump.Get(Pdpt, PdptIdx) >> 12;
+    const uint64_t PdIdx = Rng() % 512;
+    if (Dump.Get(Pd, PdIdx) != 0) {
+      continue;
+    }
+
+    const uint64_t Pt = Dump.NewTable();
+    Dump.Set(Pd, PdIdx, Pt, Present | Write | User);
+    for (uint64_t PtIdx = Rng() % 64; PtIdx < 512; PtIdx += 64 + (Rng() % 64)) {
+      const uint64_t Flags = RandomFlags(Rng, Present | User);
+      const uint64_t Length = std::min(uint64_t(1 + (Rng() % 16)), 512 - PtIdx);
+      for (uint64_t Page = 0; Page < Length; Page++) {
+        Dump.Set(Pt, PtIdx + Page, NextData++, Flags);
+      }
+    }
+  }
+}
+
+//
+// A kernel half densely mapped with 2MB pages, and a 1GB page at the start of
+// every PDPT.
+//
+
+inline void DenseHugePageKernel(DumpBuilder_t &Dump, const uint64_t Size,
+                                std::mt19937_64 &Rng) {
+  const uint64_t Pml4 = Dump.NewTable();
+  uint64_t NumberPds = 0;
+  for (uint64_t Pml4Idx = 256; Pml4Idx < 512 && NumberPds < Size; Pml4Idx++) {
+    const uint64_t Pdpt = Dump.NewTable();
+    Dump.Set(Pml4, Pml4Idx, Pdpt, Present | Write);
+    for (uint64_t PdptIdx = 0; PdptIdx < 512 && NumberPds < Size; PdptIdx++) {
+      const uint64_t Flags = RandomFlags(Rng, Present);
+      if (PdptIdx == 0) {
+        Dump.Set(Pdpt, PdptIdx, PdptIdx << 18, Flags | LargePage);
+        continue;
+      }
+
+      const uint64_t Pd = Dump.NewTable();
+      NumberPds++;
+      Dump.Set(Pdpt, PdptIdx, Pd, Present | Write);
+      for (uint64_t PdIdx = 0; PdIdx < 512; PdIdx++) {
+        Dump.Set(Pd, PdIdx, PdIdx << 9, Flags | LargePage);
+      }
+    }
+  }
+}
+
+//
+// Fully populated page tables with a random protection for every page, so
+// that no two neighbours can be merged.
+//
+
+inline void RandomFragmentation(DumpBuilder_t &Dump, const uint64_t Size,
+                                std::mt19937_64 &Rng) {
+  const uint64_t Pml4 = Dump.NewTable();
+  uint64_t NextData = DumpBuilder_t::DataPfn;
+  uint64_t Pdpt = 0, Pd = 0;
+  for (uint64_t Idx = 0; Idx < Size; Idx++) {
+    if ((Idx % (512 * 512)) == 0) {
+      Pdpt = Dump.NewTable();
+      Dump.Set(Pml4, Idx / (512 * 512), Pdpt, Present | Write | User);
+    }
+
+    if ((Idx % 512) == 0) {
+      Pd = Dump.NewTable();
+      Dump.Set(Pdpt, (Idx / 512) % 512, Pd, Present | Write | User);
+    }
+
+    const uint64_t Pt = Dump.NewTable();
+    Dump.Set(Pd, Idx % 512, Pt, Present | Write | User);
+    for (uint64_t PtIdx = 0; PtIdx < 512; PtIdx++) {
+      const uint64_t Flags = Rng() % 8 == 0 ? 0 : RandomFlags(Rng, Present);
+      Dump.Set(Pt, PtIdx, NextData++, Flags | ((Rng() & 1) ? User : 0));
+    }
+  }
+}
+
+struct Scenario_t {
+  std::string_view Name;
+  std::function<void(DumpBuilder_t &, uint64_t, std::mt19937_64 &)> Generate;
+};
+
+inline const std::array<Scenario_t, 3> Scenarios = {{
+    {"sparse-user-heaps", SparseUserHeaps},
+    {"dense-huge-kernel", DenseHugePageKernel},
+    {"random-fragmentation", RandomFragmentation},
+}};
+
+} // namespace clairvoyance::synthetic
@@ -0,0 +1,151 @@
+// Axel '0vercl0k' Souchet - October 15 2026
+#include "clairvoyance.h"
+#include "synthetic.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+namespace chrono = std::chrono;
+namespace fs = std::filesystem;
+using namespace clairvoyance;
+using namespace clairvoyance::synthetic;
+
+namespace {
+
+//
+// The number of tables a fuzz case is made of, and the number of PFNs its
+// entries can reference: the ones past the tables are missing from the dump.
+//
+
+constexpr uint64_t MaxTables = 64;
+constexpr uint64_t NumberMissingPfns = 4;
+
+//
+// A walk taking longer than that is a performance cliff; the tables are
+// visited at most once so the walks are bounded by the size of the input.
+//
+
+constexpr auto MaxWalkTime = chrono::seconds(1);
+
+void Check(const bool Condition) {
+  if (!Condition) {
+    std::abort();
+  }
+}
+
+void Configure(ptables::PageTableWalker_t &Walker) {
+  Walker.LimitTableVisits(1);
+  Walker.SkipSelfReference();
+  Walker.RecordAttributes();
+}
+
+} // namespace
+
+//
+// Every 4KB of the input is a table of the hierarchy, the first one being the
+// directory. The PFNs of the entries are folded onto the other tables so that
+// they reference each other (loops, shared tables, self-references), and the
+// walks of the three walker paths have to agree with each other and with
+// KernelDumpParser::VirtTranslate.
+//
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  const uint64_t NumberTables = std::min(Size / page::Size, MaxTables);
+  if (NumberTables == 0) {
+    return 0;
+  }
+
+  DumpBuilder_t Builder;
+  std::vector<uint64_t> Pfns;
+  for (uint64_t Idx = 0; Idx < NumberTables; Idx++) {
+    Pfns.emplace_back(Builder.NewTable());
+  }
+
+  const uint64_t NumberPfns = NumberTables + NumberMissingPfns;
+  const uint64_t PfnMask = 0xff'ff'ff'ff'ffull << 12;
+  for (uint64_t Idx = 0; Idx < NumberTables; Idx++) {
+    uint64_t *Entries = Builder.Entries(Pfns[Idx]);
+    memcpy(Entries, Data + (Idx * page::Size), page::Size);
+    for (uint64_t EntryIdx = 0; EntryIdx < 512; EntryIdx++) {
+      const uint64_t Pfn = Pfns[0] + (((Entries[EntryIdx] & PfnMask) >> 12) %
+                                      NumberPfns);
+      Entries[EntryIdx] = (Entries[EntryIdx] & ~PfnMask) | (Pfn << 12);
+    }
+  }
+
+  static const fs::path DumpFile =
+      fs::temp_directory_path() /
+      fmt::format("walker-fuzz-{:x}.dmp", std::random_device()());
+  Check(Builder.Write(DumpFile));
+
+  kdmpparser::KernelDumpParser Dump;
+  Check(Dump.Parse(DumpFile.string().c_str()));
+  const uint64_t DirectoryBase = Pfns[0] * page::Size;
+
+  //
+  // The scalar walk is the reference.
+  //
+
+  const auto Start = chrono::steady_clock::now();
+  std::vector<ptables::Entry_t> Entries;
+  ptables::PageTableWalker_t Walker(Dump, DirectoryBase);
+  Configure(Walker);
+  while (const auto &Entry = Walker.Next<ptables::QuietPolicy_t>()) {
+    Entries.emplace_back(*Entry);
+  }
+
+  ptables::PageTableWalker_t Batches(Dump, DirectoryBase);
+  Configure(Batches);
+  ptables::EntryBatch_t Batch;
+  uint64_t EntryIdx = 0;
+  while (const uint64_t BatchSize = Batches.NextBatch(Batch)) {
+    for (uint64_t Idx = 0; Idx < BatchSize; Idx++, EntryIdx++) {
+      Check(EntryIdx < Entries.size());
+      const auto &Entry = Entries[EntryIdx];
+      Check(Batch.Vas[Idx] == Entry.Va && Batch.Pas[Idx] == Entry.Pa &&
+            Batch.Protections[Idx] == Entry.Protection() &&
+            Batch.Types[Idx] == Entry.Type);
+    }
+  }
+
+  Check(EntryIdx == Entries.size());
+
+  //
+  // The ranges have to cover the entries, in order.
+  //
+
+  ptables::PageTableWalker_t Ranges(Dump, DirectoryBase);
+  Configure(Ranges);
+  EntryIdx = 0;
+  while (const auto &Range = Ranges.NextRange()) {
+    uint64_t NumberPages = 0;
+    while (NumberPages < Range->NumberPages) {
+      Check(EntryIdx < Entries.size());
+      const auto &Entry = Entries[EntryIdx++];
+      Check(Entry.Va == Range->Va + (NumberPages * page::Size) &&
+            Entry.Protection() == Range->Protection &&
+            Entry.Attributes == Range->Attributes);
+      NumberPages += ptables::PageSize(Entry.Type) / page::Size;
+    }
+
+    Check(NumberPages == Range->NumberPages);
+  }
+
+  Check(EntryIdx == Entries.size());
+  Check(chrono::steady_clock::now() - Start < MaxWalkTime);
+
+  //
+  // The addresses the walker finds have to translate the same way.
+  //
+
+  for (uint64_t Idx = 0; Idx < std::min(Entries.size(), size_t(64)); Idx++) {
+    const auto &Entry = Entries[Idx];
+    Check(Dump.VirtTranslate(Entry.Va, DirectoryBase) == Entry.Pa);
+  }
+
+  return 0;
+}
@@ -0,0 +1,513 @@
+// Axel '0vercl0k' Souchet - October 15 2026
+#include "clairvoyance.h"
+#include "fmt/format.h"
+#include "synthetic.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace chrono = std::chrono;
+namespace fs = std::filesystem;
+using namespace clairvoyance;
+using namespace clairvoyance::synthetic;
+
+namespace {
+
+//
+// KernelDumpParser::VirtTranslate prints why an address isn't mapped; the
+// output is silenced while the unmapped addresses are checked.
+//
+
+class Mute_t {
+#if defined(LINUX)
+  int Saved_ = -1;
+#endif
+
+public:
+  Mute_t() {
+#if defined(LINUX)
+    fflush(stdout);
+    Saved_ = dup(STDOUT_FILENO);
+    const int Null = open("/dev/null", O_WRONLY);
+    dup2(Null, STDOUT_FILENO);
+    close(Null);
+#endif
+  }
+
+  ~Mute_t() {
+#if defined(LINUX)
+    fflush(stdout);
+    dup2(Saved_, STDOUT_FILENO);
+    close(Saved_);
+#endif
+  }
+};
+
+//
+// Keep track of the mismatches; only the first few of every check are
+// printed.
+//
+
+class Checker_t {
+  static constexpr uint64_t MaxReports = 8;
+
+  uint64_t NumberFailures_ = 0;
+  uint64_t NumberReports_ = 0;
+
+public:
+  void Fail(const std::string &Message) {
+    NumberFailures_++;
+    if (NumberReports_++ < MaxReports) {
+      fmt::print("  {}\n", Message);
+    }
+  }
+
+  //
+  // Print the result of a check and start the next one.
+  //
+
+  void Done(const std::string_view Name,
+            const chrono::steady_clock::time_point Start) {
+    const double Seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+    fmt::print("{:>30}: {} ({:.6f}s)\n", Name,
+               NumberReports_ == 0 ? "ok"
+                                   : fmt::format("{} mismatches",
+                                                 NumberReports_),
+               Seconds);
+    NumberReports_ = 0;
+  }
+
+  uint64_t NumberFailures() const { return NumberFailures_; }
+};
+
+//
+// The number of 4KB pages of a page type.
+//
+
+constexpr uint64_t NumberPages(const ptables::PageType_t Type) {
+  return ptables::PageSize(Type) / page::Size;
+}
+
+//
+// Turn leaf entries into ranges of pages and merge the contiguous ranges with
+// the same protection and attributes; every way of walking an address space
+// has to end up with the same ranges.
+//
+
+void Merge(std::vector<ptables::Range_t> &Ranges,
+           const ptables::Range_t &Range) {
+  if (!Ranges.empty()) {
+    auto &Last = Ranges.back();
+    if (Last.Protection == Range.Protection &&
+        Last.Attributes == Range.Attributes &&
+        (Last.Va + (Last.NumberPages * page::Size)) == Range.Va) {
+      Last.NumberPages += Range.NumberPages;
+      return;
+    }
+  }
+
+  Ranges.emplace_back(Range);
+}
+
+std::vector<ptables::Range_t>
+Normalize(const std::vector<ptables::Entry_t> &Entries) {
+  std::vector<ptables::Range_t> Ranges;
+  for (const auto &Entry : Entries) {
+    Merge(Ranges, {Entry.Va, NumberPages(Entry.Type), Entry.Protection(),
+                   Entry.Attributes});
+  }
+
+  return Ranges;
+}
+
+void Compare(Checker_t &Checker, const std::vector<ptables::Range_t> &Expected,
+             const std::vector<ptables::Range_t> &Ranges) {
+  if (Ranges.size() != Expected.size()) {
+    Checker.Fail(fmt::format("{} ranges instead of {}", Ranges.size(),
+                             Expected.size()));
+  }
+
+  for (uint64_t Idx = 0; Idx < std::min(Ranges.size(), Expected.size());
+       Idx++) {
+    const auto &A = Expected[Idx];
+    const auto &B = Ranges[Idx];
+    if (A.Va != B.Va || A.NumberPages != B.NumberPages ||
+        A.Protection != B.Protection || A.Attributes != B.Attributes) {
+      Checker.Fail(fmt::format(
+          "range {}: {:#x} {} pages {} {:#x} instead of {:#x} {} pages {} "
+          "{:#x}",
+          Idx, B.Va, B.NumberPages, ptables::ToString(B.Protection),
+          B.Attributes, A.Va, A.NumberPages, ptables::ToString(A.Protection),
+          A.Attributes));
+      return;
+    }
+  }
+}
+
+//
+// Walk a directory base entry by entry with the scalar walker; this is the
+// reference the fast paths are checked against.
+//
+
+std::vector<ptables::Entry_t>
+Collect(const kdmpparser::KernelDumpParser &DumpParser,
+        const uint64_t DirectoryBase, const bool Attributes) {
+  std::vector<ptables::Entry_t> Entries;
+  ptables::PageTableWalker_t Walker(DumpParser, DirectoryBase);
+  if (Attributes) {
+    Walker.RecordAttributes();
+  }
+
+  while (const auto &Entry = Walker.Next<ptables::QuietPolicy_t>()) {
+    Entries.emplace_back(*Entry);
+  }
+
+  return Entries;
+}
+
+//
+// Check the walker against KernelDumpParser::VirtTranslate and the software
+// TLB: random addresses inside the pages the walker found have to translate
+// to the same physical address, and random addresses of the address space
+// that the walker doesn't find have to be unmapped for the others too.
+//
+
+void CheckTranslations(Checker_t &Checker,
+                       const kdmpparser::KernelDumpParser &DumpParser,
+                       const uint64_t DirectoryBase,
+                       const std::vector<ptables::Entry_t> &Entries,
+                       const uint64_t NumberSamples, std::mt19937_64 &Rng) {
+  auto Start = chrono::steady_clock::now();
+  translation::Tlb_t Tlb(DumpParser);
+  for (uint64_t Idx = 0; !Entries.empty() && Idx < NumberSamples; Idx++) {
+    const auto &Entry = Entries[Rng() % Entries.size()];
+    const uint64_t Offset = Rng() % (NumberPages(Entry.Type) * page::Size);
+    const uint64_t Va = Entry.Va + Offset;
+    const uint64_t Expected = Entry.Pa + Offset;
+    const uint64_t Pa = DumpParser.VirtTranslate(Va, DirectoryBase);
+    if (Pa != Expected) {
+      Checker.Fail(
+          fmt::format("{:#x} ({}) translates to {:#x} instead of {:#x}", Va,
+                      ptables::ToString(Entry.Type), Pa, Expected));
+    }
+
+    const auto &Translation = Tlb.Translate(DirectoryBase, Va);
+    if (!Translation || Translation->Pa != Expected ||
+        Translation->Protection != Entry.Protection()) {
+      Checker.Fail(
+          fmt::format("the TLB translates {:#x} to {:#x} instead of {:#x}", Va,
+                      Translation ? Translation->Pa : 0, Expected));
+    }
+  }
+
+  Checker.Done("walker vs VirtTranslate", Start);
+
+  Start = chrono::steady_clock::now();
+  for (uint64_t Idx = 0; Idx < NumberSamples; Idx++) {
+    const uint64_t Va = ptables::CanonicalVa(4, Rng() & ~uint64_t(0xfff));
+    ptables::PageTableWalker_t Walker(DumpParser, DirectoryBase,
+                                      ptables::Va_t(Va), ptables::Va_t(Va));
+    if (Walker.Next<ptables::QuietPolicy_t>()) {
+      continue;
+    }
+
+    const uint64_t Pa = [&] {
+      const Mute_t Mute;
+      return DumpParser.VirtTranslate(Va, DirectoryBase);
+    }();
+
+    if (Pa != 0) {
+      Checker.Fail(
+          fmt::format("{:#x} isn't mapped but translates to {:#x}", Va, Pa));
+    }
+
+    if (Tlb.Translate(DirectoryBase, Va)) {
+      Checker.Fail(fmt::format("{:#x} isn't mapped but is in the TLB", Va));
+    }
+  }
+
+  Checker.Done("unmapped vs VirtTranslate", Start);
+}
+
+//
+// Check that every fast path of the walker agrees with the scalar one.
+//
+
+void CheckFastPaths(Checker_t &Checker,
+                    const kdmpparser::KernelDumpParser &DumpParser,
+                    const uint64_t DirectoryBase,
+                    const std::vector<ptables::Entry_t> &Entries,
+                    const uint64_t NumberThreads) {
+
+  //
+  // The batches compute the protections out of the access bits they track.
+  //
+
+  auto Start = chrono::steady_clock::now();
+  {
+    ptables::PageTableWalker_t Walker(DumpParser, DirectoryBase);
+    ptables::EntryBatch_t Batch;
+    uint64_t EntryIdx = 0;
+    while (const uint64_t Size = Walker.NextBatch(Batch)) {
+      for (uint64_t Idx = 0; Idx < Size; Idx++, EntryIdx++) {
+        if (EntryIdx >= Entries.size()) {
+          Checker.Fail(fmt::format("the batches have more than {} entries",
+                                   Entries.size()));
+          break;
+        }
+
+        const auto &Entry = Entries[EntryIdx];
+        if (Batch.Vas[Idx] != Entry.Va || Batch.Pas[Idx] != Entry.Pa ||
+            Batch.Protections[Idx] != Entry.Protection() ||
+            Batch.Types[Idx] != Entry.Type) {
+          Checker.Fail(fmt::format(
+              "batch entry {} is {:#x} -> {:#x} {} instead of {:#x} -> {:#x} "
+              "{}",
+              EntryIdx, Batch.Vas[Idx], Batch.Pas[Idx],
+              ptables::ToString(Batch.Protections[Idx]), Entry.Va, Entry.Pa,
+              ptables::ToString(Entry.Protection())));
+        }
+      }
+    }
+
+    if (EntryIdx != Entries.size()) {
+      Checker.Fail(fmt::format("the batches have {} entries instead of {}",
+                               EntryIdx, Entries.size()));
+    }
+  }
+
+  Checker.Done("NextBatch vs Next", Start);
+
+  //
+  // The ranges are found with vector compares, with and without the
+  // attributes.
+  //
+
+  for (const bool Attributes : {false, true}) {
+    Start = chrono::steady_clock::now();
+    const auto &Expected =
+        Normalize(Attributes ? Collect(DumpParser, DirectoryBase, true)
+                             : Entries);
+    std::vector<ptables::Range_t> Ranges;
+    ptables::PageTableWalker_t Walker(DumpParser, DirectoryBase);
+    if (Attributes) {
+      Walker.RecordAttributes();
+    }
+
+    while (const auto &Range = Walker.NextRange()) {
+      Merge(Ranges, *Range);
+    }
+
+    Compare(Checker, Expected, Ranges);
+    Checker.Done(Attributes ? "NextRange vs Next (attributes)"
+                            : "NextRange vs Next",
+                 Start);
+  }
+
+  //
+  // The parallel walks have to stitch their slices back in order, whatever
+  // the number of threads.
+  //
+
+  const auto &Expected = Normalize(Entries);
+  for (uint64_t Threads = 1; Threads <= NumberThreads;
+       Threads = Threads == NumberThreads
+                     ? Threads + 1
+                     : std::min(Threads * 2, NumberThreads)) {
+    Start = chrono::steady_clock::now();
+    using Partial_t = std::vector<ptables::Range_t>;
+    std::vector<ptables::Range_t> Ranges;
+    ptables::ParallelWalk(
+        DumpParser, DirectoryBase, Threads, Partial_t(),
+        [](Partial_t &Partial, const ptables::Range_t &Range) {
+          Merge(Partial, Range);
+        },
+        [&](Partial_t &&Partial) {
+          for (const auto &Range : Partial) {
+            Merge(Ranges, Range);
+          }
+        });
+
+    Compare(Checker, Expected, Ranges);
+    Checker.Done(fmt::format("ParallelWalk ({} threads)", Threads), Start);
+  }
+
+  //
+  // The vector compares looking for the end of a run against a loop.
+  //
+
+  Start = chrono::steady_clock::now();
+  std::mt19937_64 Rng(DirectoryBase);
+  std::array<ptables::Pte_t, 512> Table;
+  for (uint64_t Round = 0; Round < 10'000; Round++) {
+    const uint64_t Mask = Rng() | ptables::pxe::Present;
+    const uint64_t Expected = Rng() & Mask;
+    for (auto &Entry : Table) {
+      Entry = (Rng() % 4) == 0 ? Rng() : Expected | (Rng() & ~Mask);
+    }
+
+    const uint64_t Begin = Rng() % Table.size();
+    const uint64_t End = Begin + (Rng() % (Table.size() - Begin + 1));
+    uint64_t Reference = Begin;
+    while (Reference < End &&
+           (Table[Reference].AsUINT64 & Mask) == Expected) {
+      Reference++;
+    }
+
+    const uint64_t Found =
+        ptables::FindMismatch(Table.data(), Begin, End, Mask, Expected);
+    if (Found != Reference) {
+      Checker.Fail(
+          fmt::format("FindMismatch over [{}, {}) returned {} instead of {}",
+                      Begin, End, Found, Reference));
+    }
+  }
+
+  Checker.Done("FindMismatch vs loop", Start);
+}
+
+//
+// Run every check against a directory base of a dump.
+//
+
+bool Check(const fs::path &DumpFile, const std::optional<uint64_t> &Base,
+           const uint64_t NumberSamples, const uint64_t NumberThreads,
+           const uint64_t Seed) {
+  kdmpparser::KernelDumpParser DumpParser;
+  if (!DumpParser.Parse(DumpFile.string().c_str())) {
+    fmt::print("Parse of {} failed\n", DumpFile.string());
+    return false;
+  }
+
+  const uint64_t DirectoryBase =
+      page::Align(Base.value_or(DumpParser.GetDirectoryTableBase()));
+  const auto &Entries = Collect(DumpParser, DirectoryBase, false);
+  fmt::print("{} ({:#x}, {} leaf entries)\n", DumpFile.filename().string(),
+             DirectoryBase, Entries.size());
+
+  Checker_t Checker;
+  std::mt19937_64 Rng(Seed);
+  CheckTranslations(Checker, DumpParser, DirectoryBase, Entries,
+                    NumberSamples, Rng);
+  CheckFastPaths(Checker, DumpParser, DirectoryBase, Entries, NumberThreads);
+  return Checker.NumberFailures() == 0;
+}
+
+//
+// The large pages can have their PAT bit set, which is the low bit of their
+// PFN; it isn't part of the address they map.
+//
+
+void LargePagesWithPat(DumpBuilder_t &Dump, const uint64_t Size,
+                       std::mt19937_64 &Rng) {
+  const uint64_t Pml4 = Dump.NewTable();
+  const uint64_t Pdpt = Dump.NewTable();
+  Dump.Set(Pml4, 256, Pdpt, Present | Write);
+  for (uint64_t PdptIdx = 0; PdptIdx < std::min(Size, uint64_t(512));
+       PdptIdx++) {
+    const uint64_t Pat = 1;
+    if ((PdptIdx % 2) == 0) {
+      Dump.Set(Pdpt, PdptIdx, (PdptIdx << 18) | Pat,
+               RandomFlags(Rng, Present) | LargePage);
+      continue;
+    }
+
+    const uint64_t Pd = Dump.NewTable();
+    Dump.Set(Pdpt, PdptIdx, Pd, Present | Write);
+    for (uint64_t PdIdx = 0; PdIdx < 512; PdIdx += 1 + (Rng() % 4)) {
+      Dump.Set(Pd, PdIdx, (PdIdx << 9) | ((Rng() & 1) ? Pat : 0),
+               RandomFlags(Rng, Present) | LargePage);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  uint64_t Size = 64;
+  uint64_t NumberSamples = 100'000;
+  uint64_t Seed = 0;
+  uint64_t NumberThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::string_view> Positionals;
+  bool Usage = false;
+  for (int Idx = 1; Idx < argc; Idx++) {
+    const std::string_view Arg(argv[Idx]);
+    if (!Arg.starts_with("--")) {
+      Positionals.emplace_back(Arg);
+      continue;
+    }
+
+    if ((Idx + 1) >= argc) {
+      Usage = true;
+      break;
+    }
+
+    if (Arg == "--size") {
+      Size = std::max(1ull, strtoull(argv[++Idx], nullptr, 0));
+    } else if (Arg == "--samples") {
+      NumberSamples = strtoull(argv[++Idx], nullptr, 0);
+    } else if (Arg == "--seed") {
+      Seed = strtoull(argv[++Idx], nullptr, 0);
+    } else if (Arg == "--threads") {
+      NumberThreads = std::max(1ull, strtoull(argv[++Idx], nullptr, 0));
+    } else {
+      Usage = true;
+      break;
+    }
+  }
+
+  if (Usage || Positionals.size() > 2) {
+    fmt::print("./walker-check [--size <tables>] [--samples <n>] "
+               "[--seed <n>] [--threads <n>] [<dump path> [<page dir pa>]]\n");
+    return EXIT_FAILURE;
+  }
+
+  //
+  // Check a real dump if there is one, or the synthetic ones.
+  //
+
+  if (!Positionals.empty()) {
+    const std::optional<uint64_t> Base =
+        Positionals.size() > 1
+            ? std::optional(strtoull(Positionals[1].data(), nullptr, 0))
+            : std::nullopt;
+    return Check(Positionals[0], Base, NumberSamples, NumberThreads, Seed)
+               ? EXIT_SUCCESS
+               : EXIT_FAILURE;
+  }
+
+  std::vector<Scenario_t> Checked(Scenarios.begin(), Scenarios.end());
+  Checked.push_back({"large-pages-with-pat", LargePagesWithPat});
+  bool Success = true;
+  for (const auto &Scenario : Checked) {
+    std::mt19937_64 Rng(Seed + Size);
+    DumpBuilder_t Builder;
+    Scenario.Generate(Builder, Size, Rng);
+    const fs::path DumpFile =
+        fs::temp_directory_path() / fmt::format("{}.dmp", Scenario.Name);
+    if (!Builder.Write(DumpFile)) {
+      return EXIT_FAILURE;
+    }
+
+    Success &= Check(DumpFile, std::nullopt, NumberSamples, NumberThreads,
+                     Seed);
+    fs::remove(DumpFile);
+  }
+
+  return Success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
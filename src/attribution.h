@@ -0,0 +1,416 @@
+// Axel '0vercl0k' Souchet - October 15 2026
+#pragma once
+#include "binaryformat.h"
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include "tape.h"
+#include "translation.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace clairvoyance::attribution {
+
+//
+// A big pool table: the address of PoolBigPageTable and its number of
+// entries (PoolBigPageTableSize); the dump header doesn't point to it, so it
+// has to be given.
+//
+
+struct BigPool_t {
+  uint64_t Va = 0;
+  uint64_t NumberEntries = 0;
+};
+
+//
+// The owners of ranges of the address space, with their names interned in a
+// dictionary. The label 0 is the empty one, for the addresses nobody owns.
+// The ranges are sorted and made disjoint before being joined against a tape;
+// when two of them overlap, the one starting first wins.
+//
+
+class Table_t {
+public:
+  struct Interval_t {
+    uint64_t Start = 0;
+    uint64_t End = 0;
+    uint16_t Label = 0;
+  };
+
+  //
+  // The labels are stored on 16 bits in the output.
+  //
+
+  static constexpr uint64_t MaxNumberLabels = 0x1'00'00;
+
+private:
+  std::vector<std::string> Labels_ = {""};
+  std::unordered_map<std::string, uint16_t> LabelIdxs_;
+  std::vector<Interval_t> Intervals_;
+  uint64_t NumberDropped_ = 0;
+
+public:
+  //
+  // Give [Start, End) to Label. The range is dropped if the dictionary is
+  // full.
+  //
+
+  void Add(const uint64_t Start, const uint64_t End, const std::string &Label) {
+    if (Start >= End) {
+      return;
+    }
+
+    auto Idx = LabelIdxs_.find(Label);
+    if (Idx == LabelIdxs_.end()) {
+      if (Labels_.size() == MaxNumberLabels) {
+        NumberDropped_++;
+        return;
+      }
+
+      Idx = LabelIdxs_.emplace(Label, uint16_t(Labels_.size())).first;
+      Labels_.emplace_back(Label);
+    }
+
+    Intervals_.push_back({Start, End, Idx->second});
+  }
+
+  //
+  // Sort the ranges and clip the ones overlapping the range before them.
+  //
+
+  void Sort() {
+    std::sort(Intervals_.begin(), Intervals_.end(),
+              [](const Interval_t &A, const Interval_t &B) {
+                return A.Start < B.Start;
+              });
+
+    uint64_t End = 0;
+    size_t NumberKept = 0;
+    for (Interval_t Interval : Intervals_) {
+      Interval.Start = std::max(Interval.Start, End);
+      if (Interval.Start >= Interval.End) {
+        continue;
+      }
+
+      End = Interval.End;
+      Intervals_[NumberKept++] = Interval;
+    }
+
+    Intervals_.resize(NumberKept);
+  }
+
+  const std::vector<std::string> &Labels() const { return Labels_; }
+  std::span<const Interval_t> Intervals() const { return Intervals_; }
+  uint64_t NumberDropped() const { return NumberDropped_; }
+};
+
+//
+// Read Size bytes of virtual memory at Va; the read can cross pages. The
+// translations go through the TLB, and every page is released once it has
+// been copied out.
+//
+
+inline bool ReadVirtual(const kdmpparser::KernelDumpParser &DumpParser,
+                        translation::Tlb_t &Tlb, const uint64_t DirectoryBase,
+                        const uint64_t Va, void *Buffer, const uint64_t Size) {
+  uint8_t *Out = (uint8_t *)Buffer;
+  for (uint64_t Offset = 0; Offset < Size;) {
+    const uint64_t Current = Va + Offset;
+    const auto &Translation = Tlb.Translate(DirectoryBase, Current);
+    if (!Translation) {
+      return false;
+    }
+
+    const uint64_t Pa = page::Align(Translation->Pa);
+    const uint8_t *Page = DumpParser.GetPhysicalPage(Pa);
+    if (Page == nullptr) {
+      return false;
+    }
+
+    const uint64_t PageOffset = Current & (page::Size - 1);
+    const uint64_t Length = std::min(Size - Offset, page::Size - PageOffset);
+    memcpy(Out + Offset, Page + PageOffset, Length);
+    DumpParser.ReleasePhysicalPage(Pa);
+    Offset += Length;
+  }
+
+  return true;
+}
+
+//
+// Add the images of the modules of PsLoadedModuleList to the table; the
+// entries are the x64 LDR_DATA_TABLE_ENTRY. The list is followed at most
+// MaxNumberModules times, in case it is corrupt.
+//
+
+inline uint64_t AddModules(const kdmpparser::KernelDumpParser &DumpParser,
+                           translation::Tlb_t &Tlb,
+                           const uint64_t DirectoryBase,
+                           const uint64_t PsLoadedModuleList, Table_t &Table) {
+  constexpr uint64_t MaxNumberModules = 0x10'000;
+  constexpr uint64_t DllBaseOffset = 0x30;
+  constexpr uint64_t SizeOfImageOffset = 0x40;
+  constexpr uint64_t BaseDllNameOffset = 0x58;
+  uint64_t NumberModules = 0;
+  uint64_t Entry = 0;
+  if (PsLoadedModuleList == 0 ||
+      !ReadVirtual(DumpParser, Tlb, DirectoryBase, PsLoadedModuleList,
+                   &Entry, sizeof(Entry))) {
+    return 0;
+  }
+
+  while (Entry != PsLoadedModuleList && NumberModules < MaxNumberModules) {
+    uint64_t DllBase = 0;
+    uint32_t SizeOfImage = 0;
+    uint16_t NameLength = 0;
+    uint64_t NameBuffer = 0;
+    if (!ReadVirtual(DumpParser, Tlb, DirectoryBase, Entry + DllBaseOffset,
+                     &DllBase, sizeof(DllBase)) ||
+        !ReadVirtual(DumpParser, Tlb, DirectoryBase, Entry + SizeOfImageOffset,
+                     &SizeOfImage, sizeof(SizeOfImage)) ||
+        !ReadVirtual(DumpParser, Tlb, DirectoryBase, Entry + BaseDllNameOffset,
+                     &NameLength, sizeof(NameLength)) ||
+        !ReadVirtual(DumpParser, Tlb, DirectoryBase,
+                     Entry + BaseDllNameOffset + 8, &NameBuffer,
+                     sizeof(NameBuffer))) {
+      break;
+    }
+
+    //
+    // The names are UTF-16; anything that isn't ASCII is replaced.
+    //
+
+    std::vector<uint16_t> Wide(NameLength / 2);
+    std::string Name;
+    if (ReadVirtual(DumpParser, Tlb, DirectoryBase, NameBuffer, Wide.data(),
+                    Wide.size() * sizeof(uint16_t))) {
+      for (const uint16_t Character : Wide) {
+        Name.push_back(Character < 0x80 ? char(Character) : '?');
+      }
+    }
+
+    if (Name.empty()) {
+      Name = fmt::format("module-{:#x}", DllBase);
+    }
+
+    Table.Add(page::Align(DllBase),
+              page::Align(DllBase + SizeOfImage + page::Size - 1), Name);
+    NumberModules++;
+    if (!ReadVirtual(DumpParser, Tlb, DirectoryBase, Entry, &Entry,
+                     sizeof(Entry))) {
+      break;
+    }
+  }
+
+  return NumberModules;
+}
+
+//
+// Add the allocations of a big pool table to the table; the entries are the
+// x64 POOL_TRACKER_BIG_PAGES, and the ones whose Va has the low bit set are
+// free. The allocations are labeled with their tag and their pool type.
+//
+
+inline uint64_t AddBigPool(const kdmpparser::KernelDumpParser &DumpParser,
+                           translation::Tlb_t &Tlb,
+                           const uint64_t DirectoryBase, const BigPool_t &Pool,
+                           Table_t &Table) {
+  struct Entry_t {
+    uint64_t Va;
+    uint32_t Key;
+    uint32_t Pattern : 8;
+    uint32_t PoolType : 12;
+    uint32_t SlushSize : 12;
+    uint64_t NumberOfBytes;
+  };
+
+  static_assert(sizeof(Entry_t) == 0x18);
+
+  constexpr uint64_t EntriesPerRead = 0x1'000;
+  std::vector<Entry_t> Entries(EntriesPerRead);
+  uint64_t NumberAllocations = 0;
+  for (uint64_t First = 0; First < Pool.NumberEntries;
+       First += EntriesPerRead) {
+    const uint64_t Count = std::min(EntriesPerRead, Pool.NumberEntries - First);
+    if (!ReadVirtual(DumpParser, Tlb, DirectoryBase,
+                     Pool.Va + (First * sizeof(Entry_t)), Entries.data(),
+                     Count * sizeof(Entry_t))) {
+      fmt::print("The big pool table at {:#x} isn't entirely mapped\n",
+                 Pool.Va);
+      break;
+    }
+
+    for (uint64_t Idx = 0; Idx < Count; Idx++) {
+      const Entry_t &Entry = Entries[Idx];
+      if ((Entry.Va & 1) != 0 || Entry.Va == 0 || Entry.NumberOfBytes == 0) {
+        continue;
+      }
+
+      std::string Tag(4, '.');
+      for (uint64_t Byte = 0; Byte < Tag.size(); Byte++) {
+        const char Character = char(Entry.Key >> (Byte * 8));
+        if (Character >= 0x20 && Character < 0x7f) {
+          Tag[Byte] = Character;
+        }
+      }
+
+      const std::string_view Type =
+          (Entry.PoolType & 1) != 0 ? "Paged" : "NonPaged";
+      const uint64_t Va = page::Align(Entry.Va);
+      const uint64_t End =
+          page::Align(Entry.Va + Entry.NumberOfBytes + page::Size - 1);
+      Table.Add(Va, End, fmt::format("pool {} {}", Tag, Type));
+      NumberAllocations++;
+    }
+  }
+
+  return NumberAllocations;
+}
+
+//
+// The labels of the pixels of a tape: spans of consecutive pixels with the
+// same owner, in the order of the tape.
+//
+
+class Channel_t {
+  std::vector<std::string> Labels_;
+  std::vector<binary::LabelSpan_t> Spans_;
+  uint64_t NumberOwnedPixels_ = 0;
+
+  void Append(const uint16_t Label, const uint64_t Length) {
+    if (Length == 0) {
+      return;
+    }
+
+    NumberOwnedPixels_ += Label != 0 ? Length : 0;
+    if (!Spans_.empty() && Spans_.back().Label == Label) {
+      Spans_.back().Length += Length;
+      return;
+    }
+
+    binary::LabelSpan_t Span;
+    Span.Length = Length;
+    Span.Label = Label;
+    Spans_.emplace_back(Span);
+  }
+
+public:
+  //
+  // Join the sorted ranges of a table against the runs of a tape in a single
+  // pass: the runs and the ranges are both in increasing addresses, so a
+  // cursor in the ranges only ever moves forward. The empty runs (the gaps
+  // drawn in the tape) don't belong to anybody.
+  //
+
+  template <typename Builder_t>
+  static Channel_t Join(const Table_t &Table, const Builder_t &Builder) {
+    Channel_t Channel;
+    Channel.Labels_ = Table.Labels();
+    const auto &Intervals = Table.Intervals();
+    size_t Cursor = 0;
+    uint64_t RunIdx = Builder.Tape().FirstRun();
+    for (const auto &Region : Builder.Regions()) {
+      uint64_t Va = Region.Va;
+      Builder.Tape().ForEachSpan(
+          RunIdx, Region.EndRun,
+          [&](const std::span<const Tape_t::Run_t> &Runs) {
+            for (const auto &Run : Runs) {
+              if (Run.Prot() == ptables::Protection_t::None) {
+                Channel.Append(0, Run.Length);
+                Va += Run.Length * page::Size;
+                continue;
+              }
+
+              const uint64_t End = Va + (Run.Length * page::Size);
+              while (Va < End) {
+                while (Cursor < Intervals.size() &&
+                       Intervals[Cursor].End <= Va) {
+                  Cursor++;
+                }
+
+                if (Cursor == Intervals.size() ||
+                    Intervals[Cursor].Start >= End) {
+                  Channel.Append(0, (End - Va) / page::Size);
+                  Va = End;
+                  break;
+                }
+
+                const auto &Interval = Intervals[Cursor];
+                if (Interval.Start > Va) {
+                  Channel.Append(0, (Interval.Start - Va) / page::Size);
+                  Va = Interval.Start;
+                }
+
+                const uint64_t Stop = std::min(End, Interval.End);
+                Channel.Append(Interval.Label, (Stop - Va) / page::Size);
+                Va = Stop;
+              }
+            }
+          });
+
+      RunIdx = Region.EndRun;
+    }
+
+    return Channel;
+  }
+
+  //
+  // Get the size of the labels section of the binary format.
+  //
+
+  uint64_t EncodedSize() const {
+    return binary::LabelsSize(Labels_, Spans_.size());
+  }
+
+  //
+  // Encode the labels section of the binary format in Out, which is
+  // EncodedSize() bytes long.
+  //
+
+  void Encode(uint8_t *Out) const {
+    binary::EncodeLabels(Out, Labels_, Spans_);
+  }
+
+  bool Empty() const { return Spans_.empty(); }
+  const std::vector<std::string> &Labels() const { return Labels_; }
+  std::span<const binary::LabelSpan_t> Spans() const { return Spans_; }
+  uint64_t NumberOwnedPixels() const { return NumberOwnedPixels_; }
+};
+
+//
+// Build the table of the owners of the kernel address space of a dump: the
+// modules of its PsLoadedModuleList and the allocations of the big pool
+// tables. The structures are read through DirectoryBase.
+//
+
+inline Table_t Build(const kdmpparser::KernelDumpParser &DumpParser,
+                     const uint64_t DirectoryBase,
+                     const std::vector<BigPool_t> &BigPools, const bool La57) {
+  Table_t Table;
+  translation::Tlb_t Tlb(DumpParser, La57);
+  const uint64_t NumberModules =
+      AddModules(DumpParser, Tlb, DirectoryBase,
+                 DumpParser.GetPsLoadedModuleList(), Table);
+  uint64_t NumberAllocations = 0;
+  for (const auto &Pool : BigPools) {
+    NumberAllocations +=
+        AddBigPool(DumpParser, Tlb, DirectoryBase, Pool, Table);
+  }
+
+  if (Table.NumberDropped() > 0) {
+    fmt::print("Dropped {} ranges as there are too many labels\n",
+               Table.NumberDropped());
+  }
+
+  Table.Sort();
+  fmt::print("Found {} modules and {} big pool allocations ({} labels)\n",
+             NumberModules, NumberAllocations, Table.Labels().size() - 1);
+  return Table;
+}
+
+} // namespace clairvoyance::attribution
@@ -0,0 +1,990 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "pagetables.h"
+#include "textformat.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace clairvoyance::binary {
+
+namespace fs = std::filesystem;
+
+//
+// The binary version of the .clairvoyance format is laid out like this:
+//   - a Header_t,
+//   - Header_t::NumberRegions Region_t entries,
+//   - Header_t::NumberRuns Run_t entries.
+// Every region describes a contiguous piece of the tape starting at Va, and
+// points to the runs of identical protections making it up; every pixel of it
+// stands for Scale pages, and it is followed on the curve by Padding empty
+// pixels that are not stored. Everything is stored little-endian. Version 1
+// didn't have the padding field; it was stored in the runs instead. Versions
+// 1 and 2 stored 56-bit lengths and no attributes. Versions 1 to 3 didn't
+// have the scale field, a pixel was always a page.
+//
+// A progressive file is made of several of those documents back to back,
+// every one of them a finer picture of the same address space than the one
+// before; the first one is written quickly so that there is something to
+// look at while the others are being computed.
+//
+// The last document can be followed by a labels section naming the owner of
+// the pixels (see attribution.h):
+//   - a LabelsHeader_t,
+//   - LabelsHeader_t::NumberLabels NUL-terminated labels, StringsSize bytes
+//     in total; the first one is empty and means that nobody owns the pixel,
+//   - LabelsHeader_t::NumberSpans LabelSpan_t entries giving the label of
+//     the pixels of the regions, in order; the padding isn't covered.
+//
+// Every document can then be followed by an index section, so that a pixel
+// can be found without reading the file from the start:
+//   - an IndexHeader_t,
+//   - IndexHeader_t::NumberEntries IndexEntry_t entries; the n-th one tells
+//     where the pixel at distance n * Stride on the curve is,
+//   - an IndexFooter_t pointing to the IndexHeader_t. The one at the end of
+//     the file is the one of the finest document.
+//
+
+constexpr uint32_t Magic = 0x59'56'4c'43; // 'CLVY'
+constexpr uint32_t Version = 4;
+constexpr uint32_t LabelsMagic = 0x4c'56'4c'43; // 'CLVL'
+constexpr uint32_t LabelsVersion = 1;
+constexpr uint32_t IndexMagic = 0x58'56'4c'43; // 'CLVX'
+constexpr uint32_t IndexVersion = 1;
+
+//
+// The number of pixels between two entries of the index.
+//
+
+constexpr uint64_t DefaultIndexStride = 0x1'00'00;
+
+struct Header_t {
+  uint32_t Magic = binary::Magic;
+  uint32_t Version = binary::Version;
+  uint64_t Width = 0;
+  uint64_t Height = 0;
+  uint64_t NumberPixels = 0;
+  uint64_t NumberRegions = 0;
+  uint64_t NumberRuns = 0;
+};
+
+static_assert(sizeof(Header_t) == 0x30);
+
+struct Region_t {
+  uint64_t Va = 0;
+  uint64_t NumberPixels = 0;
+  uint64_t FirstRun = 0;
+  uint64_t NumberRuns = 0;
+  uint64_t Padding = 0;
+  uint64_t Scale = 1;
+};
+
+static_assert(sizeof(Region_t) == 0x30);
+
+//
+// The size of a region in a version of the format.
+//
+
+constexpr size_t RegionSize(const uint32_t Version) {
+  return Version == 1 ? 0x20 : Version < 4 ? 0x28 : sizeof(Region_t);
+}
+
+struct Run_t {
+  uint64_t Length : 48 = 0;
+  uint64_t Protection : 8 = 0;
+  uint64_t Attributes : 8 = 0;
+};
+
+static_assert(sizeof(Run_t) == 8);
+
+struct LabelsHeader_t {
+  uint32_t Magic = LabelsMagic;
+  uint32_t Version = LabelsVersion;
+  uint64_t NumberLabels = 0;
+  uint64_t NumberSpans = 0;
+  uint64_t StringsSize = 0;
+};
+
+static_assert(sizeof(LabelsHeader_t) == 0x20);
+
+struct LabelSpan_t {
+  uint64_t Length : 48 = 0;
+  uint64_t Label : 16 = 0;
+};
+
+static_assert(sizeof(LabelSpan_t) == 8);
+
+//
+// DocumentOffset is the offset of the Header_t of the document the index is
+// about, and IndexOffset the one of the IndexHeader_t; they are relative to
+// the beginning of the file.
+//
+
+struct IndexHeader_t {
+  uint32_t Magic = IndexMagic;
+  uint32_t Version = IndexVersion;
+  uint64_t Stride = 0;
+  uint64_t NumberEntries = 0;
+  uint64_t DocumentOffset = 0;
+};
+
+static_assert(sizeof(IndexHeader_t) == 0x20);
+
+//
+// The pixel is Offset pixels into the run Run of the region Region, whose
+// first pixel is at Va. A pixel of the padding has Run set past the runs of
+// its region, Offset is then relative to the beginning of the padding and Va
+// is the end of the region.
+//
+
+struct IndexEntry_t {
+  uint64_t Region = 0;
+  uint64_t Run = 0;
+  uint64_t Offset = 0;
+  uint64_t Va = 0;
+};
+
+static_assert(sizeof(IndexEntry_t) == 0x20);
+
+struct IndexFooter_t {
+  uint64_t IndexOffset = 0;
+  uint32_t Magic = IndexMagic;
+  uint32_t Version = IndexVersion;
+};
+
+static_assert(sizeof(IndexFooter_t) == 0x10);
+
+//
+// Build the index of a document; the regions and their runs are fed in
+// order.
+//
+
+class IndexBuilder_t {
+  std::vector<IndexEntry_t> Entries_;
+  uint64_t Stride_ = DefaultIndexStride;
+  uint64_t Distance_ = 0;
+  uint64_t Next_ = 0;
+  uint64_t Scale_ = 1;
+  IndexEntry_t Current_;
+
+  void Cover(const uint64_t Length) {
+    while (Next_ < (Distance_ + Length)) {
+      Current_.Offset = Next_ - Distance_;
+      Entries_.emplace_back(Current_);
+      Next_ += Stride_;
+    }
+
+    Distance_ += Length;
+  }
+
+public:
+  explicit IndexBuilder_t(const uint64_t Stride = DefaultIndexStride)
+      : Stride_(Stride) {}
+
+  //
+  // Get the size of the index section of NumberDistances pixels, the padding
+  // included.
+  //
+
+  static uint64_t EncodedSize(const uint64_t NumberDistances,
+                              const uint64_t Stride = DefaultIndexStride) {
+    const uint64_t NumberEntries = (NumberDistances + Stride - 1) / Stride;
+    return sizeof(IndexHeader_t) + (NumberEntries * sizeof(IndexEntry_t)) +
+           sizeof(IndexFooter_t);
+  }
+
+  void BeginRegion(const uint64_t RegionIdx, const uint64_t Va,
+                   const uint64_t FirstRun, const uint64_t Scale = 1) {
+    Current_.Region = RegionIdx;
+    Current_.Run = FirstRun;
+    Current_.Va = Va;
+    Scale_ = Scale;
+  }
+
+  void Run(const uint64_t Length) {
+    Cover(Length);
+    Current_.Run++;
+    Current_.Va += Length * Scale_ * page::Size;
+  }
+
+  void Pad(const uint64_t Padding) { Cover(Padding); }
+
+  //
+  // Encode the index section in Out, which is EncodedSize() bytes long and
+  // IndexOffset bytes into the file.
+  //
+
+  void Encode(uint8_t *Out, const uint64_t DocumentOffset,
+              const uint64_t IndexOffset) const {
+    IndexHeader_t Header;
+    Header.Stride = Stride_;
+    Header.NumberEntries = Entries_.size();
+    Header.DocumentOffset = DocumentOffset;
+    memcpy(Out, &Header, sizeof(Header));
+    Out += sizeof(Header);
+    memcpy(Out, Entries_.data(), Entries_.size() * sizeof(IndexEntry_t));
+    Out += Entries_.size() * sizeof(IndexEntry_t);
+    IndexFooter_t Footer;
+    Footer.IndexOffset = IndexOffset;
+    memcpy(Out, &Footer, sizeof(Footer));
+  }
+};
+
+//
+// Get the size of a labels section.
+//
+
+inline uint64_t LabelsSize(std::span<const std::string> Labels,
+                           const uint64_t NumberSpans) {
+  uint64_t Size = sizeof(LabelsHeader_t);
+  for (const auto &Label : Labels) {
+    Size += Label.size() + 1;
+  }
+
+  return Size + (NumberSpans * sizeof(LabelSpan_t));
+}
+
+//
+// Encode a labels section in Out, which is LabelsSize() bytes long.
+//
+
+inline void EncodeLabels(uint8_t *Out, std::span<const std::string> Labels,
+                         std::span<const LabelSpan_t> Spans) {
+  LabelsHeader_t Header;
+  Header.NumberLabels = Labels.size();
+  Header.NumberSpans = Spans.size();
+  uint8_t *Strings = Out + sizeof(Header);
+  for (const auto &Label : Labels) {
+    memcpy(Strings, Label.c_str(), Label.size() + 1);
+    Strings += Label.size() + 1;
+    Header.StringsSize += Label.size() + 1;
+  }
+
+  memcpy(Strings, Spans.data(), Spans.size() * sizeof(LabelSpan_t));
+  memcpy(Out, &Header, sizeof(Header));
+}
+
+//
+// Convert a run stored by version 1 or 2 of the format.
+//
+
+constexpr Run_t RunFromV2(const uint64_t Raw) {
+  Run_t Run;
+  Run.Length = Raw & ((1ull << 56) - 1);
+  Run.Protection = Raw >> 56;
+  return Run;
+}
+
+//
+// The writer collects regions and runs and serializes them in one go as the
+// header needs to know how many of them there are.
+//
+
+class Writer_t {
+  std::vector<Region_t> Regions_;
+  std::vector<Run_t> Runs_;
+  uint64_t NumberPixels_ = 0;
+
+public:
+  //
+  // Start a new region at Va, of Scale pages per pixel.
+  //
+
+  void BeginRegion(const uint64_t Va, const uint64_t Scale = 1) {
+    Region_t Region;
+    Region.Va = Va;
+    Region.Scale = Scale;
+    Region.FirstRun = Runs_.size();
+    Regions_.emplace_back(Region);
+  }
+
+  //
+  // Append Length pixels of Protection to the current region; consecutive
+  // identical protections and attributes are merged into a single run.
+  //
+
+  void Append(const ptables::Protection_t Protection, const uint64_t Length,
+              const uint8_t Attributes = 0) {
+    if (Length == 0) {
+      return;
+    }
+
+    auto &Region = Regions_.back();
+    Region.NumberPixels += Length;
+    NumberPixels_ += Length;
+
+    const uint64_t Protection8 = uint64_t(Protection);
+    if (Region.NumberRuns > 0 && Runs_.back().Protection == Protection8 &&
+        Runs_.back().Attributes == Attributes) {
+      Runs_.back().Length += Length;
+      return;
+    }
+
+    Run_t Run;
+    Run.Length = Length;
+    Run.Protection = Protection8;
+    Run.Attributes = Attributes;
+    Runs_.emplace_back(Run);
+    Region.NumberRuns++;
+  }
+
+  //
+  // Set the number of empty pixels following the current region.
+  //
+
+  void Pad(const uint64_t Padding) { Regions_.back().Padding = Padding; }
+
+  //
+  // Serialize everything on disk.
+  //
+
+  bool Write(const fs::path &Filename, const uint64_t Width,
+             const uint64_t Height) const {
+    Header_t Header;
+    Header.Width = Width;
+    Header.Height = Height;
+    Header.NumberPixels = NumberPixels_;
+    Header.NumberRegions = Regions_.size();
+    Header.NumberRuns = Runs_.size();
+
+    FILE *File = fopen(Filename.string().c_str(), "wb");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    const bool Success =
+        fwrite(&Header, sizeof(Header), 1, File) == 1 &&
+        fwrite(Regions_.data(), sizeof(Region_t), Regions_.size(), File) ==
+            Regions_.size() &&
+        fwrite(Runs_.data(), sizeof(Run_t), Runs_.size(), File) ==
+            Runs_.size();
+
+    fclose(File);
+    return Success;
+  }
+
+  //
+  // Append the index section of what was serialized by Write to the end of
+  // the file; it goes after the labels section if there is one.
+  //
+
+  bool WriteIndex(const fs::path &Filename) const {
+    IndexBuilder_t Builder;
+    uint64_t NumberDistances = 0;
+    for (uint64_t Idx = 0; Idx < Regions_.size(); Idx++) {
+      const auto &Region = Regions_[Idx];
+      Builder.BeginRegion(Idx, Region.Va, Region.FirstRun, Region.Scale);
+      for (uint64_t RunIdx = 0; RunIdx < Region.NumberRuns; RunIdx++) {
+        Builder.Run(Runs_[Region.FirstRun + RunIdx].Length);
+      }
+
+      Builder.Pad(Region.Padding);
+      NumberDistances += Region.NumberPixels + Region.Padding;
+    }
+
+    FILE *File = fopen(Filename.string().c_str(), "ab");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    std::vector<uint8_t> Index(IndexBuilder_t::EncodedSize(NumberDistances));
+    const long IndexOffset =
+        fseek(File, 0, SEEK_END) == 0 ? ftell(File) : -1;
+    if (IndexOffset >= 0) {
+      Builder.Encode(Index.data(), 0, IndexOffset);
+    }
+
+    const bool Success =
+        IndexOffset >= 0 && fwrite(Index.data(), Index.size(), 1, File) == 1;
+    return fclose(File) == 0 && Success;
+  }
+};
+
+//
+// The reader loads a binary .clairvoyance file and validates it, so that the
+// regions and runs can be consumed without any text parsing. The finest
+// complete document of a progressive file is the one that gets loaded.
+//
+
+class Reader_t {
+  Header_t Header_;
+  uint64_t DocumentOffset_ = 0;
+  std::vector<Region_t> Regions_;
+  std::vector<Run_t> Runs_;
+  std::vector<std::string> Labels_;
+  std::vector<LabelSpan_t> LabelSpans_;
+  uint64_t IndexStride_ = 0;
+  std::vector<IndexEntry_t> Index_;
+
+public:
+  //
+  // Is this file a binary .clairvoyance file?
+  //
+
+  static bool IsBinary(const fs::path &Filename) {
+    std::ifstream File(Filename, std::ios::binary);
+    uint32_t FileMagic = 0;
+    File.read((char *)&FileMagic, sizeof(FileMagic));
+    return File.good() && FileMagic == Magic;
+  }
+
+  bool Read(const fs::path &Filename) {
+    std::ifstream File(Filename, std::ios::binary);
+    if (!ReadDocument(File, Filename, false)) {
+      return false;
+    }
+
+    //
+    // The documents following the first one are finer; the last one might
+    // still be in the works, in which case the one before it is kept. The
+    // labels and the index sections go with the document they follow.
+    //
+
+    Reader_t Finer;
+    while (File.peek() != std::ifstream::traits_type::eof()) {
+      if (NextIs(File, LabelsMagic)) {
+        if (!ReadLabels(File, Filename)) {
+          return false;
+        }
+
+        continue;
+      }
+
+      if (NextIs(File, IndexMagic)) {
+        if (!ReadIndex(File, Filename)) {
+          return false;
+        }
+
+        continue;
+      }
+
+      if (!Finer.ReadDocument(File, Filename, true)) {
+        break;
+      }
+
+      *this = std::move(Finer);
+    }
+
+    return true;
+  }
+
+  const Header_t &Header() const { return Header_; }
+
+  std::span<const Region_t> Regions() const { return Regions_; }
+
+  std::span<const Run_t> Runs(const Region_t &Region) const {
+    return std::span(Runs_).subspan(Region.FirstRun, Region.NumberRuns);
+  }
+
+  //
+  // Get the labels of the pixels; they are empty if the file doesn't have
+  // any.
+  //
+
+  const std::vector<std::string> &Labels() const { return Labels_; }
+
+  std::span<const LabelSpan_t> LabelSpans() const { return LabelSpans_; }
+
+  //
+  // Get the index of the document and its stride; it is empty if the file
+  // doesn't have one.
+  //
+
+  std::span<const IndexEntry_t> Index() const { return Index_; }
+
+  uint64_t IndexStride() const { return IndexStride_; }
+
+  //
+  // Write the ranges of addresses every label owns, a
+  // `<start>-<end> <label>` line each.
+  //
+
+  bool WriteLabels(const fs::path &Filename) const {
+    FILE *File = fopen(Filename.string().c_str(), "wb");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    uint64_t SpanIdx = 0;
+    uint64_t SpanLeft = LabelSpans_.empty() ? 0 : LabelSpans_[0].Length;
+    for (const auto &Region : Regions_) {
+      uint64_t Va = Region.Va;
+      uint64_t Left = Region.NumberPixels;
+      while (Left > 0 && SpanIdx < LabelSpans_.size()) {
+        const uint64_t Length = std::min(Left, SpanLeft);
+        const uint64_t Label = LabelSpans_[SpanIdx].Label;
+        const uint64_t End = Va + (Length * Region.Scale * page::Size);
+        if (Label != 0) {
+          fmt::print(File, "{:#018x}-{:#018x} {}\n", Va, End,
+                     Labels_[Label]);
+        }
+
+        Va = End;
+        Left -= Length;
+        SpanLeft -= Length;
+        if (SpanLeft == 0 && ++SpanIdx < LabelSpans_.size()) {
+          SpanLeft = LabelSpans_[SpanIdx].Length;
+        }
+      }
+    }
+
+    const bool Success = ferror(File) == 0;
+    fclose(File);
+    return Success;
+  }
+
+  //
+  // Convert the file to the text version of the format; it doesn't have a
+  // scale, so only the files where a pixel is a page can be.
+  //
+
+  bool WriteText(const fs::path &Filename) const {
+    if (std::any_of(Regions_.begin(), Regions_.end(),
+                    [](const Region_t &Region) { return Region.Scale != 1; })) {
+      fmt::print("The pixels are not pages, the file can't be converted to "
+                 "the text format\n");
+      return false;
+    }
+
+    FILE *File = fopen(Filename.string().c_str(), "wb");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    bool Success = true;
+    {
+      text::LineWriter_t Writer(File);
+      Writer.Line(fmt::format("{} {}", Header_.Width, Header_.Height));
+      for (const auto &Region : Regions_) {
+        Writer.Line(fmt::format("{:#x}", Region.Va));
+        for (const auto &Run : Runs(Region)) {
+          Writer.Lines(Run.Length, ptables::Protection_t(Run.Protection));
+        }
+
+        Writer.Lines(Region.Padding, ptables::Protection_t::None);
+      }
+
+      Success = Writer.Flush();
+    }
+
+    fclose(File);
+    return Success;
+  }
+
+private:
+  //
+  // Is a section starting with SectionMagic at the current position of File?
+  //
+
+  static bool NextIs(std::ifstream &File, const uint32_t SectionMagic) {
+    const auto Begin = File.tellg();
+    uint32_t NextMagic = 0;
+    File.read((char *)&NextMagic, sizeof(NextMagic));
+    const bool Found = File.good() && NextMagic == SectionMagic;
+    File.clear();
+    File.seekg(Begin);
+    return Found;
+  }
+
+  //
+  // Read the index section at the current position of File and make sure it
+  // is the one of the document.
+  //
+
+  bool ReadIndex(std::ifstream &File, const fs::path &Filename) {
+    const auto Begin = File.tellg();
+    File.seekg(0, std::ios::end);
+    const uint64_t Remaining = uint64_t(File.tellg() - Begin);
+    File.seekg(Begin);
+    IndexHeader_t Header;
+    if (!File.read((char *)&Header, sizeof(Header)) ||
+        Header.Version != IndexVersion || Header.Stride == 0 ||
+        Header.DocumentOffset != DocumentOffset_) {
+      fmt::print("{} has an invalid index\n", Filename.string());
+      return false;
+    }
+
+    const uint64_t MaxCount = Remaining / sizeof(IndexEntry_t);
+    IndexFooter_t Footer;
+    if (Header.NumberEntries > MaxCount ||
+        (sizeof(Header) + (Header.NumberEntries * sizeof(IndexEntry_t)) +
+         sizeof(Footer)) > Remaining) {
+      fmt::print("{} has a truncated index\n", Filename.string());
+      return false;
+    }
+
+    Index_.resize(Header.NumberEntries);
+    if (!File.read((char *)Index_.data(),
+                   Index_.size() * sizeof(IndexEntry_t)) ||
+        !File.read((char *)&Footer, sizeof(Footer))) {
+      fmt::print("{} has a truncated index\n", Filename.string());
+      return false;
+    }
+
+    uint64_t NumberDistances = 0;
+    for (const auto &Region : Regions_) {
+      NumberDistances += Region.NumberPixels + Region.Padding;
+    }
+
+    const uint64_t NumberEntries =
+        (NumberDistances + Header.Stride - 1) / Header.Stride;
+    if (Footer.Magic != IndexMagic || Footer.IndexOffset != uint64_t(Begin) ||
+        NumberEntries != Header.NumberEntries) {
+      fmt::print("{} has an invalid index\n", Filename.string());
+      return false;
+    }
+
+    IndexStride_ = Header.Stride;
+    return true;
+  }
+
+  //
+  // Read the labels section at the current position of File and make sure
+  // it covers the pixels of the document.
+  //
+
+  bool ReadLabels(std::ifstream &File, const fs::path &Filename) {
+    const auto Begin = File.tellg();
+    File.seekg(0, std::ios::end);
+    const uint64_t Remaining = uint64_t(File.tellg() - Begin);
+    File.seekg(Begin);
+    LabelsHeader_t Header;
+    if (!File.read((char *)&Header, sizeof(Header)) ||
+        Header.Version != LabelsVersion) {
+      fmt::print("{} has invalid labels\n", Filename.string());
+      return false;
+    }
+
+    const uint64_t MaxCount = Remaining / sizeof(LabelSpan_t);
+    if (Header.NumberSpans > MaxCount || Header.StringsSize > Remaining ||
+        (sizeof(Header) + Header.StringsSize +
+         (Header.NumberSpans * sizeof(LabelSpan_t))) > Remaining) {
+      fmt::print("{} has truncated labels\n", Filename.string());
+      return false;
+    }
+
+    std::string Strings(Header.StringsSize, '\0');
+    LabelSpans_.resize(Header.NumberSpans);
+    if (!File.read(Strings.data(), Strings.size()) ||
+        !File.read((char *)LabelSpans_.data(),
+                   LabelSpans_.size() * sizeof(LabelSpan_t))) {
+      fmt::print("{} has truncated labels\n", Filename.string());
+      return false;
+    }
+
+    for (size_t Offset = 0; Offset < Strings.size();) {
+      const size_t End = Strings.find('\0', Offset);
+      if (End == std::string::npos) {
+        break;
+      }
+
+      Labels_.emplace_back(Strings.substr(Offset, End - Offset));
+      Offset = End + 1;
+    }
+
+    uint64_t NumberPixels = 0;
+    for (const auto &Span : LabelSpans_) {
+      NumberPixels += Span.Length;
+      if (Span.Label >= Labels_.size()) {
+        fmt::print("{} has a span with an invalid label\n", Filename.string());
+        return false;
+      }
+    }
+
+    if (Labels_.size() != Header.NumberLabels ||
+        NumberPixels != Header_.NumberPixels) {
+      fmt::print("{} has invalid labels\n", Filename.string());
+      return false;
+    }
+
+    return true;
+  }
+
+  //
+  // Read the document at the current position of File; the errors are not
+  // reported if Quiet is set.
+  //
+
+  bool ReadDocument(std::ifstream &File, const fs::path &Filename,
+                    const bool Quiet) {
+    const auto Fail = [&](const std::string &Message) {
+      if (!Quiet) {
+        fmt::print("{}\n", Message);
+      }
+
+      return false;
+    };
+
+    const auto Begin = File.tellg();
+    File.seekg(0, std::ios::end);
+    const uint64_t Remaining = uint64_t(File.tellg() - Begin);
+    File.seekg(Begin);
+    DocumentOffset_ = uint64_t(Begin);
+    if (!File.read((char *)&Header_, sizeof(Header_))) {
+      return Fail(
+          fmt::format("Could not read the header of {}", Filename.string()));
+    }
+
+    if (Header_.Magic != Magic) {
+      return Fail(fmt::format("{} is not a binary .clairvoyance file",
+                              Filename.string()));
+    }
+
+    if (Header_.Version == 0 || Header_.Version > Version) {
+      return Fail(fmt::format("{} has an unsupported version ({})",
+                              Filename.string(), Header_.Version));
+    }
+
+    //
+    // Don't trust the counts of the header before making sure that the file
+    // is large enough for them.
+    //
+
+    const size_t RegionSize = binary::RegionSize(Header_.Version);
+    const uint64_t MaxCount = Remaining / sizeof(Run_t);
+    if (Header_.NumberRegions > MaxCount || Header_.NumberRuns > MaxCount ||
+        (sizeof(Header_) + (Header_.NumberRegions * RegionSize) +
+         (Header_.NumberRuns * sizeof(Run_t))) > Remaining) {
+      return Fail(fmt::format("{} is truncated", Filename.string()));
+    }
+
+    Regions_.resize(Header_.NumberRegions);
+    Runs_.resize(Header_.NumberRuns);
+    bool Truncated = false;
+    for (auto &Region : Regions_) {
+      if (!File.read((char *)&Region, RegionSize)) {
+        Truncated = true;
+        break;
+      }
+    }
+
+    if (Truncated ||
+        !File.read((char *)Runs_.data(), Runs_.size() * sizeof(Run_t))) {
+      return Fail(fmt::format("{} is truncated", Filename.string()));
+    }
+
+    if (Header_.Version < 3) {
+      for (auto &Run : Runs_) {
+        Run = RunFromV2(std::bit_cast<uint64_t>(Run));
+      }
+    }
+
+    //
+    // Make sure the regions point inside the run table, that the runs have a
+    // valid protection (it indexes the palettes of the renderers) and that
+    // the sizes add up.
+    //
+
+    uint64_t NumberPixels = 0;
+    for (const auto &Region : Regions_) {
+      if (Region.FirstRun > Runs_.size() ||
+          Region.NumberRuns > (Runs_.size() - Region.FirstRun)) {
+        return Fail(fmt::format("{} has a region with invalid runs",
+                                Filename.string()));
+      }
+
+      if (Region.Scale == 0) {
+        return Fail(fmt::format("{} has a region with an invalid scale",
+                                Filename.string()));
+      }
+
+      uint64_t RegionPixels = 0;
+      for (const auto &Run : Runs(Region)) {
+        if (Run.Protection >
+            uint64_t(ptables::Protection_t::KernelReadWriteExec)) {
+          return Fail(fmt::format("{} has a region with invalid runs",
+                                  Filename.string()));
+        }
+
+        RegionPixels += Run.Length;
+      }
+
+      if (RegionPixels != Region.NumberPixels) {
+        return Fail(fmt::format("{} has a region with an invalid size",
+                                Filename.string()));
+      }
+
+      NumberPixels += RegionPixels;
+    }
+
+    if (NumberPixels != Header_.NumberPixels) {
+      return Fail(fmt::format("{} has an invalid number of pixels",
+                              Filename.string()));
+    }
+
+    return true;
+  }
+};
+
+//
+// A pixel found by Seeker_t::Locate. The pixels of the padding don't have an
+// address.
+//
+
+struct Pixel_t {
+  uint64_t Region = 0;
+  std::optional<uint64_t> Va;
+  ptables::Protection_t Protection = ptables::Protection_t::None;
+  uint8_t Attributes = 0;
+  uint64_t Scale = 1;
+};
+
+//
+// The seeker finds the pixels of the last document of a binary .clairvoyance
+// file with its index, without reading the file from the start: a pixel
+// costs reading an index entry, and at most Stride pixels worth of runs from
+// there.
+//
+
+class Seeker_t {
+  std::ifstream File_;
+  Header_t Header_;
+  IndexHeader_t Index_;
+  uint64_t IndexOffset_ = 0;
+  size_t RegionSize_ = sizeof(Region_t);
+
+  bool ReadAt(const uint64_t Offset, void *Out, const size_t Size) {
+    File_.clear();
+    File_.seekg(Offset);
+    return bool(File_.read((char *)Out, Size));
+  }
+
+  bool ReadRegion(const uint64_t RegionIdx, Region_t &Region) {
+    return RegionIdx < Header_.NumberRegions &&
+           ReadAt(Index_.DocumentOffset + sizeof(Header_) +
+                      (RegionIdx * RegionSize_),
+                  &Region, RegionSize_) &&
+           Region.FirstRun <= Header_.NumberRuns &&
+           Region.NumberRuns <= (Header_.NumberRuns - Region.FirstRun);
+  }
+
+public:
+  bool Open(const fs::path &Filename) {
+    File_.open(Filename, std::ios::binary);
+    File_.seekg(0, std::ios::end);
+    const uint64_t Size = File_ ? uint64_t(File_.tellg()) : 0;
+    IndexFooter_t Footer;
+    if (Size < sizeof(Footer) ||
+        !ReadAt(Size - sizeof(Footer), &Footer, sizeof(Footer)) ||
+        Footer.Magic != IndexMagic || Footer.Version != IndexVersion) {
+      fmt::print("{} doesn't have an index\n", Filename.string());
+      return false;
+    }
+
+    IndexOffset_ = Footer.IndexOffset;
+    const uint64_t MaxCount = Size / sizeof(IndexEntry_t);
+    if (IndexOffset_ >= Size ||
+        !ReadAt(IndexOffset_, &Index_, sizeof(Index_)) ||
+        Index_.Magic != IndexMagic || Index_.Version != IndexVersion ||
+        Index_.Stride == 0 || Index_.NumberEntries > MaxCount ||
+        (IndexOffset_ + sizeof(Index_) +
+         (Index_.NumberEntries * sizeof(IndexEntry_t)) + sizeof(Footer)) !=
+            Size) {
+      fmt::print("{} has an invalid index\n", Filename.string());
+      return false;
+    }
+
+    //
+    // The index appeared in version 3.
+    //
+
+    const uint64_t MaxRuns = IndexOffset_ / sizeof(Run_t);
+    if (Index_.DocumentOffset >= IndexOffset_ ||
+        !ReadAt(Index_.DocumentOffset, &Header_, sizeof(Header_)) ||
+        Header_.Magic != Magic || Header_.Version < 3 ||
+        Header_.Version > Version) {
+      fmt::print("{} has an invalid document\n", Filename.string());
+      return false;
+    }
+
+    RegionSize_ = RegionSize(Header_.Version);
+    if (Header_.NumberRegions > MaxRuns || Header_.NumberRuns > MaxRuns ||
+        (Index_.DocumentOffset + sizeof(Header_) +
+         (Header_.NumberRegions * RegionSize_) +
+         (Header_.NumberRuns * sizeof(Run_t))) > IndexOffset_) {
+      fmt::print("{} has an invalid document\n", Filename.string());
+      return false;
+    }
+
+    return true;
+  }
+
+  const Header_t &Header() const { return Header_; }
+
+  //
+  // Find the pixel at Distance on the curve; there is none past the end of
+  // the tape.
+  //
+
+  std::optional<Pixel_t> Locate(const uint64_t Distance) {
+    const uint64_t EntryIdx = Distance / Index_.Stride;
+    IndexEntry_t Entry;
+    if (EntryIdx >= Index_.NumberEntries ||
+        !ReadAt(IndexOffset_ + sizeof(Index_) +
+                    (EntryIdx * sizeof(IndexEntry_t)),
+                &Entry, sizeof(Entry))) {
+      return std::nullopt;
+    }
+
+    const uint64_t RunsOffset = Index_.DocumentOffset + sizeof(Header_) +
+                                (Header_.NumberRegions * RegionSize_);
+    uint64_t Left = Entry.Offset + (Distance % Index_.Stride);
+    uint64_t RunIdx = Entry.Run;
+    uint64_t Va = Entry.Va;
+    Region_t Region;
+    for (uint64_t RegionIdx = Entry.Region; ReadRegion(RegionIdx, Region);
+         RegionIdx++) {
+      if (RegionIdx != Entry.Region) {
+        RunIdx = Region.FirstRun;
+        Va = Region.Va;
+      }
+
+      const uint64_t EndRun = Region.FirstRun + Region.NumberRuns;
+      if (RunIdx < Region.FirstRun || RunIdx > EndRun) {
+        return std::nullopt;
+      }
+
+      File_.clear();
+      File_.seekg(RunsOffset + (RunIdx * sizeof(Run_t)));
+      for (; RunIdx < EndRun; RunIdx++) {
+        Run_t Run;
+        if (!File_.read((char *)&Run, sizeof(Run))) {
+          return std::nullopt;
+        }
+
+        if (Left < Run.Length) {
+          return Pixel_t{RegionIdx, Va + (Left * Region.Scale * page::Size),
+                         ptables::Protection_t(Run.Protection),
+                         uint8_t(Run.Attributes), Region.Scale};
+        }
+
+        Left -= Run.Length;
+        Va += Run.Length * Region.Scale * page::Size;
+      }
+
+      if (Left < Region.Padding) {
+        return Pixel_t{RegionIdx, std::nullopt, ptables::Protection_t::None,
+                       0, 1};
+      }
+
+      Left -= Region.Padding;
+    }
+
+    return std::nullopt;
+  }
+};
+
+} // namespace clairvoyance::binary
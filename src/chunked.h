@@ -0,0 +1,469 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "kdmp-parser.h"
+#include "spill.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#if defined(LINUX)
+#include <sys/mman.h>
+#endif
+
+namespace clairvoyance {
+
+//
+// A growable array of trivially copyable elements stored in page-aligned
+// chunks: appending never moves what is already there, and moving the
+// elements of another array at the end of this one only moves its chunks
+// around. The chunks start at a page and double up to 2MB, the size of a
+// large page, so that the small arrays stay small and the large ones can be
+// backed by transparent huge pages. The chunks are kept around when the
+// array is emptied, for the next elements. Once spilled, new chunks come out
+// of a SpillFile_t and the array only uses a budget of memory.
+//
+
+template <typename Element_t> class ChunkedVector_t {
+  static_assert(std::is_trivially_copyable_v<Element_t>);
+
+  static constexpr uint64_t PageSize = 0x1000;
+  static constexpr uint64_t MaxChunkBytes = uint64_t(2) << 20;
+
+  //
+  // A chunk; Elements can move past Base when the front of the chunk is
+  // erased.
+  //
+
+  struct Chunk_t {
+    void *Base = nullptr;
+    uint64_t Bytes = 0;
+    Element_t *Elements = nullptr;
+    uint64_t Size = 0;
+    uint64_t Capacity = 0;
+    bool Spilled = false;
+
+    bool Full() const { return Size == Capacity; }
+  };
+
+  //
+  // The chunks holding elements, in order, followed by the empty ones kept
+  // for later; Starts has the index of the first element of every chunk in
+  // use.
+  //
+
+  std::vector<Chunk_t> Chunks_;
+  uint64_t NumberUsed_ = 0;
+  std::vector<uint64_t> Starts_;
+  uint64_t Size_ = 0;
+
+  std::unique_ptr<SpillFile_t> Spill_;
+
+  static constexpr std::align_val_t Alignment(const uint64_t Bytes) {
+    return std::align_val_t(Bytes >= MaxChunkBytes ? MaxChunkBytes : PageSize);
+  }
+
+  Chunk_t NewChunk(const uint64_t Bytes) {
+    Chunk_t Chunk;
+    Chunk.Bytes = Bytes;
+    if (Spill_) {
+      Chunk.Base = Spill_->Allocate(Bytes);
+      Chunk.Spilled = true;
+    } else {
+      Chunk.Base = ::operator new(Bytes, Alignment(Bytes));
+#if defined(LINUX) && defined(MADV_HUGEPAGE)
+      if (Bytes >= MaxChunkBytes) {
+        madvise(Chunk.Base, Bytes, MADV_HUGEPAGE);
+      }
+#endif
+    }
+
+    Chunk.Elements = (Element_t *)Chunk.Base;
+    Chunk.Capacity = Bytes / sizeof(Element_t);
+    return Chunk;
+  }
+
+  static void FreeChunk(const Chunk_t &Chunk) {
+    if (!Chunk.Spilled) {
+      ::operator delete(Chunk.Base, Alignment(Chunk.Bytes));
+    }
+  }
+
+  //
+  // Get a chunk with room for at least one element at the end of the array.
+  //
+
+  Chunk_t &Tail() {
+    if (NumberUsed_ > 0 && !Chunks_[NumberUsed_ - 1].Full()) {
+      return Chunks_[NumberUsed_ - 1];
+    }
+
+    if (NumberUsed_ == Chunks_.size()) {
+      const uint64_t PreviousBytes =
+          Chunks_.empty() ? 0 : Chunks_[NumberUsed_ - 1].Bytes;
+      const uint64_t MaxBytes =
+          Spill_ ? std::clamp(Spill_->BudgetBytes() / 4 & ~(PageSize - 1),
+                              PageSize, MaxChunkBytes)
+                 : MaxChunkBytes;
+      const uint64_t Bytes =
+          std::clamp(PreviousBytes * 2, PageSize, MaxBytes);
+      Chunks_.emplace_back(NewChunk(Bytes));
+    }
+
+    Starts_.emplace_back(Size_);
+    return Chunks_[NumberUsed_++];
+  }
+
+  //
+  // Find the chunk holding an element, and its offset in it; the index past
+  // the last element is in the chunk past the last one.
+  //
+
+  std::pair<uint64_t, uint64_t> Locate(const uint64_t Idx) const {
+    if (Idx >= Size_) {
+      return {NumberUsed_, 0};
+    }
+
+    const auto &It =
+        std::upper_bound(Starts_.begin(), Starts_.begin() + NumberUsed_, Idx);
+    const uint64_t ChunkIdx = uint64_t(It - Starts_.begin()) - 1;
+    return {ChunkIdx, Idx - Starts_[ChunkIdx]};
+  }
+
+  void Release() {
+    for (const auto &Chunk : Chunks_) {
+      FreeChunk(Chunk);
+    }
+
+    Chunks_.clear();
+    Starts_.clear();
+    NumberUsed_ = 0;
+    Size_ = 0;
+  }
+
+public:
+  //
+  // Iterates over a part of the array; the elements of a chunk are
+  // contiguous.
+  //
+
+  class Iterator_t {
+    const ChunkedVector_t *Vector_ = nullptr;
+    uint64_t ChunkIdx_ = 0;
+    uint64_t Offset_ = 0;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Element_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Element_t *;
+    using reference = const Element_t &;
+
+    Iterator_t() = default;
+    Iterator_t(const ChunkedVector_t *Vector, const uint64_t ChunkIdx,
+               const uint64_t Offset)
+        : Vector_(Vector), ChunkIdx_(ChunkIdx), Offset_(Offset) {}
+
+    reference operator*() const {
+      return Vector_->Chunks_[ChunkIdx_].Elements[Offset_];
+    }
+
+    pointer operator->() const { return &**this; }
+
+    Iterator_t &operator++() {
+      if (++Offset_ == Vector_->Chunks_[ChunkIdx_].Size) {
+        ChunkIdx_++;
+        Offset_ = 0;
+      }
+
+      return *this;
+    }
+
+    Iterator_t operator++(int) {
+      Iterator_t Previous = *this;
+      ++*this;
+      return Previous;
+    }
+
+    bool operator==(const Iterator_t &Other) const {
+      return ChunkIdx_ == Other.ChunkIdx_ && Offset_ == Other.Offset_;
+    }
+  };
+
+  //
+  // The elements in [Begin, End).
+  //
+
+  class Range_t {
+    Iterator_t Begin_;
+    Iterator_t End_;
+    uint64_t Size_ = 0;
+
+  public:
+    Range_t(const Iterator_t &Begin, const Iterator_t &End, const uint64_t Size)
+        : Begin_(Begin), End_(End), Size_(Size) {}
+
+    Iterator_t begin() const { return Begin_; }
+    Iterator_t end() const { return End_; }
+    uint64_t size() const { return Size_; }
+    bool empty() const { return Size_ == 0; }
+  };
+
+  ChunkedVector_t() = default;
+  ~ChunkedVector_t() { Release(); }
+
+  //
+  // Copies always live in memory.
+  //
+
+  ChunkedVector_t(const ChunkedVector_t &Other) { *this = Other; }
+
+  ChunkedVector_t &operator=(const ChunkedVector_t &Other) {
+    if (this != &Other) {
+      Release();
+      Spill_.reset();
+      for (uint64_t Idx = 0; Idx < Other.NumberUsed_; Idx++) {
+        const auto &Chunk = Other.Chunks_[Idx];
+        Append(Chunk.Elements, Chunk.Elements + Chunk.Size);
+      }
+    }
+
+    return *this;
+  }
+
+  ChunkedVector_t(ChunkedVector_t &&Other) noexcept {
+    *this = std::move(Other);
+  }
+
+  ChunkedVector_t &operator=(ChunkedVector_t &&Other) noexcept {
+    if (this != &Other) {
+      Release();
+      Chunks_ = std::move(Other.Chunks_);
+      Starts_ = std::move(Other.Starts_);
+      NumberUsed_ = Other.NumberUsed_;
+      Size_ = Other.Size_;
+      Spill_ = std::move(Other.Spill_);
+      Other.Chunks_.clear();
+      Other.Starts_.clear();
+      Other.NumberUsed_ = 0;
+      Other.Size_ = 0;
+    }
+
+    return *this;
+  }
+
+  //
+  // Move the elements to a temporary file in Directory, and keep at most
+  // BudgetBytes of them resident from now on.
+  //
+
+  bool Spill(const fs::path &Directory, const uint64_t BudgetBytes) {
+    auto Spill = std::make_unique<SpillFile_t>();
+    if (!Spill->Open(Directory, BudgetBytes)) {
+      return false;
+    }
+
+    ChunkedVector_t Previous(std::move(*this));
+    Spill_ = std::move(Spill);
+    for (uint64_t Idx = 0; Idx < Previous.NumberUsed_; Idx++) {
+      const auto &Chunk = Previous.Chunks_[Idx];
+      Append(Chunk.Elements, Chunk.Elements + Chunk.Size);
+    }
+
+    return true;
+  }
+
+  uint64_t size() const { return Size_; }
+  bool empty() const { return Size_ == 0; }
+
+  const Element_t &front() const { return Chunks_[0].Elements[0]; }
+
+  Element_t &back() {
+    const auto &Chunk = Chunks_[NumberUsed_ - 1];
+    return Chunk.Elements[Chunk.Size - 1];
+  }
+
+  void emplace_back(const Element_t &Element) {
+    Chunk_t &Chunk = Tail();
+    Chunk.Elements[Chunk.Size++] = Element;
+    Size_++;
+  }
+
+  //
+  // Copy a range of elements at the end.
+  //
+
+  void Append(const Element_t *First, const Element_t *Last) {
+    while (First != Last) {
+      Chunk_t &Chunk = Tail();
+      const uint64_t Number =
+          std::min(uint64_t(Last - First), Chunk.Capacity - Chunk.Size);
+      memcpy(&Chunk.Elements[Chunk.Size], First, Number * sizeof(Element_t));
+      Chunk.Size += Number;
+      Size_ += Number;
+      First += Number;
+    }
+  }
+
+  //
+  // Move the elements of another array at the end of this one; its chunks
+  // are moved over unless one of the two is spilled, in which case the
+  // elements are copied.
+  //
+
+  void Splice(ChunkedVector_t &&Other) {
+    if (Spill_ || Other.Spill_) {
+      for (uint64_t Idx = 0; Idx < Other.NumberUsed_; Idx++) {
+        const auto &Chunk = Other.Chunks_[Idx];
+        Append(Chunk.Elements, Chunk.Elements + Chunk.Size);
+      }
+
+      Other = ChunkedVector_t();
+      return;
+    }
+
+    std::vector<Chunk_t> Chunks;
+    Chunks.reserve(Chunks_.size() + Other.NumberUsed_);
+    Chunks.insert(Chunks.end(), Chunks_.begin(),
+                  Chunks_.begin() + NumberUsed_);
+    for (uint64_t Idx = 0; Idx < Other.NumberUsed_; Idx++) {
+      Starts_.emplace_back(Size_);
+      Size_ += Other.Chunks_[Idx].Size;
+      Chunks.emplace_back(Other.Chunks_[Idx]);
+    }
+
+    Chunks.insert(Chunks.end(), Chunks_.begin() + NumberUsed_, Chunks_.end());
+    NumberUsed_ += Other.NumberUsed_;
+    Chunks_ = std::move(Chunks);
+    Other.Chunks_.erase(Other.Chunks_.begin(),
+                        Other.Chunks_.begin() + Other.NumberUsed_);
+    Other = ChunkedVector_t();
+  }
+
+  //
+  // Remove the first Number elements; the chunks that get emptied are freed.
+  //
+
+  void EraseFront(const uint64_t Number) {
+    const auto [ChunkIdx, Offset] = Locate(Number);
+    for (uint64_t Idx = 0; Idx < ChunkIdx; Idx++) {
+      FreeChunk(Chunks_[Idx]);
+    }
+
+    Chunks_.erase(Chunks_.begin(), Chunks_.begin() + ChunkIdx);
+    Starts_.erase(Starts_.begin(), Starts_.begin() + ChunkIdx);
+    NumberUsed_ -= ChunkIdx;
+    if (Offset > 0) {
+      Chunk_t &Chunk = Chunks_[0];
+      Chunk.Elements += Offset;
+      Chunk.Size -= Offset;
+      Chunk.Capacity -= Offset;
+    }
+
+    for (auto &Start : Starts_) {
+      Start = std::max(Start, Number) - Number;
+    }
+
+    Size_ -= Number;
+  }
+
+  //
+  // Empty the array; the chunks are kept for the next elements, unless the
+  // array is spilled in which case the file is rewound.
+  //
+
+  void clear() {
+    if (Spill_) {
+      Chunks_.clear();
+      Spill_->Reset();
+    }
+
+    for (auto &Chunk : Chunks_) {
+      Chunk.Elements = (Element_t *)Chunk.Base;
+      Chunk.Size = 0;
+      Chunk.Capacity = Chunk.Bytes / sizeof(Element_t);
+    }
+
+    Starts_.clear();
+    NumberUsed_ = 0;
+    Size_ = 0;
+  }
+
+  //
+  // Get the elements in [Begin, End).
+  //
+
+  Range_t Range(const uint64_t Begin, const uint64_t End) const {
+    const auto [BeginChunk, BeginOffset] = Locate(Begin);
+    const auto [EndChunk, EndOffset] = Locate(End);
+    return Range_t(Iterator_t(this, BeginChunk, BeginOffset),
+                   Iterator_t(this, EndChunk, EndOffset), End - Begin);
+  }
+
+  //
+  // Invoke Function with the contiguous spans of elements in [Begin, End).
+  //
+
+  template <typename Function_t>
+  void ForEachSpan(const uint64_t Begin, const uint64_t End,
+                   Function_t &&Function) const {
+    auto [ChunkIdx, Offset] = Locate(Begin);
+    for (uint64_t Left = End - Begin; Left > 0; ChunkIdx++, Offset = 0) {
+      const auto &Chunk = Chunks_[ChunkIdx];
+      const uint64_t Number = std::min(Left, Chunk.Size - Offset);
+      Function(std::span<const Element_t>(&Chunk.Elements[Offset], Number));
+      Left -= Number;
+    }
+  }
+
+  //
+  // Let the OS reclaim the elements in [Begin, End) when spilled; a reader
+  // going through the elements calls this when it's done with them.
+  //
+
+  void Evict(const uint64_t Begin, const uint64_t End) const {
+    if (Spill_) {
+      ForEachSpan(Begin, End, [&](const std::span<const Element_t> &Span) {
+        Spill_->Evict(Span.data(), Span.size_bytes());
+      });
+    }
+  }
+
+  //
+  // Get the elements as a single span; they are moved to a single chunk
+  // first if needed.
+  //
+
+  std::span<const Element_t> Contiguous() {
+    if (NumberUsed_ > 1) {
+      const uint64_t Bytes =
+          ((Size_ * sizeof(Element_t)) + PageSize - 1) & ~(PageSize - 1);
+      Chunk_t Chunk = NewChunk(Bytes);
+      ForEachSpan(0, Size_, [&](const std::span<const Element_t> &Span) {
+        memcpy(&Chunk.Elements[Chunk.Size], Span.data(), Span.size_bytes());
+        Chunk.Size += Span.size();
+      });
+
+      Release();
+      Chunks_.emplace_back(Chunk);
+      Starts_.emplace_back(0);
+      NumberUsed_ = 1;
+      Size_ = Chunk.Size;
+    }
+
+    if (NumberUsed_ == 0) {
+      return {};
+    }
+
+    return std::span<const Element_t>(Chunks_[0].Elements, Size_);
+  }
+};
+
+} // namespace clairvoyance
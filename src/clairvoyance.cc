@@ -1,381 +1,1783 @@
 // Axel '0vercl0k' Souchet - December 1 2020
+#include "clairvoyance.h"
 #include "fmt/format.h"
 #include "fmt/os.h"
-#include "pagetables.h"
-#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+namespace fs = std::filesystem;
+
+namespace clairvoyance {
+
 //
-// Turn this on to dump the gap mappings.
+// The options the user can pass on the command line.
 //
 
-constexpr bool VerboseDumpGapMappings = false;
+struct Options_t {
+  fs::path DumpFile;
+  std::vector<uint64_t> DirectoryBases;
+  std::optional<uint64_t> LivePid;
+  std::vector<kdmpparser::MemoryRegion_t> GuestRegions;
+  std::optional<uint64_t> NestedPointer;
+  kdmpparser::NestedPaging_t NestedPaging = kdmpparser::NestedPaging_t::Ept;
+  OutputFormat_t Format = OutputFormat_t::Text;
+  fs::path DecodeFile;
+  fs::path StoreDirectory;
+  bool Fetch = false;
+  std::vector<fs::path> StoreFiles;
+  fs::path QueryFile;
+  fs::path LocateFile;
+  std::vector<std::string> Queries;
+  bool ReverseMap = false;
+  fs::path ReverseMapFile;
+  bool SharedPages = false;
+  bool Summary = false;
+  bool Stacks = false;
+  stacks::Limits_t StackLimits;
+  std::vector<std::vector<uint8_t>> Patterns;
+  fs::path ServeSocket;
+  uint64_t ServeMemoryBudget = server::DefaultMemoryBudget;
+  bool Diff = false;
+  fs::path DiffDumpFile;
+  bool Series = false;
+  bool Batch = false;
+  std::vector<fs::path> DumpFiles;
+  bool DiscoverDirectoryBases = false;
+  bool Stream = false;
+  bool Gzip = false;
+  std::optional<ptables::PageType_t> Progressive;
+  bool Verbose = false;
+  std::optional<std::chrono::duration<double>> Deadline;
+  bool Progress = false;
+  WalkOptions_t Walk;
+  Overlay_t Overlay = Overlay_t::Protection;
+  hilbert::Shape_t Layout = hilbert::Shape_t::Square;
+  bool Attribute = false;
+  std::vector<attribution::BigPool_t> BigPools;
+  fs::path RenderFile;
+  fs::path StatsFile;
+  fs::path TapeCache;
+  std::optional<tapecache::Cache_t> Tapes;
+  uint64_t MaxMemory = 0;
+  kdmpparser::ReaderType_t Reader = kdmpparser::ReaderType_t::Mmap;
+  uint64_t CacheSize = kdmpparser::PageCache_t::DefaultNumberPages;
+  GapPolicy_t GapPolicy;
+  uint64_t NumberThreads = std::max(1u, std::thread::hardware_concurrency());
+};
 
 //
-// Turn this on to dump the VA mappings.
+// Read a list of directory bases from a file; one per line.
 //
 
-constexpr bool VerboseDumpMappings = false;
+bool ReadDirectoryBases(const fs::path &Filename,
+                        std::vector<uint64_t> &DirectoryBases) {
+  std::ifstream File(Filename);
+  if (!File) {
+    fmt::print("Could not open {}\n", Filename.string());
+    return false;
+  }
 
-namespace fs = std::filesystem;
+  std::string Line;
+  while (std::getline(File, Line)) {
+    if (Line.empty()) {
+      continue;
+    }
 
-namespace clairvoyance {
+    DirectoryBases.emplace_back(strtoull(Line.c_str(), nullptr, 0));
+  }
+
+  return true;
+}
 
 //
-// The palette of color used for the visualization.
+// Parse the command line; flags can appear anywhere, the rest are the
+// positional arguments.
 //
 
-namespace color {
-constexpr uint32_t White = 0xff'ff'ff;
-constexpr uint32_t Black = 0x00'00'00;
-constexpr uint32_t Green = 0x00'ff'00;
-constexpr uint32_t PaleGreen = 0xa9'ff'52;
-constexpr uint32_t CanaryYellow = 0xff'ff'99;
-constexpr uint32_t Yellow = 0xff'ff'00;
-constexpr uint32_t Purple = 0xa0'20'f0;
-constexpr uint32_t Mauve = 0xe0'b0'ff;
-constexpr uint32_t Red = 0xfe'00'00;
-constexpr uint32_t LightRed = 0xff'7f'7f;
-}; // namespace color
+bool ParseOptions(const int argc, char *argv[], Options_t &Opts) {
+  std::vector<std::string_view> Positionals;
+  std::optional<uint64_t> Padding;
+  for (int Idx = 1; Idx < argc; Idx++) {
+    const std::string_view Arg(argv[Idx]);
+    if (Arg == "--binary") {
+      Opts.Format = OutputFormat_t::Binary;
+    } else if (Arg == "--png") {
+      Opts.Format = OutputFormat_t::Png;
+    } else if (Arg == "--ppm") {
+      Opts.Format = OutputFormat_t::Ppm;
+    } else if (Arg == "--tiles") {
+      Opts.Format = OutputFormat_t::Tiles;
+    } else if (Arg == "--threads") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
 
-//
-// The visualizer is the class that generates the pictures. It reads the dump,
-// parses the page tables hierarchy and puts the address space onto a hilbert
-// curve.
-//
+      Opts.NumberThreads = std::max(1ull, strtoull(argv[++Idx], nullptr, 0));
+    } else if (Arg == "--dirbases") {
+      if ((Idx + 1) >= argc ||
+          !ReadDirectoryBases(argv[++Idx], Opts.DirectoryBases)) {
+        return false;
+      }
+    } else if (Arg == "--max-gap" || Arg == "--padding") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
 
-class Visualizer_t {
+      const uint64_t Value = strtoull(argv[++Idx], nullptr, 0);
+      if (Arg == "--padding") {
+        Padding = Value;
+      } else {
+        Opts.GapPolicy.MaxGapPages = Value;
+      }
+    } else if (Arg == "--stream") {
+      Opts.Stream = true;
+    } else if (Arg == "--gzip") {
+      Opts.Gzip = true;
+    } else if (Arg == "--progressive") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
 
-  struct Region_t {
-    uint64_t Va = 0;
-    uint64_t EndIdx = 0;
-  };
+      const std::string_view Block = argv[++Idx];
+      if (Block == "2m") {
+        Opts.Progressive = ptables::PageType_t::Large;
+      } else if (Block == "1g") {
+        Opts.Progressive = ptables::PageType_t::Huge;
+      } else {
+        fmt::print("--progressive takes 2m or 1g\n");
+        return false;
+      }
+    } else if (Arg == "--verbose") {
+      Opts.Verbose = true;
+    } else if (Arg == "--deadline") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.Deadline =
+          std::chrono::duration<double>(strtod(argv[++Idx], nullptr));
+    } else if (Arg == "--progress") {
+      Opts.Progress = true;
+    } else if (Arg == "--la57") {
+      Opts.Walk.La57 = true;
+    } else if (Arg == "--attributes") {
+      Opts.Walk.Attributes = true;
+    } else if (Arg == "--content") {
+      Opts.Walk.Content = true;
+    } else if (Arg == "--attribute") {
+      Opts.Attribute = true;
+    } else if (Arg == "--big-pool") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      char *End = nullptr;
+      attribution::BigPool_t Pool;
+      Pool.Va = strtoull(argv[++Idx], &End, 0);
+      if (*End != ':') {
+        return false;
+      }
+
+      Pool.NumberEntries = strtoull(End + 1, &End, 0);
+      if (*End != '\0') {
+        return false;
+      }
+
+      Opts.Attribute = true;
+      Opts.BigPools.emplace_back(Pool);
+    } else if (Arg == "--overlay") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      const std::string_view Name(argv[++Idx]);
+      const auto Overlay =
+          std::find_if(Overlays.begin(), Overlays.end(),
+                       [&](const Overlay_t Overlay) {
+                         return OverlayName(Overlay) == Name;
+                       });
+      if (Overlay == Overlays.end()) {
+        fmt::print("Unknown overlay {}\n", Name);
+        return false;
+      }
+
+      Opts.Overlay = *Overlay;
+
+      Opts.Walk.Attributes |= OverlayAttribute(Opts.Overlay) != 0;
+      Opts.Walk.Content |= Opts.Overlay == Overlay_t::Content;
+    } else if (Arg == "--layout") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      const std::string_view Shape = argv[++Idx];
+      if (Shape == "square") {
+        Opts.Layout = hilbert::Shape_t::Square;
+      } else if (Shape == "packed") {
+        Opts.Layout = hilbert::Shape_t::Packed;
+      } else {
+        fmt::print("--layout takes square or packed\n");
+        return false;
+      }
+    } else if (Arg == "--scale") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      const std::string_view Scaling = argv[++Idx];
+      if (Scaling == "page") {
+        Opts.GapPolicy.Scaling = Scaling_t::Page;
+      } else if (Scaling == "mapping") {
+        Opts.GapPolicy.Scaling = Scaling_t::Mapping;
+      } else {
+        fmt::print("--scale takes page or mapping\n");
+        return false;
+      }
+    } else if (Arg == "--render") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.RenderFile = argv[++Idx];
+    } else if (Arg == "--max-memory") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.MaxMemory = strtoull(argv[++Idx], nullptr, 0) << 20;
+    } else if (Arg == "--stats") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.StatsFile = argv[++Idx];
+    } else if (Arg == "--tape-cache") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.TapeCache = argv[++Idx];
+    } else if (Arg == "--reader") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      const std::string_view Reader(argv[++Idx]);
+      if (Reader == "mmap") {
+        Opts.Reader = kdmpparser::ReaderType_t::Mmap;
+      } else if (Reader == "pread") {
+        Opts.Reader = kdmpparser::ReaderType_t::Pread;
+      } else {
+        fmt::print("Unknown reader {}\n", Reader);
+        return false;
+      }
+    } else if (Arg == "--cache-size") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.CacheSize = strtoull(argv[++Idx], nullptr, 0);
+    } else if (Arg == "--live") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.LivePid = strtoull(argv[++Idx], nullptr, 0);
+    } else if (Arg == "--guest-region") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      const auto &Region = live::ParseRegion(argv[++Idx]);
+      if (!Region) {
+        fmt::print("Invalid region {}\n", argv[Idx]);
+        return false;
+      }
+
+      Opts.GuestRegions.emplace_back(*Region);
+    } else if (Arg == "--max-table-visits") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.Walk.MaxTableVisits = strtoull(argv[++Idx], nullptr, 0);
+    } else if (Arg == "--skip-self-reference") {
+      Opts.Walk.SkipSelfReference = true;
+    } else if (Arg == "--va-range") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      char *End = nullptr;
+      const uint64_t Start = strtoull(argv[++Idx], &End, 0);
+      if (*End != ':') {
+        return false;
+      }
+
+      const uint64_t Stop = strtoull(End + 1, &End, 0);
+      if (*End != '\0' || Start >= Stop) {
+        return false;
+      }
+
+      Opts.Walk.FirstVa = Start;
+      Opts.Walk.LastVa = Stop - 1;
+    } else if (Arg == "--ept" || Arg == "--npt") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.NestedPointer = strtoull(argv[++Idx], nullptr, 0);
+      Opts.NestedPaging = Arg == "--ept" ? kdmpparser::NestedPaging_t::Ept
+                                         : kdmpparser::NestedPaging_t::Npt;
+    } else if (Arg == "--diff") {
+      Opts.Diff = true;
+    } else if (Arg == "--diff-against") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.Diff = true;
+      Opts.DiffDumpFile = argv[++Idx];
+    } else if (Arg == "--series") {
+      Opts.Series = true;
+    } else if (Arg == "--batch") {
+      Opts.Batch = true;
+    } else if (Arg == "--all-dirbases") {
+      Opts.DiscoverDirectoryBases = true;
+    } else if (Arg == "--decode") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.DecodeFile = argv[++Idx];
+    } else if (Arg == "--store" || Arg == "--fetch") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.StoreDirectory = argv[++Idx];
+      Opts.Fetch = Arg == "--fetch";
+    } else if (Arg == "--query") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.QueryFile = argv[++Idx];
+    } else if (Arg == "--locate") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.LocateFile = argv[++Idx];
+    } else if (Arg == "--rmap") {
+      Opts.ReverseMap = true;
+    } else if (Arg == "--shared") {
+      Opts.SharedPages = true;
+    } else if (Arg == "--summary") {
+      Opts.Summary = true;
+    } else if (Arg == "--stacks") {
+      Opts.Stacks = true;
+    } else if (Arg == "--stack-pages") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      char *End = nullptr;
+      Opts.StackLimits.MinPages = strtoull(argv[++Idx], &End, 0);
+      if (*End != ':') {
+        return false;
+      }
+
+      Opts.StackLimits.MaxPages = strtoull(End + 1, &End, 0);
+      if (*End != '\0' ||
+          Opts.StackLimits.MinPages > Opts.StackLimits.MaxPages) {
+        return false;
+      }
+    } else if (Arg == "--stack-recurrences") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.StackLimits.MinRecurrences = strtoull(argv[++Idx], nullptr, 0);
+    } else if (Arg == "--search") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      std::vector<uint8_t> Pattern;
+      if (!search::ParsePattern(argv[++Idx], Pattern)) {
+        fmt::print("Invalid pattern {}\n", argv[Idx]);
+        return false;
+      }
+
+      Opts.Patterns.emplace_back(std::move(Pattern));
+    } else if (Arg == "--rmap-query") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.ReverseMapFile = argv[++Idx];
+    } else if (Arg == "--serve") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.ServeSocket = argv[++Idx];
+    } else if (Arg == "--serve-memory") {
+      if ((Idx + 1) >= argc) {
+        return false;
+      }
+
+      Opts.ServeMemoryBudget = strtoull(argv[++Idx], nullptr, 0) << 20;
+    } else if (Arg.starts_with("--")) {
+      fmt::print("Unknown option {}\n", Arg);
+      return false;
+    } else {
+      Positionals.emplace_back(Arg);
+    }
+  }
+
+  if (!Opts.DecodeFile.empty()) {
+    return Positionals.empty();
+  }
+
+  if (!Opts.StoreDirectory.empty()) {
+    Opts.StoreFiles.assign(Positionals.begin(), Positionals.end());
+    return !Opts.StoreFiles.empty();
+  }
+
+  if (!Opts.RenderFile.empty()) {
+    return Positionals.empty() && (Opts.Format == OutputFormat_t::Png ||
+                                   Opts.Format == OutputFormat_t::Ppm);
+  }
+
+  if (!Opts.QueryFile.empty() || !Opts.ReverseMapFile.empty() ||
+      !Opts.LocateFile.empty()) {
+    Opts.Queries.assign(Positionals.begin(), Positionals.end());
+    return !Opts.Queries.empty();
+  }
+
+  //
+  // By default, the regions are separated by one more pixel than the largest
+  // gap drawn.
+  //
+
+  Opts.GapPolicy.Padding = Padding.value_or(Opts.GapPolicy.MaxGapPages + 1);
 
   //
-  // The tape is basically a succession of page table properties. This is used
-  // as distances on the curve.
+  // Only the text format gets compressed, and not while it is streamed since
+  // the header of a streamed file is written over at the end.
   //
 
-  std::vector<ptables::Protection_t> Tape_;
+  if (Opts.Gzip && (Opts.Format != OutputFormat_t::Text || Opts.Stream)) {
+    return false;
+  }
 
   //
-  // Keep track of contiguous regions of memory.
+  // The progressive files are made of several binary documents.
   //
 
-  std::vector<Region_t> Regions_;
+  if (Opts.Progressive && Opts.Format != OutputFormat_t::Binary) {
+    return false;
+  }
 
   //
-  // Gets the number of 4k pages that we need to draw on the curve for
-  // Huge/Large/Normal page.
+  // The labels of the owners only have a place in the binary format.
   //
 
-  static constexpr uint64_t
-  GetNumberPixels(const ptables::PageType_t PageType) {
-    //
-    // XXX: Use the below once clang and gcc supports the feature.
-    // using enum ptables::PageType_t;
-    //
+  if (Opts.Attribute &&
+      (Opts.Format != OutputFormat_t::Binary || Opts.Stream)) {
+    return false;
+  }
 
-    switch (PageType) {
-    case ptables::PageType_t::Huge: {
+  //
+  // When a pixel is a mapping, the text format can't tell how many pages it
+  // is and the content and the owners of the pages of a large mapping would
+  // have to be merged.
+  //
 
-      //
-      // Huge pages are 1GB so we'll add the below number of pixels.
-      //
+  if (Opts.GapPolicy.Scaling == Scaling_t::Mapping &&
+      (Opts.Format == OutputFormat_t::Text || Opts.Walk.Content ||
+       Opts.Attribute || Opts.Verbose)) {
+    return false;
+  }
+
+  //
+  // The tape cache only holds the plain tapes of a dump file.
+  //
 
-      return (1024 * 1024 * 1024) / page::Size;
+  if (!Opts.TapeCache.empty() &&
+      (Opts.Stream || Opts.Progressive || Opts.Attribute || Opts.Verbose ||
+       Opts.LivePid || Opts.NestedPointer || Opts.Series || Opts.Batch)) {
+    return false;
+  }
+
+  if (!Opts.ServeSocket.empty()) {
+    return Positionals.empty();
+  }
+
+  //
+  // A live target only takes directory bases; it is named after the process
+  // in the output files.
+  //
+
+  if (Opts.LivePid) {
+    Opts.DumpFile = fmt::format("qemu-{}", *Opts.LivePid);
+    for (const auto &Positional : Positionals) {
+      Opts.DirectoryBases.emplace_back(
+          strtoull(Positional.data(), nullptr, 0));
+    }
+
+    return !Opts.Diff && !Opts.Series && !Opts.Batch;
+  }
+
+  if (Positionals.empty()) {
+    return false;
+  }
+
+  Opts.DumpFile = Positionals[0];
+
+  //
+  // A series or a batch only takes dumps; the report of --stats is about a
+  // single dump.
+  //
+
+  if (Opts.Series || Opts.Batch) {
+    Opts.DumpFiles.assign(Positionals.begin(), Positionals.end());
+    return !(Opts.Series && Opts.Batch) &&
+           (Opts.Series || Opts.StatsFile.empty());
+  }
+
+  for (size_t Idx = 1; Idx < Positionals.size(); Idx++) {
+    Opts.DirectoryBases.emplace_back(
+        strtoull(Positionals[Idx].data(), nullptr, 0));
+  }
+
+  //
+  // A diff of a single dump needs two directory bases; a diff against another
+  // dump takes at most one for each.
+  //
+
+  if (Opts.Diff) {
+    return Opts.DiffDumpFile.empty() ? Opts.DirectoryBases.size() == 2
+                                     : Opts.DirectoryBases.size() <= 2;
+  }
+
+  return true;
+}
+
+//
+// Convert a binary .clairvoyance file back to the text format.
+//
+
+bool Decode(const fs::path &InFile) {
+  binary::Reader_t Reader;
+  if (!Reader.Read(InFile)) {
+    return false;
+  }
+
+  fs::path OutFile(fs::current_path() / InFile.filename());
+  OutFile.replace_extension(".txt.clairvoyance");
+  if (!Reader.WriteText(OutFile)) {
+    return false;
+  }
+
+  fmt::print("Done writing {}\n", OutFile.filename().string());
+
+  //
+  // The owners of the pixels go in their own file.
+  //
+
+  if (Reader.Labels().empty()) {
+    return true;
+  }
+
+  OutFile = fs::current_path() / InFile.filename();
+  OutFile.replace_extension(".labels");
+  if (!Reader.WriteLabels(OutFile)) {
+    return false;
+  }
+
+  fmt::print("Done writing {}\n", OutFile.filename().string());
+  return true;
+}
+
+//
+// Put binary .clairvoyance files in a store, named after them, or get them
+// back out of it.
+//
+
+bool Store(const Options_t &Opts) {
+  store::Store_t Store(Opts.StoreDirectory);
+  for (const auto &File : Opts.StoreFiles) {
+    if (Opts.Fetch) {
+      const fs::path OutFile(fs::current_path() /
+                             fmt::format("{}.clairvoyance", File.string()));
+      if (!Store.Get(File.string(), OutFile)) {
+        fmt::print("Fetching {} failed\n", File.string());
+        return false;
+      }
+
+      fmt::print("Done writing {}\n", OutFile.filename().string());
+    } else if (!Store.Put(File, File.stem().string())) {
+      fmt::print("Storing {} failed\n", File.string());
+      return false;
+    }
+  }
+
+  const auto &Stats = Store.Stats();
+  fmt::print("{} {} chunks ({} bytes), {} of them {} ({} bytes)\n",
+             Opts.Fetch ? "Fetched" : "Stored", Stats.NumberChunks,
+             Stats.NumberBytes, Stats.NumberNewChunks,
+             Opts.Fetch ? "read from the store" : "new", Stats.NumberNewBytes);
+  return true;
+}
+
+//
+// Render the picture of a binary .clairvoyance file with an overlay; the
+// attributes are in the file so the dump doesn't need to be walked again.
+//
+
+bool RenderBinary(const Options_t &Opts) {
+  binary::Reader_t Reader;
+  if (!Reader.Read(Opts.RenderFile)) {
+    return false;
+  }
+
+  //
+  // Lay the regions and their padding out like the tape does.
+  //
+
+  std::vector<Tape_t::Run_t> Runs;
+  for (const auto &Region : Reader.Regions()) {
+    for (const auto &Run : Reader.Runs(Region)) {
+      Tape_t::Run_t Layout;
+      Layout.Length = Run.Length;
+      Layout.Protection = Run.Protection;
+      Layout.Attributes = Run.Attributes;
+      Runs.emplace_back(Layout);
+    }
+
+    if (Region.Padding > 0) {
+      Tape_t::Run_t Padding;
+      Padding.Length = Region.Padding;
+      Padding.Protection = uint64_t(ptables::Protection_t::None);
+      Runs.emplace_back(Padding);
     }
+  }
+
+  const auto &Layout =
+      hilbert::LayoutOf(Reader.Header().Width, Reader.Header().Height);
+  if (!Layout) {
+    fmt::print("{} has invalid dimensions\n", Opts.RenderFile.string());
+    return false;
+  }
 
-    case ptables::PageType_t::Large: {
+  Image_t Image;
+  Image.Render(Runs, *Layout, Opts.NumberThreads, Opts.Overlay);
+
+  fs::path OutFile(fs::current_path() / Opts.RenderFile.filename());
+  OutFile.replace_extension(fmt::format(
+      ".{}.{}", OverlayName(Opts.Overlay), Extension(Opts.Format)));
+  if (!Image.Write(OutFile, Opts.Format == OutputFormat_t::Png
+                                ? ImageFormat_t::Png
+                                : ImageFormat_t::Ppm)) {
+    fmt::print("Write failed\n");
+    return false;
+  }
 
-      //
-      // Large pages are 2MB so we'll add the below number of pixels.
-      //
+  fmt::print("Done writing {}\n", OutFile.filename().string());
+  return true;
+}
+
+//
+// Answer queries against a binary .clairvoyance file.
+//
+
+bool Query(const fs::path &InFile, const std::vector<std::string> &Queries) {
+  binary::Reader_t Reader;
+  if (!Reader.Read(InFile)) {
+    return false;
+  }
+
+  const query::Index_t Index(Reader);
+  for (const auto &Query : Queries) {
+    std::string Answer;
+    query::Answer(Index, Query, Answer);
+    fmt::print("{}", Answer);
+  }
+
+  return true;
+}
+
+//
+// Find pixels of a binary .clairvoyance file with its index, without loading
+// it. A pixel is either a distance on the curve or <x>,<y> coordinates.
+//
+
+bool Locate(const fs::path &InFile, const std::vector<std::string> &Pixels) {
+  binary::Seeker_t Seeker;
+  if (!Seeker.Open(InFile)) {
+    return false;
+  }
 
-      return (1024 * 1024 * 2) / page::Size;
+  const auto &Layout =
+      hilbert::LayoutOf(Seeker.Header().Width, Seeker.Header().Height);
+  if (!Layout) {
+    fmt::print("{} has invalid dimensions\n", InFile.string());
+    return false;
+  }
+
+  for (const auto &Pixel : Pixels) {
+    char *End = nullptr;
+    uint64_t Distance = strtoull(Pixel.c_str(), &End, 0);
+    bool Parsed = End != Pixel.c_str();
+    bool Outside = false;
+    if (Parsed && *End == ',') {
+      const char *Second = End + 1;
+      const uint64_t X = Distance;
+      const uint64_t Y = strtoull(Second, &End, 0);
+      Parsed = End != Second;
+      Outside = X >= Layout->Width() || Y >= Layout->Height();
+      if (!Outside) {
+        Distance = hilbert::Xy2d(hilbert::Point_t{uint32_t(X), uint32_t(Y)},
+                                 *Layout);
+      }
     }
 
-    case ptables::PageType_t::Normal: {
+    if (!Parsed || *End != '\0') {
+      fmt::print("invalid pixel {}\n", Pixel);
+      continue;
+    }
 
-      //
-      // This is a normal page, so we'll just materialize a single pixel.
-      //
+    if (Outside || Distance >= Layout->NumberPixels()) {
+      fmt::print("{} is outside the picture\n", Pixel);
+      continue;
+    }
 
-      return 1;
+    const auto &Point = hilbert::D2xy(Distance, *Layout);
+    const auto &Found = Seeker.Locate(Distance);
+    if (!Found) {
+      fmt::print("{:#x} ({}, {}) is past the end of the tape\n", Distance,
+                 Point.X, Point.Y);
+    } else if (!Found->Va) {
+      fmt::print("{:#x} ({}, {}) is padding after region {}\n", Distance,
+                 Point.X, Point.Y, Found->Region);
+    } else {
+      const auto &Pages = Found->Scale > 1
+                              ? fmt::format(" ({} pages)", Found->Scale)
+                              : std::string();
+      fmt::print("{:#x} ({}, {}) {:#018x} {}{}\n", Distance, Point.X,
+                 Point.Y, *Found->Va, ptables::ToString(Found->Protection),
+                 Pages);
     }
+  }
+
+  return true;
+}
+
+//
+// Build the reverse map of the directory bases of a dump and write it on disk.
+//
+
+bool WriteReverseMap(const Options_t &Opts,
+                     const kdmpparser::KernelDumpParser &DumpParser) {
+  const auto &Index = rmap::Build(DumpParser, Opts.DirectoryBases,
+                                  Opts.NumberThreads, Opts.Walk.La57);
+  const auto &Filename =
+      fmt::format("{}.rmap", Opts.DumpFile.stem().string());
+  if (!Index.Write(fs::current_path() / Filename)) {
+    fmt::print("Write failed\n");
+    return false;
+  }
+
+  fmt::print("Done writing {} ({} mappings of {} directory bases in {} bytes, "
+             "{} aliased ranges)\n",
+             Filename, Index.NumberRecords(), Index.DirectoryBases().size(),
+             Index.MemoryUsage(), Index.Aliases().size());
+  return true;
+}
+
+//
+// Answer queries against a .rmap file.
+//
+
+bool QueryReverseMap(const fs::path &InFile,
+                     const std::vector<std::string> &Queries) {
+  rmap::Index_t Index;
+  if (!Index.Read(InFile)) {
+    return false;
+  }
+
+  for (const auto &Query : Queries) {
+    std::string Answer;
+    rmap::Answer(Index, Query, Answer);
+    fmt::print("{}", Answer);
+  }
+
+  return true;
+}
+
+//
+// Search the mapped memory of the directory bases of a dump for patterns and
+// print where they are.
+//
+
+bool SearchPatterns(const Options_t &Opts,
+                    const kdmpparser::KernelDumpParser &DumpParser) {
+  const search::Matcher_t Matcher(Opts.Patterns);
+  uint64_t NumberHits = 0;
+  for (const uint64_t DirectoryBase : Opts.DirectoryBases) {
+    const uint64_t Base = page::Align(DirectoryBase);
+    const auto &Hits = search::Search(DumpParser, Base, Matcher,
+                                      Opts.NumberThreads, Opts.Walk.La57);
+    for (const auto &Hit : Hits) {
+      fmt::print("{:#x} {:#x} {} {:02x}\n", Base, Hit.Va,
+                 ToString(Hit.Protection),
+                 fmt::join(Matcher.Patterns()[Hit.Pattern], ""));
     }
 
-    std::abort();
+    NumberHits += Hits.size();
   }
 
-public:
+  fmt::print("Found {} hits in {} directory bases\n", NumberHits,
+             Opts.DirectoryBases.size());
+  return true;
+}
+
+//
+// Find the user pages shared by the directory bases of a dump and write the
+// sharing sets on disk.
+//
+
+bool WriteSharedPages(const Options_t &Opts,
+                      const kdmpparser::KernelDumpParser &DumpParser) {
+  const auto &DirectoryBases = sharing::UniqueBases(Opts.DirectoryBases);
+  const auto &Sets = sharing::FindSharedPages(
+      DumpParser, DirectoryBases, Opts.NumberThreads, Opts.Walk.La57);
+  const auto &Filename =
+      fmt::format("{}.shared", Opts.DumpFile.stem().string());
+  if (!sharing::Write(fs::current_path() / Filename, Sets, DirectoryBases)) {
+    fmt::print("Write failed\n");
+    return false;
+  }
+
+  uint64_t NumberPages = 0;
+  for (const auto &Set : Sets) {
+    NumberPages += Set.NumberPages;
+  }
+
+  fmt::print("Done writing {} ({} shared pages in {} sets)\n", Filename,
+             NumberPages, Sets.size());
+  return true;
+}
+
+//
+// Print how much of the directory bases of a dump is mapped with every
+// protection as JSON, without building their tapes.
+//
+
+bool PrintSummary(const Options_t &Opts,
+                  const kdmpparser::KernelDumpParser &DumpParser) {
+
   //
-  // Parses and prepares the tape.
+  // The walks can complain about missing tables, so the report is printed
+  // once they are all done.
   //
 
-  bool Parse(const kdmpparser::KernelDumpParser &DumpParser,
-             const uint64_t DirectoryBase) {
+  std::vector<std::string> Lines;
+  for (const uint64_t DirectoryBase : Opts.DirectoryBases) {
+    const uint64_t Base = page::Align(DirectoryBase);
+    const auto &Summary =
+        summary::Summarize(DumpParser, Base, Opts.NumberThreads, Opts.Walk);
+    Lines.emplace_back(Summary.ToJson(Base));
+  }
 
-    //
-    // Initialize the page tables walker.
-    //
+  fmt::print("{{\"directoryBases\": [\n  {}\n]}}\n",
+             fmt::join(Lines, ",\n  "));
+  return true;
+}
 
-    ptables::PageTableWalker_t Walker(DumpParser, DirectoryBase);
+//
+// Print the kernel stacks of the directory bases of a dump as JSON, without
+// building their tapes.
+//
 
-    //
-    // Warm up the tape.
-    //
+bool PrintStacks(const Options_t &Opts,
+                 const kdmpparser::KernelDumpParser &DumpParser) {
+  std::vector<std::string> Lines;
+  for (const uint64_t DirectoryBase : Opts.DirectoryBases) {
+    const uint64_t Base = page::Align(DirectoryBase);
+    const auto &Report = stacks::Detect(DumpParser, Base, Opts.NumberThreads,
+                                        Opts.Walk, Opts.StackLimits);
+    Lines.emplace_back(Report.ToJson(Base));
+  }
 
-    Tape_.reserve(1'500'000);
+  fmt::print("{{\"directoryBases\": [\n  {}\n]}}\n",
+             fmt::join(Lines, ",\n  "));
+  return true;
+}
 
-    //
-    // Let's go!
-    //
+//
+// Diff two address spaces and write the ranges whose protection changed.
+//
 
-    uint64_t LastVa = 0;
-    Region_t Region;
-    while (1) {
+bool WriteDiff(const diff::Side_t &A, const fs::path &DumpFileA,
+               const diff::Side_t &B, const fs::path &DumpFileB) {
+  diff::Differ_t Differ(A, B);
+  if (!Differ.Run()) {
+    fmt::print("The page directories are not mapped in the dump files\n");
+    return false;
+  }
 
-      //
-      // Grab an entry from the iterator.
-      //
+  const std::string &OutFile = fmt::format(
+      "{}-{:#x}-vs-{}-{:#x}.diff", DumpFileA.stem().string(),
+      A.DirectoryAddress, DumpFileB.stem().string(), B.DirectoryAddress);
+  auto Out = fmt::output_file(OutFile);
+  uint64_t NumberPages = 0;
+  for (const auto &Change : Differ.Changes()) {
+    Out.print("{:#018x}-{:#018x} {} -> {}\n", Change.Va,
+              Change.Va + (Change.NumberPages * page::Size),
+              ptables::ToString(Change.Before),
+              ptables::ToString(Change.After));
+    NumberPages += Change.NumberPages;
+  }
 
-      const auto &Entry = Walker.Next();
+  Out.close();
+  fmt::print("{} ranges ({} pages) changed; {} tables compared ({} "
+             "identical), {} subtrees skipped\n",
+             Differ.Changes().size(), NumberPages,
+             Differ.NumberTablesCompared(), Differ.NumberTablesIdentical(),
+             Differ.NumberSubtreesSkipped());
+  fmt::print("Done writing {}\n", OutFile);
+  return true;
+}
 
-      //
-      // If there's no entry, the page tables walk is done.
-      //
+//
+// Diff two directory bases of the dump, or a directory base of the dump
+// against one of another dump.
+//
+
+bool Diff(const Options_t &Opts,
+          const kdmpparser::KernelDumpParser &DumpParser) {
+  kdmpparser::KernelDumpParser OtherDumpParser;
+  const kdmpparser::KernelDumpParser *DumpParserB = &DumpParser;
+  fs::path DumpFileB = Opts.DumpFile;
+  if (!Opts.DiffDumpFile.empty()) {
+    DumpFileB = Opts.DiffDumpFile;
+    if (!OtherDumpParser.Parse(DumpFileB.string().c_str(), Opts.Reader,
+                               Opts.CacheSize, Opts.NumberThreads)) {
+      fmt::print("Parse failed\n");
+      return false;
+    }
 
-      if (!Entry) {
+    DumpParserB = &OtherDumpParser;
+  }
 
-        //
-        // When we're done, complete the segment.
-        //
+  const auto &Bases = Opts.DirectoryBases;
+  const uint64_t DirectoryBaseA = page::Align(
+      Bases.size() > 0 ? Bases[0] : DumpParser.GetDirectoryTableBase());
+  const uint64_t DirectoryBaseB = page::Align(
+      Bases.size() > 1 ? Bases[1] : DumpParserB->GetDirectoryTableBase());
+  return WriteDiff({DumpParser, DirectoryBaseA}, Opts.DumpFile,
+                   {*DumpParserB, DirectoryBaseB}, DumpFileB);
+}
+
+//
+// Describe everything that shapes a tape besides the dump and the directory
+// base, to key it in the tape cache.
+//
+
+std::string TapeKey(const Options_t &Opts) {
+  const auto &Walk = Opts.Walk;
+  return fmt::format("la57={} attributes={} content={} visits={} self={} "
+                     "va={:#x}:{:#x} gap={} padding={} scale={}",
+                     Walk.La57, Walk.Attributes, Walk.Content,
+                     Walk.MaxTableVisits, Walk.SkipSelfReference, Walk.FirstVa,
+                     Walk.LastVa, Opts.GapPolicy.MaxGapPages,
+                     Opts.GapPolicy.Padding, int(Opts.GapPolicy.Scaling));
+}
+
+//
+// Write the coarse picture of a progressive file: the walk stops at the 2MB
+// or 1GB blocks and gives every block the protection of the entries leading
+// to it, so it only reads the upper levels of the hierarchy.
+//
+
+bool RenderCoarse(const Options_t &Opts,
+                  const kdmpparser::KernelDumpParser &DumpParser,
+                  const uint64_t DirectoryBase, const uint64_t NumberThreads,
+                  const fs::path &OutFile,
+                  const ptables::Cancellation_t &Cancellation) {
+  WalkOptions_t Options = Opts.Walk;
+  Options.Attributes = false;
+  Options.Content = false;
+  Options.Finest = *Opts.Progressive;
+  Visualizer_t Coarse(Opts.GapPolicy, Options);
+  Coarse.AbandonOn(&Cancellation);
+  Coarse.LayOutAs(Opts.Layout);
+  if (!Coarse.Parse(DumpParser, DirectoryBase, NumberThreads) ||
+      !Coarse.Write(OutFile, OutputFormat_t::Binary, NumberThreads)) {
+    fmt::print("Writing the coarse picture failed\n");
+    return false;
+  }
+
+  fmt::print("Done writing the coarse picture in {}\n",
+             OutFile.filename().string());
+  return true;
+}
+
+//
+// Walk the page tables of a directory base and write its picture on disk. The
+// visualizer is reset first, so that it can be reused across directory bases.
+// If Stats is passed, the phases are timed and the counters of the walk are
+// stored in it. The walk and the write are abandoned past --deadline, and
+// --progress reports how far the walk went every second. With --tape-cache,
+// the tape is loaded out of the cache instead of walked when it is there, and
+// stored in it after the walk otherwise; the dump is not touched on a hit.
+//
+
+template <typename Verbosity_t>
+bool RenderWith(const Options_t &Opts,
+                const kdmpparser::KernelDumpParser &DumpParser,
+                const uint64_t DirectoryBase, const uint64_t NumberThreads,
+                typename BasicVisualizer_t<Verbosity_t>::Cache_t *Cache,
+                BasicVisualizer_t<Verbosity_t> &Visu,
+                stats::DirectoryBase_t *Stats) {
+  const auto &Key = TapeKey(Opts);
+  const bool Cached = Opts.Tapes && Opts.Tapes->Contains(DirectoryBase, Key);
+
+  //
+  // Check that the PML4 at least exists.
+  //
+
+  if (!Cached && DumpParser.GetPhysicalPage(DirectoryBase) == nullptr) {
+    fmt::print("The page directory {:#x} is not mapped in the dump file\n",
+               DirectoryBase);
+    return false;
+  }
+
+  if (!Cached) {
+    DumpParser.ReleasePhysicalPage(DirectoryBase);
+  }
+
+  const auto &Filename =
+      fmt::format("{}-{:#x}.{}{}", Opts.DumpFile.stem().string(),
+                  DirectoryBase, Extension(Opts.Format),
+                  Opts.Gzip ? ".gz" : "");
+  const fs::path OutFile(fs::current_path() / Filename);
+
+  //
+  // In streaming mode, the picture is written on disk while the dump gets
+  // parsed.
+  //
+
+  auto Record = [&](const double WalkSeconds, const double WriteSeconds) {
+    if (Stats != nullptr) {
+      *Stats = {DirectoryBase, WalkSeconds, WriteSeconds, Visu.Stats(),
+                Visu.Builder().NumberGapPages()};
+    }
+  };
 
-        Region.EndIdx = Tape_.size();
-        Regions_.emplace_back(Region);
-        break;
+  const ptables::Cancellation_t Cancellation(Opts.Deadline);
+  stats::ProgressReport_t Report;
+  typename BasicVisualizer_t<Verbosity_t>::Progress_t Progress;
+  if (Opts.Progress) {
+    Progress = [&](const ptables::WalkProgress_t &WalkProgress) {
+      if (const auto &Line = Report.Line(WalkProgress)) {
+        fmt::print("{:#x}: {}\n", DirectoryBase, *Line);
       }
+    };
+  }
 
-      //
-      // If we have a gap in the address space, we fill it up the best we can.
-      //
+  Visu.Reset();
+  Visu.AbandonOn(&Cancellation);
+  Visu.LayOutAs(Opts.Layout);
+  if (Opts.Stream && Opts.Format == OutputFormat_t::Text) {
+    const stats::Stopwatch_t Stopwatch;
+    if (!Visu.Stream(DumpParser, DirectoryBase, OutFile, NumberThreads,
+                     Cache, Progress)) {
+      fmt::print("Stream failed\n");
+      return false;
+    }
 
-      if ((LastVa + page::Size) != Entry->Va) {
+    Record(Stopwatch.Seconds(), 0);
+    fmt::print("Done writing {}\n", Filename);
+    return true;
+  }
 
-        //
-        // Fill the gap with at most 10k entries of black pixels.
-        //
+  //
+  // In progressive mode, a coarse picture that doesn't need the tables below
+  // the blocks is written first; the fine one gets appended to it.
+  //
 
-        uint64_t N = 0;
-        constexpr uint64_t MaxGapEntries = 10'000;
-        bool Gap = false;
+  if (Opts.Progressive &&
+      !RenderCoarse(Opts, DumpParser, DirectoryBase, NumberThreads, OutFile,
+                    Cancellation)) {
+    return false;
+  }
 
-        //
-        // If we haven't added anything to the tape, it means the address space
-        // starts with a gap. So it means that the first page is a gap and as a
-        // result we should not increase the last virtual address.
-        //
+  //
+  // Parse the dump and prepare the curve, unless the tape is in the cache.
+  //
 
-        if (Tape_.size() > 0) {
-          LastVa += page::Size;
-        }
+  const stats::Stopwatch_t WalkStopwatch;
+  if (Cached) {
+    const auto &CacheFile = Opts.Tapes->Path(DirectoryBase, Key);
+    binary::Reader_t Reader;
+    if (!Reader.Read(CacheFile)) {
+      fmt::print("The tape of {:#x} in the cache is corrupted, remove {}\n",
+                 DirectoryBase, CacheFile.string());
+      return false;
+    }
 
-        for (; LastVa != Entry->Va; LastVa += page::Size) {
-          if constexpr (VerboseDumpGapMappings) {
-            fmt::print("VA:{:#x} (Gap, Dist:{})\n", LastVa, Tape_.size());
-          }
+    Visu.Load(Reader);
+  } else if (!Visu.Parse(DumpParser, DirectoryBase, NumberThreads, Cache,
+                         Progress)) {
+    fmt::print("Parse failed\n");
+    return false;
+  } else if (Opts.Tapes) {
+    Opts.Tapes->Put(DirectoryBase, Key, [&](const fs::path &CacheFile) {
+      return Visu.Write(CacheFile, OutputFormat_t::Binary, NumberThreads);
+    });
+  }
 
-          Tape_.emplace_back(ptables::Protection_t::None);
+  //
+  // Label the tape with the owners of the kernel address space; they are
+  // found through the directory base of the dump header when there is one.
+  //
 
-          //
-          // If we exhausted the number of allowed consecutive entries, we break
-          // out of the loop.
-          //
+  if (Opts.Attribute) {
+    const uint64_t KernelBase = DumpParser.GetDirectoryTableBase();
+    const auto &Table = attribution::Build(
+        DumpParser, KernelBase != 0 ? page::Align(KernelBase) : DirectoryBase,
+        Opts.BigPools, Opts.Walk.La57);
+    Visu.Attribute(Table);
+  }
 
-          if (N++ >= MaxGapEntries) {
-            if constexpr (VerboseDumpMappings) {
-              fmt::print("Huge gap from {:x} to {:x}, skipping\n", LastVa,
-                         Entry->Va);
-            }
+  const double WalkSeconds = WalkStopwatch.Seconds();
 
-            Gap = true;
-            break;
-          }
-        }
+  //
+  // Write the picture on disk.
+  //
 
-        if (Gap) {
+  const stats::Stopwatch_t WriteStopwatch;
+  const bool Written =
+      Opts.Progressive
+          ? Visu.Append(OutFile, NumberThreads)
+          : Visu.Write(OutFile, Opts.Format, NumberThreads, Opts.Overlay,
+                       Opts.Gzip);
+  if (!Written) {
+    fmt::print("Write failed\n");
+    return false;
+  }
 
-          //
-          // If we have a gap, close the current segment and start
-          // a new one.
-          //
+  Record(WalkSeconds, WriteStopwatch.Seconds());
 
-          Region.EndIdx = Tape_.size();
-          Regions_.emplace_back(Region);
+  //
+  // Yay!
+  //
 
-          //
-          // Start a new one.
-          //
+  fmt::print("Done writing {}\n", Filename);
+  return true;
+}
 
-          Region.Va = Entry->Va;
-        }
-      }
+//
+// Render a directory base with the visualizer of the production mode, unless
+// --verbose is used; in which case a visualizer dumping the mappings is
+// instantiated and the walk is done on a single thread so that the output
+// comes out in order.
+//
 
-      //
-      // Calculate the page protection from the PML4E/PDPTE/PDE/PTE.
-      //
+bool Render(const Options_t &Opts,
+            const kdmpparser::KernelDumpParser &DumpParser,
+            const uint64_t DirectoryBase, const uint64_t NumberThreads,
+            SubtreeCache_t *Cache, Visualizer_t &Visu,
+            stats::DirectoryBase_t *Stats = nullptr) {
+  if (Opts.Verbose) {
+    BasicVisualizer_t<ptables::VerbosePolicy_t> VerboseVisu(Opts.GapPolicy,
+                                                            Opts.Walk);
+    return RenderWith(Opts, DumpParser, DirectoryBase, 1, nullptr,
+                      VerboseVisu, Stats);
+  }
+
+  return RenderWith(Opts, DumpParser, DirectoryBase, NumberThreads, Cache,
+                    Visu, Stats);
+}
+
+//
+// Get a visualizer ready to render; with --max-memory, its tape gets its share
+// of the budget and the rest is spilled to a temporary file.
+//
+
+bool Prepare(const Options_t &Opts, Visualizer_t &Visu,
+             const uint64_t NumberVisualizers) {
+  if (Opts.MaxMemory == 0) {
+    return true;
+  }
+
+  return Visu.Spill(fs::temp_directory_path(),
+                    Opts.MaxMemory / NumberVisualizers);
+}
+
+//
+// Render a series of snapshots of the same machine, using the directory base of
+// every dump header: the first one is rendered entirely and every one after
+// that is written as a delta frame, the ranges whose protection changed since
+// the previous snapshot. The previous dump is kept open so that the page
+// tables that didn't change are skipped with a memcmp instead of being
+// decoded again.
+//
+
+bool RenderSeries(const Options_t &Opts) {
+  std::unique_ptr<kdmpparser::KernelDumpParser> Previous;
+  fs::path PreviousDumpFile;
+  uint64_t PreviousDirectoryBase = 0;
+  Visualizer_t Visu(Opts.GapPolicy, Opts.Walk);
+  if (!Prepare(Opts, Visu, 1)) {
+    return false;
+  }
 
-      const auto &Protection = Entry->Protection();
+  for (const auto &DumpFile : Opts.DumpFiles) {
+    auto Current = std::make_unique<kdmpparser::KernelDumpParser>();
+    if (!Current->Parse(DumpFile.string().c_str(), Opts.Reader,
+                        Opts.CacheSize, Opts.NumberThreads)) {
+      fmt::print("Parse of {} failed\n", DumpFile.string());
+      return false;
+    }
 
-      //
-      // Grab the number of pixels that we need for this page.
-      //
+    const uint64_t DirectoryBase =
+        page::Align(Current->GetDirectoryTableBase());
+    const bool Success =
+        Previous == nullptr
+            ? Render(Opts, *Current, DirectoryBase, Opts.NumberThreads,
+                     nullptr, Visu)
+            : WriteDiff({*Previous, PreviousDirectoryBase}, PreviousDumpFile,
+                        {*Current, DirectoryBase}, DumpFile);
+    if (!Success) {
+      return false;
+    }
 
-      const uint64_t NumberPixels = GetNumberPixels(Entry->Type);
+    Previous = std::move(Current);
+    PreviousDumpFile = DumpFile;
+    PreviousDirectoryBase = DirectoryBase;
+  }
 
-      //
-      // Time to populate the tape.
-      //
+  return true;
+}
 
-      for (uint64_t Idx = 0; Idx < NumberPixels; Idx++) {
-        const uint64_t CurrentPa = ptables::AddressFromPfn(Entry->Pa, Idx);
-        const uint64_t CurrentVa = ptables::AddressFromPfn(Entry->Va, Idx);
-        LastVa = CurrentVa;
+//
+// Render a batch of dumps with the directory base of their header, several of
+// them at a time. Every worker is pinned to a NUMA node and renders the dumps
+// it picks up from start to finish with threads of that node, so that the
+// pages of the dump, its physmem index and its tape end up in the memory of
+// the node. The workers are spread over the nodes and their walks get an
+// equal share of the threads. How fast every node went is printed at the end.
+//
 
-        //
-        // Dump the mappings if the user want to.
-        //
+bool RenderDumps(const Options_t &Opts) {
+  const auto &Nodes = numa::Nodes();
+  const uint64_t NumberWorkers =
+      Opts.Verbose
+          ? 1
+          : std::min(Opts.NumberThreads, uint64_t(Opts.DumpFiles.size()));
+  const uint64_t NumberThreadsPerWalk =
+      std::max(uint64_t(1), Opts.NumberThreads / NumberWorkers);
 
-        if (VerboseDumpMappings) {
-          fmt::print("VA:{:#x}, PA:{:#x} ({}, {}, PML4E:{:#x}, PDPTE:{:#x}, "
-                     "PDE:{:#x}, PTE:{:#x}, Dist:{})\n",
-                     CurrentVa, CurrentPa, ToString(Protection),
-                     ToString(Entry->Type), Entry->Pml4eAddress,
-                     Entry->PdpteAddress, Entry->PdeAddress, Entry->PteAddress,
-                     Tape_.size());
-        }
+  //
+  // What every node went through.
+  //
 
-        //
-        // Emplace the properties.
-        //
+  struct NodeStats_t {
+    uint64_t NumberDumps = 0;
+    uint64_t NumberFailures = 0;
+    uint64_t NumberBytes = 0;
+    double Seconds = 0;
+  };
 
-        Tape_.emplace_back(Protection);
+  std::mutex StatsLock;
+  std::vector<NodeStats_t> NodeStats(Nodes.size());
+  std::atomic<uint64_t> NextDumpFile = 0;
+  auto Worker = [&](const uint64_t NodeIdx) {
+    Visualizer_t Visu(Opts.GapPolicy, Opts.Walk);
+    if (!numa::Pin(Nodes[NodeIdx]) ||
+        !Prepare(Opts, Visu, NumberWorkers)) {
+      std::scoped_lock Guard(StatsLock);
+      NodeStats[NodeIdx].NumberFailures++;
+      return;
+    }
+
+    for (uint64_t Idx = NextDumpFile++; Idx < Opts.DumpFiles.size();
+         Idx = NextDumpFile++) {
+      const fs::path &DumpFile = Opts.DumpFiles[Idx];
+      const stats::Stopwatch_t Stopwatch;
+      Options_t DumpOpts = Opts;
+      DumpOpts.DumpFile = DumpFile;
+      kdmpparser::KernelDumpParser DumpParser;
+      bool Success = DumpParser.Parse(DumpFile.string().c_str(), Opts.Reader,
+                                      Opts.CacheSize, NumberThreadsPerWalk);
+      if (!Success) {
+        fmt::print("Parse of {} failed\n", DumpFile.string());
+      } else {
+        Success = Render(DumpOpts, DumpParser,
+                         page::Align(DumpParser.GetDirectoryTableBase()),
+                         NumberThreadsPerWalk, nullptr, Visu);
       }
+
+      std::error_code Ec;
+      const uint64_t NumberBytes = fs::file_size(DumpFile, Ec);
+      std::scoped_lock Guard(StatsLock);
+      NodeStats_t &Stats = NodeStats[NodeIdx];
+      Stats.NumberDumps += Success;
+      Stats.NumberFailures += !Success;
+      Stats.NumberBytes += Ec ? 0 : NumberBytes;
+      Stats.Seconds += Stopwatch.Seconds();
     }
+  };
 
-    //
-    // We're done.
-    //
+  std::vector<std::thread> Threads;
+  for (uint64_t Idx = 1; Idx < NumberWorkers; Idx++) {
+    Threads.emplace_back(Worker, Idx % Nodes.size());
+  }
 
-    fmt::print(
-        "Extracted {} properties and {} contiguous regions from the dump \n",
-        Tape_.size(), Regions_.size());
-    return true;
+  Worker(0);
+  for (auto &Thread : Threads) {
+    Thread.join();
   }
 
   //
-  // Write the tape on the disk with the PPM format.
+  // The throughput of a node is the size of the dumps it rendered over the
+  // time its workers spent on them.
   //
 
-  bool Write(const fs::path &Filename) const {
-    const uint64_t Order = uint64_t(ceil(std::log2(float(Tape_.size())) / 2));
-    const uint64_t Width = uint64_t(1) << Order;
-    const uint64_t Height = Width;
-    fmt::print("Laying it out on an hilbert-curve order {} ({} total pixels)\n",
-               Order, Width * Height);
+  uint64_t NumberFailures = 0;
+  for (uint64_t NodeIdx = 0; NodeIdx < Nodes.size(); NodeIdx++) {
+    const NodeStats_t &Stats = NodeStats[NodeIdx];
+    NumberFailures += Stats.NumberFailures;
+    if (Stats.NumberDumps == 0 && Stats.NumberFailures == 0) {
+      continue;
+    }
+
+    const double Megabytes = double(Stats.NumberBytes) / (1 << 20);
+    fmt::print("Node {}: {} dumps rendered ({} failed), {:.1f}MB in {:.3f}s "
+               "({:.1f}MB/s)\n",
+               Nodes[NodeIdx].Id, Stats.NumberDumps, Stats.NumberFailures,
+               Megabytes, Stats.Seconds,
+               Stats.Seconds > 0 ? Megabytes / Stats.Seconds : 0);
+  }
+
+  return NumberFailures == 0;
+}
+
+//
+// Render a batch of directory bases out of the same dump. Every directory
+// base is walked in its own thread, and the threads left over are used to walk
+// each of them in parallel. The kernel half of the address space is shared by
+// every process, so its subtrees are only walked once. What the rendering of
+// every directory base went through is stored in the report.
+//
+
+bool RenderBatch(const Options_t &Opts,
+                 const kdmpparser::KernelDumpParser &DumpParser,
+                 const std::vector<uint64_t> &DirectoryBases,
+                 stats::Report_t &Report) {
+  const uint64_t NumberWorkers =
+      Opts.Verbose
+          ? 1
+          : std::min(Opts.NumberThreads, uint64_t(DirectoryBases.size()));
+  const uint64_t NumberThreadsPerWalk =
+      std::max(uint64_t(1), Opts.NumberThreads / NumberWorkers);
+
+  SubtreeCache_t Cache;
+  SubtreeCache_t *CachePtr = DirectoryBases.size() > 1 ? &Cache : nullptr;
+  std::atomic<uint64_t> NextDirectoryBase = 0;
+  std::atomic<uint64_t> NumberFailures = 0;
+  Report.DirectoryBases.resize(DirectoryBases.size());
+  auto Worker = [&]() {
+    Visualizer_t Visu(Opts.GapPolicy, Opts.Walk);
+    if (!Prepare(Opts, Visu, NumberWorkers)) {
+      NumberFailures++;
+      return;
+    }
 
-    auto File = fmt::output_file(Filename.string());
-    File.print("{} {}\n", Width, Height);
-    uint64_t Idx = 0;
-    for (const auto &Region : Regions_) {
-      File.print("{:#x}\n", Region.Va);
-      for (; Idx != Region.EndIdx; Idx++) {
-        File.print("{:x}\n", Tape_[Idx]);
+    for (uint64_t Idx = NextDirectoryBase++; Idx < DirectoryBases.size();
+         Idx = NextDirectoryBase++) {
+      if (!Render(Opts, DumpParser, DirectoryBases[Idx], NumberThreadsPerWalk,
+                  CachePtr, Visu, &Report.DirectoryBases[Idx])) {
+        NumberFailures++;
       }
     }
+  };
 
-    return true;
+  std::vector<std::thread> Threads;
+  for (uint64_t Idx = 1; Idx < NumberWorkers; Idx++) {
+    Threads.emplace_back(Worker);
   }
-};
+
+  Worker();
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+
+  if (DirectoryBases.size() > 1) {
+    fmt::print("Rendered {} directory bases ({} failed, {} kernel subtrees "
+               "walked, {} reused)\n",
+               DirectoryBases.size() - NumberFailures, NumberFailures,
+               Cache.Misses(), Cache.Hits());
+  }
+
+  return NumberFailures == 0;
+}
 } // namespace clairvoyance
 
 int main(int argc, char *argv[]) {
-  if (argc < 2) {
-    fmt::print("./clairvoyance <dump path> [<page dir pa>]\n");
+  clairvoyance::Options_t Opts;
+  if (!clairvoyance::ParseOptions(argc, argv, Opts)) {
+    fmt::print("./clairvoyance [--binary|--png|--ppm|--tiles] [--threads <n>] "
+               "[--dirbases <file>] [--all-dirbases] [--stream] [--gzip] "
+               "[--progressive 2m|1g] "
+               "[--verbose] [--la57] [--attributes] [--content] "
+               "[--deadline <seconds>] [--progress] "
+               "[--overlay <overlay>] [--layout square|packed] "
+               "[--scale page|mapping] [--reader mmap|pread] "
+               "[--cache-size <pages>] "
+               "[--max-gap <pages>] [--padding <pixels>] [--stats <path>] "
+               "[--max-memory <MB>] [--max-table-visits <n>] "
+               "[--skip-self-reference] [--va-range <start>:<end>] "
+               "[--attribute] [--big-pool <va>:<number of entries>] "
+               "[--tape-cache <cache path>] "
+               "<dump path> [<page dir pa>...]\n");
+    fmt::print("./clairvoyance --ept|--npt <eptp|ncr3> [<render options>] "
+               "<host dump path> <guest page dir pa>...\n");
+    fmt::print("./clairvoyance --live <qemu pid> "
+               "[--guest-region <pa>:<host va>:<size>...] [<render options>] "
+               "<page dir pa>...\n");
+    fmt::print("./clairvoyance --diff <dump path> <page dir pa> "
+               "<other page dir pa>\n");
+    fmt::print("./clairvoyance --diff-against <other dump path> <dump path> "
+               "[<page dir pa> [<other page dir pa>]]\n");
+    fmt::print("./clairvoyance --series [<render options>] <dump path>...\n");
+    fmt::print("./clairvoyance --batch [<render options>] <dump path>...\n");
+    fmt::print("./clairvoyance --decode <binary .clairvoyance path>\n");
+    fmt::print("./clairvoyance --store <store path> "
+               "<binary .clairvoyance path>...\n");
+    fmt::print("./clairvoyance --fetch <store path> <name>...\n");
+    fmt::print("./clairvoyance --render <binary .clairvoyance path> "
+               "--png|--ppm [--overlay <overlay>] [--threads <n>]\n");
+    fmt::print("  <overlay> is protection, accessed, dirty, cache-disable, "
+               "write-through or content\n");
+    fmt::print("./clairvoyance --query <binary .clairvoyance path> "
+               "<va>|<start>-<end>|<protection>...\n");
+    fmt::print("./clairvoyance --locate <binary .clairvoyance path> "
+               "<distance>|<x>,<y>...\n");
+    fmt::print("./clairvoyance --rmap [--dirbases <file>] [--all-dirbases] "
+               "[--la57] [--threads <n>] <dump path> [<page dir pa>...]\n");
+    fmt::print("./clairvoyance --shared [--dirbases <file>] [--all-dirbases] "
+               "[--la57] [--threads <n>] <dump path> [<page dir pa>...]\n");
+    fmt::print("./clairvoyance --summary [--dirbases <file>] [--all-dirbases] "
+               "[--la57] [--threads <n>] [--max-table-visits <n>] "
+               "[--skip-self-reference] [--va-range <start>:<end>] "
+               "<dump path> [<page dir pa>...]\n");
+    fmt::print("./clairvoyance --stacks [--stack-pages <min>:<max>] "
+               "[--stack-recurrences <n>] [--dirbases <file>] "
+               "[--all-dirbases] [--la57] [--threads <n>] "
+               "<dump path> [<page dir pa>...]\n");
+    fmt::print("./clairvoyance --search <hex pattern> "
+               "[--search <hex pattern>...] [--dirbases <file>] "
+               "[--all-dirbases] [--la57] [--threads <n>] "
+               "<dump path> [<page dir pa>...]\n");
+    fmt::print("./clairvoyance --rmap-query <.rmap path> <pa>|aliases...\n");
+    fmt::print("./clairvoyance --serve <socket path> [--serve-memory <MB>] "
+               "[--threads <n>] [--reader mmap|pread] [--cache-size <pages>] "
+               "[--max-gap <pages>] [--padding <pixels>] "
+               "[--deadline <seconds>] [--progress]\n");
     return 0;
   }
 
   //
-  // Parse the dump file.
+  // If the user wants to decode a binary file, do it and bail.
+  //
+
+  if (!Opts.DecodeFile.empty()) {
+    return clairvoyance::Decode(Opts.DecodeFile);
+  }
+
+  //
+  // Put files in a store, or get them back.
   //
 
-  const fs::path DumpFile(argv[1]);
+  if (!Opts.StoreDirectory.empty()) {
+    return clairvoyance::Store(Opts);
+  }
+
+  //
+  // Same for rendering one.
+  //
+
+  if (!Opts.RenderFile.empty()) {
+    return clairvoyance::RenderBinary(Opts);
+  }
+
+  //
+  // Same for queries.
+  //
+
+  if (!Opts.QueryFile.empty()) {
+    return clairvoyance::Query(Opts.QueryFile, Opts.Queries);
+  }
+
+  if (!Opts.LocateFile.empty()) {
+    return clairvoyance::Locate(Opts.LocateFile, Opts.Queries);
+  }
+
+  if (!Opts.ReverseMapFile.empty()) {
+    return clairvoyance::QueryReverseMap(Opts.ReverseMapFile, Opts.Queries);
+  }
+
+  //
+  // In server mode, the dumps come from the requests.
+  //
+
+  if (!Opts.ServeSocket.empty()) {
+    clairvoyance::server::Config_t Config;
+    Config.SocketPath = Opts.ServeSocket;
+    Config.MemoryBudget = Opts.ServeMemoryBudget;
+    Config.NumberThreads = Opts.NumberThreads;
+    Config.Reader = Opts.Reader;
+    Config.CacheSize = Opts.CacheSize;
+    Config.GapPolicy = Opts.GapPolicy;
+    Config.Deadline = Opts.Deadline;
+    Config.Progress = Opts.Progress;
+    clairvoyance::server::Server_t Server(Config);
+    return Server.Serve() ? 1 : 0;
+  }
+
+  //
+  // A series of dumps is parsed one dump at a time.
+  //
+
+  if (Opts.Series) {
+    return clairvoyance::RenderSeries(Opts) ? 1 : 0;
+  }
+
+  //
+  // A batch of dumps is spread over the NUMA nodes.
+  //
+
+  if (Opts.Batch) {
+    return clairvoyance::RenderDumps(Opts) ? 1 : 0;
+  }
+
+  //
+  // When the tapes of every directory base to render are in the cache, they
+  // are rendered without parsing the dump file at all.
+  //
+
+  const fs::path &DumpFile = Opts.DumpFile;
   kdmpparser::KernelDumpParser DumpParser;
-  if (!DumpParser.Parse(DumpFile.string().c_str())) {
+  if (!Opts.TapeCache.empty()) {
+    Opts.Tapes.emplace();
+    if (!Opts.Tapes->Open(Opts.TapeCache, DumpFile)) {
+      return 0;
+    }
+
+    auto DirectoryBases = Opts.DirectoryBases;
+    if (DirectoryBases.empty()) {
+      DirectoryBases.emplace_back(Opts.Tapes->DirectoryTableBase());
+    }
+
+    const bool Rendering =
+        !Opts.Diff && !Opts.DiscoverDirectoryBases && !Opts.ReverseMap &&
+        Opts.Patterns.empty() && !Opts.SharedPages && !Opts.Summary &&
+        !Opts.Stacks;
+    const auto &Key = clairvoyance::TapeKey(Opts);
+    auto IsCached = [&](const uint64_t DirectoryBase) {
+      return DirectoryBase != 0 && Opts.Tapes->Contains(DirectoryBase, Key);
+    };
+
+    if (Rendering &&
+        std::all_of(DirectoryBases.begin(), DirectoryBases.end(), IsCached)) {
+      clairvoyance::stats::Report_t Report;
+      const bool Success =
+          clairvoyance::RenderBatch(Opts, DumpParser, DirectoryBases, Report);
+      if (!Opts.StatsFile.empty()) {
+        Report.Write(Opts.StatsFile, DumpFile);
+        fmt::print("Done writing {}\n", Opts.StatsFile.string());
+      }
+
+      return Success ? 1 : 0;
+    }
+  }
+
+  //
+  // Parse the dump file.
+  //
+
+  if (Opts.LivePid) {
+    if (Opts.GuestRegions.empty()) {
+      const auto &Region = clairvoyance::live::FindGuestMemory(*Opts.LivePid);
+      if (!Region) {
+        return 0;
+      }
+
+      Opts.GuestRegions.emplace_back(*Region);
+    }
+
+    const std::string MemoryPath =
+        clairvoyance::live::MemoryPath(*Opts.LivePid);
+    if (!DumpParser.ParseLive(MemoryPath.c_str(), Opts.GuestRegions,
+                              Opts.CacheSize)) {
+      fmt::print("Parse failed\n");
+      return false;
+    }
+  } else if (!DumpParser.Parse(DumpFile.string().c_str(), Opts.Reader,
+                               Opts.CacheSize, Opts.NumberThreads)) {
     fmt::print("Parse failed\n");
     return false;
   }
 
+  //
+  // Look at the memory of a guest of the host if the user wants to.
+  //
+
+  if (Opts.NestedPointer &&
+      !DumpParser.Nest(*Opts.NestedPointer, Opts.NestedPaging)) {
+    fmt::print("The second stage translation at {:#x} failed\n",
+               *Opts.NestedPointer);
+    return false;
+  }
+
   //
   // Warn if there is a chance to not have the full page tables hierarchy in
   // the dump.
   //
 
-  if (DumpParser.GetDumpType() != kdmpparser::DumpType_t::FullDump) {
+  if (DumpParser.GetDumpType() == kdmpparser::DumpType_t::BMPDump) {
     fmt::print("/!\\ {} is not a full dump so some pages might be missing\n",
                DumpFile.string());
   }
 
+  //
+  // Diff two address spaces if the user wants to.
+  //
+
+  if (Opts.Diff) {
+    return clairvoyance::Diff(Opts, DumpParser) ? 1 : 0;
+  }
+
+  //
+  // Scan the dump for every directory base if the user wants to.
+  //
+
+  if (Opts.DiscoverDirectoryBases) {
+    const auto Discovered =
+        discovery::FindDirectoryBases(DumpParser, Opts.NumberThreads);
+    fmt::print("Discovered {} directory bases in the dump\n",
+               Discovered.size());
+    if (Discovered.empty()) {
+      return 0;
+    }
+
+    auto &DirectoryBases = Opts.DirectoryBases;
+    DirectoryBases.insert(DirectoryBases.end(), Discovered.begin(),
+                          Discovered.end());
+    std::sort(DirectoryBases.begin(), DirectoryBases.end());
+    DirectoryBases.erase(
+        std::unique(DirectoryBases.begin(), DirectoryBases.end()),
+        DirectoryBases.end());
+  }
+
   //
   // Get the default @cr3 if one is not specified from the user.
   //
 
-  const uint64_t DirectoryBase = [&]() {
-    if (argc == 3) {
-      return uint64_t(strtoull(argv[2], nullptr, 0));
+  if (Opts.DirectoryBases.empty()) {
+    if (DumpParser.GetDirectoryTableBase() == 0) {
+      fmt::print("{} doesn't have a directory base, pass one after it\n",
+                 DumpFile.string());
+      return 0;
     }
 
-    return DumpParser.GetDirectoryTableBase();
-  }();
+    Opts.DirectoryBases.emplace_back(DumpParser.GetDirectoryTableBase());
+  }
 
   //
-  // Check that the PML4 at least exists.
+  // Build the reverse map instead of rendering if the user wants to.
   //
 
-  if (DumpParser.GetPhysicalPage(DirectoryBase) == nullptr) {
-    fmt::print("The page directory {:#x} is not mapped in the dump file\n",
-               DirectoryBase);
-    return 0;
+  if (Opts.ReverseMap) {
+    return clairvoyance::WriteReverseMap(Opts, DumpParser) ? 1 : 0;
   }
 
   //
-  // Parse the dump and prepare the curve.
+  // Same for the pattern search.
   //
 
-  clairvoyance::Visualizer_t Visu;
-  if (!Visu.Parse(DumpParser, DirectoryBase)) {
-    fmt::print("Parse failed\n");
-    return 0;
+  if (!Opts.Patterns.empty()) {
+    return clairvoyance::SearchPatterns(Opts, DumpParser) ? 1 : 0;
   }
 
   //
-  // Write the picture on disk.
+  // Same for the pages shared across directory bases.
   //
 
-  const auto &Filename = fmt::format("{}-{:#x}.clairvoyance",
-                                     DumpFile.stem().string(), DirectoryBase);
-  const fs::path OutFile(fs::current_path() / Filename);
-  if (!Visu.Write(OutFile)) {
-    fmt::print("Write failed\n");
-    return 0;
+  if (Opts.SharedPages) {
+    return clairvoyance::WriteSharedPages(Opts, DumpParser) ? 1 : 0;
   }
 
   //
-  // Yay!
+  // Same for the summary.
   //
 
-  fmt::print("Done writing {}\n", Filename);
-  return 1;
-}
\ No newline at end of file
+  if (Opts.Summary) {
+    return clairvoyance::PrintSummary(Opts, DumpParser) ? 1 : 0;
+  }
+
+  //
+  // Same for the kernel stacks.
+  //
+
+  if (Opts.Stacks) {
+    return clairvoyance::PrintStacks(Opts, DumpParser) ? 1 : 0;
+  }
+
+  //
+  // Render every directory base; the dump is only parsed once.
+  //
+
+  clairvoyance::stats::Report_t Report;
+  Report.SetParseStats(DumpParser.GetParseStats());
+  const bool Success = clairvoyance::RenderBatch(Opts, DumpParser,
+                                                 Opts.DirectoryBases, Report);
+  const auto &Stats = DumpParser.GetPageCacheStats();
+  if (Stats.Misses != 0) {
+    const std::string Capacity =
+        Stats.Capacity != Opts.CacheSize
+            ? fmt::format(" (capacity of {} pages)", Stats.Capacity)
+            : std::string();
+    fmt::print("Page cache: {} hits, {} misses, {} evictions, {} pages{}\n",
+               Stats.Hits, Stats.Misses, Stats.Evictions, Stats.NumberPages,
+               Capacity);
+  }
+
+  //
+  // Write the timings and the counters if the user wants them.
+  //
+
+  if (!Opts.StatsFile.empty()) {
+    Report.Write(Opts.StatsFile, DumpFile);
+    fmt::print("Done writing {}\n", Opts.StatsFile.string());
+  }
+
+  return Success ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+
+//
+// The public interface of libclairvoyance, for the programs that want to walk
+// dumps in-process instead of spawning clairvoyance and parsing its output:
+//   - kdmpparser::KernelDumpParser opens a dump,
+//   - ptables::PageTableWalker_t / ptables::ParallelWalk walk the page tables
+//     of a directory base,
+//   - clairvoyance::TapeBuilder_t turns what they return into a tape,
+//   - clairvoyance::Visualizer_t drives the above and writes the text, binary
+//     and image formats,
+//   - clairvoyance::query::Index_t answers queries about an address space,
+//   - clairvoyance::rmap::Index_t maps physical pages back to their virtual
+//     mappings in every directory base,
+//   - clairvoyance::sharing::FindSharedPages finds the user pages that several
+//     directory bases share,
+//   - clairvoyance::search::Search looks for patterns in the memory mapped by
+//     a directory base,
+//   - clairvoyance::summary::Summarize counts the pages mapped with every
+//     protection by a directory base,
+//   - clairvoyance::entropy::Classify tells what a physical page contains,
+//   - clairvoyance::translation::Tlb_t caches the translations of virtual
+//     addresses,
+//   - clairvoyance::live::FindGuestMemory finds the guest RAM of a QEMU
+//     process, for KernelDumpParser::ParseLive,
+//   - clairvoyance::attribution::Build finds the owners of the kernel address
+//     space (modules and big pool allocations) to label a tape with,
+//   - clairvoyance::numa::Nodes / numa::Pin place the threads on NUMA nodes,
+//   - clairvoyance::stats::Report_t writes the timings and the counters of a
+//     rendering as JSON,
+//   - diff::Differ_t compares two address spaces,
+//   - discovery::FindDirectoryBases looks for the directory bases of a dump,
+//   - store::Store_t keeps binary files in a deduplicated chunk store,
+//   - server::Server_t keeps dumps and their tapes around to answer requests.
+// A visualizer (and a tape builder) can be reset and reused for another
+// directory base so that long-running programs don't reallocate the tape; its
+// walks and writes can be abandoned with a ptables::Cancellation_t, and
+// Parse reports how far the walk went.
+//
+
+#include "attribution.h"
+#include "binaryformat.h"
+#include "diff.h"
+#include "discovery.h"
+#include "entropy.h"
+#include "image.h"
+#include "kdmp-parser.h"
+#include "live.h"
+#include "numa.h"
+#include "pagetables.h"
+#include "query.h"
+#include "reversemap.h"
+#include "search.h"
+#include "server.h"
+#include "sharing.h"
+#include "stacks.h"
+#include "stats.h"
+#include "store.h"
+#include "streamwriter.h"
+#include "summary.h"
+#include "tape.h"
+#include "tapecache.h"
+#include "tiles.h"
+#include "translation.h"
+#include "visualizer.h"
@@ -0,0 +1,287 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace diff {
+
+//
+// A range of pages whose protection differs between two address spaces.
+//
+
+struct Change_t {
+  uint64_t Va = 0;
+  uint64_t NumberPages = 0;
+  ptables::Protection_t Before = ptables::Protection_t::None;
+  ptables::Protection_t After = ptables::Protection_t::None;
+};
+
+//
+// One side of the diff: a directory base in a dump.
+//
+
+struct Side_t {
+  const kdmpparser::KernelDumpParser &DumpParser;
+  uint64_t DirectoryAddress = 0;
+};
+
+//
+// Compare two address spaces, either two directory bases of the same dump or
+// directory bases of two dumps, and hand out the ranges whose protection
+// changed in ascending VA order. Both hierarchies are walked in lockstep, and
+// only the parts that differ get walked entirely: a PXE that is identical on
+// both sides (ignoring the accessed / dirty bits) and reached with the same
+// access bits maps the same thing if it is a leaf, as well as if it points to
+// a table in the same dump. Across dumps, tables are compared with memcmp
+// first so that identical page tables are skipped without decoding a single
+// entry.
+//
+
+class Differ_t {
+  using Pte_t = ptables::Pte_t;
+  using Va_t = ptables::Va_t;
+
+  //
+  // The levels of the hierarchy, and what a PXE at every level covers.
+  //
+
+  enum Level_t : uint64_t { Pml4, Pdpt, Pd, Pt, NumberLevels };
+  static constexpr uint64_t NumberEntries = page::Size / sizeof(Pte_t);
+  static constexpr uint64_t PagesPerEntry[] = {NumberEntries * NumberEntries *
+                                                   NumberEntries,
+                                               NumberEntries * NumberEntries,
+                                               NumberEntries, 1};
+
+  //
+  // The accessed and dirty bits are set by the hardware, they don't matter.
+  //
+
+  static constexpr uint64_t StableBits = ~uint64_t(0b110'0000);
+
+  const Side_t A_;
+  const Side_t B_;
+  const bool SameDump_;
+  std::vector<Change_t> Changes_;
+
+  //
+  // Statistics.
+  //
+
+  uint64_t NumberTablesCompared_ = 0;
+  uint64_t NumberTablesIdentical_ = 0;
+  uint64_t NumberSubtreesSkipped_ = 0;
+
+  //
+  // Record that [Va, Va + NumberPages pages) went from Before to After;
+  // contiguous changes are merged.
+  //
+
+  void Emit(const uint64_t Va, const uint64_t NumberPages,
+            const ptables::Protection_t Before,
+            const ptables::Protection_t After) {
+    if (Before == After || NumberPages == 0) {
+      return;
+    }
+
+    if (!Changes_.empty()) {
+      Change_t &Last = Changes_.back();
+      if (Last.Before == Before && Last.After == After &&
+          (Last.Va + (Last.NumberPages * page::Size)) == Va) {
+        Last.NumberPages += NumberPages;
+        return;
+      }
+    }
+
+    Changes_.push_back({Va, NumberPages, Before, After});
+  }
+
+  //
+  // The ranges of a side in [First, Last], with the holes filled with None so
+  // that they cover it entirely.
+  //
+
+  static std::vector<ptables::Range_t> Ranges(const Side_t &Side,
+                                              const Va_t First,
+                                              const Va_t Last,
+                                              const uint64_t NumberPages) {
+    std::vector<ptables::Range_t> Ranges;
+    ptables::PageTableWalker_t Walker(Side.DumpParser, Side.DirectoryAddress,
+                                      First, Last);
+    uint64_t Page = 0;
+    while (const auto &Range = Walker.NextRange()) {
+      const uint64_t RangePage = (Range->Va - First.U64()) / page::Size;
+      if (RangePage > Page) {
+        Ranges.push_back({First.U64() + (Page * page::Size), RangePage - Page,
+                          ptables::Protection_t::None});
+      }
+
+      Ranges.push_back(*Range);
+      Page = RangePage + Range->NumberPages;
+    }
+
+    if (Page < NumberPages) {
+      Ranges.push_back({First.U64() + (Page * page::Size), NumberPages - Page,
+                        ptables::Protection_t::None});
+    }
+
+    return Ranges;
+  }
+
+  //
+  // Walk the part of the address space covered by the PXE at Indexes on both
+  // sides and compare the ranges; this is what's done when the two
+  // hierarchies don't have the same shape.
+  //
+
+  void Compare(const uint64_t Level, const uint64_t Indexes[NumberLevels]) {
+    uint64_t FirstIndexes[NumberLevels] = {}, LastIndexes[NumberLevels] = {};
+    for (uint64_t Idx = 0; Idx < NumberLevels; Idx++) {
+      FirstIndexes[Idx] = Idx <= Level ? Indexes[Idx] : 0;
+      LastIndexes[Idx] = Idx <= Level ? Indexes[Idx] : NumberEntries - 1;
+    }
+
+    const Va_t First(FirstIndexes[Pml4], FirstIndexes[Pdpt], FirstIndexes[Pd],
+                     FirstIndexes[Pt]);
+    const Va_t Last(LastIndexes[Pml4], LastIndexes[Pdpt], LastIndexes[Pd],
+                    LastIndexes[Pt]);
+    const uint64_t NumberPages = PagesPerEntry[Level];
+    const auto &Before = Ranges(A_, First, Last, NumberPages);
+    const auto &After = Ranges(B_, First, Last, NumberPages);
+
+    //
+    // Sweep both lists of ranges.
+    //
+
+    uint64_t Page = 0;
+    auto BeforeIt = Before.begin(), AfterIt = After.begin();
+    uint64_t BeforeEnd = BeforeIt->NumberPages, AfterEnd = AfterIt->NumberPages;
+    while (Page < NumberPages) {
+      const uint64_t End = std::min(BeforeEnd, AfterEnd);
+      Emit(First.U64() + (Page * page::Size), End - Page,
+           BeforeIt->Protection, AfterIt->Protection);
+      Page = End;
+      if (Page == BeforeEnd && ++BeforeIt != Before.end()) {
+        BeforeEnd += BeforeIt->NumberPages;
+      }
+
+      if (Page == AfterEnd && ++AfterIt != After.end()) {
+        AfterEnd += AfterIt->NumberPages;
+      }
+    }
+  }
+
+  //
+  // Is this entry mapping memory (as opposed to pointing to a table)?
+  //
+
+  static bool IsLeaf(const uint64_t Level, const Pte_t &Entry) {
+    return Level == Pt || ((Level == Pdpt || Level == Pd) && Entry.u.LargePage);
+  }
+
+  //
+  // Compare two tables at the same position in both hierarchies.
+  //
+
+  void Diff(const uint64_t Level, const Pte_t *TableA, const Pte_t *TableB,
+            const ptables::Access_t &AccessA, const ptables::Access_t &AccessB,
+            uint64_t Indexes[NumberLevels]) {
+    NumberTablesCompared_++;
+    const bool Identical = memcmp(TableA, TableB, page::Size) == 0;
+    NumberTablesIdentical_ += Identical;
+    if (Identical && AccessA == AccessB && Level == Pt) {
+      return;
+    }
+
+    for (uint64_t Idx = 0; Idx < NumberEntries; Idx++) {
+      Indexes[Level] = Idx;
+      const Pte_t &EntryA = TableA[Idx];
+      const Pte_t &EntryB = TableB[Idx];
+      const bool PresentA = EntryA.u.Present, PresentB = EntryB.u.Present;
+      if (!PresentA && !PresentB) {
+        continue;
+      }
+
+      const bool Same = AccessA == AccessB &&
+                        (EntryA.AsUINT64 & StableBits) ==
+                            (EntryB.AsUINT64 & StableBits);
+      const bool LeafA = PresentA && IsLeaf(Level, EntryA);
+      const bool LeafB = PresentB && IsLeaf(Level, EntryB);
+      if (Same && (LeafA || SameDump_)) {
+        NumberSubtreesSkipped_ += !LeafA;
+        continue;
+      }
+
+      //
+      // If both entries point to a table, compare them. Otherwise the shapes
+      // differ and both sides get walked.
+      //
+
+      if (PresentA && PresentB && !LeafA && !LeafB) {
+        const uint64_t AddressA =
+            ptables::AddressFromPfn(EntryA.u.PageFrameNumber);
+        const uint64_t AddressB =
+            ptables::AddressFromPfn(EntryB.u.PageFrameNumber);
+        const auto ChildA = (Pte_t *)A_.DumpParser.GetPhysicalPage(AddressA);
+        const auto ChildB = (Pte_t *)B_.DumpParser.GetPhysicalPage(AddressB);
+        if (ChildA != nullptr && ChildB != nullptr) {
+          Diff(Level + 1, ChildA, ChildB, AccessA.Combine(EntryA),
+               AccessB.Combine(EntryB), Indexes);
+        }
+
+        if (ChildA != nullptr) {
+          A_.DumpParser.ReleasePhysicalPage(AddressA);
+        }
+
+        if (ChildB != nullptr) {
+          B_.DumpParser.ReleasePhysicalPage(AddressB);
+        }
+
+        if (ChildA != nullptr && ChildB != nullptr) {
+          continue;
+        }
+      }
+
+      Compare(Level, Indexes);
+    }
+  }
+
+public:
+  Differ_t(const Side_t &A, const Side_t &B)
+      : A_(A), B_(B), SameDump_(&A.DumpParser == &B.DumpParser) {}
+
+  //
+  // Run the diff; returns false if one of the PML4s is not in its dump.
+  //
+
+  bool Run() {
+    const auto Pml4A =
+        (Pte_t *)A_.DumpParser.GetPhysicalPage(A_.DirectoryAddress);
+    const auto Pml4B =
+        (Pte_t *)B_.DumpParser.GetPhysicalPage(B_.DirectoryAddress);
+    if (Pml4A != nullptr && Pml4B != nullptr) {
+      uint64_t Indexes[NumberLevels] = {};
+      Diff(Pml4, Pml4A, Pml4B, ptables::Access_t(), ptables::Access_t(),
+           Indexes);
+    }
+
+    if (Pml4A != nullptr) {
+      A_.DumpParser.ReleasePhysicalPage(A_.DirectoryAddress);
+    }
+
+    if (Pml4B != nullptr) {
+      B_.DumpParser.ReleasePhysicalPage(B_.DirectoryAddress);
+    }
+
+    return Pml4A != nullptr && Pml4B != nullptr;
+  }
+
+  const std::vector<Change_t> &Changes() const { return Changes_; }
+  uint64_t NumberTablesCompared() const { return NumberTablesCompared_; }
+  uint64_t NumberTablesIdentical() const { return NumberTablesIdentical_; }
+  uint64_t NumberSubtreesSkipped() const { return NumberSubtreesSkipped_; }
+};
+
+} // namespace diff
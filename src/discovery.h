@@ -0,0 +1,186 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace discovery {
+
+//
+// Number of PXEs per page and index of the first kernel PML4E.
+//
+
+constexpr uint64_t NumberEntries = page::Size / sizeof(ptables::Pte_t);
+constexpr uint64_t FirstKernelEntry = NumberEntries / 2;
+
+//
+// Bits of a PML4E that are identical in every copy of the kernel half; the
+// accessed / dirty bits are set independently by the hardware in every copy.
+//
+
+constexpr uint64_t StableBits = ~uint64_t(0b110'0000);
+
+//
+// Count how many kernel PML4Es of a candidate match the reference ones.
+//
+
+inline uint64_t CountMatchingKernelEntries(const ptables::Pte_t *Candidate,
+                                           const ptables::Pte_t *Reference) {
+  uint64_t NumberMatches = 0;
+  uint64_t Idx = FirstKernelEntry;
+#if defined(__AVX2__)
+  const __m256i Mask = _mm256_set1_epi64x(int64_t(StableBits));
+  for (; (Idx + 4) <= NumberEntries; Idx += 4) {
+    const __m256i A = _mm256_and_si256(
+        _mm256_loadu_si256((const __m256i *)&Candidate[Idx]), Mask);
+    const __m256i B = _mm256_and_si256(
+        _mm256_loadu_si256((const __m256i *)&Reference[Idx]), Mask);
+    const int Equal = _mm256_movemask_pd(_mm256_castsi256_pd(
+        _mm256_cmpeq_epi64(A, B)));
+    NumberMatches += std::popcount(uint32_t(Equal));
+  }
+#endif
+
+  for (; Idx < NumberEntries; Idx++) {
+    NumberMatches += (Candidate[Idx].AsUINT64 & StableBits) ==
+                     (Reference[Idx].AsUINT64 & StableBits);
+  }
+
+  return NumberMatches;
+}
+
+//
+// Scan every physical page of the dump looking for PML4s. A page is a PML4 if
+// it has a self-referencing entry at the same index as the reference PML4 (the
+// one from the dump header) and if most of its kernel half matches the
+// reference one. The scan is spread across threads by chunks of pages.
+//
+
+inline std::vector<uint64_t>
+FindDirectoryBases(kdmpparser::KernelDumpParser &DumpParser,
+                   const uint64_t NumberThreads) {
+  const uint64_t ReferenceAddress =
+      page::Align(DumpParser.GetDirectoryTableBase());
+  const auto Reference =
+      (ptables::Pte_t *)DumpParser.GetPhysicalPage(ReferenceAddress);
+  if (Reference == nullptr) {
+    fmt::print("The page directory {:#x} is not mapped in the dump file\n",
+               ReferenceAddress);
+    return {};
+  }
+
+  //
+  // Every process has the self-reference at the same index, and the same
+  // kernel PML4Es.
+  //
+
+  const auto SelfRefIdx = ptables::FindSelfReference(
+      Reference, ReferenceAddress, FirstKernelEntry);
+  if (!SelfRefIdx) {
+    fmt::print("The page directory {:#x} doesn't have a self-reference\n",
+               ReferenceAddress);
+    DumpParser.ReleasePhysicalPage(ReferenceAddress);
+    return {};
+  }
+
+  uint64_t NumberKernelEntries = 0;
+  for (uint64_t Idx = FirstKernelEntry; Idx < NumberEntries; Idx++) {
+    NumberKernelEntries += Idx != *SelfRefIdx && Reference[Idx].u.Present;
+  }
+
+  //
+  // Be lenient: most of the kernel entries that are present in the reference
+  // need to match, not all of them.
+  //
+
+  const uint64_t MinMatches =
+      (NumberEntries - FirstKernelEntry) - (NumberKernelEntries / 4);
+
+  //
+  // Chunk up the physical memory.
+  //
+
+  constexpr uint64_t PagesPerChunk = 0x1000;
+  struct Chunk_t {
+    uint64_t BasePage;
+    uint64_t PageCount;
+  };
+
+  std::vector<Chunk_t> Chunks;
+  for (const auto &Run : DumpParser.GetPhysmem().Runs()) {
+    for (uint64_t PageIdx = 0; PageIdx < Run.PageCount;
+         PageIdx += PagesPerChunk) {
+      Chunks.push_back({Run.BasePage + PageIdx,
+                        std::min(PagesPerChunk, Run.PageCount - PageIdx)});
+    }
+  }
+
+  std::mutex Lock;
+  std::vector<uint64_t> DirectoryBases;
+  std::atomic<uint64_t> NextChunk = 0;
+  auto Worker = [&]() {
+    std::vector<uint64_t> Found;
+    for (uint64_t ChunkIdx = NextChunk++; ChunkIdx < Chunks.size();
+         ChunkIdx = NextChunk++) {
+      const Chunk_t &Chunk = Chunks[ChunkIdx];
+      for (uint64_t PageIdx = 0; PageIdx < Chunk.PageCount; PageIdx++) {
+        const uint64_t Pfn = Chunk.BasePage + PageIdx;
+        const uint64_t Address = ptables::AddressFromPfn(Pfn);
+        const auto Candidate =
+            (ptables::Pte_t *)DumpParser.GetPhysicalPage(Address);
+        if (Candidate == nullptr) {
+          continue;
+        }
+
+        //
+        // The self-reference check rejects almost every page with a single
+        // load, so do it first. The self-reference counts as a match as every
+        // copy has its own.
+        //
+
+        const ptables::Pte_t &SelfRef = Candidate[*SelfRefIdx];
+        const bool Match =
+            SelfRef.u.Present && SelfRef.u.PageFrameNumber == Pfn &&
+            (CountMatchingKernelEntries(Candidate, Reference) +
+             (Pfn != (ReferenceAddress / page::Size))) >= MinMatches;
+        DumpParser.ReleasePhysicalPage(Address);
+        if (Match) {
+          Found.emplace_back(Address);
+        }
+      }
+    }
+
+    std::scoped_lock Guard(Lock);
+    DirectoryBases.insert(DirectoryBases.end(), Found.begin(), Found.end());
+  };
+
+  std::vector<std::thread> Threads;
+  const uint64_t NumberWorkers =
+      std::max(uint64_t(1), std::min(NumberThreads, uint64_t(Chunks.size())));
+  for (uint64_t Idx = 1; Idx < NumberWorkers; Idx++) {
+    Threads.emplace_back(Worker);
+  }
+
+  Worker();
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+
+  DumpParser.ReleasePhysicalPage(ReferenceAddress);
+  std::sort(DirectoryBases.begin(), DirectoryBases.end());
+  return DirectoryBases;
+}
+
+} // namespace discovery
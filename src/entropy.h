@@ -0,0 +1,149 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace clairvoyance::entropy {
+
+//
+// What a page contains: pages that are zero or filled with a single byte get
+// their own class, the others are bucketed by the Shannon entropy of their
+// bytes; EntropyN covers [N, N + 1) bits per byte. Missing is for the pages
+// that aren't in the dump.
+//
+
+enum class Content_t : uint8_t {
+  Missing,
+  Zero,
+  Uniform,
+  Entropy0,
+  Entropy1,
+  Entropy2,
+  Entropy3,
+  Entropy4,
+  Entropy5,
+  Entropy6,
+  Entropy7,
+};
+
+constexpr uint64_t NumberContents = uint64_t(Content_t::Entropy7) + 1;
+
+//
+// The content of a page is stored in the high nibble of its attributes byte,
+// above the bits of the leaf entry.
+//
+
+constexpr uint8_t AttributesShift = 4;
+
+constexpr uint8_t ToAttributes(const Content_t Content) {
+  return uint8_t(Content) << AttributesShift;
+}
+
+constexpr Content_t FromAttributes(const uint8_t Attributes) {
+  return Content_t(Attributes >> AttributesShift);
+}
+
+//
+// Is the page filled with a single byte value?
+//
+
+inline bool IsUniform(const uint8_t *Page) {
+#if defined(__AVX2__)
+  const __m256i First = _mm256_set1_epi8(char(Page[0]));
+  __m256i Different = _mm256_setzero_si256();
+  for (uint64_t Offset = 0; Offset < page::Size; Offset += 32) {
+    const __m256i Bytes = _mm256_loadu_si256((const __m256i *)&Page[Offset]);
+    Different = _mm256_or_si256(Different, _mm256_xor_si256(Bytes, First));
+  }
+
+  return _mm256_testz_si256(Different, Different) != 0;
+#else
+  return memcmp(Page, Page + 1, page::Size - 1) == 0;
+#endif
+}
+
+//
+// Get the Shannon entropy of the bytes of a page, in bits per byte. The
+// histogram is spread over four tables so that consecutive bytes with the
+// same value don't serialize on the same counter; AVX2 doesn't have scatters
+// so this is as fast as it gets. The count * log2(count) terms come out of a
+// table.
+//
+
+inline double Entropy(const uint8_t *Page) {
+  static const auto Terms = []() {
+    std::array<float, page::Size + 1> Terms = {};
+    for (uint64_t Count = 1; Count < Terms.size(); Count++) {
+      Terms[Count] = float(double(Count) * std::log2(double(Count)));
+    }
+
+    return Terms;
+  }();
+
+  std::array<std::array<uint16_t, 256>, 4> Counts = {};
+  for (uint64_t Offset = 0; Offset < page::Size; Offset += sizeof(uint64_t)) {
+    uint64_t Bytes;
+    memcpy(&Bytes, &Page[Offset], sizeof(Bytes));
+    Counts[0][uint8_t(Bytes)]++;
+    Counts[1][uint8_t(Bytes >> 8)]++;
+    Counts[2][uint8_t(Bytes >> 16)]++;
+    Counts[3][uint8_t(Bytes >> 24)]++;
+    Counts[0][uint8_t(Bytes >> 32)]++;
+    Counts[1][uint8_t(Bytes >> 40)]++;
+    Counts[2][uint8_t(Bytes >> 48)]++;
+    Counts[3][uint8_t(Bytes >> 56)]++;
+  }
+
+  float Sum = 0;
+  for (uint64_t Value = 0; Value < 256; Value++) {
+    Sum += Terms[Counts[0][Value] + Counts[1][Value] + Counts[2][Value] +
+                 Counts[3][Value]];
+  }
+
+  //
+  // H = log2(N) - (sum(c * log2(c)) / N) with N = 4096.
+  //
+
+  return std::max(0., 12. - (double(Sum) / double(page::Size)));
+}
+
+//
+// Classify the content of a page.
+//
+
+inline Content_t Classify(const uint8_t *Page) {
+  if (IsUniform(Page)) {
+    return Page[0] == 0 ? Content_t::Zero : Content_t::Uniform;
+  }
+
+  const uint64_t Bucket = std::min(uint64_t(Entropy(Page)), uint64_t(7));
+  return Content_t(uint64_t(Content_t::Entropy0) + Bucket);
+}
+
+//
+// Classify the content of the physical page at Pa.
+//
+
+inline Content_t Classify(const kdmpparser::KernelDumpParser &DumpParser,
+                          const uint64_t Pa) {
+  const uint64_t PageAddress = page::Align(Pa);
+  const uint8_t *Page = DumpParser.GetPhysicalPage(PageAddress);
+  if (Page == nullptr) {
+    return Content_t::Missing;
+  }
+
+  const Content_t Content = Classify(Page);
+  DumpParser.ReleasePhysicalPage(PageAddress);
+  return Content;
+}
+
+} // namespace clairvoyance::entropy
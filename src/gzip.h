@@ -0,0 +1,211 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(CLAIRVOYANCE_GZIP)
+#include <zlib.h>
+#endif
+
+namespace clairvoyance::gzip {
+
+namespace fs = std::filesystem;
+
+//
+// The gzip writer compresses the buffers that are handed over to it in its
+// own thread and writes them in a .gz file, which browsers decompress
+// natively. The buffers are swapped with the ones it is done with instead of
+// being copied, and the queue is bounded so that the producer gets throttled
+// if it is faster than the compression. It is only available when
+// clairvoyance is built with zlib.
+//
+
+class Writer_t {
+  //
+  // The maximum number of buffers waiting to be compressed.
+  //
+
+  static constexpr size_t MaxChunks = 4;
+
+  //
+  // The size of the compressed data written at once.
+  //
+
+  static constexpr size_t OutputSize = 1024 * 1024;
+
+  struct Chunk_t {
+    std::vector<uint8_t> Buffer;
+    uint64_t Size = 0;
+  };
+
+  FILE *File_ = nullptr;
+  std::thread Thread_;
+  std::mutex Lock_;
+  std::condition_variable NotEmpty_;
+  std::condition_variable NotFull_;
+  std::deque<Chunk_t> Queue_;
+  std::vector<std::vector<uint8_t>> Free_;
+  bool Closed_ = false;
+  std::atomic<bool> Success_ = true;
+
+#if defined(CLAIRVOYANCE_GZIP)
+  z_stream Stream_ = {};
+
+  //
+  // Compress a buffer, or finish the stream if Flush is Z_FINISH.
+  //
+
+  void Deflate(const uint8_t *Data, const uint64_t Size, const int Flush,
+               std::vector<uint8_t> &Output) {
+    Stream_.next_in = (Bytef *)Data;
+    Stream_.avail_in = uInt(Size);
+    int Result = Z_OK;
+    do {
+      Stream_.next_out = Output.data();
+      Stream_.avail_out = uInt(Output.size());
+      Result = deflate(&Stream_, Flush);
+      const uint64_t Produced = Output.size() - Stream_.avail_out;
+      if (Result == Z_STREAM_ERROR ||
+          (Produced > 0 && fwrite(Output.data(), Produced, 1, File_) != 1)) {
+        Success_ = false;
+        return;
+      }
+    } while (Stream_.avail_out == 0 ||
+             (Flush == Z_FINISH && Result != Z_STREAM_END));
+  }
+#endif
+
+  //
+  // Compress every buffer that gets pushed until the writer is closed.
+  //
+
+  void Run() {
+#if defined(CLAIRVOYANCE_GZIP)
+    std::vector<uint8_t> Output(OutputSize);
+    while (true) {
+      Chunk_t Chunk;
+      {
+        std::unique_lock Guard(Lock_);
+        NotEmpty_.wait(Guard, [&]() { return Closed_ || !Queue_.empty(); });
+        if (Queue_.empty()) {
+          break;
+        }
+
+        Chunk = std::move(Queue_.front());
+        Queue_.pop_front();
+      }
+
+      NotFull_.notify_one();
+      Deflate(Chunk.Buffer.data(), Chunk.Size, Z_NO_FLUSH, Output);
+
+      std::scoped_lock Guard(Lock_);
+      Free_.emplace_back(std::move(Chunk.Buffer));
+    }
+
+    Deflate(nullptr, 0, Z_FINISH, Output);
+#endif
+  }
+
+public:
+  Writer_t() = default;
+  Writer_t(const Writer_t &) = delete;
+  Writer_t &operator=(const Writer_t &) = delete;
+
+  ~Writer_t() {
+    if (File_ != nullptr) {
+      Close();
+    }
+  }
+
+  //
+  // Create the file and start the compression thread; Level is the zlib
+  // compression level.
+  //
+
+  bool Open(const fs::path &Filename, const int Level = 1) {
+#if defined(CLAIRVOYANCE_GZIP)
+
+    //
+    // Adding 16 to the window bits asks for a gzip header and trailer.
+    //
+
+    constexpr int GzipWindowBits = 15 + 16;
+    constexpr int MemoryLevel = 8;
+    if (deflateInit2(&Stream_, Level, Z_DEFLATED, GzipWindowBits, MemoryLevel,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      fmt::print("Could not initialize the compression\n");
+      return false;
+    }
+
+    File_ = fopen(Filename.string().c_str(), "wb");
+    if (File_ == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      deflateEnd(&Stream_);
+      return false;
+    }
+
+    Thread_ = std::thread([this]() { Run(); });
+    return true;
+#else
+    (void)Filename;
+    (void)Level;
+    fmt::print("clairvoyance was built without zlib, so it can't compress\n");
+    return false;
+#endif
+  }
+
+  //
+  // Queue the first Size bytes of a buffer; it is swapped with a buffer that
+  // has been compressed already (or an empty one). This blocks if the
+  // compression is lagging behind.
+  //
+
+  bool Write(std::vector<uint8_t> &Buffer, const uint64_t Size) {
+    std::unique_lock Guard(Lock_);
+    NotFull_.wait(Guard, [&]() { return Queue_.size() < MaxChunks; });
+    Queue_.push_back({std::move(Buffer), Size});
+    Buffer.clear();
+    if (!Free_.empty()) {
+      Buffer = std::move(Free_.back());
+      Free_.pop_back();
+    }
+
+    Guard.unlock();
+    NotEmpty_.notify_one();
+    return Success_;
+  }
+
+  //
+  // Compress what is left, finish the stream and close the file.
+  //
+
+  bool Close() {
+    {
+      std::scoped_lock Guard(Lock_);
+      Closed_ = true;
+    }
+
+    NotEmpty_.notify_one();
+    Thread_.join();
+#if defined(CLAIRVOYANCE_GZIP)
+    deflateEnd(&Stream_);
+#endif
+
+    if (fclose(File_) != 0) {
+      Success_ = false;
+    }
+
+    File_ = nullptr;
+    return Success_;
+  }
+};
+
+} // namespace clairvoyance::gzip
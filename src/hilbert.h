@@ -0,0 +1,268 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace hilbert {
+
+//
+// Coordinates of a point on the curve.
+//
+
+struct Point_t {
+  uint32_t X = 0;
+  uint32_t Y = 0;
+};
+
+//
+// Convert a distance on a hilbert-curve of a given order to (x, y)
+// coordinates. This is the state machine from Hacker's delight second edition
+// (figure 16-8): every step consumes two bits of the distance and produces a
+// bit of each coordinate. The state transitions and outputs are packed into
+// the three constants.
+//
+
+constexpr Point_t D2xy(const uint64_t Distance, const uint64_t Order) {
+  uint32_t State = 0;
+  Point_t Point;
+  for (int64_t Shift = int64_t(2 * Order) - 2; Shift >= 0; Shift -= 2) {
+    const uint32_t Row = (4 * State) | ((Distance >> Shift) & 3);
+    Point.X = (Point.X << 1) | ((0x93'6c >> Row) & 1);
+    Point.Y = (Point.Y << 1) | ((0x39'c6 >> Row) & 1);
+    State = (0x3e'6b'94'c1 >> (2 * Row)) & 3;
+  }
+
+  return Point;
+}
+
+static_assert(D2xy(0, 1).X == 0 && D2xy(0, 1).Y == 0);
+static_assert(D2xy(1, 1).X == 0 && D2xy(1, 1).Y == 1);
+static_assert(D2xy(2, 1).X == 1 && D2xy(2, 1).Y == 1);
+static_assert(D2xy(3, 1).X == 1 && D2xy(3, 1).Y == 0);
+
+//
+// How a tape is laid out: NumberTiles curves of a given order side by side,
+// the n-th one covering the distances [n * 4^Order, (n + 1) * 4^Order). A
+// curve starts at its top-left corner and ends at its top-right corner, so
+// the next one starts right next to where the previous one ended and the
+// neighbourhoods are preserved across the tiles.
+//
+
+struct Layout_t {
+  uint64_t Order = 0;
+  uint64_t NumberTiles = 1;
+
+  constexpr uint64_t Width() const { return NumberTiles << Order; }
+  constexpr uint64_t Height() const { return uint64_t(1) << Order; }
+  constexpr uint64_t NumberPixels() const { return Width() * Height(); }
+};
+
+//
+// The layouts a tape can be put on: a single square curve, or up to three
+// curves of the order below side by side.
+//
+
+enum class Shape_t { Square, Packed };
+
+//
+// Get the smallest layout of a shape that fits Size pixels. A square curve
+// of order n fits 4^n pixels, so its order is half the number of bits of
+// Size - 1 rounded up; this is exact unlike going through floats. It wastes
+// up to three quarters of its pixels for a tape just past a power of four, a
+// packed layout at most a third.
+//
+
+constexpr Layout_t LayoutFor(const uint64_t Size, const Shape_t Shape) {
+  const uint64_t Order =
+      Size > 1 ? (uint64_t(std::bit_width(Size - 1)) + 1) / 2 : 0;
+
+  if (Shape == Shape_t::Square || Order == 0) {
+    return {Order, 1};
+  }
+
+  const uint64_t TileSize = uint64_t(1) << (2 * (Order - 1));
+  const uint64_t NumberTiles = (Size + TileSize - 1) / TileSize;
+  return NumberTiles < 4 ? Layout_t{Order - 1, NumberTiles}
+                         : Layout_t{Order, 1};
+}
+
+static_assert(LayoutFor(17, Shape_t::Square).Width() == 8);
+static_assert(LayoutFor(17, Shape_t::Packed).Width() == 8);
+static_assert(LayoutFor(17, Shape_t::Packed).Height() == 4);
+static_assert(LayoutFor(33, Shape_t::Packed).Width() == 12);
+static_assert(LayoutFor(64, Shape_t::Packed).Width() == 8);
+
+//
+// Get the layout of a picture out of its dimensions, as they are stored in
+// the headers of the formats.
+//
+
+constexpr std::optional<Layout_t> LayoutOf(const uint64_t Width,
+                                           const uint64_t Height) {
+  if (!std::has_single_bit(Height) || Width == 0 || (Width % Height) != 0) {
+    return std::nullopt;
+  }
+
+  return Layout_t{uint64_t(std::countr_zero(Height)), Width / Height};
+}
+
+//
+// Convert a distance to (x, y) coordinates on a layout.
+//
+
+constexpr Point_t D2xy(const uint64_t Distance, const Layout_t &Layout) {
+  const uint64_t TileShift = 2 * Layout.Order;
+  Point_t Point =
+      D2xy(Distance & ((uint64_t(1) << TileShift) - 1), Layout.Order);
+  Point.X += uint32_t((Distance >> TileShift) << Layout.Order);
+  return Point;
+}
+
+static_assert(D2xy(3, Layout_t{1, 2}).X == 1 && D2xy(3, Layout_t{1, 2}).Y == 0);
+static_assert(D2xy(4, Layout_t{1, 2}).X == 2 && D2xy(4, Layout_t{1, 2}).Y == 0);
+
+//
+// Convert (x, y) coordinates to a distance on a hilbert-curve of a given
+// order; this is the inverse of the state machine above, every step consumes
+// a bit of each coordinate and produces two bits of the distance.
+//
+
+constexpr uint64_t Xy2d(const Point_t &Point, const uint64_t Order) {
+  uint32_t State = 0;
+  uint64_t Distance = 0;
+  for (uint64_t Bit = Order; Bit > 0; Bit--) {
+    const uint32_t Row = (4 * State) | (((Point.X >> (Bit - 1)) & 1) << 1) |
+                         ((Point.Y >> (Bit - 1)) & 1);
+    Distance = (Distance << 2) | ((0x36'1e'9c'b4 >> (2 * Row)) & 3);
+    State = (0x8f'e6'58'31 >> (2 * Row)) & 3;
+  }
+
+  return Distance;
+}
+
+static_assert(Xy2d(D2xy(0x1234, 8), 8) == 0x1234);
+
+//
+// Convert (x, y) coordinates to a distance on a layout.
+//
+
+constexpr uint64_t Xy2d(const Point_t &Point, const Layout_t &Layout) {
+  const uint64_t Tile = Point.X >> Layout.Order;
+  const uint32_t Mask = uint32_t((uint64_t(1) << Layout.Order) - 1);
+  return (Tile << (2 * Layout.Order)) |
+         Xy2d(Point_t{Point.X & Mask, Point.Y}, Layout.Order);
+}
+
+static_assert(Xy2d(D2xy(0x123, Layout_t{4, 3}), Layout_t{4, 3}) == 0x123);
+
+namespace detail {
+
+//
+// The state machine above run for four steps at a time: the table is indexed
+// by the current state and a byte of the distance, and every entry holds a
+// nibble of X (bits 0-3), a nibble of Y (bits 4-7) and the next state (bits
+// 8-9).
+//
+
+constexpr std::array<uint32_t, 4 * 256> BuildLut() {
+  std::array<uint32_t, 4 * 256> Lut = {};
+  for (uint32_t FirstState = 0; FirstState < 4; FirstState++) {
+    for (uint32_t Byte = 0; Byte < 256; Byte++) {
+      uint32_t State = FirstState, X = 0, Y = 0;
+      for (int32_t Shift = 6; Shift >= 0; Shift -= 2) {
+        const uint32_t Row = (4 * State) | ((Byte >> Shift) & 3);
+        X = (X << 1) | ((0x93'6c >> Row) & 1);
+        Y = (Y << 1) | ((0x39'c6 >> Row) & 1);
+        State = (0x3e'6b'94'c1 >> (2 * Row)) & 3;
+      }
+
+      Lut[(FirstState * 256) + Byte] = X | (Y << 4) | (State << 8);
+    }
+  }
+
+  return Lut;
+}
+
+inline constexpr auto Lut = BuildLut();
+
+} // namespace detail
+
+//
+// Convert a batch of distances on a hilbert-curve of a given order to (x, y)
+// coordinates; this is a lot faster than calling the above for every one of
+// them. The distances are consumed a byte at a time using the lookup table,
+// so the order is rounded up to a multiple of four by prepending zero
+// steps. From the initial state, two zero steps bring the machine back to it
+// and a single one transposes the curve, so when an odd number of them is
+// prepended the coordinates only need to be swapped. With AVX2, four
+// distances are converted at once with gathers.
+//
+
+inline void D2xy(const std::span<const uint64_t> Distances,
+                 const std::span<uint32_t> Xs, const std::span<uint32_t> Ys,
+                 const uint64_t Order) {
+  const uint64_t NumberBytes = (Order + 3) / 4;
+  const bool Transposed = ((NumberBytes * 4) - Order) & 1;
+  const std::span TransposedXs = Transposed ? Ys : Xs;
+  const std::span TransposedYs = Transposed ? Xs : Ys;
+  const int64_t FirstShift = int64_t(NumberBytes * 8) - 8;
+
+  size_t Idx = 0;
+#if defined(__AVX2__)
+  const __m256i ByteMask = _mm256_set1_epi64x(0xff);
+  const __m256i NibbleMask = _mm256_set1_epi64x(0xf);
+  const __m256i LowDwords = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+  for (; (Idx + 4) <= Distances.size(); Idx += 4) {
+    const __m256i Distance =
+        _mm256_loadu_si256((const __m256i *)&Distances[Idx]);
+    __m256i State = _mm256_setzero_si256();
+    __m256i X = _mm256_setzero_si256();
+    __m256i Y = _mm256_setzero_si256();
+    for (int64_t Shift = FirstShift; Shift >= 0; Shift -= 8) {
+      const __m256i Byte = _mm256_and_si256(
+          _mm256_srl_epi64(Distance, _mm_cvtsi64_si128(Shift)), ByteMask);
+      const __m256i LutIdx =
+          _mm256_or_si256(_mm256_slli_epi64(State, 8), Byte);
+      const __m256i Entry = _mm256_cvtepu32_epi64(_mm256_i64gather_epi32(
+          (const int *)detail::Lut.data(), LutIdx, sizeof(uint32_t)));
+      X = _mm256_or_si256(_mm256_slli_epi64(X, 4),
+                          _mm256_and_si256(Entry, NibbleMask));
+      Y = _mm256_or_si256(
+          _mm256_slli_epi64(Y, 4),
+          _mm256_and_si256(_mm256_srli_epi64(Entry, 4), NibbleMask));
+      State = _mm256_srli_epi64(Entry, 8);
+    }
+
+    _mm_storeu_si128(
+        (__m128i *)&TransposedXs[Idx],
+        _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(X, LowDwords)));
+    _mm_storeu_si128(
+        (__m128i *)&TransposedYs[Idx],
+        _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(Y, LowDwords)));
+  }
+#endif
+
+  for (; Idx < Distances.size(); Idx++) {
+    const uint64_t Distance = Distances[Idx];
+    uint32_t State = 0, X = 0, Y = 0;
+    for (int64_t Shift = FirstShift; Shift >= 0; Shift -= 8) {
+      const uint32_t Entry =
+          detail::Lut[(State * 256) + ((Distance >> Shift) & 0xff)];
+      X = (X << 4) | (Entry & 0xf);
+      Y = (Y << 4) | ((Entry >> 4) & 0xf);
+      State = Entry >> 8;
+    }
+
+    TransposedXs[Idx] = X;
+    TransposedYs[Idx] = Y;
+  }
+}
+
+} // namespace hilbert
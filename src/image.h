@@ -0,0 +1,565 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "entropy.h"
+#include "fmt/format.h"
+#include "hilbert.h"
+#include "pagetables.h"
+#include "tape.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace clairvoyance {
+
+namespace fs = std::filesystem;
+
+//
+// The palette of color used for the visualization.
+//
+
+namespace color {
+constexpr uint32_t White = 0xff'ff'ff;
+constexpr uint32_t Black = 0x00'00'00;
+constexpr uint32_t Green = 0x00'ff'00;
+constexpr uint32_t PaleGreen = 0xa9'ff'52;
+constexpr uint32_t CanaryYellow = 0xff'ff'99;
+constexpr uint32_t Yellow = 0xff'ff'00;
+constexpr uint32_t Purple = 0xa0'20'f0;
+constexpr uint32_t Mauve = 0xe0'b0'ff;
+constexpr uint32_t Red = 0xfe'00'00;
+constexpr uint32_t LightRed = 0xff'7f'7f;
+constexpr uint32_t Gray = 0x80'80'80;
+constexpr uint32_t Navy = 0x00'00'80;
+constexpr uint32_t Azure = 0x00'7f'ff;
+
+//
+// The colors of the entropy buckets, from the lowest to the highest.
+//
+
+constexpr std::array<uint32_t, 8> Entropy = {
+    0x44'01'54, 0x46'32'7e, 0x36'5c'8d, 0x27'7f'8e,
+    0x1f'a1'87, 0x4a'c1'6d, 0xa0'da'39, 0xfd'e7'25,
+};
+}; // namespace color
+
+//
+// The color of every protection, indexed by its value; user pages get the
+// pale version of the color of their kernel counterpart. The entry after the
+// protections is for the mapped pages that don't have the attribute of an
+// overlay, followed by the contents of the pages; the last entry is the
+// background, for the pixels past the end of the tape.
+//
+
+constexpr std::array<uint32_t, 21> Palette = {
+    color::Black,        // None
+    color::PaleGreen,    // UserRead
+    color::CanaryYellow, // UserReadExec
+    color::Mauve,        // UserReadWrite
+    color::LightRed,     // UserReadWriteExec
+    color::Green,        // KernelRead
+    color::Yellow,       // KernelReadExec
+    color::Purple,       // KernelReadWrite
+    color::Red,          // KernelReadWriteExec
+    color::Gray,         // Unset / Missing
+    color::Navy,         // Zero
+    color::Azure,        // Uniform
+    color::Entropy[0],   // Entropy0
+    color::Entropy[1],   // Entropy1
+    color::Entropy[2],   // Entropy2
+    color::Entropy[3],   // Entropy3
+    color::Entropy[4],   // Entropy4
+    color::Entropy[5],   // Entropy5
+    color::Entropy[6],   // Entropy6
+    color::Entropy[7],   // Entropy7
+    color::White,        // Background
+};
+
+constexpr uint8_t UnsetIdx = 9;
+constexpr uint8_t ContentIdx = UnsetIdx;
+constexpr uint8_t BackgroundIdx = Palette.size() - 1;
+static_assert((ContentIdx + entropy::NumberContents) == BackgroundIdx);
+
+//
+// How permissive every palette entry is: the rights first, then user pages
+// above kernel ones. The mapped pages without the attribute of an overlay
+// are only above unmapped ones, and the background is the least permissive
+// of them all. The contents only ever get mixed with unmapped pages; the
+// higher the entropy the more they stand out.
+//
+
+constexpr std::array<uint8_t, Palette.size()> Permissiveness = {
+    1,  // None
+    4,  // UserRead
+    6,  // UserReadExec
+    8,  // UserReadWrite
+    10, // UserReadWriteExec
+    3,  // KernelRead
+    5,  // KernelReadExec
+    7,  // KernelReadWrite
+    9,  // KernelReadWriteExec
+    2,  // Unset / Missing
+    11, // Zero
+    12, // Uniform
+    13, // Entropy0
+    14, // Entropy1
+    15, // Entropy2
+    16, // Entropy3
+    17, // Entropy4
+    18, // Entropy5
+    19, // Entropy6
+    20, // Entropy7
+    0,  // Background
+};
+
+//
+// Get the most permissive of two palette entries.
+//
+
+constexpr uint8_t MostPermissive(const uint8_t A, const uint8_t B) {
+  return Permissiveness[A] >= Permissiveness[B] ? A : B;
+}
+
+//
+// The image formats supported.
+//
+
+enum class ImageFormat_t { Png, Ppm };
+
+//
+// What the pixels show: the protection of the pages, the protection of the
+// pages with one of the attributes and Unset for the others, or the content
+// of the pages.
+//
+
+enum class Overlay_t {
+  Protection,
+  Accessed,
+  Dirty,
+  CacheDisable,
+  WriteThrough,
+  Content
+};
+
+constexpr std::array<Overlay_t, 6> Overlays = {
+    Overlay_t::Protection,   Overlay_t::Accessed,     Overlay_t::Dirty,
+    Overlay_t::CacheDisable, Overlay_t::WriteThrough, Overlay_t::Content};
+
+//
+// Get the name of an overlay on the command line.
+//
+
+constexpr std::string_view OverlayName(const Overlay_t Overlay) {
+  switch (Overlay) {
+  case Overlay_t::Protection:
+    return "protection";
+  case Overlay_t::Accessed:
+    return "accessed";
+  case Overlay_t::Dirty:
+    return "dirty";
+  case Overlay_t::CacheDisable:
+    return "cache-disable";
+  case Overlay_t::WriteThrough:
+    return "write-through";
+  case Overlay_t::Content:
+    return "content";
+  }
+
+  return "unknown";
+}
+
+//
+// Get the attribute bit an overlay shows; the protection and the content
+// overlays show all the pages.
+//
+
+constexpr uint8_t OverlayAttribute(const Overlay_t Overlay) {
+  switch (Overlay) {
+  case Overlay_t::Accessed:
+    return ptables::attr::Accessed;
+  case Overlay_t::Dirty:
+    return ptables::attr::Dirty;
+  case Overlay_t::CacheDisable:
+    return ptables::attr::CacheDisable;
+  case Overlay_t::WriteThrough:
+    return ptables::attr::WriteThrough;
+  case Overlay_t::Protection:
+  case Overlay_t::Content:
+    break;
+  }
+
+  return 0;
+}
+
+//
+// Get the palette entry of a run with an overlay.
+//
+
+constexpr uint8_t PaletteIdx(const Tape_t::Run_t &Run,
+                             const Overlay_t Overlay) {
+  const uint8_t Protection = uint8_t(Run.Protection);
+  if (Protection == uint8_t(ptables::Protection_t::None)) {
+    return Protection;
+  }
+
+  if (Overlay == Overlay_t::Content) {
+    return ContentIdx +
+           uint8_t(entropy::FromAttributes(uint8_t(Run.Attributes)));
+  }
+
+  const uint8_t Attribute = OverlayAttribute(Overlay);
+  if (Attribute == 0 || (Run.Attributes & Attribute) != 0) {
+    return Protection;
+  }
+
+  return UnsetIdx;
+}
+
+namespace png {
+
+//
+// The CRC used by the chunks.
+//
+
+inline uint32_t Crc32(const uint8_t *Buffer, const size_t Size,
+                      uint32_t Crc = 0) {
+  static const auto Table = []() {
+    std::array<uint32_t, 256> Table;
+    for (uint32_t Idx = 0; Idx < Table.size(); Idx++) {
+      uint32_t Value = Idx;
+      for (uint32_t Bit = 0; Bit < 8; Bit++) {
+        Value = (Value & 1) ? (0xed'b8'83'20 ^ (Value >> 1)) : (Value >> 1);
+      }
+
+      Table[Idx] = Value;
+    }
+
+    return Table;
+  }();
+
+  Crc = ~Crc;
+  for (size_t Idx = 0; Idx < Size; Idx++) {
+    Crc = Table[(Crc ^ Buffer[Idx]) & 0xff] ^ (Crc >> 8);
+  }
+
+  return ~Crc;
+}
+
+//
+// Serialize a value in big-endian.
+//
+
+inline void AppendBe32(std::vector<uint8_t> &Buffer, const uint32_t Value) {
+  Buffer.push_back(uint8_t(Value >> 24));
+  Buffer.push_back(uint8_t(Value >> 16));
+  Buffer.push_back(uint8_t(Value >> 8));
+  Buffer.push_back(uint8_t(Value));
+}
+
+//
+// Write a chunk made of its type and its data.
+//
+
+inline bool WriteChunk(FILE *File, const char Type[4],
+                       const std::vector<uint8_t> &Data) {
+  std::vector<uint8_t> Chunk;
+  Chunk.reserve(Data.size() + 12);
+  AppendBe32(Chunk, uint32_t(Data.size()));
+  Chunk.insert(Chunk.end(), Type, Type + 4);
+  Chunk.insert(Chunk.end(), Data.begin(), Data.end());
+  AppendBe32(Chunk, Crc32(Chunk.data() + 4, Chunk.size() - 4));
+  return fwrite(Chunk.data(), Chunk.size(), 1, File) == 1;
+}
+
+//
+// Encode an image of palette indices as a PNG; Stride is the distance between
+// two rows of Pixels. The pixel data is stored in uncompressed deflate blocks
+// so that no compression library is required.
+//
+
+inline bool Write(FILE *File, const uint8_t *Pixels, const uint64_t Width,
+                  const uint64_t Height, const uint64_t Stride) {
+  constexpr uint8_t Signature[] = {0x89, 'P',  'N',  'G',
+                                   '\r', '\n', 0x1a, '\n'};
+  if (fwrite(Signature, sizeof(Signature), 1, File) != 1) {
+    return false;
+  }
+
+  //
+  // 8-bit palette indices.
+  //
+
+  std::vector<uint8_t> Header;
+  AppendBe32(Header, uint32_t(Width));
+  AppendBe32(Header, uint32_t(Height));
+  Header.insert(Header.end(), {8, 3, 0, 0, 0});
+
+  std::vector<uint8_t> Plte;
+  for (const uint32_t Color : Palette) {
+    Plte.insert(Plte.end(),
+                {uint8_t(Color >> 16), uint8_t(Color >> 8), uint8_t(Color)});
+  }
+
+  if (!WriteChunk(File, "IHDR", Header) ||
+      !WriteChunk(File, "PLTE", Plte)) {
+    return false;
+  }
+
+  //
+  // The zlib stream is made of the scanlines, each of them prefixed by the
+  // 'None' filter, cut into stored blocks of at most 64KB. It is spread
+  // across as many IDAT chunks as necessary.
+  //
+
+  constexpr size_t MaxBlockSize = 0xff'ff;
+  constexpr size_t MaxChunkSize = 1024 * 1024;
+  const uint64_t ScanlineSize = Width + 1;
+  const uint64_t RawSize = ScanlineSize * Height;
+
+  std::vector<uint8_t> Idat = {0x78, 0x01};
+  std::vector<uint8_t> Block;
+  uint32_t AdlerA = 1, AdlerB = 0;
+  uint64_t Written = 0;
+  while (Written < RawSize) {
+    Block.clear();
+    const uint64_t BlockSize =
+        std::min(uint64_t(MaxBlockSize), RawSize - Written);
+    for (uint64_t Idx = Written; Idx < (Written + BlockSize); Idx++) {
+      const uint64_t Y = Idx / ScanlineSize;
+      const uint64_t X = Idx % ScanlineSize;
+      const uint8_t Byte = X == 0 ? 0 : Pixels[(Y * Stride) + X - 1];
+      Block.push_back(Byte);
+      AdlerA = (AdlerA + Byte) % 65'521;
+      AdlerB = (AdlerB + AdlerA) % 65'521;
+    }
+
+    Written += BlockSize;
+    const bool Final = Written == RawSize;
+    const uint16_t Len = uint16_t(BlockSize);
+    const uint16_t NLen = ~Len;
+    Idat.insert(Idat.end(), {uint8_t(Final), uint8_t(Len), uint8_t(Len >> 8),
+                             uint8_t(NLen), uint8_t(NLen >> 8)});
+    Idat.insert(Idat.end(), Block.begin(), Block.end());
+    if (Final) {
+      AppendBe32(Idat, (AdlerB << 16) | AdlerA);
+    }
+
+    if (Idat.size() >= MaxChunkSize || Final) {
+      if (!WriteChunk(File, "IDAT", Idat)) {
+        return false;
+      }
+
+      Idat.clear();
+    }
+  }
+
+  return WriteChunk(File, "IEND", {});
+}
+
+} // namespace png
+
+//
+// An image is the tape laid out on hilbert-curves (see hilbert::Layout_t);
+// every pixel is an index in the palette.
+//
+
+class Image_t {
+  hilbert::Layout_t Layout_;
+  uint64_t Width_ = 0;
+  uint64_t Height_ = 0;
+  std::vector<uint8_t> Pixels_;
+
+  //
+  // Lay out the pixels [Begin, End) of the tape; RunIdx is the run that
+  // contains Begin and RunBegin is the distance at which it starts. The
+  // distances are converted to coordinates in batches.
+  //
+
+  void Draw(const std::span<const Tape_t::Run_t> Runs, uint64_t RunIdx,
+            uint64_t RunBegin, const uint64_t Begin, const uint64_t End,
+            const Overlay_t Overlay) {
+    constexpr uint64_t BatchSize = 4'096;
+    const uint64_t TileShift = 2 * Layout_.Order;
+    const uint64_t TileMask = (uint64_t(1) << TileShift) - 1;
+    std::array<uint64_t, BatchSize> Distances;
+    std::array<uint32_t, BatchSize> Xs, Ys;
+    std::array<uint8_t, BatchSize> Protections;
+    for (uint64_t Distance = Begin; Distance < End; Distance += BatchSize) {
+      const uint64_t Size = std::min(BatchSize, End - Distance);
+      for (uint64_t Idx = 0; Idx < Size; Idx++) {
+        while ((RunBegin + Runs[RunIdx].Length) <= (Distance + Idx)) {
+          RunBegin += Runs[RunIdx++].Length;
+        }
+
+        Distances[Idx] = (Distance + Idx) & TileMask;
+        Protections[Idx] = PaletteIdx(Runs[RunIdx], Overlay);
+      }
+
+      hilbert::D2xy(std::span(Distances).first(Size),
+                    std::span(Xs).first(Size), std::span(Ys).first(Size),
+                    Layout_.Order);
+
+      for (uint64_t Idx = 0; Idx < Size; Idx++) {
+        const uint64_t X =
+            Xs[Idx] + (((Distance + Idx) >> TileShift) << Layout_.Order);
+        Pixels_[(uint64_t(Ys[Idx]) * Width_) + X] = Protections[Idx];
+      }
+    }
+  }
+
+  //
+  // Encode the image as a binary PPM.
+  //
+
+  bool WritePpm(FILE *File) const {
+    if (fprintf(File, "P6\n%llu %llu\n255\n", (unsigned long long)Width_,
+                (unsigned long long)Height_) < 0) {
+      return false;
+    }
+
+    std::vector<uint8_t> Row(Width_ * 3);
+    for (uint64_t Y = 0; Y < Height_; Y++) {
+      for (uint64_t X = 0; X < Width_; X++) {
+        const uint32_t Color = Palette[Pixels_[(Y * Width_) + X]];
+        Row[(X * 3) + 0] = uint8_t(Color >> 16);
+        Row[(X * 3) + 1] = uint8_t(Color >> 8);
+        Row[(X * 3) + 2] = uint8_t(Color);
+      }
+
+      if (fwrite(Row.data(), Row.size(), 1, File) != 1) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  //
+  // Encode the image as a PNG with a palette.
+  //
+
+  bool WritePng(FILE *File) const {
+    return png::Write(File, Pixels_.data(), Width_, Height_, Width_);
+  }
+
+public:
+  //
+  // Lay out runs on hilbert-curves with an overlay. The runs are split in as
+  // many pieces as there are threads.
+  //
+
+  void Render(const std::span<const Tape_t::Run_t> Runs,
+              const hilbert::Layout_t &Layout,
+              const uint64_t NumberThreads = 1,
+              const Overlay_t Overlay = Overlay_t::Protection) {
+    Layout_ = Layout;
+    Width_ = Layout.Width();
+    Height_ = Layout.Height();
+    Pixels_.assign(Width_ * Height_, BackgroundIdx);
+
+    //
+    // Find the run every piece starts in.
+    //
+
+    uint64_t NumberPixels = 0;
+    for (const auto &Run : Runs) {
+      NumberPixels += Run.Length;
+    }
+
+    const uint64_t Size = std::min(NumberPixels, Width_ * Height_);
+    const uint64_t NumberPieces =
+        std::max(uint64_t(1), std::min(NumberThreads, Size));
+    const uint64_t PieceSize = (Size + NumberPieces - 1) / NumberPieces;
+
+    struct Piece_t {
+      uint64_t RunIdx = 0;
+      uint64_t RunBegin = 0;
+      uint64_t Begin = 0;
+      uint64_t End = 0;
+    };
+
+    std::vector<Piece_t> Pieces;
+    uint64_t RunIdx = 0, RunBegin = 0;
+    for (uint64_t Begin = 0; Begin < Size; Begin += PieceSize) {
+      while ((RunBegin + Runs[RunIdx].Length) <= Begin) {
+        RunBegin += Runs[RunIdx++].Length;
+      }
+
+      Pieces.push_back(
+          {RunIdx, RunBegin, Begin, std::min(Begin + PieceSize, Size)});
+    }
+
+    std::vector<std::thread> Threads;
+    for (uint64_t Idx = 1; Idx < Pieces.size(); Idx++) {
+      const auto &Piece = Pieces[Idx];
+      Threads.emplace_back([&, Piece]() {
+        Draw(Runs, Piece.RunIdx, Piece.RunBegin, Piece.Begin, Piece.End,
+             Overlay);
+      });
+    }
+
+    if (!Pieces.empty()) {
+      const auto &Piece = Pieces.front();
+      Draw(Runs, Piece.RunIdx, Piece.RunBegin, Piece.Begin, Piece.End,
+           Overlay);
+    }
+
+    for (auto &Thread : Threads) {
+      Thread.join();
+    }
+  }
+
+  //
+  // Get an image half the size of this one; every pixel is the most
+  // permissive of the 2x2 block it replaces.
+  //
+
+  Image_t Downsample() const {
+    Image_t Image;
+    Image.Layout_ = {Layout_.Order - 1, Layout_.NumberTiles};
+    Image.Width_ = Width_ / 2;
+    Image.Height_ = Height_ / 2;
+    Image.Pixels_.resize(Image.Width_ * Image.Height_);
+    for (uint64_t Y = 0; Y < Image.Height_; Y++) {
+      const uint8_t *Top = &Pixels_[(Y * 2) * Width_];
+      const uint8_t *Bottom = Top + Width_;
+      for (uint64_t X = 0; X < Image.Width_; X++) {
+        Image.Pixels_[(Y * Image.Width_) + X] = MostPermissive(
+            MostPermissive(Top[X * 2], Top[(X * 2) + 1]),
+            MostPermissive(Bottom[X * 2], Bottom[(X * 2) + 1]));
+      }
+    }
+
+    return Image;
+  }
+
+  uint64_t Order() const { return Layout_.Order; }
+  const hilbert::Layout_t &Layout() const { return Layout_; }
+  uint64_t Width() const { return Width_; }
+  uint64_t Height() const { return Height_; }
+  const std::vector<uint8_t> &Pixels() const { return Pixels_; }
+
+  //
+  // Write the image on the disk.
+  //
+
+  bool Write(const fs::path &Filename, const ImageFormat_t Format) const {
+    FILE *File = fopen(Filename.string().c_str(), "wb");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    const bool Success =
+        Format == ImageFormat_t::Png ? WritePng(File) : WritePpm(File);
+    return fclose(File) == 0 && Success;
+  }
+};
+
+
+} // namespace clairvoyance
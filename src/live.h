@@ -0,0 +1,112 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace clairvoyance::live {
+
+//
+// The memory of a running guest is read out of the address space of the
+// QEMU process running it, through /proc/<pid>/mem; the guest RAM is an
+// anonymous (or memfd) mapping of that process.
+//
+
+inline std::string MemoryPath(const uint64_t Pid) {
+  return fmt::format("/proc/{}/mem", Pid);
+}
+
+//
+// Parse a region of guest memory: <guest physical address>:<host virtual
+// address>:<size>.
+//
+
+inline std::optional<kdmpparser::MemoryRegion_t>
+ParseRegion(const std::string_view String) {
+  const std::string Region(String);
+  char *End = nullptr;
+  kdmpparser::MemoryRegion_t Parsed;
+  Parsed.PhysicalAddress = strtoull(Region.c_str(), &End, 0);
+  if (*End != ':') {
+    return std::nullopt;
+  }
+
+  Parsed.Offset = strtoull(End + 1, &End, 0);
+  if (*End != ':') {
+    return std::nullopt;
+  }
+
+  Parsed.Size = strtoull(End + 1, &End, 0);
+  if (*End != '\0' || Parsed.Size == 0) {
+    return std::nullopt;
+  }
+
+  return Parsed;
+}
+
+//
+// Find the guest RAM of a QEMU process: its largest writable anonymous or
+// memfd mapping, which is mapped at guest physical address 0. Guests with
+// more than 2GB of RAM have it split around the PCI hole (at 2GB or 3GB
+// depending on the machine type) and need their regions to be given
+// explicitly.
+//
+
+inline std::optional<kdmpparser::MemoryRegion_t>
+FindGuestMemory(const uint64_t Pid) {
+  const std::string MapsPath = fmt::format("/proc/{}/maps", Pid);
+  std::ifstream Maps(MapsPath);
+  if (!Maps) {
+    fmt::print("Could not open {}\n", MapsPath);
+    return std::nullopt;
+  }
+
+  kdmpparser::MemoryRegion_t Largest;
+  std::string Line;
+  while (std::getline(Maps, Line)) {
+
+    //
+    // A line looks like: <start>-<end> <perms> <offset> <dev> <inode> [path].
+    //
+
+    char *End = nullptr;
+    const uint64_t Start = strtoull(Line.c_str(), &End, 16);
+    const uint64_t Stop = strtoull(End + 1, &End, 16);
+    const std::string_view Rest(End);
+    if (Rest.size() < 5 || Rest.substr(1, 2) != "rw") {
+      continue;
+    }
+
+    const size_t PathStart = Rest.find('/');
+    const bool Anonymous = PathStart == std::string_view::npos &&
+                           Rest.find('[') == std::string_view::npos;
+    const bool Memfd = PathStart != std::string_view::npos &&
+                       Rest.substr(PathStart).starts_with("/memfd:");
+    if ((Anonymous || Memfd) && (Stop - Start) > Largest.Size) {
+      Largest = {0, Start, Stop - Start};
+    }
+  }
+
+  if (Largest.Size == 0) {
+    fmt::print("Could not find the guest memory in {}\n", MapsPath);
+    return std::nullopt;
+  }
+
+  constexpr uint64_t MaxContiguousSize = uint64_t(2) << 30;
+  if (Largest.Size > MaxContiguousSize) {
+    fmt::print("The guest memory at {:#x} is {}MB so it is split around the "
+               "PCI hole; pass its regions with --guest-region\n",
+               Largest.Offset, Largest.Size >> 20);
+    return std::nullopt;
+  }
+
+  return Largest;
+}
+
+} // namespace clairvoyance::live
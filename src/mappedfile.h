@@ -0,0 +1,153 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#if defined(LINUX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace clairvoyance {
+
+namespace fs = std::filesystem;
+
+//
+// A file of a size known up front that is mapped writable in memory, so that
+// it can be filled in place from several threads without going through any
+// buffer; the writeback is kicked off once when it is closed. A file can
+// also be appended to by mapping the bytes past its end. On the platforms
+// other than Linux, the content is kept in memory and written in one go
+// instead.
+//
+
+class MappedFile_t {
+  uint8_t *Data_ = nullptr;
+  uint64_t Size_ = 0;
+#if defined(LINUX)
+  int Fd_ = -1;
+
+  //
+  // The distance between the beginning of the mapping, which is aligned on
+  // a page, and the data.
+  //
+
+  uint64_t Delta_ = 0;
+#else
+  fs::path Filename_;
+  uint64_t Offset_ = 0;
+  std::vector<uint8_t> Buffer_;
+#endif
+
+public:
+  MappedFile_t() = default;
+  MappedFile_t(const MappedFile_t &) = delete;
+  MappedFile_t &operator=(const MappedFile_t &) = delete;
+
+  ~MappedFile_t() { Close(); }
+
+  //
+  // Create (or truncate) the file and grow it to Size bytes. If Offset isn't
+  // zero, the file is kept and grown to Offset + Size bytes instead, and the
+  // Size bytes at Offset are the ones that get mapped.
+  //
+
+  bool Open(const fs::path &Filename, const uint64_t Size,
+            const uint64_t Offset = 0) {
+#if defined(LINUX)
+    const int Flags = O_RDWR | O_CREAT | (Offset == 0 ? O_TRUNC : 0);
+    const int Fd = open(Filename.string().c_str(), Flags, 0644);
+    if (Fd < 0) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    if (ftruncate(Fd, off_t(Offset + Size)) != 0) {
+      fmt::print("Could not grow {} to {} bytes\n", Filename.string(),
+                 Offset + Size);
+      close(Fd);
+      return false;
+    }
+
+    const uint64_t Delta = Offset % uint64_t(sysconf(_SC_PAGESIZE));
+    if (Size > 0) {
+      void *Data = mmap(nullptr, Size + Delta, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, Fd, off_t(Offset - Delta));
+      if (Data == MAP_FAILED) {
+        fmt::print("Could not map {}\n", Filename.string());
+        close(Fd);
+        return false;
+      }
+
+      Data_ = (uint8_t *)Data + Delta;
+    }
+
+    Fd_ = Fd;
+    Delta_ = Delta;
+#else
+    Filename_ = Filename;
+    Offset_ = Offset;
+    Buffer_.resize(Size);
+    Data_ = Buffer_.data();
+#endif
+
+    Size_ = Size;
+    return true;
+  }
+
+  uint8_t *Data() const { return Data_; }
+  uint64_t Size() const { return Size_; }
+
+  //
+  // Unmap the file and close it; returns false if the content couldn't be
+  // written out.
+  //
+
+  bool Close() {
+#if defined(LINUX)
+    if (Fd_ < 0) {
+      return true;
+    }
+
+    bool Success = true;
+    if (Data_ != nullptr) {
+      uint8_t *Mapping = Data_ - Delta_;
+      Success = msync(Mapping, Size_ + Delta_, MS_ASYNC) == 0;
+      munmap(Mapping, Size_ + Delta_);
+    }
+
+    Success = close(Fd_) == 0 && Success;
+    Fd_ = -1;
+#else
+    if (Filename_.empty()) {
+      return true;
+    }
+
+    auto Mode = std::ios::binary | std::ios::out;
+    if (Offset_ > 0) {
+      Mode |= std::ios::in;
+    }
+
+    std::fstream File(Filename_, Mode);
+    File.seekp(std::streamoff(Offset_));
+    File.write((const char *)Buffer_.data(), std::streamsize(Buffer_.size()));
+    File.close();
+    const bool Success = !File.fail();
+    Filename_.clear();
+    Offset_ = 0;
+    Buffer_ = {};
+#endif
+
+    Data_ = nullptr;
+    Size_ = 0;
+    return Success;
+  }
+};
+
+} // namespace clairvoyance
@@ -0,0 +1,141 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(LINUX)
+#include <sched.h>
+#endif
+
+namespace clairvoyance::numa {
+
+namespace fs = std::filesystem;
+
+//
+// A NUMA node and the CPUs it is made of.
+//
+
+struct Node_t {
+  uint64_t Id = 0;
+  std::vector<uint32_t> Cpus;
+};
+
+//
+// Parse a list of CPUs like the ones of sysfs: "0-3,8,10-11".
+//
+
+inline bool ParseCpuList(const std::string &List,
+                         std::vector<uint32_t> &Cpus) {
+  const char *Cursor = List.c_str();
+  while (*Cursor != '\0' && *Cursor != '\n') {
+    char *End = nullptr;
+    const uint64_t First = strtoull(Cursor, &End, 10);
+    if (End == Cursor) {
+      return false;
+    }
+
+    uint64_t Last = First;
+    if (*End == '-') {
+      Cursor = End + 1;
+      Last = strtoull(Cursor, &End, 10);
+      if (End == Cursor || Last < First) {
+        return false;
+      }
+    }
+
+    for (uint64_t Cpu = First; Cpu <= Last; Cpu++) {
+      Cpus.emplace_back(uint32_t(Cpu));
+    }
+
+    Cursor = *End == ',' ? End + 1 : End;
+  }
+
+  return true;
+}
+
+//
+// Get the NUMA nodes of the machine that have CPUs. Without NUMA (or off
+// Linux), the machine is a single node with every CPU in it.
+//
+
+inline std::vector<Node_t> Nodes() {
+  std::vector<Node_t> Nodes;
+#if defined(LINUX)
+  const fs::path Root("/sys/devices/system/node");
+  std::error_code Ec;
+  for (const auto &Entry : fs::directory_iterator(Root, Ec)) {
+    const std::string Name = Entry.path().filename().string();
+    if (!Name.starts_with("node") || Name.size() == 4 ||
+        !std::all_of(Name.begin() + 4, Name.end(), ::isdigit)) {
+      continue;
+    }
+
+    std::ifstream File(Entry.path() / "cpulist");
+    std::string List;
+    Node_t Node;
+    Node.Id = strtoull(Name.c_str() + 4, nullptr, 10);
+    if (!std::getline(File, List) || !ParseCpuList(List, Node.Cpus) ||
+        Node.Cpus.empty()) {
+      continue;
+    }
+
+    Nodes.emplace_back(std::move(Node));
+  }
+
+  std::sort(Nodes.begin(), Nodes.end(), [](const Node_t &A, const Node_t &B) {
+    return A.Id < B.Id;
+  });
+#endif
+
+  if (Nodes.empty()) {
+    Node_t Node;
+    const uint32_t NumberCpus =
+        std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t Cpu = 0; Cpu < NumberCpus; Cpu++) {
+      Node.Cpus.emplace_back(Cpu);
+    }
+
+    Nodes.emplace_back(std::move(Node));
+  }
+
+  return Nodes;
+}
+
+//
+// Run the calling thread on the CPUs of a node. The threads it creates after
+// that inherit its affinity, and the memory they touch first (the pages of
+// the dump they read, the physmem index and the tapes they build) is
+// allocated on the node with the default memory policy, so the rendering of
+// a dump never goes across sockets.
+//
+
+inline bool Pin(const Node_t &Node) {
+#if defined(LINUX)
+  cpu_set_t Set;
+  CPU_ZERO(&Set);
+  for (const uint32_t Cpu : Node.Cpus) {
+    if (Cpu < CPU_SETSIZE) {
+      CPU_SET(Cpu, &Set);
+    }
+  }
+
+  if (sched_setaffinity(0, sizeof(Set), &Set) != 0) {
+    fmt::print("Could not pin a thread on node {}\n", Node.Id);
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+} // namespace clairvoyance::numa
@@ -1,8 +1,27 @@
 // Axel '0vercl0k' Souchet - December 11 2020
 #pragma once
+#include "fmt/format.h"
 #include "kdmp-parser.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
 namespace page {
 
@@ -60,6 +79,107 @@ union Pte_t {
 
 static_assert(sizeof(Pte_t) == 8);
 
+//
+// The bits of a PXE, as masks.
+//
+
+namespace pxe {
+constexpr uint64_t Present = uint64_t(1) << 0;
+constexpr uint64_t Write = uint64_t(1) << 1;
+constexpr uint64_t UserAccessible = uint64_t(1) << 2;
+constexpr uint64_t WriteThrough = uint64_t(1) << 3;
+constexpr uint64_t CacheDisable = uint64_t(1) << 4;
+constexpr uint64_t Accessed = uint64_t(1) << 5;
+constexpr uint64_t Dirty = uint64_t(1) << 6;
+constexpr uint64_t LargePage = uint64_t(1) << 7;
+constexpr uint64_t NoExecute = uint64_t(1) << 63;
+constexpr uint64_t Attributes = WriteThrough | CacheDisable | Accessed | Dirty;
+} // namespace pxe
+
+//
+// The attributes of a page other than its protection, packed in a byte; they
+// come from the leaf entry mapping it.
+//
+
+namespace attr {
+constexpr uint8_t Accessed = 1 << 0;
+constexpr uint8_t Dirty = 1 << 1;
+constexpr uint8_t CacheDisable = 1 << 2;
+constexpr uint8_t WriteThrough = 1 << 3;
+} // namespace attr
+
+constexpr uint8_t AttributesFromPxe(const uint64_t Pxe) {
+  return ((Pxe & pxe::Accessed) ? attr::Accessed : 0) |
+         ((Pxe & pxe::Dirty) ? attr::Dirty : 0) |
+         ((Pxe & pxe::CacheDisable) ? attr::CacheDisable : 0) |
+         ((Pxe & pxe::WriteThrough) ? attr::WriteThrough : 0);
+}
+
+//
+// Find the first entry in [Begin, End) of a table for which the bits selected
+// by Mask are not equal to Expected; End is returned if there is none. This is
+// the innermost loop of the walker; it compares eight entries at a time with
+// AVX-512 and four with AVX2.
+//
+
+inline uint64_t FindMismatch(const Pte_t *Table, uint64_t Begin,
+                             const uint64_t End, const uint64_t Mask,
+                             const uint64_t Expected) {
+  const auto Entries = (const uint64_t *)Table;
+#if defined(__AVX512F__)
+  const __m512i Mask512 = _mm512_set1_epi64(int64_t(Mask));
+  const __m512i Expected512 = _mm512_set1_epi64(int64_t(Expected));
+  for (; (Begin + 8) <= End; Begin += 8) {
+    const __m512i Values = _mm512_and_si512(
+        _mm512_loadu_si512((const void *)&Entries[Begin]), Mask512);
+    const __mmask8 Mismatches = _mm512_cmpneq_epi64_mask(Values, Expected512);
+    if (Mismatches != 0) {
+      return Begin + std::countr_zero(uint32_t(Mismatches));
+    }
+  }
+#elif defined(__AVX2__)
+  const __m256i Mask256 = _mm256_set1_epi64x(int64_t(Mask));
+  const __m256i Expected256 = _mm256_set1_epi64x(int64_t(Expected));
+  for (; (Begin + 4) <= End; Begin += 4) {
+    const __m256i Values = _mm256_and_si256(
+        _mm256_loadu_si256((const __m256i *)&Entries[Begin]), Mask256);
+    const uint32_t Matches = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(Values, Expected256)));
+    if (Matches != 0b1111) {
+      return Begin + std::countr_zero(~Matches);
+    }
+  }
+#endif
+
+  for (; Begin < End; Begin++) {
+    if ((Entries[Begin] & Mask) != Expected) {
+      break;
+    }
+  }
+
+  return Begin;
+}
+
+//
+// Find the index of the entry of a top-level table that points back to the
+// table itself (the self-reference through which Windows maps the page
+// tables in the address space) if any, starting at First.
+//
+
+inline std::optional<uint64_t> FindSelfReference(const Pte_t *Table,
+                                                 const uint64_t TableAddress,
+                                                 const uint64_t First = 0) {
+  const uint64_t Pfn = TableAddress / page::Size;
+  constexpr uint64_t NumberEntries = page::Size / sizeof(Pte_t);
+  for (uint64_t Idx = First; Idx < NumberEntries; Idx++) {
+    if (Table[Idx].u.Present && Table[Idx].u.PageFrameNumber == Pfn) {
+      return Idx;
+    }
+  }
+
+  return std::nullopt;
+}
+
 //
 // Structure to parse a virtual address.
 //
@@ -113,6 +233,27 @@ struct Va_t {
 
 static_assert(sizeof(Va_t) == 8);
 
+//
+// The bits of a virtual address below the index of a level in a hierarchy of
+// NumberLevels levels; level 0 is the top-level table (the PML4, or the PML5
+// with LA57).
+//
+
+constexpr uint64_t LevelShift(const uint64_t NumberLevels,
+                              const uint64_t Level) {
+  return 12 + (9 * (NumberLevels - 1 - Level));
+}
+
+//
+// Sign-extend a virtual address translated by a hierarchy of NumberLevels
+// levels; 48 bits are translated with four levels and 57 with five.
+//
+
+constexpr uint64_t CanonicalVa(const uint64_t NumberLevels, const uint64_t Va) {
+  const uint64_t UnusedBits = 64 - LevelShift(NumberLevels, 0) - 9;
+  return uint64_t(int64_t(Va << UnusedBits) >> UnusedBits);
+}
+
 //
 // Get an absolute address from a PFN (with a base).
 //
@@ -153,6 +294,26 @@ constexpr std::string_view ToString(const PageType_t &Type) {
   std::abort();
 }
 
+//
+// The number of bytes mapped by a page of a type.
+//
+
+constexpr uint64_t PageSize(const PageType_t Type) {
+  return Type == PageType_t::Huge    ? 512 * 512 * page::Size
+         : Type == PageType_t::Large ? 512 * page::Size
+                                     : page::Size;
+}
+
+//
+// Get the physical address of a page out of the PFN of its leaf entry; the
+// low bits of the PFN of a large or huge page aren't part of its address (the
+// first one is the PAT bit).
+//
+
+constexpr uint64_t PageAddress(const uint64_t Pfn, const PageType_t Type) {
+  return AddressFromPfn(Pfn) & ~(PageSize(Type) - 1);
+}
+
 //
 // Properties of a page.
 //
@@ -204,10 +365,346 @@ constexpr std::string_view ToString(const Protection_t &Prop) {
 }
 
 //
-// This walks a hierarchy of page tables using a dump parser.
+// Does a protection allow writing / executing / accessing from user-mode?
+//
+
+constexpr bool IsWritable(const Protection_t &Prop) {
+  return Prop == Protection_t::UserReadWrite ||
+         Prop == Protection_t::UserReadWriteExec ||
+         Prop == Protection_t::KernelReadWrite ||
+         Prop == Protection_t::KernelReadWriteExec;
+}
+
+constexpr bool IsExecutable(const Protection_t &Prop) {
+  return Prop == Protection_t::UserReadExec ||
+         Prop == Protection_t::UserReadWriteExec ||
+         Prop == Protection_t::KernelReadExec ||
+         Prop == Protection_t::KernelReadWriteExec;
+}
+
+constexpr bool IsUserAccessible(const Protection_t &Prop) {
+  return Prop == Protection_t::UserRead || Prop == Protection_t::UserReadExec ||
+         Prop == Protection_t::UserReadWrite ||
+         Prop == Protection_t::UserReadWriteExec;
+}
+
+//
+// Protection from the effective access bits.
+//
+
+constexpr Protection_t ToProtection(const bool UserAccessible, const bool Write,
+                                    const bool NoExecute) {
+  if (UserAccessible) {
+    if (Write) {
+      if (NoExecute) {
+        return Protection_t::UserReadWrite;
+      } else {
+        return Protection_t::UserReadWriteExec;
+      }
+    } else {
+      if (NoExecute) {
+        return Protection_t::UserRead;
+      } else {
+        return Protection_t::UserReadExec;
+      }
+    }
+  }
+
+  if (Write) {
+    if (NoExecute) {
+      return Protection_t::KernelReadWrite;
+    } else {
+      return Protection_t::KernelReadWriteExec;
+    }
+  } else {
+    if (NoExecute) {
+      return Protection_t::KernelRead;
+    } else {
+      return Protection_t::KernelReadExec;
+    }
+  }
+}
+
+//
+// The effective access bits of a path in the hierarchy, packed in three bits:
+// write, user accessible and executable. The executable bit is the inverse of
+// NX so that combining the bits of a PXE with the ones of its parents is a
+// single AND, and the protection they give is a load from a table indexed by
+// them.
+//
+
+struct Access_t {
+  static constexpr uint8_t WriteBit = 1 << 0;
+  static constexpr uint8_t UserAccessibleBit = 1 << 1;
+  static constexpr uint8_t ExecuteBit = 1 << 2;
+  static constexpr uint8_t NumberCombinations = 1 << 3;
+
+  uint8_t Bits = WriteBit | UserAccessibleBit | ExecuteBit;
+
+  //
+  // A PXE that doesn't restrict anything; this is the PML5E of the entries of
+  // a four-level hierarchy.
+  //
+
+  static constexpr uint64_t PermissivePxe =
+      pxe::Present | pxe::Write | pxe::UserAccessible;
+
+  //
+  // The access bits of a PXE; W and U/S are bits 1 and 2 of the entry, right
+  // next to each other.
+  //
+
+  static constexpr uint8_t BitsFromPxe(const uint64_t Pxe) {
+    static_assert(pxe::Write == (WriteBit << 1) &&
+                  pxe::UserAccessible == (UserAccessibleBit << 1));
+    return uint8_t(((Pxe >> 1) & (WriteBit | UserAccessibleBit)) |
+                   ((~Pxe >> 63) << 2));
+  }
+
+  constexpr Access_t Combine(const Pte_t &Pxe) const {
+    return {uint8_t(Bits & BitsFromPxe(Pxe.AsUINT64))};
+  }
+
+  constexpr bool Write() const { return Bits & WriteBit; }
+  constexpr bool UserAccessible() const { return Bits & UserAccessibleBit; }
+  constexpr bool NoExecute() const { return !(Bits & ExecuteBit); }
+
+  static constexpr std::array<Protection_t, NumberCombinations> Protections =
+      []() {
+        std::array<Protection_t, NumberCombinations> Protections = {};
+        for (uint8_t Bits = 0; Bits < NumberCombinations; Bits++) {
+          Protections[Bits] =
+              ToProtection(Bits & UserAccessibleBit, Bits & WriteBit,
+                           !(Bits & ExecuteBit));
+        }
+
+        return Protections;
+      }();
+
+  constexpr Protection_t Protection() const { return Protections[Bits]; }
+
+  bool operator==(const Access_t &) const = default;
+};
+
+//
+// Structure that the walker returns.
+//
+
+struct Entry_t {
+  Pte_t Pml5e = Access_t::PermissivePxe;
+  uint64_t Pml5eAddress = 0;
+  Pte_t Pml4e = 0;
+  uint64_t Pml4eAddress = 0;
+  Pte_t Pdpte = 0;
+  uint64_t PdpteAddress = 0;
+  Pte_t Pde = 0;
+  uint64_t PdeAddress = 0;
+  Pte_t Pte = 0;
+  uint64_t PteAddress = 0;
+  uint64_t Pa = 0;
+  uint64_t Va = 0;
+  PageType_t Type = PageType_t::Normal;
+  uint8_t Attributes = 0;
+
+  //
+  // Protections from PXEs.
+  //
+
+  constexpr Protection_t Protection() const {
+    Access_t Access = Access_t().Combine(Pml5e).Combine(Pml4e).Combine(Pdpte);
+    if (!Pdpte.u.LargePage) {
+      Access = Access.Combine(Pde);
+      if (!Pde.u.LargePage) {
+        Access = Access.Combine(Pte);
+      }
+    }
+
+    return Access.Protection();
+  }
+};
+
+//
+// The verbosity policies select at compile time what gets dumped while the
+// address space is walked: the quiet one doesn't dump anything and doesn't
+// keep track of the addresses of the PXEs, the verbose one dumps every
+// mapping along with the PXEs leading to it as well as the gaps.
+//
+
+struct QuietPolicy_t {
+  static constexpr bool DumpMappings = false;
+  static constexpr bool DumpGapMappings = false;
+};
+
+struct VerbosePolicy_t {
+  static constexpr bool DumpMappings = true;
+  static constexpr bool DumpGapMappings = true;
+};
+
+//
+// Structure that the walker returns when walking by ranges: NumberPages
+// contiguous 4KB pages starting at Va that share the same protection (and
+// the same attributes when the walker records them).
+//
+
+struct Range_t {
+  uint64_t Va = 0;
+  uint64_t NumberPages = 0;
+  Protection_t Protection = Protection_t::None;
+  uint8_t Attributes = 0;
+};
+
+//
+// What a walk went through: the tables it entered, the tables referenced by a
+// present PXE that are not in the dump (indexed like TableNames; a missing
+// PML4 is the one of a five-level hierarchy), the leaf entries it found by
+// page type and the tables it didn't enter because it had entered them too
+// many times already.
+//
+
+constexpr std::array<std::string_view, 4> TableNames = {"PML4", "PDPT", "PD",
+                                                         "PT"};
+
+struct WalkStats_t {
+  uint64_t NumberTables = 0;
+  std::array<uint64_t, TableNames.size()> NumberMissingTables = {};
+  std::array<uint64_t, 3> NumberEntries = {};
+  uint64_t NumberDuplicateTables = 0;
+  uint64_t NumberSelfReferences = 0;
+
+  uint64_t NumberEntriesOf(const PageType_t Type) const {
+    return NumberEntries[uint64_t(Type)];
+  }
+
+  WalkStats_t &operator+=(const WalkStats_t &Other) {
+    NumberTables += Other.NumberTables;
+    for (uint64_t Idx = 0; Idx < NumberMissingTables.size(); Idx++) {
+      NumberMissingTables[Idx] += Other.NumberMissingTables[Idx];
+    }
+
+    for (uint64_t Idx = 0; Idx < NumberEntries.size(); Idx++) {
+      NumberEntries[Idx] += Other.NumberEntries[Idx];
+    }
+
+    NumberDuplicateTables += Other.NumberDuplicateTables;
+    NumberSelfReferences += Other.NumberSelfReferences;
+    return *this;
+  }
+};
+
+//
+// Lets a walk be abandoned: Cancel can be called from any thread, and the
+// walk is abandoned as well once Timeout (if any) has passed since the
+// construction. The walkers poll it between slices and every PollInterval
+// entries.
+//
+
+class Cancellation_t {
+  using Clock_t = std::chrono::steady_clock;
+
+  mutable std::atomic<bool> Cancelled_ = false;
+  std::optional<Clock_t::time_point> Deadline_;
+
+public:
+  static constexpr uint64_t PollInterval = 0x1000;
+
+  Cancellation_t() = default;
+  explicit Cancellation_t(
+      const std::optional<std::chrono::duration<double>> &Timeout) {
+    if (Timeout) {
+      Deadline_ = Clock_t::now() +
+                  std::chrono::duration_cast<Clock_t::duration>(*Timeout);
+    }
+  }
+
+  void Cancel() { Cancelled_ = true; }
+
+  bool Cancelled() const {
+    if (Cancelled_.load(std::memory_order_relaxed)) {
+      return true;
+    }
+
+    if (Deadline_ && Clock_t::now() >= *Deadline_) {
+      Cancelled_ = true;
+    }
+
+    return Cancelled_;
+  }
+};
+
+//
+// How far a walk went: the number of top-level entries (PML4Es, or PML5Es)
+// it is done with, and the number of pages it emitted so far. The top-level
+// entries are walked in order, so the fraction of them done gives an ETA.
 //
 
-class PageTableWalker_t {
+struct WalkProgress_t {
+  static constexpr uint64_t NumberTopEntries = page::Size / sizeof(Pte_t);
+
+  uint64_t TopIdx = 0;
+  uint64_t NumberPages = 0;
+
+  double Fraction() const { return double(TopIdx) / NumberTopEntries; }
+};
+
+//
+// A batch of leaf entries laid out as a structure of arrays, that the walker
+// fills without building an Entry_t for every one of them; the batch is
+// allocated once and reused from one call to the next. The full chain of
+// PXEs leading to an entry is only available through Next().
+//
+
+struct EntryBatch_t {
+  static constexpr uint64_t DefaultCapacity = 1024;
+
+  std::vector<uint64_t> Vas;
+  std::vector<uint64_t> Pas;
+  std::vector<Protection_t> Protections;
+  std::vector<PageType_t> Types;
+  uint64_t Size = 0;
+
+  explicit EntryBatch_t(const uint64_t Capacity = DefaultCapacity)
+      : Vas(Capacity), Pas(Capacity), Protections(Capacity), Types(Capacity) {}
+
+  uint64_t Capacity() const { return Vas.size(); }
+};
+
+//
+// This walks a hierarchy of page tables using a dump parser. The walk can be
+// restricted to the entries between two virtual addresses (inclusive), which
+// is what allows splitting it up in several independent slices. The number of
+// levels is a template parameter: four for PML4 -> PDPT -> PD -> PT, and five
+// when LA57 puts a PML5 on top of the PML4s.
+//
+
+template <uint64_t NumberLevels_> class BasicPageTableWalker_t {
+  static_assert(NumberLevels_ == 4 || NumberLevels_ == 5);
+
+  //
+  // The levels of the hierarchy; Root is the top-level table and the last
+  // three are the ones that can map memory. NumberLevels also means that the
+  // walk is over.
+  //
+
+  static constexpr uint64_t NumberLevels = NumberLevels_;
+  static constexpr uint64_t Root = 0;
+  static constexpr uint64_t Pml4 = NumberLevels - 4;
+  static constexpr uint64_t Pdpt = NumberLevels - 3;
+  static constexpr uint64_t Pd = NumberLevels - 2;
+  static constexpr uint64_t Pt = NumberLevels - 1;
+
+  //
+  // Number of PXEs per page.
+  //
+
+  static constexpr uint64_t NumberEntries = (page::Size / sizeof(uint64_t));
+
+  //
+  // Number of 4KB pages mapped by an entry at every level.
+  //
+
+  static constexpr uint64_t PagesPerEntry(const uint64_t Level) {
+    return uint64_t(1) << (LevelShift(NumberLevels, Level) - 12);
+  }
 
   //
   // Dump parser.
@@ -222,191 +719,244 @@ class PageTableWalker_t {
   uint64_t DirectoryAddress_ = 0;
 
   //
-  // Current PML4/PDPT/PDE/PTE and their entries.
+  // The first and last virtual addresses of the walk.
   //
 
-  const Pte_t *Pml4_ = nullptr, *Pdpt_ = nullptr, *Pd_ = nullptr,
-              *Pt_ = nullptr;
-  const Pte_t *Pml4e_ = nullptr, *Pdpte_ = nullptr, *Pde_ = nullptr,
-              *Pte_ = nullptr;
+  Va_t First_;
+  Va_t Last_;
 
   //
-  // Structure that the walker returns.
+  // Current PML4/PDPT/PD/PT, the physical address of those, the index of the
+  // entry we are looking at as well as the index where to stop in each of
+  // them.
   //
 
-  struct Entry_t {
-    Pte_t Pml4e = 0;
-    uint64_t Pml4eAddress = 0;
-    Pte_t Pdpte = 0;
-    uint64_t PdpteAddress = 0;
-    Pte_t Pde = 0;
-    uint64_t PdeAddress = 0;
-    Pte_t Pte = 0;
-    uint64_t PteAddress = 0;
-    uint64_t Pa = 0;
-    uint64_t Va = 0;
-    PageType_t Type = PageType_t::Normal;
+  const Pte_t *Tables_[NumberLevels] = {};
+  uint64_t TableAddresses_[NumberLevels] = {};
+  uint64_t Indexes_[NumberLevels] = {};
+  uint64_t Limits_[NumberLevels] = {};
 
-    //
-    // Protections from PXEs.
-    //
+  //
+  // Are we on the path leading to the first / last virtual address?
+  //
 
-    constexpr Protection_t Protection() const {
-      //
-      // XXX: using enum Properties_t;
-      //
+  bool OnFirstPath_[NumberLevels] = {};
+  bool OnLastPath_[NumberLevels] = {};
 
-      auto And = [](const bool A, const bool B) { return A && B; };
-      auto Or = [](const bool A, const bool B) { return A || B; };
-
-#define CalculateBit(FieldName, Comp)                                          \
-  [&]() {                                                                      \
-    bool FieldName = Comp(Pml4e.u.FieldName, Pdpte.u.FieldName);               \
-    if (!Pdpte.u.LargePage) {                                                  \
-      FieldName = Comp(FieldName, Pde.u.FieldName);                            \
-    }                                                                          \
-    if (!Pde.u.LargePage) {                                                    \
-      FieldName = Comp(FieldName, Pte.u.FieldName);                            \
-    }                                                                          \
-    return FieldName;                                                          \
-  }();
-
-      const bool UserAccessible = CalculateBit(UserAccessible, And);
-      const bool Write = CalculateBit(Write, And);
-      const bool NoExecute = CalculateBit(NoExecute, Or);
-
-      if (UserAccessible) {
-        if (Write) {
-          if (NoExecute) {
-            return Protection_t::UserReadWrite;
-          } else {
-            return Protection_t::UserReadWriteExec;
-          }
-        } else {
-          if (NoExecute) {
-            return Protection_t::UserRead;
-          } else {
-            return Protection_t::UserReadExec;
-          }
-        }
-      }
+  //
+  // The access bits of the PXEs leading to the table at every level.
+  //
 
-      if (Write) {
-        if (NoExecute) {
-          return Protection_t::KernelReadWrite;
-        } else {
-          return Protection_t::KernelReadWriteExec;
-        }
-      } else {
-        if (NoExecute) {
-          return Protection_t::KernelRead;
-        } else {
-          return Protection_t::KernelReadExec;
-        }
-      }
+  Access_t Accesses_[NumberLevels] = {};
 
-      std::abort();
-    }
-  };
+  //
+  // The index up to which the tables referenced at every level have been
+  // prefetched, and how far ahead of the walk we prefetch.
+  //
+
+  uint64_t Prefetched_[NumberLevels] = {};
+  static constexpr uint64_t PrefetchDistance = 16;
 
   //
-  // Number of PXEs per page.
+  // The bits of the leaf entries that make up the attributes of the pages;
+  // none unless they are recorded.
   //
 
-  static constexpr uint64_t NumberEntries = (page::Size / sizeof(uint64_t));
+  uint64_t AttributeMask_ = 0;
 
   //
-  // Gets the index of an entry from the start of a directory.
+  // How many times a table can be entered at a given level, and how many
+  // times every table was; zero means that the tables are entered every time
+  // they are referenced.
   //
 
-  static constexpr uint64_t IndexFromPxe(const Pte_t *Directory,
-                                         const Pte_t *Entry) {
-    //
-    // The reason why we don't do:
-    //   uintptr_t(Entry) & 0xfff
-    // is because those are not allowed in a constant expression.
-    //
+  uint64_t MaxTableVisits_ = 0;
+  kdmpparser::FlatPageMap_t TableVisits_;
+
+  //
+  // The index of the self-reference entry of the top-level table if it is
+  // skipped; NumberEntries otherwise.
+  //
+
+  uint64_t SelfReferenceIdx_ = NumberEntries;
+
+  //
+  // The deepest level the walk descends to; the present entries at that
+  // level are all leaves.
+  //
+
+  uint64_t LeafLevel_ = Pt;
 
-    return uint64_t(Entry - Directory);
+  //
+  // The level we are currently at; NumberLevels means the walk is over.
+  //
+
+  uint64_t Level_ = NumberLevels;
+
+  //
+  // What the walk went through so far.
+  //
+
+  WalkStats_t Stats_;
+
+  //
+  // Gets the index of a VA in the table at a specific level.
+  //
+
+  static constexpr uint64_t IndexFromVa(const Va_t &Va, const uint64_t Level) {
+    return (Va.U64() >> LevelShift(NumberLevels, Level)) & (NumberEntries - 1);
   }
 
   //
-  // Gets the offsets between an entry and its directory.
+  // Gets the PXE at a specific level.
   //
 
-  static constexpr uint64_t OffsetFromPxe(const Pte_t *Directory,
-                                          const Pte_t *Entry) {
-    //
-    // The reason why we don't do:
-    //   uintptr_t(Entry) - uintptr_t(Directory)
-    // Or:
-    //   uintptr_t(Entry) & 0xfff
-    // is because those are not allowed in a constant expression.
-    //
+  const Pte_t &Pxe(const uint64_t Level) const {
+    return Tables_[Level][Indexes_[Level]];
+  }
 
-    return uint64_t(Entry - Directory) * sizeof(Pte_t);
+  //
+  // Gets the physical address of the PXE at a specific level.
+  //
+
+  uint64_t PxeAddress(const uint64_t Level) const {
+    return TableAddresses_[Level] + (Indexes_[Level] * sizeof(Pte_t));
   }
 
   //
-  // Gets the limit address of a directory.
+  // Enters a table at a specific level and compute the range of entries we
+  // need to visit in it.
   //
 
-  static constexpr const Pte_t *Limit(const Pte_t *Directory) {
-    return Directory + NumberEntries;
+  void Enter(const uint64_t Level, const Pte_t *Table,
+             const uint64_t TableAddress) {
+    OnFirstPath_[Level] =
+        Level == Root ||
+        (OnFirstPath_[Level - 1] &&
+         Indexes_[Level - 1] == IndexFromVa(First_, Level - 1));
+    OnLastPath_[Level] =
+        Level == Root || (OnLastPath_[Level - 1] &&
+                          Indexes_[Level - 1] == IndexFromVa(Last_, Level - 1));
+
+    Accesses_[Level] = Level == Root
+                           ? Access_t()
+                           : Accesses_[Level - 1].Combine(Pxe(Level - 1));
+    Tables_[Level] = Table;
+    TableAddresses_[Level] = TableAddress;
+    Prefetched_[Level] = 0;
+    Indexes_[Level] = OnFirstPath_[Level] ? IndexFromVa(First_, Level) : 0;
+    Limits_[Level] =
+        OnLastPath_[Level] ? IndexFromVa(Last_, Level) + 1 : NumberEntries;
+    Level_ = Level;
+    Stats_.NumberTables++;
   }
 
   //
-  // Creates an entry that we return to the user.
+  // Prefetches the tables referenced by the entries following the current one
+  // at a specific level; by the time the walk gets to them, they hopefully
+  // have been paged in.
   //
 
-  Entry_t MakeEntry() const {
+  void Prefetch(const uint64_t Level) {
+    const Pte_t *Table = Tables_[Level];
+    const uint64_t End =
+        std::min(Indexes_[Level] + 1 + PrefetchDistance, Limits_[Level]);
+    uint64_t &Idx = Prefetched_[Level];
+    for (Idx = std::max(Idx, Indexes_[Level] + 1); Idx < End; Idx++) {
+      const Pte_t &Entry = Table[Idx];
+      if (!Entry.u.Present || IsLeaf(Level, Entry)) {
+        continue;
+      }
+
+      DumpParser_.PrefetchPhysicalPage(
+          AddressFromPfn(Entry.u.PageFrameNumber));
+    }
+  }
+
+  //
+  // Creates an entry that we return to the user; the addresses of the PXEs
+  // are only filled when the mappings get dumped.
+  //
+
+  template <typename Verbosity_t>
+  Entry_t MakeEntry(const PageType_t Type) const {
+    constexpr bool Addresses = Verbosity_t::DumpMappings;
     Entry_t Entry;
-    const uint64_t Pml4eIdx = IndexFromPxe(Pml4_, Pml4e_);
-    Entry.Pml4e = *Pml4e_;
-    Entry.Pml4eAddress = DirectoryAddress_ + OffsetFromPxe(Pml4_, Pml4e_);
-
-    const uint64_t PdpteIdx = IndexFromPxe(Pdpt_, Pdpte_);
-    Entry.Pdpte = *Pdpte_;
-    Entry.PdpteAddress = AddressFromPfn(Pml4e_->u.PageFrameNumber) +
-                         OffsetFromPxe(Pdpt_, Pdpte_);
-
-    if (Pdpte_->u.LargePage) {
-      Entry.Pa = AddressFromPfn(Pdpte_->u.PageFrameNumber);
-      Entry.Va = Va_t(Pml4eIdx, PdpteIdx).U64();
-      Entry.Type = PageType_t::Huge;
-      return Entry;
+    if constexpr (NumberLevels == 5) {
+      Entry.Pml5e = Pxe(Root);
+      if constexpr (Addresses) {
+        Entry.Pml5eAddress = PxeAddress(Root);
+      }
     }
 
-    const uint64_t PdeIdx = IndexFromPxe(Pd_, Pde_);
-    Entry.Pde = *Pde_;
-    Entry.PdeAddress =
-        AddressFromPfn(Pdpte_->u.PageFrameNumber) + OffsetFromPxe(Pd_, Pde_);
+    Entry.Pml4e = Pxe(Pml4);
+    Entry.Pdpte = Pxe(Pdpt);
+    Entry.Type = Type;
+    Entry.Va = CurrentVa();
+    Entry.Attributes =
+        AttributesFromPxe(Pxe(Level_).AsUINT64 & AttributeMask_);
+    if constexpr (Addresses) {
+      Entry.Pml4eAddress = PxeAddress(Pml4);
+      Entry.PdpteAddress = PxeAddress(Pdpt);
+    }
 
-    if (Pde_->u.LargePage) {
-      Entry.Pa = AddressFromPfn(Pde_->u.PageFrameNumber);
-      Entry.Va = Va_t(Pml4eIdx, PdpteIdx, PdeIdx).U64();
-      Entry.Type = PageType_t::Large;
+    if (Type == PageType_t::Huge) {
+      Entry.Pa = PageAddress(Entry.Pdpte.u.PageFrameNumber, Type);
       return Entry;
     }
 
-    const uint64_t PteIdx = IndexFromPxe(Pt_, Pte_);
-    Entry.Pte = *Pte_;
-    Entry.PteAddress =
-        AddressFromPfn(Pde_->u.PageFrameNumber) + OffsetFromPxe(Pt_, Pte_);
+    Entry.Pde = Pxe(Pd);
+    if constexpr (Addresses) {
+      Entry.PdeAddress = PxeAddress(Pd);
+    }
 
-    Entry.Pa = AddressFromPfn(Pte_->u.PageFrameNumber);
-    Entry.Va = Va_t(Pml4eIdx, PdpteIdx, PdeIdx, PteIdx).U64();
-    Entry.Type = PageType_t::Normal;
+    if (Type == PageType_t::Large) {
+      Entry.Pa = PageAddress(Entry.Pde.u.PageFrameNumber, Type);
+      return Entry;
+    }
+
+    Entry.Pte = Pxe(Pt);
+    if constexpr (Addresses) {
+      Entry.PteAddress = PxeAddress(Pt);
+    }
+    Entry.Pa = AddressFromPfn(Entry.Pte.u.PageFrameNumber);
     return Entry;
   }
 
+  //
+  // Count a visit of a table at a level; returns false if the table has been
+  // entered too many times at this level already. The tables are keyed by
+  // PFN and level, so that the tables that are reached through the
+  // self-reference entry at every level are still entered once per level.
+  //
+
+  bool VisitTable(const uint64_t Level, const uint64_t TableAddress) {
+    const uint64_t Key = ((TableAddress / page::Size) << 3) | Level;
+    if (MaxTableVisits_ == 0 || Key > kdmpparser::FlatPageMap_t::MaxKey) {
+      return true;
+    }
+
+    const uint64_t Visits = TableVisits_.Find(Key).value_or(0);
+    if (Visits >= MaxTableVisits_) {
+      return false;
+    }
+
+    TableVisits_.Insert(Key, Visits + 1);
+    return true;
+  }
+
   //
   // Reset the walker.
   //
 
   void Reset() {
-    Pml4_ = (Pte_t *)DumpParser_.GetPhysicalPage(DirectoryAddress_);
-    Pml4e_ = Pml4_;
+    const auto Table = (Pte_t *)DumpParser_.GetPhysicalPage(DirectoryAddress_);
+    if (Table == nullptr) {
+      Level_ = NumberLevels;
+      return;
+    }
+
+    Enter(Root, Table, DirectoryAddress_);
   }
 
 public:
@@ -414,130 +964,758 @@ public:
   // Ctor.
   //
 
-  explicit PageTableWalker_t(const kdmpparser::KernelDumpParser &DumpParser,
-                             const uint64_t DirectoryAddress)
-      : DumpParser_(DumpParser), DirectoryAddress_(DirectoryAddress) {
+  explicit BasicPageTableWalker_t(
+      const kdmpparser::KernelDumpParser &DumpParser,
+      const uint64_t DirectoryAddress, const Va_t First = Va_t(0, 0, 0, 0),
+      const Va_t Last = Va_t(511, 511, 511, 511))
+      : DumpParser_(DumpParser), DirectoryAddress_(DirectoryAddress),
+        First_(First), Last_(Last) {
     Reset();
   }
 
   //
-  // Gets the next entry.
+  // Release the tables of the walk in progress, if any.
   //
 
-  std::optional<Entry_t> Next() {
+  ~BasicPageTableWalker_t() {
+    for (uint64_t Level = 0; Level_ != NumberLevels && Level <= Level_;
+         Level++) {
+      DumpParser_.ReleasePhysicalPage(TableAddresses_[Level]);
+    }
+  }
 
-    //
-    // First level.
-    //
+  BasicPageTableWalker_t(const BasicPageTableWalker_t &) = delete;
+  BasicPageTableWalker_t &operator=(const BasicPageTableWalker_t &) = delete;
+
+  //
+  // Record the attributes of the pages in the entries and the ranges; the
+  // ranges are split where the attributes change, so there are more of them.
+  //
+
+  void RecordAttributes() { AttributeMask_ = pxe::Attributes; }
+
+  //
+  // Enter every table at most MaxVisits times at every level (zero means no
+  // limit); the references past that are skipped. This bounds the walks of
+  // corrupt page tables referencing the same tables over and over by the
+  // number of unique tables. It has to be set before the walk starts.
+  //
+
+  void LimitTableVisits(const uint64_t MaxVisits) {
+    MaxTableVisits_ =
+        std::min(MaxVisits, uint64_t(kdmpparser::FlatPageMap_t::MaxValue));
+    if (Level_ == Root) {
+      VisitTable(Root, DirectoryAddress_);
+    }
+  }
+
+  //
+  // Don't descend into the self-reference entry of the top-level table: the
+  // window it maps is made of the tables of the hierarchy, which get walked
+  // again as if they were mapping memory. It has to be set before the walk
+  // starts.
+  //
 
-    for (; Pml4e_ < Limit(Pml4_); Pml4e_++) {
-      if (!Pml4e_->u.Present) {
+  void SkipSelfReference() {
+    if (Level_ != Root) {
+      return;
+    }
+
+    SelfReferenceIdx_ =
+        FindSelfReference(Tables_[Root], DirectoryAddress_).value_or(
+            NumberEntries);
+  }
+
+  //
+  // Don't descend past the tables mapping pages of a type: the entries
+  // pointing to the tables below are returned as pages of that type, with
+  // the protection of the entries leading to them. This gives a coarse
+  // picture of an address space without reading its PTs (or its PDs).
+  //
+
+  void StopAt(const PageType_t Type) {
+    LeafLevel_ = Type == PageType_t::Huge    ? Pdpt
+                 : Type == PageType_t::Large ? Pd
+                                             : Pt;
+  }
+
+private:
+  //
+  // Moves to the next leaf entry; returns false when the walk is over.
+  //
+
+  bool Advance() {
+    while (Level_ != NumberLevels) {
+
+      //
+      // If we are done with the current table, go back up one level.
+      //
+
+      if (Indexes_[Level_] >= Limits_[Level_]) {
+        DumpParser_.ReleasePhysicalPage(TableAddresses_[Level_]);
+        if (Level_ == Root) {
+          Level_ = NumberLevels;
+          break;
+        }
+
+        Level_--;
+        Indexes_[Level_]++;
         continue;
       }
 
-      const uint64_t PdptAddress = AddressFromPfn(Pml4e_->u.PageFrameNumber);
-      const auto OldPdpt = Pdpt_;
-      Pdpt_ = (Pte_t *)DumpParser_.GetPhysicalPage(PdptAddress);
-
-      if (Pdpt_ == nullptr) {
-        fmt::print("PDPT:{:#x} not available in the dump, bailing\n",
-                   PdptAddress);
+      const Pte_t &Entry = Pxe(Level_);
+      if (!Entry.u.Present) {
+        Indexes_[Level_] = FindMismatch(Tables_[Level_], Indexes_[Level_] + 1,
+                                        Limits_[Level_], pxe::Present, 0);
         continue;
       }
 
-      if (OldPdpt != Pdpt_) {
-        Pdpte_ = Pdpt_;
+      //
+      // Huge page (1GB), large page (2MB) or a normal page.
+      //
+
+      if (IsLeaf(Level_, Entry)) {
+        Stats_.NumberEntries[uint64_t(TypeFromLevel(Level_))]++;
+        return true;
       }
 
       //
-      // Second level.
+      // Otherwise, this is a directory so let's descend into it, unless it is
+      // the self-reference.
       //
 
-      for (; Pdpte_ < Limit(Pdpt_); Pdpte_++) {
-        if (!Pdpte_->u.Present) {
-          continue;
+      if (Level_ == Root && Indexes_[Root] == SelfReferenceIdx_) {
+        Stats_.NumberSelfReferences++;
+        Indexes_[Level_]++;
+        continue;
+      }
+
+      const uint64_t TableAddress = AddressFromPfn(Entry.u.PageFrameNumber);
+      if (!VisitTable(Level_ + 1, TableAddress)) {
+        Stats_.NumberDuplicateTables++;
+        Indexes_[Level_]++;
+        continue;
+      }
+
+      const auto Table = (Pte_t *)DumpParser_.GetPhysicalPage(TableAddress);
+      if (Table == nullptr) {
+        const uint64_t NameIdx = Level_ + 5 - NumberLevels;
+        fmt::print("{}:{:#x} not available in the dump, {}\n",
+                   TableNames[NameIdx], TableAddress,
+                   Level_ == Pd ? "skipping" : "bailing");
+        Stats_.NumberMissingTables[NameIdx]++;
+        Indexes_[Level_]++;
+        continue;
+      }
+
+      Prefetch(Level_);
+      Enter(Level_ + 1, Table, TableAddress);
+    }
+
+    return false;
+  }
+
+  //
+  // Is this present entry mapping memory (as opposed to pointing to a table)?
+  //
+
+  bool IsLeaf(const uint64_t Level, const Pte_t &Entry) const {
+    return Level == LeafLevel_ ||
+           ((Level == Pdpt || Level == Pd) && Entry.u.LargePage);
+  }
+
+  //
+  // Gets the type of the page mapped by a leaf entry at a specific level.
+  //
+
+  static constexpr PageType_t TypeFromLevel(const uint64_t Level) {
+    return Level == Pdpt ? PageType_t::Huge
+           : Level == Pd ? PageType_t::Large
+                         : PageType_t::Normal;
+  }
+
+  //
+  // Gets the virtual address of the current entry.
+  //
+
+  uint64_t CurrentVa() const {
+    uint64_t Va = 0;
+    for (uint64_t Level = Root; Level <= Level_; Level++) {
+      Va |= Indexes_[Level] << LevelShift(NumberLevels, Level);
+    }
+
+    return CanonicalVa(NumberLevels, Va);
+  }
+
+public:
+  //
+  // Gets the next entry; the verbosity policy decides whether the addresses of
+  // the PXEs are filled.
+  //
+
+  template <typename Verbosity_t = VerbosePolicy_t>
+  std::optional<Entry_t> Next() {
+    if (!Advance()) {
+      return std::nullopt;
+    }
+
+    const auto &Result = MakeEntry<Verbosity_t>(TypeFromLevel(Level_));
+    Indexes_[Level_]++;
+    return Result;
+  }
+
+  //
+  // Fills a batch with the next entries; returns the number of entries in the
+  // batch, zero when the walk is over. The protection of an entry is computed
+  // out of the access bits of its parents that the walker already tracks.
+  //
+
+  uint64_t NextBatch(EntryBatch_t &Batch) {
+    Batch.Size = 0;
+    while (Batch.Size < Batch.Capacity() && Advance()) {
+      const Pte_t &Entry = Pxe(Level_);
+      const Access_t Access = Accesses_[Level_].Combine(Entry);
+      const uint64_t Idx = Batch.Size++;
+      const PageType_t Type = TypeFromLevel(Level_);
+      Batch.Vas[Idx] = CurrentVa();
+      Batch.Pas[Idx] = PageAddress(Entry.u.PageFrameNumber, Type);
+      Batch.Protections[Idx] = Access.Protection();
+      Batch.Types[Idx] = Type;
+      Indexes_[Level_]++;
+    }
+
+    return Batch.Size;
+  }
+
+  //
+  // Gets the next range of pages sharing the same protection. The following
+  // entries in the current table are folded in the range as long as they map
+  // memory with the same protection, so a uniform page table is returned in
+  // a single range instead of 512 entries.
+  //
+
+  std::optional<Range_t> NextRange() {
+    if (!Advance()) {
+      return std::nullopt;
+    }
+
+    const Access_t &Parent = Accesses_[Level_];
+    const Pte_t &First = Pxe(Level_);
+    const Access_t Access = Parent.Combine(First);
+
+    Range_t Range;
+    Range.Va = CurrentVa();
+    Range.Protection = Access.Protection();
+    Range.Attributes = AttributesFromPxe(First.AsUINT64 & AttributeMask_);
+
+    //
+    // The following entries have the same protection if they are present
+    // leaves and if the access bits that the parents don't already decide
+    // are the same.
+    //
+
+    const uint64_t Mask = pxe::Present |
+                          (Level_ == LeafLevel_ ? 0 : pxe::LargePage) |
+                          (Parent.UserAccessible() ? pxe::UserAccessible : 0) |
+                          (Parent.Write() ? pxe::Write : 0) |
+                          (Parent.NoExecute() ? 0 : pxe::NoExecute) |
+                          AttributeMask_;
+
+    uint64_t &Idx = Indexes_[Level_];
+    const uint64_t Begin = Idx;
+    Idx = FindMismatch(Tables_[Level_], Idx + 1, Limits_[Level_], Mask,
+                       First.AsUINT64 & Mask);
+
+    Range.NumberPages = (Idx - Begin) * PagesPerEntry(Level_);
+    Stats_.NumberEntries[uint64_t(TypeFromLevel(Level_))] += Idx - Begin - 1;
+    return Range;
+  }
+
+  //
+  // Get what the walk went through so far.
+  //
+
+  const WalkStats_t &Stats() const { return Stats_; }
+};
+
+//
+// The walker of the usual four-level hierarchies, and the one of the
+// five-level hierarchies of LA57.
+//
+
+using PageTableWalker_t = BasicPageTableWalker_t<4>;
+using La57PageTableWalker_t = BasicPageTableWalker_t<5>;
+
+//
+// A slice of the address space; it covers the entries [First, Last] of a
+// table at Level, a PDPT or a PD. Pxe is the entry pointing to that table and
+// Access holds the access bits of the PXEs above it, if any.
+//
+
+struct Slice_t {
+  Va_t First;
+  Va_t Last;
+  Pte_t Pxe;
+  Access_t Access;
+  uint64_t Level = 0;
+};
+
+//
+// Cache of the partial results computed for slices of the kernel half of the
+// address space. Every process shares the same kernel PML4Es, so when several
+// directory bases are walked out of the same dump the kernel subtrees are
+// only walked once. A slice is identified by the range of addresses it covers
+// and by the PXEs leading to it (the physical address of the PDPT as well as
+// the bits that get combined in the protections).
+//
+
+template <typename Partial_t> class SubtreeCache_t {
+  using Key_t = std::array<uint64_t, 4>;
+  using Value_t = std::shared_future<std::shared_ptr<const Partial_t>>;
+
+  std::mutex Lock_;
+  std::map<Key_t, Value_t> Entries_;
+  std::atomic<uint64_t> Hits_ = 0;
+  std::atomic<uint64_t> Misses_ = 0;
+
+public:
+  //
+  // Is this slice worth caching?
+  //
+
+  static bool Cacheable(const Slice_t &Slice) {
+    return int64_t(Slice.First.U64()) < 0;
+  }
+
+  //
+  // Get the partial result of a slice, or compute it if nobody did it
+  // already. If another thread is busy computing it, we wait for it. Compute
+  // returns std::nullopt if its walk got abandoned; nothing is cached then,
+  // nullptr is returned and whoever was waiting computes it again.
+  //
+
+  template <typename Compute_t>
+  std::shared_ptr<const Partial_t> GetOrCompute(const Slice_t &Slice,
+                                                Compute_t &&Compute) {
+    const Key_t Key = {Slice.First.U64(), Slice.Last.U64(), Slice.Pxe.AsUINT64,
+                       Slice.Access.Bits};
+
+    while (true) {
+      std::promise<std::shared_ptr<const Partial_t>> Promise;
+      std::optional<Value_t> Existing;
+      {
+        std::scoped_lock Lock(Lock_);
+        const auto &It = Entries_.find(Key);
+        if (It != Entries_.end()) {
+          Existing = It->second;
+        } else {
+          Entries_.emplace(Key, Promise.get_future().share());
         }
+      }
 
-        if (Pdpte_->u.LargePage) {
+      if (Existing) {
+        if (auto Result = Existing->get()) {
+          Hits_++;
+          return Result;
+        }
 
-          //
-          // Huge page (1GB).
-          //
+        continue;
+      }
 
-          Pd_ = Pde_ = Pt_ = Pte_ = nullptr;
-          const auto &Entry = MakeEntry();
-          Pdpte_++;
-          return Entry;
+      Misses_++;
+      std::optional<Partial_t> Computed = Compute();
+      if (!Computed) {
+        {
+          std::scoped_lock Lock(Lock_);
+          Entries_.erase(Key);
         }
 
-        const uint64_t PdAddress = AddressFromPfn(Pdpte_->u.PageFrameNumber);
-        const auto OldPd = Pd_;
-        Pd_ = (Pte_t *)DumpParser_.GetPhysicalPage(PdAddress);
+        Promise.set_value(nullptr);
+        return nullptr;
+      }
+
+      auto Result = std::make_shared<const Partial_t>(std::move(*Computed));
+      Promise.set_value(Result);
+      return Result;
+    }
+  }
+
+  uint64_t Hits() const { return Hits_; }
+  uint64_t Misses() const { return Misses_; }
+};
+
+//
+// Get the number of PTs a PDPTE leads to, which is what walking it costs;
+// its PD is read to count them.
+//
+
+inline uint64_t NumberPts(const kdmpparser::KernelDumpParser &DumpParser,
+                          const Pte_t &Pdpte) {
+  if (!Pdpte.u.Present || Pdpte.u.LargePage) {
+    return 0;
+  }
 
-        if (Pd_ == nullptr) {
-          fmt::print("PD:{:#x} not available in the dump, bailing\n",
-                     PdAddress);
-          continue;
+  const uint64_t PdAddress = AddressFromPfn(Pdpte.u.PageFrameNumber);
+  const auto Pd = (Pte_t *)DumpParser.GetPhysicalPage(PdAddress);
+  if (Pd == nullptr) {
+    return 0;
+  }
+
+  uint64_t NumberPts = 0;
+  for (uint64_t Idx = 0; Idx < (page::Size / sizeof(Pte_t)); Idx++) {
+    NumberPts += Pd[Idx].u.Present && !Pd[Idx].u.LargePage;
+  }
+
+  DumpParser.ReleasePhysicalPage(PdAddress);
+  return NumberPts;
+}
+
+//
+// Split the part of the address space covered by Table, a table at Level of a
+// hierarchy of NumberLevels levels mapping Va onwards, in slices. The tables
+// above the PDPTs are walked down to every PDPT, which gets split in slices
+// of consecutive PDPTEs going through a bounded number of PTs. The PDs that
+// have more PTs than that on their own are split further at the PDE level,
+// so that the dense parts of the kernel are shared by the threads instead of
+// being walked by a single one of them. The slices only depend on the page
+// tables, not on the number of threads.
+//
+
+template <uint64_t NumberLevels>
+void ComputeSlices(const kdmpparser::KernelDumpParser &DumpParser,
+                   const Pte_t *Table, const uint64_t Level, const uint64_t Va,
+                   const Access_t &Access, std::vector<Slice_t> &Slices) {
+
+  //
+  // A slice goes through at most PtsPerSlice PTs and PresentPerSlice present
+  // PDPTEs; the PDs with more PTs than that are walked PdesPerSlice PDEs at a
+  // time.
+  //
+
+  constexpr uint64_t PtsPerSlice = 64;
+  constexpr uint64_t PresentPerSlice = 32;
+  constexpr uint64_t PdesPerSlice = 64;
+  constexpr uint64_t NumberEntries = page::Size / sizeof(Pte_t);
+  constexpr uint64_t Pml4 = NumberLevels - 4;
+  constexpr uint64_t Pdpt = NumberLevels - 3;
+  constexpr uint64_t Pd = NumberLevels - 2;
+  for (uint64_t Idx = 0; Idx < NumberEntries; Idx++) {
+    const Pte_t &Entry = Table[Idx];
+    if (!Entry.u.Present) {
+      continue;
+    }
+
+    const uint64_t EntryVa = Va | (Idx << LevelShift(NumberLevels, Level));
+    const uint64_t ChildAddress = AddressFromPfn(Entry.u.PageFrameNumber);
+    const auto Child = (Pte_t *)DumpParser.GetPhysicalPage(ChildAddress);
+    if (Level != Pml4) {
+      if (Child != nullptr) {
+        ComputeSlices<NumberLevels>(DumpParser, Child, Level + 1, EntryVa,
+                                    Access.Combine(Entry), Slices);
+        DumpParser.ReleasePhysicalPage(ChildAddress);
+      }
+
+      continue;
+    }
+
+    const uint64_t PdpteShift = LevelShift(NumberLevels, Pdpt);
+    const uint64_t PdeShift = LevelShift(NumberLevels, Pd);
+    const auto Push = [&](const uint64_t First, const uint64_t Last,
+                          const Pte_t &Pxe, const Access_t &PxeAccess,
+                          const uint64_t SliceLevel) {
+      Slices.push_back({Va_t(CanonicalVa(NumberLevels, First)),
+                        Va_t(CanonicalVa(NumberLevels, Last)), Pxe, PxeAccess,
+                        SliceLevel});
+    };
+
+    //
+    // Push the slice of the PDPTEs [Begin, End).
+    //
+
+    const auto PushPdptes = [&](const uint64_t Begin, const uint64_t End) {
+      if (Begin < End) {
+        Push(EntryVa | (Begin << PdpteShift),
+             EntryVa + (End << PdpteShift) - page::Size, Entry, Access, Pdpt);
+      }
+    };
+
+    uint64_t Begin = 0;
+    uint64_t NumberPts = 0;
+    uint64_t NumberPresent = 0;
+    for (uint64_t PdpteIdx = 0; Child != nullptr && PdpteIdx < NumberEntries;
+         PdpteIdx++) {
+      const Pte_t &Pdpte = Child[PdpteIdx];
+      const uint64_t PdptePts = ptables::NumberPts(DumpParser, Pdpte);
+      if (PdptePts > PtsPerSlice) {
+        PushPdptes(Begin, PdpteIdx);
+        const uint64_t PdpteVa = EntryVa | (PdpteIdx << PdpteShift);
+        for (uint64_t PdeIdx = 0; PdeIdx < NumberEntries;
+             PdeIdx += PdesPerSlice) {
+          Push(PdpteVa | (PdeIdx << PdeShift),
+               PdpteVa + ((PdeIdx + PdesPerSlice) << PdeShift) - page::Size,
+               Pdpte, Access.Combine(Entry), Pd);
         }
 
-        if (OldPd != Pd_) {
-          Pde_ = Pd_;
+        Begin = PdpteIdx + 1;
+        NumberPts = 0;
+        NumberPresent = 0;
+        continue;
+      }
+
+      NumberPts += PdptePts;
+      NumberPresent += Pdpte.u.Present;
+      if (NumberPts >= PtsPerSlice || NumberPresent == PresentPerSlice) {
+        PushPdptes(Begin, PdpteIdx + 1);
+        Begin = PdpteIdx + 1;
+        NumberPts = 0;
+        NumberPresent = 0;
+      }
+    }
+
+    PushPdptes(Begin, NumberEntries);
+    if (Child != nullptr) {
+      DumpParser.ReleasePhysicalPage(ChildAddress);
+    }
+  }
+}
+
+//
+// Walk the page tables in parallel. The address space is split in slices of
+// PDPTEs, and the dense PDs are split further in slices of PDEs (see
+// ComputeSlices). Every slice is walked independently by a pool of threads and
+// Visit is invoked for every range of pages with the partial result associated
+// to the slice. Consume is invoked with the partial results in ascending VA
+// order as soon as they are available, so that they can be merged back while
+// the walk goes on; calls to Consume are serialized. If a cache is passed, the
+// kernel slices are looked up / stored in it. The hierarchy has four levels
+// unless NumberLevels says otherwise, and the ranges carry the attributes of
+// their pages if Attributes is set. If Visit takes an Entry_t instead of a
+// Range_t, the slices are walked entry by entry. If Stats is passed, what the
+// walkers went through is added to it; the slices grabbed from the cache are
+// not walked. MaxTableVisits limits how many times the walker of a slice enters
+// the same table (see LimitTableVisits), and the slices under the
+// self-reference entry of the top-level table are left out if SkipSelfReference
+// is set (see BasicPageTableWalker_t::SkipSelfReference). Only the addresses
+// between First and Last (inclusive) are walked, the slices being clipped to
+// them. The walkers don't descend past the tables mapping pages of type Finest
+// (see BasicPageTableWalker_t::StopAt). If Consume also takes a WalkProgress_t,
+// it gets how far the walk went along with every partial result. If
+// Cancellation is passed, the walk is abandoned once it is cancelled: the
+// slices left are not consumed. Returns false if the top-level table is not in
+// the dump or if the walk was abandoned.
+//
+
+template <uint64_t NumberLevels = 4, typename Partial_t, typename Visit_t,
+          typename Consume_t>
+bool ParallelWalk(const kdmpparser::KernelDumpParser &DumpParser,
+                  const uint64_t DirectoryAddress, const uint64_t NumberThreads,
+                  const Partial_t &Initial, Visit_t &&Visit,
+                  Consume_t &&Consume,
+                  SubtreeCache_t<Partial_t> *Cache = nullptr,
+                  const bool Attributes = false,
+                  WalkStats_t *Stats = nullptr,
+                  const uint64_t MaxTableVisits = 0,
+                  const bool SkipSelfReference = false,
+                  const Va_t First = Va_t(0),
+                  const Va_t Last = Va_t(~uint64_t(0)),
+                  const PageType_t Finest = PageType_t::Normal,
+                  const Cancellation_t *Cancellation = nullptr) {
+
+  //
+  // Compute the slices.
+  //
+
+  std::vector<Slice_t> Slices;
+  const auto Root = (Pte_t *)DumpParser.GetPhysicalPage(DirectoryAddress);
+  if (Root == nullptr) {
+    return false;
+  }
+
+  ComputeSlices<NumberLevels>(DumpParser, Root, 0, 0, Access_t(), Slices);
+  const auto SelfReferenceIdx =
+      SkipSelfReference ? FindSelfReference(Root, DirectoryAddress)
+                        : std::nullopt;
+  DumpParser.ReleasePhysicalPage(DirectoryAddress);
+  if (SelfReferenceIdx) {
+    const uint64_t RootShift = LevelShift(NumberLevels, 0);
+    const uint64_t RootMask = page::Size / sizeof(Pte_t) - 1;
+    std::erase_if(Slices, [&](const Slice_t &Slice) {
+      return ((Slice.First.U64() >> RootShift) & RootMask) ==
+             *SelfReferenceIdx;
+    });
+
+    if (Stats != nullptr) {
+      Stats->NumberSelfReferences++;
+    }
+  }
+
+  std::erase_if(Slices, [&](const Slice_t &Slice) {
+    return Slice.Last.U64() < First.U64() || Slice.First.U64() > Last.U64();
+  });
+
+  for (Slice_t &Slice : Slices) {
+    Slice.First = Va_t(std::max(Slice.First.U64(), First.U64()));
+    Slice.Last = Va_t(std::min(Slice.Last.U64(), Last.U64()));
+  }
+
+  //
+  // Walk the slices.
+  //
+
+  std::vector<Partial_t> Partials(Slices.size(), Initial);
+  std::vector<WalkStats_t> SliceStats(Stats != nullptr ? Slices.size() : 0);
+  std::vector<uint64_t> SlicePages(Slices.size(), 0);
+  std::atomic<uint64_t> NextSlice = 0;
+  auto Abandoned = [&]() {
+    return Cancellation != nullptr && Cancellation->Cancelled();
+  };
+
+  //
+  // The slices that are done get handed over in order by whichever thread
+  // completes the one everybody is waiting on.
+  //
+
+  std::mutex ConsumeLock;
+  std::vector<bool> Done(Slices.size(), false);
+  uint64_t NextConsume = 0;
+  WalkProgress_t Progress;
+  auto Complete = [&](const uint64_t SliceIdx) {
+    std::scoped_lock Guard(ConsumeLock);
+    Done[SliceIdx] = true;
+    while (NextConsume < Slices.size() && Done[NextConsume]) {
+      const uint64_t Next = Slices[NextConsume].Last.U64() + 1;
+      const uint64_t RootShift = LevelShift(NumberLevels, 0);
+      Progress.TopIdx = ((Next >> RootShift) % Progress.NumberTopEntries) +
+                        (Next == 0 ? Progress.NumberTopEntries : 0);
+      Progress.NumberPages += SlicePages[NextConsume];
+      Partial_t Partial = std::move(Partials[NextConsume++]);
+      if constexpr (std::is_invocable_v<Consume_t, Partial_t &&,
+                                        const WalkProgress_t &>) {
+        Consume(std::move(Partial), Progress);
+      } else {
+        Consume(std::move(Partial));
+      }
+    }
+  };
+
+  auto Walk = [&](const uint64_t SliceIdx, Partial_t &Partial) {
+    const Slice_t &Slice = Slices[SliceIdx];
+    BasicPageTableWalker_t<NumberLevels> Walker(DumpParser, DirectoryAddress,
+                                                Slice.First, Slice.Last);
+    if (Attributes) {
+      Walker.RecordAttributes();
+    }
+
+    Walker.LimitTableVisits(MaxTableVisits);
+    Walker.StopAt(Finest);
+    uint64_t NumberPages = 0;
+    uint64_t NumberVisits = 0;
+    auto Poll = [&]() {
+      return (++NumberVisits % Cancellation_t::PollInterval) != 0 ||
+             !Abandoned();
+    };
+
+    if constexpr (std::is_invocable_v<Visit_t, Partial_t &, const Entry_t &>) {
+      while (const auto &Entry = Walker.template Next<QuietPolicy_t>()) {
+        Visit(Partial, *Entry);
+        NumberPages += PageSize(Entry->Type) / page::Size;
+        if (!Poll()) {
+          return false;
+        }
+      }
+    } else {
+      while (const auto &Range = Walker.NextRange()) {
+        Visit(Partial, *Range);
+        NumberPages += Range->NumberPages;
+        if (!Poll()) {
+          return false;
         }
+      }
+    }
+
+    SlicePages[SliceIdx] = NumberPages;
+    if (Stats != nullptr) {
+      SliceStats[SliceIdx] = Walker.Stats();
+    }
 
-        //
-        // Third level.
-        //
-
-        for (; Pde_ < Limit(Pd_); Pde_++) {
-          if (!Pde_->u.Present) {
-            continue;
-          }
-
-          if (Pde_->u.LargePage) {
-
-            //
-            // Large page (2MB).
-            //
-
-            Pt_ = Pte_ = nullptr;
-            const auto &Entry = MakeEntry();
-            Pde_++;
-            return Entry;
-          }
-
-          const uint64_t PtAddress = AddressFromPfn(Pde_->u.PageFrameNumber);
-          const auto OldPt = Pt_;
-          Pt_ = (Pte_t *)DumpParser_.GetPhysicalPage(PtAddress);
-
-          if (Pt_ == nullptr) {
-            fmt::print("PT:{:#x} not available in the dump, skipping\n",
-                       PtAddress);
-            continue;
-          }
-
-          if (OldPt != Pt_) {
-            Pte_ = Pt_;
-          }
-
-          //
-          // Fourth level.
-          //
-
-          for (; Pte_ < Limit(Pt_); Pte_++) {
-            if (!Pte_->u.Present) {
-              continue;
-            }
-
-            const auto &Entry = MakeEntry();
-            Pte_++;
-            return Entry;
-          }
+    return true;
+  };
+
+  auto Worker = [&]() {
+    for (uint64_t SliceIdx = NextSlice++;
+         SliceIdx < Slices.size() && !Abandoned(); SliceIdx = NextSlice++) {
+      const Slice_t &Slice = Slices[SliceIdx];
+      if (Cache == nullptr || !Cache->Cacheable(Slice)) {
+        if (!Walk(SliceIdx, Partials[SliceIdx])) {
+          break;
+        }
+      } else {
+        const auto &Cached =
+            Cache->GetOrCompute(Slice, [&]() -> std::optional<Partial_t> {
+              Partial_t Partial = Initial;
+              if (!Walk(SliceIdx, Partial)) {
+                return std::nullopt;
+              }
+
+              return Partial;
+            });
+        if (Cached == nullptr) {
+          break;
         }
+
+        Partials[SliceIdx] = *Cached;
       }
+
+      Complete(SliceIdx);
     }
+  };
 
-    return std::nullopt;
+  std::vector<std::thread> Threads;
+  const uint64_t NumberWorkers =
+      std::max(uint64_t(1), std::min(NumberThreads, uint64_t(Slices.size())));
+  for (uint64_t Idx = 1; Idx < NumberWorkers; Idx++) {
+    Threads.emplace_back(Worker);
   }
-};
 
-} // namespace ptables
\ No newline at end of file
+  Worker();
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+
+  if (NextConsume < Slices.size()) {
+    return false;
+  }
+
+  //
+  // Every walker entered the tables leading to the table of its slice (and
+  // that one); they are only counted once, for the first slice going through
+  // them. The PDs of the slices at the PDE level were read to split them, so
+  // they are in the dump.
+  //
+
+  for (uint64_t SliceIdx = 0; SliceIdx < SliceStats.size(); SliceIdx++) {
+    WalkStats_t &SliceStat = SliceStats[SliceIdx];
+    const uint64_t SliceLevel = Slices[SliceIdx].Level;
+    const bool TablePresent = SliceLevel != NumberLevels - 3 ||
+                              SliceStat.NumberMissingTables[1] == 0;
+    if (SliceStat.NumberTables > 0) {
+      SliceStat.NumberTables -= SliceLevel + (TablePresent ? 1 : 0);
+    }
+
+    for (uint64_t Level = 0; Level <= SliceLevel; Level++) {
+      const uint64_t Shift =
+          Level == 0 ? 64 : LevelShift(NumberLevels, Level - 1);
+      const bool First =
+          SliceIdx == 0 ||
+          (Shift < 64 && (Slices[SliceIdx].First.U64() >> Shift) !=
+                             (Slices[SliceIdx - 1].First.U64() >> Shift));
+      SliceStat.NumberTables += First && (Level != SliceLevel || TablePresent);
+    }
+
+    *Stats += SliceStat;
+  }
+
+  return true;
+}
+
+} // namespace ptables
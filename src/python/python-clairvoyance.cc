@@ -0,0 +1,390 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#include "python-clairvoyance.h"
+#include <string_view>
+
+//
+// Object methods of the Python Dump type.
+//
+
+static PyMethodDef DumpObjectMethods[] = {
+    {"directory_table_base", DumpGetDirectoryTableBase, METH_NOARGS,
+     "Get the directory table base from the dump header"},
+    {"walk", DumpWalk, METH_VARARGS,
+     "Walk the page tables of a directory base and yield (va, number_pages, "
+     "protection) ranges"},
+    {"tape", DumpTape, METH_VARARGS,
+     "Walk the page tables of a directory base and build its tape"},
+    {nullptr, nullptr, 0, nullptr}};
+
+//
+// The type objects are zero-initialized and filled in by InitializeTypes when
+// the module is initialized, as most of their slots keep their defaults.
+//
+
+static PyTypeObject PythonDumpType;
+static PyTypeObject PythonWalkerType;
+
+//
+// Object methods and buffer procedures of the Python Tape type.
+//
+
+static PyMethodDef TapeObjectMethods[] = {
+    {"regions", TapeRegions, METH_NOARGS,
+     "Get the regions of the tape as (va, end_idx, end_run, padding) tuples"},
+    {"number_pixels", TapeNumberPixels, METH_NOARGS,
+     "Get the number of pixels of the tape, padding included"},
+    {nullptr, nullptr, 0, nullptr}};
+
+static PyBufferProcs TapeBufferProcs = {
+    .bf_getbuffer = TapeGetBuffer,
+    .bf_releasebuffer = nullptr,
+};
+
+static PyTypeObject PythonTapeType;
+
+//
+// Fill in the type objects; they are static, so they start with a reference
+// like the ones initialized with PyVarObject_HEAD_INIT.
+//
+
+static void InitializeTypes() {
+  Py_SET_REFCNT(&PythonDumpType, 1);
+  PythonDumpType.tp_name = "clairvoyance.Dump";
+  PythonDumpType.tp_basicsize = sizeof(PythonDump_t);
+  PythonDumpType.tp_dealloc = DeleteDump;
+  PythonDumpType.tp_flags = Py_TPFLAGS_DEFAULT;
+  PythonDumpType.tp_doc = "Dump object";
+  PythonDumpType.tp_methods = DumpObjectMethods;
+  PythonDumpType.tp_new = NewDump;
+
+  Py_SET_REFCNT(&PythonWalkerType, 1);
+  PythonWalkerType.tp_name = "clairvoyance.Walker";
+  PythonWalkerType.tp_basicsize = sizeof(PythonWalker_t);
+  PythonWalkerType.tp_dealloc = DeleteWalker;
+  PythonWalkerType.tp_flags = Py_TPFLAGS_DEFAULT;
+  PythonWalkerType.tp_doc = "Page tables walker object";
+  PythonWalkerType.tp_iter = PyObject_SelfIter;
+  PythonWalkerType.tp_iternext = WalkerNext;
+
+  Py_SET_REFCNT(&PythonTapeType, 1);
+  PythonTapeType.tp_name = "clairvoyance.Tape";
+  PythonTapeType.tp_basicsize = sizeof(PythonTape_t);
+  PythonTapeType.tp_dealloc = DeleteTape;
+  PythonTapeType.tp_as_buffer = &TapeBufferProcs;
+  PythonTapeType.tp_flags = Py_TPFLAGS_DEFAULT;
+  PythonTapeType.tp_doc =
+      "Tape object; the buffer is an array of uint64 runs, the low 48 bits "
+      "are the length, the next 8 bits the protection and the high 8 bits "
+      "the attributes";
+  PythonTapeType.tp_methods = TapeObjectMethods;
+}
+
+//
+// Python Dump instance creation.
+//   >>> Dump(filepath, [reader]) # reader is 'mmap' or 'pread'
+//
+
+PyObject *NewDump(PyTypeObject *Type, PyObject *Args, PyObject *) {
+  char *DumpPath = nullptr;
+  char *ReaderName = nullptr;
+  if (!PyArg_ParseTuple(Args, "s|s", &DumpPath, &ReaderName)) {
+    return nullptr;
+  }
+
+  const std::string_view Reader(ReaderName == nullptr ? "mmap" : ReaderName);
+  if (Reader != "mmap" && Reader != "pread") {
+    return PyErr_Format(PyExc_ValueError, "Dump() unknown reader %s",
+                        ReaderName);
+  }
+
+  PythonDump_t *Self = reinterpret_cast<PythonDump_t *>(Type->tp_alloc(Type, 0));
+  if (Self == nullptr) {
+    return nullptr;
+  }
+
+  Self->DumpParser = new kdmpparser::KernelDumpParser();
+  if (!Self->DumpParser->Parse(DumpPath, Reader == "mmap"
+                                             ? kdmpparser::ReaderType_t::Mmap
+                                             : kdmpparser::ReaderType_t::Pread)) {
+    DeleteDump(reinterpret_cast<PyObject *>(Self));
+    return PyErr_Format(PyExc_ValueError, "Dump() could not parse %s",
+                        DumpPath);
+  }
+
+  return reinterpret_cast<PyObject *>(Self);
+}
+
+//
+// Python Dump instance destruction.
+//
+
+void DeleteDump(PyObject *Object) {
+  PythonDump_t *Self = reinterpret_cast<PythonDump_t *>(Object);
+  delete Self->DumpParser;
+  Self->DumpParser = nullptr;
+  Py_TYPE(Self)->tp_free(Self);
+}
+
+//
+// Get a page-aligned directory base out of the arguments; 0 designates the
+// one from the dump header. Sets an exception and returns false if the PML4
+// isn't in the dump.
+//
+
+static bool GetDirectoryBase(const PythonDump_t *Self, PyObject *Args,
+                             const char *Format, uint64_t &DirectoryBase,
+                             unsigned long long *Extra = nullptr) {
+  unsigned long long Base = 0;
+  if (!PyArg_ParseTuple(Args, Format, &Base, Extra)) {
+    return false;
+  }
+
+  DirectoryBase = page::Align(
+      Base == 0 ? Self->DumpParser->GetDirectoryTableBase() : Base);
+  if (Self->DumpParser->GetPhysicalPage(DirectoryBase) == nullptr) {
+    PyErr_SetString(PyExc_ValueError,
+                    fmt::format("the page directory {:#x} is not in the dump",
+                                DirectoryBase)
+                        .c_str());
+    return false;
+  }
+
+  Self->DumpParser->ReleasePhysicalPage(DirectoryBase);
+  return true;
+}
+
+//
+// Python Dump instance method to get the directory table base.
+//   >>> dump_instance.directory_table_base() # return int
+//
+
+PyObject *DumpGetDirectoryTableBase(PyObject *Object, PyObject *) {
+  const PythonDump_t *Self = reinterpret_cast<PythonDump_t *>(Object);
+  return PyLong_FromUnsignedLongLong(
+      Self->DumpParser->GetDirectoryTableBase());
+}
+
+//
+// Python Dump instance method to walk the page tables of a directory base.
+//   >>> for va, number_pages, protection in dump_instance.walk([dtb]):
+//
+
+PyObject *DumpWalk(PyObject *Object, PyObject *Args) {
+  const PythonDump_t *Self = reinterpret_cast<PythonDump_t *>(Object);
+  uint64_t DirectoryBase = 0;
+  if (!GetDirectoryBase(Self, Args, "|K", DirectoryBase)) {
+    return nullptr;
+  }
+
+  PythonWalker_t *Walker =
+      PyObject_New(PythonWalker_t, &PythonWalkerType);
+  if (Walker == nullptr) {
+    return nullptr;
+  }
+
+  Walker->Walker =
+      new ptables::PageTableWalker_t(*Self->DumpParser, DirectoryBase);
+  Walker->Dump = Object;
+  Py_INCREF(Object);
+  return reinterpret_cast<PyObject *>(Walker);
+}
+
+//
+// Python Dump instance method to build the tape of a directory base. The walk
+// happens without holding the GIL.
+//   >>> tape = dump_instance.tape([dtb, [threads]])
+//   >>> runs = numpy.frombuffer(tape, dtype=numpy.uint64) # no copy
+//
+
+PyObject *DumpTape(PyObject *Object, PyObject *Args) {
+  const PythonDump_t *Self = reinterpret_cast<PythonDump_t *>(Object);
+  uint64_t DirectoryBase = 0;
+  unsigned long long NumberThreads = 1;
+  if (!GetDirectoryBase(Self, Args, "|KK", DirectoryBase, &NumberThreads)) {
+    return nullptr;
+  }
+
+  PythonTape_t *Tape = PyObject_New(PythonTape_t, &PythonTapeType);
+  if (Tape == nullptr) {
+    return nullptr;
+  }
+
+  auto Builder = new clairvoyance::TapeBuilder_t();
+  Py_BEGIN_ALLOW_THREADS;
+  ptables::ParallelWalk(
+      *Self->DumpParser, DirectoryBase, std::max(1ull, NumberThreads),
+      clairvoyance::TapeBuilder_t(true, Builder->Policy()),
+      [](clairvoyance::TapeBuilder_t &Partial, const ptables::Range_t &Range) {
+        Partial.Add(Range);
+      },
+      [&](clairvoyance::TapeBuilder_t &&Partial) {
+        Builder->Splice(std::move(Partial));
+      });
+  Builder->Finish();
+  Py_END_ALLOW_THREADS;
+
+  Tape->Builder = Builder;
+  Tape->Shape = Py_ssize_t(Builder->Contiguous().size());
+  Tape->Stride = sizeof(clairvoyance::Tape_t::Run_t);
+  return reinterpret_cast<PyObject *>(Tape);
+}
+
+//
+// Python Walker instance destruction; the walker goes before the dump it
+// walks.
+//
+
+void DeleteWalker(PyObject *Object) {
+  PythonWalker_t *Self = reinterpret_cast<PythonWalker_t *>(Object);
+  delete Self->Walker;
+  Self->Walker = nullptr;
+  Py_XDECREF(Self->Dump);
+  PyObject_Free(Self);
+}
+
+//
+// Python Walker iteration; returns the next (va, number_pages, protection)
+// range.
+//
+
+PyObject *WalkerNext(PyObject *Object) {
+  PythonWalker_t *Self = reinterpret_cast<PythonWalker_t *>(Object);
+  const auto &Range = Self->Walker->NextRange();
+  if (!Range) {
+    return nullptr;
+  }
+
+  return Py_BuildValue("(KKB)", (unsigned long long)Range->Va,
+                       (unsigned long long)Range->NumberPages,
+                       (unsigned char)Range->Protection);
+}
+
+//
+// Python Tape instance destruction.
+//
+
+void DeleteTape(PyObject *Object) {
+  PythonTape_t *Self = reinterpret_cast<PythonTape_t *>(Object);
+  delete Self->Builder;
+  Self->Builder = nullptr;
+  PyObject_Free(Self);
+}
+
+//
+// Export the runs of the tape as a read-only array of uint64; the buffer
+// points straight into the tape.
+//
+
+int TapeGetBuffer(PyObject *Object, Py_buffer *View, int Flags) {
+  PythonTape_t *Self = reinterpret_cast<PythonTape_t *>(Object);
+  if ((Flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "the tape is read-only");
+    View->obj = nullptr;
+    return -1;
+  }
+
+  static_assert(sizeof(clairvoyance::Tape_t::Run_t) ==
+                sizeof(unsigned long long));
+  const auto &Runs = Self->Builder->Contiguous();
+  View->buf = (void *)Runs.data();
+  View->obj = Object;
+  Py_INCREF(Object);
+  View->len = Py_ssize_t(Runs.size_bytes());
+  View->readonly = 1;
+  View->itemsize = sizeof(clairvoyance::Tape_t::Run_t);
+  View->format = (Flags & PyBUF_FORMAT) == PyBUF_FORMAT ? (char *)"Q" : nullptr;
+  View->ndim = 1;
+  View->shape = (Flags & PyBUF_ND) == PyBUF_ND ? &Self->Shape : nullptr;
+  View->strides =
+      (Flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &Self->Stride : nullptr;
+  View->suboffsets = nullptr;
+  View->internal = nullptr;
+  return 0;
+}
+
+//
+// Python Tape instance method to get its regions.
+//   >>> tape.regions() # return list((va, end_idx, end_run, padding))
+//
+
+PyObject *TapeRegions(PyObject *Object, PyObject *) {
+  const PythonTape_t *Self = reinterpret_cast<PythonTape_t *>(Object);
+  const auto &Regions = Self->Builder->Regions();
+  PyObject *List = PyList_New(Py_ssize_t(Regions.size()));
+  if (List == nullptr) {
+    return nullptr;
+  }
+
+  for (size_t Idx = 0; Idx < Regions.size(); Idx++) {
+    const auto &Region = Regions[Idx];
+    PyList_SET_ITEM(List, Py_ssize_t(Idx),
+                    Py_BuildValue("(KKKK)", (unsigned long long)Region.Va,
+                                  (unsigned long long)Region.EndIdx,
+                                  (unsigned long long)Region.EndRun,
+                                  (unsigned long long)Region.Padding));
+  }
+
+  return List;
+}
+
+//
+// Python Tape instance method to get the number of pixels.
+//   >>> tape.number_pixels() # return int
+//
+
+PyObject *TapeNumberPixels(PyObject *Object, PyObject *) {
+  const PythonTape_t *Self = reinterpret_cast<PythonTape_t *>(Object);
+  return PyLong_FromUnsignedLongLong(Self->Builder->Size());
+}
+
+//
+// Module definition.
+//
+
+static struct PyModuleDef ClairvoyanceModule = {
+    .m_base = PyModuleDef_HEAD_INIT,
+    .m_name = "clairvoyance",
+    .m_doc = "Walk the page tables of Windows kernel dumps",
+    .m_size = -1,
+    .m_methods = nullptr,
+    .m_slots = nullptr,
+    .m_traverse = nullptr,
+    .m_clear = nullptr,
+    .m_free = nullptr,
+};
+
+//
+// Module initialization function; the protection names are exported in their
+// numerical order so that PROTECTIONS[protection] is its name.
+//
+
+PyMODINIT_FUNC PyInit_clairvoyance(void) {
+  InitializeTypes();
+  if (PyType_Ready(&PythonDumpType) < 0 ||
+      PyType_Ready(&PythonWalkerType) < 0 ||
+      PyType_Ready(&PythonTapeType) < 0) {
+    return nullptr;
+  }
+
+  PyObject *Module = PyModule_Create(&ClairvoyanceModule);
+  if (Module == nullptr) {
+    return nullptr;
+  }
+
+  constexpr uint8_t NumberProtections =
+      uint8_t(ptables::Protection_t::KernelReadWriteExec) + 1;
+  PyObject *Protections = PyTuple_New(NumberProtections);
+  for (uint8_t Idx = 0; Idx < NumberProtections; Idx++) {
+    const auto &Name = ptables::ToString(ptables::Protection_t(Idx));
+    PyTuple_SET_ITEM(Protections, Idx,
+                     PyUnicode_FromStringAndSize(Name.data(), Name.size()));
+  }
+
+  Py_INCREF(&PythonDumpType);
+  PyModule_AddObject(Module, "Dump",
+                     reinterpret_cast<PyObject *>(&PythonDumpType));
+  PyModule_AddObject(Module, "PROTECTIONS", Protections);
+  PyModule_AddIntConstant(Module, "LENGTH_BITS", 48);
+  PyModule_AddIntConstant(Module, "PROTECTION_BITS", 8);
+  return Module;
+}
@@ -0,0 +1,67 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#define PY_SSIZE_T_CLEAN
+
+#include "clairvoyance.h"
+#include <Python.h>
+
+//
+// Python object wrapping a parsed dump.
+//
+
+struct PythonDump_t {
+  PyObject_HEAD kdmpparser::KernelDumpParser *DumpParser;
+};
+
+//
+// Python object wrapping a page tables walker; it keeps the dump it walks
+// alive.
+//
+
+struct PythonWalker_t {
+  PyObject_HEAD ptables::PageTableWalker_t *Walker;
+  PyObject *Dump;
+};
+
+//
+// Python object wrapping a complete tape; its runs are exported through the
+// buffer protocol, as an array of Shape runs of Stride bytes.
+//
+
+struct PythonTape_t {
+  PyObject_HEAD clairvoyance::TapeBuilder_t *Builder;
+  Py_ssize_t Shape;
+  Py_ssize_t Stride;
+};
+
+//
+// Python Dump type functions declarations.
+//
+
+PyObject *NewDump(PyTypeObject *Type, PyObject *Args, PyObject *Kwds);
+void DeleteDump(PyObject *Object);
+PyObject *DumpGetDirectoryTableBase(PyObject *Object, PyObject *NotUsed);
+PyObject *DumpWalk(PyObject *Object, PyObject *Args);
+PyObject *DumpTape(PyObject *Object, PyObject *Args);
+
+//
+// Python Walker type functions declarations.
+//
+
+void DeleteWalker(PyObject *Object);
+PyObject *WalkerNext(PyObject *Object);
+
+//
+// Python Tape type functions declarations.
+//
+
+void DeleteTape(PyObject *Object);
+int TapeGetBuffer(PyObject *Object, Py_buffer *View, int Flags);
+PyObject *TapeRegions(PyObject *Object, PyObject *NotUsed);
+PyObject *TapeNumberPixels(PyObject *Object, PyObject *NotUsed);
+
+//
+// Module initialization function.
+//
+
+PyMODINIT_FUNC PyInit_clairvoyance(void);
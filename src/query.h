@@ -0,0 +1,279 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "binaryformat.h"
+#include "fmt/format.h"
+#include "pagetables.h"
+#include "tape.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace clairvoyance::query {
+
+//
+// An index over an address space that answers point and range queries in
+// logarithmic time. It is built out of a complete tape (or a binary
+// .clairvoyance file) and stores the mapped ranges as a sorted array of
+// disjoint intervals; the unmapped parts of the address space (the gaps drawn
+// on the curve and the padding between regions) are not stored. The ranges of
+// every protection are also kept on the side so that "all the RWX ranges" is
+// answered without looking at the other ones.
+//
+
+class Index_t {
+  using Protection_t = ptables::Protection_t;
+  using Range_t = ptables::Range_t;
+
+  static constexpr uint64_t NumberProtections =
+      uint64_t(Protection_t::KernelReadWriteExec) + 1;
+
+  std::vector<Range_t> Ranges_;
+  std::array<std::vector<Range_t>, NumberProtections> ByProtection_;
+
+  //
+  // The last virtual address covered by a range.
+  //
+
+  static uint64_t LastVa(const Range_t &Range) {
+    return Range.Va + ((Range.NumberPages - 1) * page::Size);
+  }
+
+  //
+  // Add NumberPages pages of Protection starting at Va; the ranges are added
+  // in ascending VA order and contiguous ranges with the same protection are
+  // merged.
+  //
+
+  void Add(const uint64_t Va, const uint64_t NumberPages,
+           const Protection_t Protection) {
+    if (NumberPages == 0 || Protection == Protection_t::None) {
+      return;
+    }
+
+    if (!Ranges_.empty()) {
+      Range_t &Last = Ranges_.back();
+      if (Last.Protection == Protection &&
+          (LastVa(Last) + page::Size) == Va) {
+        Last.NumberPages += NumberPages;
+        return;
+      }
+    }
+
+    Ranges_.push_back({Va, NumberPages, Protection});
+  }
+
+  //
+  // Build the per-protection arrays once every range has been added.
+  //
+
+  void Finish() {
+    for (const auto &Range : Ranges_) {
+      ByProtection_[uint64_t(Range.Protection)].push_back(Range);
+    }
+  }
+
+  //
+  // Find the first range that ends at or after the page of Va.
+  //
+
+  static std::span<const Range_t>::iterator
+  LowerBound(std::span<const Range_t> Ranges, const uint64_t Va) {
+    return std::lower_bound(Ranges.begin(), Ranges.end(), page::Align(Va),
+                            [](const Range_t &Range, const uint64_t Va) {
+                              return LastVa(Range) < Va;
+                            });
+  }
+
+  //
+  // Get the ranges of an array that overlap [Begin, End).
+  //
+
+  static std::span<const Range_t> Overlapping(std::span<const Range_t> Ranges,
+                                              const uint64_t Begin,
+                                              const uint64_t End) {
+    if (Begin >= End) {
+      return {};
+    }
+
+    const auto &First = LowerBound(Ranges, Begin);
+    const auto &Last =
+        std::lower_bound(First, Ranges.end(), End,
+                         [](const Range_t &Range, const uint64_t End) {
+                           return Range.Va < End;
+                         });
+    return std::span(First, Last);
+  }
+
+public:
+  Index_t() = default;
+
+  //
+  // Index a complete tape; its runs must not have been drained.
+  //
+
+  explicit Index_t(const TapeBuilder_t &Builder) {
+    const auto &Tape = Builder.Tape();
+    uint64_t RunIdx = Tape.FirstRun();
+    for (const auto &Region : Builder.Regions()) {
+      uint64_t Va = Region.Va;
+      for (const auto &Run : Tape.Runs(RunIdx, Region.EndRun)) {
+        Add(Va, Run.Length * Region.Scale, Run.Prot());
+        Va += Run.Length * Region.Scale * page::Size;
+      }
+
+      RunIdx = Region.EndRun;
+    }
+
+    Finish();
+  }
+
+  //
+  // Index a binary .clairvoyance file.
+  //
+
+  explicit Index_t(const binary::Reader_t &Reader) {
+    for (const auto &Region : Reader.Regions()) {
+      uint64_t Va = Region.Va;
+      for (const auto &Run : Reader.Runs(Region)) {
+        Add(Va, Run.Length * Region.Scale, Protection_t(Run.Protection));
+        Va += Run.Length * Region.Scale * page::Size;
+      }
+    }
+
+    Finish();
+  }
+
+  //
+  // Get the range that maps Va, if it is mapped.
+  //
+
+  std::optional<Range_t> Find(const uint64_t Va) const {
+    const std::span<const Range_t> All(Ranges_);
+    const auto &It = LowerBound(All, Va);
+    if (It == All.end() || It->Va > page::Align(Va)) {
+      return std::nullopt;
+    }
+
+    return *It;
+  }
+
+  //
+  // Get the protection of Va; None if it isn't mapped.
+  //
+
+  Protection_t Protection(const uint64_t Va) const {
+    const auto &Range = Find(Va);
+    return Range ? Range->Protection : Protection_t::None;
+  }
+
+  //
+  // Get the ranges that overlap [Begin, End), optionally only the ones with a
+  // given protection. The first and last ranges can extend past the bounds.
+  //
+
+  std::span<const Range_t> Ranges(const uint64_t Begin,
+                                  const uint64_t End) const {
+    return Overlapping(Ranges_, Begin, End);
+  }
+
+  std::span<const Range_t> Ranges(const uint64_t Begin, const uint64_t End,
+                                  const Protection_t Protection) const {
+    return Overlapping(Ranges(Protection), Begin, End);
+  }
+
+  //
+  // Get all the ranges with a given protection.
+  //
+
+  std::span<const Range_t> Ranges(const Protection_t Protection) const {
+    if (Protection == Protection_t::None ||
+        uint64_t(Protection) >= NumberProtections) {
+      return {};
+    }
+
+    return ByProtection_[uint64_t(Protection)];
+  }
+
+  //
+  // Get all the mapped ranges.
+  //
+
+  std::span<const Range_t> Ranges() const { return Ranges_; }
+
+  //
+  // Number of bytes of memory used by the index.
+  //
+
+  uint64_t MemoryUsage() const {
+    uint64_t NumberRanges = Ranges_.capacity();
+    for (const auto &Ranges : ByProtection_) {
+      NumberRanges += Ranges.capacity();
+    }
+
+    return NumberRanges * sizeof(Range_t);
+  }
+};
+
+//
+// Answer a query and append the result to Out, one line per range. A query is
+// either a virtual address, a [<start>-<end>) range of addresses, or the name
+// of a protection; anything else gets an "invalid query" line.
+//
+
+inline void Answer(const Index_t &Index, const std::string &Query,
+                   std::string &Out) {
+  std::optional<ptables::Protection_t> Protection;
+  for (uint8_t Idx = 0;
+       Idx <= uint8_t(ptables::Protection_t::KernelReadWriteExec); Idx++) {
+    if (ptables::ToString(ptables::Protection_t(Idx)) == Query) {
+      Protection = ptables::Protection_t(Idx);
+    }
+  }
+
+  std::span<const ptables::Range_t> Ranges;
+  if (Protection) {
+    Ranges = Index.Ranges(*Protection);
+  } else {
+    char *End = nullptr;
+    const uint64_t Va = strtoull(Query.c_str(), &End, 0);
+    bool Parsed = End != Query.c_str();
+    if (Parsed && *End == '\0') {
+      fmt::format_to(std::back_inserter(Out), "{:#018x} {}\n", Va,
+                     ptables::ToString(Index.Protection(Va)));
+      return;
+    }
+
+    //
+    // Anything that isn't a range past this point, or an empty range, is
+    // rejected (the stop stays at zero).
+    //
+
+    uint64_t Stop = 0;
+    if (Parsed && *End == '-') {
+      const char *Second = End + 1;
+      Stop = strtoull(Second, &End, 0);
+      Parsed = End != Second && *End == '\0';
+    }
+
+    if (!Parsed || Stop <= Va) {
+      fmt::format_to(std::back_inserter(Out), "invalid query {}\n", Query);
+      return;
+    }
+
+    Ranges = Index.Ranges(Va, Stop);
+  }
+
+  for (const auto &Range : Ranges) {
+    fmt::format_to(std::back_inserter(Out), "{:#018x}-{:#018x} {}\n",
+                   Range.Va, Range.Va + (Range.NumberPages * page::Size),
+                   ptables::ToString(Range.Protection));
+  }
+}
+
+} // namespace clairvoyance::query
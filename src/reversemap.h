@@ -0,0 +1,559 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace clairvoyance::rmap {
+
+namespace fs = std::filesystem;
+
+//
+// A virtual mapping of a physical page, in one of the directory bases.
+//
+
+struct Mapping_t {
+  uint64_t DirectoryBase = 0;
+  uint64_t Va = 0;
+  ptables::Protection_t Protection = ptables::Protection_t::None;
+  ptables::PageType_t Type = ptables::PageType_t::Normal;
+};
+
+//
+// A range of physical pages that is mapped writable in one place and
+// executable in another.
+//
+
+struct Alias_t {
+  uint64_t Pfn = 0;
+  uint64_t NumberPages = 0;
+};
+
+//
+// A leaf entry collected during a walk. Pfn is the first physical page it
+// maps aligned on the size of the page (the PAT bit of the large pages sits
+// where the low bit of their PFN would be), and Base is the index of its
+// directory base.
+//
+
+struct Record_t {
+  uint64_t Pfn = 0;
+  uint64_t Va = 0;
+  uint32_t Base = 0;
+  ptables::Protection_t Protection = ptables::Protection_t::None;
+  ptables::PageType_t Type = ptables::PageType_t::Normal;
+
+  bool operator<(const Record_t &Other) const {
+    return std::tie(Pfn, Type, Base, Va) <
+           std::tie(Other.Pfn, Other.Type, Other.Base, Other.Va);
+  }
+};
+
+//
+// Number of 4KB pages mapped by a page of a given type.
+//
+
+constexpr uint64_t NumberPages(const ptables::PageType_t Type) {
+  switch (Type) {
+  case ptables::PageType_t::Huge:
+    return 512 * 512;
+  case ptables::PageType_t::Large:
+    return 512;
+  case ptables::PageType_t::Normal:
+    return 1;
+  }
+
+  std::abort();
+}
+
+//
+// The .rmap file is laid out like this:
+//   - a Header_t,
+//   - Header_t::NumberBases directory bases,
+//   - Header_t::NumberBlocks Block_t entries,
+//   - Header_t::NumberBytes bytes of encoded records,
+//   - Header_t::NumberAliases Alias_t entries.
+// Everything is stored little-endian.
+//
+
+constexpr uint32_t Magic = 0x50'41'4d'52; // 'RMAP'
+constexpr uint32_t Version = 1;
+
+struct Header_t {
+  uint32_t Magic = rmap::Magic;
+  uint32_t Version = rmap::Version;
+  uint64_t NumberBases = 0;
+  uint64_t NumberRecords = 0;
+  uint64_t NumberBlocks = 0;
+  uint64_t NumberBytes = 0;
+  uint64_t NumberAliases = 0;
+};
+
+static_assert(sizeof(Header_t) == 0x30);
+
+//
+// The records are sorted by PFN and encoded in blocks; a block knows the PFN
+// of its first record and where its bytes start.
+//
+
+struct Block_t {
+  uint64_t FirstPfn = 0;
+  uint64_t Offset = 0;
+};
+
+//
+// The reverse index maps a physical page back to every virtual address that
+// maps it, in every directory base that was walked. The records are sorted by
+// PFN and delta-encoded with varints in blocks of RecordsPerBlock records:
+//   - the PFN as a delta from the previous record,
+//   - a byte holding the protection and the page type,
+//   - the index of the directory base,
+//   - the virtual page as a zigzagged delta from the previous record, which
+//     is small when a physical page is mapped several times in a process.
+// The deltas restart at every block, so that a lookup is a binary search over
+// the blocks followed by the decoding of a couple of them.
+//
+
+class Index_t {
+  static constexpr uint64_t RecordsPerBlock = 64;
+
+  std::vector<uint64_t> DirectoryBases_;
+  std::vector<Block_t> Blocks_;
+  std::vector<uint8_t> Bytes_;
+  std::vector<Alias_t> Aliases_;
+  uint64_t NumberRecords_ = 0;
+
+  static void PutVarint(std::vector<uint8_t> &Bytes, uint64_t Value) {
+    while (Value >= 0x80) {
+      Bytes.push_back(uint8_t(Value) | 0x80);
+      Value >>= 7;
+    }
+
+    Bytes.push_back(uint8_t(Value));
+  }
+
+  bool GetVarint(uint64_t &Offset, uint64_t &Value) const {
+    Value = 0;
+    for (uint64_t Shift = 0; Shift < 64 && Offset < Bytes_.size();
+         Shift += 7) {
+      const uint8_t Byte = Bytes_[Offset++];
+      Value |= uint64_t(Byte & 0x7f) << Shift;
+      if ((Byte & 0x80) == 0) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  //
+  // Encode the sorted records in blocks.
+  //
+
+  void Encode(std::span<const Record_t> Records) {
+    Record_t Previous;
+    for (uint64_t Idx = 0; Idx < Records.size(); Idx++) {
+      const Record_t &Record = Records[Idx];
+      if ((Idx % RecordsPerBlock) == 0) {
+        Blocks_.push_back({Record.Pfn, Bytes_.size()});
+        Previous = Record_t();
+      }
+
+      const uint64_t VaPage = Record.Va / page::Size;
+      const int64_t VaDelta = int64_t(VaPage - (Previous.Va / page::Size));
+      PutVarint(Bytes_, Record.Pfn - Previous.Pfn);
+      Bytes_.push_back(uint8_t(Record.Protection) |
+                       uint8_t(uint8_t(Record.Type) << 4));
+      PutVarint(Bytes_, Record.Base);
+      PutVarint(Bytes_, uint64_t(VaDelta << 1) ^ uint64_t(VaDelta >> 63));
+      Previous = Record;
+    }
+
+    NumberRecords_ = Records.size();
+  }
+
+  //
+  // Sweep the sorted records and find the physical pages that are mapped
+  // writable by one entry and executable by another one.
+  //
+
+  void FindAliases(std::span<const Record_t> Records) {
+    struct Event_t {
+      uint64_t Pfn = 0;
+      int8_t Writable = 0;
+      int8_t Executable = 0;
+      int8_t Both = 0;
+    };
+
+    std::vector<Event_t> Events;
+    for (const auto &Record : Records) {
+      const int8_t Writable = ptables::IsWritable(Record.Protection);
+      const int8_t Executable = ptables::IsExecutable(Record.Protection);
+      if (!Writable && !Executable) {
+        continue;
+      }
+
+      const int8_t Both = Writable && Executable;
+      Events.push_back({Record.Pfn, Writable, Executable, Both});
+      Events.push_back({Record.Pfn + NumberPages(Record.Type),
+                        int8_t(-Writable), int8_t(-Executable),
+                        int8_t(-Both)});
+    }
+
+    std::sort(Events.begin(), Events.end(),
+              [](const Event_t &A, const Event_t &B) { return A.Pfn < B.Pfn; });
+
+    int64_t Writable = 0, Executable = 0, Both = 0;
+    for (uint64_t Idx = 0; Idx < Events.size();) {
+      const uint64_t Pfn = Events[Idx].Pfn;
+      for (; Idx < Events.size() && Events[Idx].Pfn == Pfn; Idx++) {
+        Writable += Events[Idx].Writable;
+        Executable += Events[Idx].Executable;
+        Both += Events[Idx].Both;
+      }
+
+      //
+      // A single RWX mapping is not an alias; at least two different
+      // mappings are needed.
+      //
+
+      const bool Aliased = Writable > 0 && Executable > 0 &&
+                           !(Writable == 1 && Executable == 1 && Both == 1);
+      if (!Aliased || Idx == Events.size()) {
+        continue;
+      }
+
+      const uint64_t Length = Events[Idx].Pfn - Pfn;
+      if (!Aliases_.empty() &&
+          (Aliases_.back().Pfn + Aliases_.back().NumberPages) == Pfn) {
+        Aliases_.back().NumberPages += Length;
+      } else {
+        Aliases_.push_back({Pfn, Length});
+      }
+    }
+  }
+
+  //
+  // Visit the records whose first PFN is Pfn.
+  //
+
+  template <typename Visit_t>
+  void Scan(const uint64_t Pfn, Visit_t &&Visit) const {
+    auto It = std::lower_bound(
+        Blocks_.begin(), Blocks_.end(), Pfn,
+        [](const Block_t &Block, const uint64_t Pfn) {
+          return Block.FirstPfn < Pfn;
+        });
+
+    //
+    // The records of Pfn can start at the end of the previous block.
+    //
+
+    if (It != Blocks_.begin()) {
+      It--;
+    }
+
+    for (; It != Blocks_.end() && It->FirstPfn <= Pfn; It++) {
+      const uint64_t BlockIdx = std::distance(Blocks_.begin(), It);
+      const uint64_t End =
+          std::min(NumberRecords_, (BlockIdx + 1) * RecordsPerBlock);
+      uint64_t Offset = It->Offset;
+      Record_t Record;
+      for (uint64_t Idx = BlockIdx * RecordsPerBlock; Idx < End; Idx++) {
+        uint64_t PfnDelta = 0, Base = 0, VaDelta = 0;
+        if (!GetVarint(Offset, PfnDelta) || Offset >= Bytes_.size()) {
+          return;
+        }
+
+        const uint8_t Bits = Bytes_[Offset++];
+        if (!GetVarint(Offset, Base) || !GetVarint(Offset, VaDelta)) {
+          return;
+        }
+
+        const int64_t Delta = int64_t(VaDelta >> 1) ^ -int64_t(VaDelta & 1);
+        Record.Pfn += PfnDelta;
+        Record.Protection = ptables::Protection_t(Bits & 0xf);
+        Record.Type = ptables::PageType_t(Bits >> 4);
+        Record.Base = uint32_t(Base);
+        Record.Va = ((Record.Va / page::Size) + Delta) * page::Size;
+        if (Record.Pfn > Pfn) {
+          return;
+        }
+
+        if (Record.Pfn == Pfn) {
+          Visit(Record);
+        }
+      }
+    }
+  }
+
+public:
+  Index_t() = default;
+
+  //
+  // Index sorted records collected out of the directory bases.
+  //
+
+  Index_t(std::vector<uint64_t> DirectoryBases,
+          std::span<const Record_t> Records)
+      : DirectoryBases_(std::move(DirectoryBases)) {
+    Encode(Records);
+    FindAliases(Records);
+  }
+
+  //
+  // Get every mapping of the physical page of Pa. The page can be mapped by
+  // a 4KB page, or be part of a large or a huge page; the addresses returned
+  // are the ones of the 4KB page in every case.
+  //
+
+  std::vector<Mapping_t> Find(const uint64_t Pa) const {
+    std::vector<Mapping_t> Mappings;
+    const uint64_t Pfn = Pa / page::Size;
+    for (const auto Type :
+         {ptables::PageType_t::Normal, ptables::PageType_t::Large,
+          ptables::PageType_t::Huge}) {
+      const uint64_t First = Pfn & ~(NumberPages(Type) - 1);
+      Scan(First, [&](const Record_t &Record) {
+        if (Record.Type != Type || Record.Base >= DirectoryBases_.size()) {
+          return;
+        }
+
+        Mappings.push_back({DirectoryBases_[Record.Base],
+                            Record.Va + ((Pfn - First) * page::Size),
+                            Record.Protection, Record.Type});
+      });
+    }
+
+    return Mappings;
+  }
+
+  std::span<const Alias_t> Aliases() const { return Aliases_; }
+  std::span<const uint64_t> DirectoryBases() const { return DirectoryBases_; }
+  uint64_t NumberRecords() const { return NumberRecords_; }
+
+  //
+  // Number of bytes of memory used by the index.
+  //
+
+  uint64_t MemoryUsage() const {
+    return (DirectoryBases_.capacity() * sizeof(uint64_t)) +
+           (Blocks_.capacity() * sizeof(Block_t)) + Bytes_.capacity() +
+           (Aliases_.capacity() * sizeof(Alias_t));
+  }
+
+  //
+  // Serialize the index on disk.
+  //
+
+  bool Write(const fs::path &Filename) const {
+    Header_t Header;
+    Header.NumberBases = DirectoryBases_.size();
+    Header.NumberRecords = NumberRecords_;
+    Header.NumberBlocks = Blocks_.size();
+    Header.NumberBytes = Bytes_.size();
+    Header.NumberAliases = Aliases_.size();
+
+    FILE *File = fopen(Filename.string().c_str(), "wb");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    const bool Success =
+        fwrite(&Header, sizeof(Header), 1, File) == 1 &&
+        fwrite(DirectoryBases_.data(), sizeof(uint64_t),
+               DirectoryBases_.size(), File) == DirectoryBases_.size() &&
+        fwrite(Blocks_.data(), sizeof(Block_t), Blocks_.size(), File) ==
+            Blocks_.size() &&
+        fwrite(Bytes_.data(), 1, Bytes_.size(), File) == Bytes_.size() &&
+        fwrite(Aliases_.data(), sizeof(Alias_t), Aliases_.size(), File) ==
+            Aliases_.size();
+
+    fclose(File);
+    return Success;
+  }
+
+  //
+  // Load an index from disk and validate it.
+  //
+
+  bool Read(const fs::path &Filename) {
+    std::ifstream File(Filename, std::ios::binary);
+    Header_t Header;
+    if (!File.read((char *)&Header, sizeof(Header))) {
+      fmt::print("Could not read the header of {}\n", Filename.string());
+      return false;
+    }
+
+    if (Header.Magic != Magic || Header.Version != Version) {
+      fmt::print("{} is not a supported .rmap file\n", Filename.string());
+      return false;
+    }
+
+    const uint64_t ExpectedBlocks =
+        (Header.NumberRecords + RecordsPerBlock - 1) / RecordsPerBlock;
+    if (Header.NumberBlocks != ExpectedBlocks) {
+      fmt::print("{} has an invalid number of blocks\n", Filename.string());
+      return false;
+    }
+
+    DirectoryBases_.resize(Header.NumberBases);
+    Blocks_.resize(Header.NumberBlocks);
+    Bytes_.resize(Header.NumberBytes);
+    Aliases_.resize(Header.NumberAliases);
+    NumberRecords_ = Header.NumberRecords;
+    if (!File.read((char *)DirectoryBases_.data(),
+                   DirectoryBases_.size() * sizeof(uint64_t)) ||
+        !File.read((char *)Blocks_.data(), Blocks_.size() * sizeof(Block_t)) ||
+        !File.read((char *)Bytes_.data(), Bytes_.size()) ||
+        !File.read((char *)Aliases_.data(),
+                   Aliases_.size() * sizeof(Alias_t))) {
+      fmt::print("{} is truncated\n", Filename.string());
+      return false;
+    }
+
+    for (const auto &Block : Blocks_) {
+      if (Block.Offset > Bytes_.size()) {
+        fmt::print("{} has a block with an invalid offset\n",
+                   Filename.string());
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
+//
+// Collect the leaf entries of a directory base.
+//
+
+template <uint64_t NumberLevels>
+std::vector<Record_t> Collect(const kdmpparser::KernelDumpParser &DumpParser,
+                              const uint64_t DirectoryBase,
+                              const uint32_t Base) {
+  std::vector<Record_t> Records;
+  ptables::BasicPageTableWalker_t<NumberLevels> Walker(DumpParser,
+                                                       DirectoryBase);
+  ptables::EntryBatch_t Batch;
+  while (const uint64_t Size = Walker.NextBatch(Batch)) {
+    for (uint64_t Idx = 0; Idx < Size; Idx++) {
+      const auto Type = Batch.Types[Idx];
+      const uint64_t Pfn =
+          (Batch.Pas[Idx] / page::Size) & ~(NumberPages(Type) - 1);
+      Records.push_back(
+          {Pfn, Batch.Vas[Idx], Base, Batch.Protections[Idx], Type});
+    }
+  }
+
+  std::sort(Records.begin(), Records.end());
+  return Records;
+}
+
+//
+// Build the reverse index of a set of directory bases. The directory bases
+// are walked and their records sorted in parallel, then the sorted runs are
+// merged pairwise.
+//
+
+inline Index_t Build(const kdmpparser::KernelDumpParser &DumpParser,
+                     const std::vector<uint64_t> &DirectoryBases,
+                     const uint64_t NumberThreads, const bool La57 = false) {
+  std::vector<std::vector<Record_t>> Runs(DirectoryBases.size());
+  std::atomic<uint64_t> Next = 0;
+  auto Worker = [&]() {
+    for (uint64_t Idx = Next++; Idx < DirectoryBases.size(); Idx = Next++) {
+      Runs[Idx] = La57 ? Collect<5>(DumpParser, DirectoryBases[Idx], Idx)
+                       : Collect<4>(DumpParser, DirectoryBases[Idx], Idx);
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  const uint64_t NumberWorkers = std::max(
+      uint64_t(1), std::min(NumberThreads, uint64_t(DirectoryBases.size())));
+  for (uint64_t Idx = 1; Idx < NumberWorkers; Idx++) {
+    Threads.emplace_back(Worker);
+  }
+
+  Worker();
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+
+  while (Runs.size() > 1) {
+    std::vector<std::vector<Record_t>> Merged;
+    for (uint64_t Idx = 0; Idx < Runs.size(); Idx += 2) {
+      if ((Idx + 1) == Runs.size()) {
+        Merged.emplace_back(std::move(Runs[Idx]));
+        break;
+      }
+
+      auto &Run = Merged.emplace_back();
+      Run.reserve(Runs[Idx].size() + Runs[Idx + 1].size());
+      std::merge(Runs[Idx].begin(), Runs[Idx].end(), Runs[Idx + 1].begin(),
+                 Runs[Idx + 1].end(), std::back_inserter(Run));
+      Runs[Idx] = {};
+      Runs[Idx + 1] = {};
+    }
+
+    Runs = std::move(Merged);
+  }
+
+  return Index_t(DirectoryBases,
+                 Runs.empty() ? std::span<const Record_t>() : Runs[0]);
+}
+
+//
+// Answer a query and append the result to Out. A query is either a physical
+// address, in which case every mapping of its page is listed, or "aliases"
+// which lists the physical ranges mapped writable and executable along with
+// the mappings of their first page.
+//
+
+inline void Answer(const Index_t &Index, const std::string &Query,
+                   std::string &Out) {
+  auto Print = [&](const uint64_t Pa, const std::string_view Prefix) {
+    const auto &Mappings = Index.Find(Pa);
+    if (Mappings.empty()) {
+      fmt::format_to(std::back_inserter(Out), "{}{:#x} unmapped\n", Prefix,
+                     Pa);
+    }
+
+    for (const auto &Mapping : Mappings) {
+      fmt::format_to(std::back_inserter(Out), "{}{:#x} {:#x} {:#018x} {} {}\n",
+                     Prefix, Pa, Mapping.DirectoryBase, Mapping.Va,
+                     ptables::ToString(Mapping.Protection),
+                     ptables::ToString(Mapping.Type));
+    }
+  };
+
+  if (Query != "aliases") {
+    Print(page::Align(strtoull(Query.c_str(), nullptr, 0)), "");
+    return;
+  }
+
+  for (const auto &Alias : Index.Aliases()) {
+    fmt::format_to(std::back_inserter(Out), "{:#x}-{:#x} aliased\n",
+                   Alias.Pfn * page::Size,
+                   (Alias.Pfn + Alias.NumberPages) * page::Size);
+    Print(Alias.Pfn * page::Size, "  ");
+  }
+}
+
+} // namespace clairvoyance::rmap
@@ -0,0 +1,373 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include "reversemap.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace clairvoyance::search {
+
+//
+// Parse a pattern written in hexadecimal, like "4d5a9000"; spaces are
+// ignored.
+//
+
+inline bool ParsePattern(const std::string_view Text,
+                         std::vector<uint8_t> &Pattern) {
+  Pattern.clear();
+  auto Nibble = [](const char C) -> int {
+    if (C >= '0' && C <= '9') {
+      return C - '0';
+    }
+
+    if (C >= 'a' && C <= 'f') {
+      return C - 'a' + 10;
+    }
+
+    if (C >= 'A' && C <= 'F') {
+      return C - 'A' + 10;
+    }
+
+    return -1;
+  };
+
+  std::string_view Rest = Text;
+  while (!Rest.empty()) {
+    if (Rest.front() == ' ') {
+      Rest.remove_prefix(1);
+      continue;
+    }
+
+    if (Rest.size() < 2 || Nibble(Rest[0]) < 0 || Nibble(Rest[1]) < 0) {
+      return false;
+    }
+
+    Pattern.push_back(uint8_t((Nibble(Rest[0]) << 4) | Nibble(Rest[1])));
+    Rest.remove_prefix(2);
+  }
+
+  return !Pattern.empty() && Pattern.size() <= page::Size;
+}
+
+//
+// A multi-pattern matcher. The patterns are bucketed by their first byte;
+// a prefilter finds the positions of the buffer holding one of the first
+// bytes and the patterns of that bucket are compared there. With AVX2 and at
+// most MaxVectorBytes distinct first bytes, the prefilter compares 32 bytes
+// at a time against every one of them; otherwise it looks every byte up in
+// a table.
+//
+
+class Matcher_t {
+  std::vector<std::vector<uint8_t>> Patterns_;
+  std::array<std::vector<uint32_t>, 256> Buckets_;
+  std::vector<uint8_t> FirstBytes_;
+  uint64_t MaxLength_ = 0;
+
+  static constexpr uint64_t MaxVectorBytes = 8;
+
+  //
+  // Compare the patterns starting with Buffer[Offset].
+  //
+
+  template <typename OnMatch_t>
+  void Verify(const uint8_t *Buffer, const uint64_t Size, const uint64_t Offset,
+              OnMatch_t &&OnMatch) const {
+    for (const uint32_t PatternIdx : Buckets_[Buffer[Offset]]) {
+      const auto &Pattern = Patterns_[PatternIdx];
+      if (Pattern.size() <= (Size - Offset) &&
+          memcmp(&Buffer[Offset], Pattern.data(), Pattern.size()) == 0) {
+        OnMatch(Offset, PatternIdx);
+      }
+    }
+  }
+
+public:
+  explicit Matcher_t(std::vector<std::vector<uint8_t>> Patterns)
+      : Patterns_(std::move(Patterns)) {
+    for (uint32_t PatternIdx = 0; PatternIdx < Patterns_.size();
+         PatternIdx++) {
+      const auto &Pattern = Patterns_[PatternIdx];
+      auto &Bucket = Buckets_[Pattern.front()];
+      if (Bucket.empty()) {
+        FirstBytes_.push_back(Pattern.front());
+      }
+
+      Bucket.push_back(PatternIdx);
+      MaxLength_ = std::max(MaxLength_, uint64_t(Pattern.size()));
+    }
+  }
+
+  const std::vector<std::vector<uint8_t>> &Patterns() const {
+    return Patterns_;
+  }
+
+  uint64_t MaxLength() const { return MaxLength_; }
+
+  //
+  // Invoke OnMatch(Offset, PatternIdx) for every pattern found in the buffer
+  // starting before Limit; the patterns have to fit in the buffer.
+  //
+
+  template <typename OnMatch_t>
+  void Scan(const uint8_t *Buffer, const uint64_t Size, const uint64_t Limit,
+            OnMatch_t &&OnMatch) const {
+    uint64_t Offset = 0;
+#if defined(__AVX2__)
+    if (FirstBytes_.size() <= MaxVectorBytes) {
+      __m256i Needles[MaxVectorBytes];
+      for (uint64_t Idx = 0; Idx < FirstBytes_.size(); Idx++) {
+        Needles[Idx] = _mm256_set1_epi8(char(FirstBytes_[Idx]));
+      }
+
+      for (; (Offset + 32) <= Limit; Offset += 32) {
+        const __m256i Bytes =
+            _mm256_loadu_si256((const __m256i *)&Buffer[Offset]);
+        __m256i Candidates = _mm256_setzero_si256();
+        for (uint64_t Idx = 0; Idx < FirstBytes_.size(); Idx++) {
+          Candidates = _mm256_or_si256(
+              Candidates, _mm256_cmpeq_epi8(Bytes, Needles[Idx]));
+        }
+
+        uint32_t Mask = uint32_t(_mm256_movemask_epi8(Candidates));
+        while (Mask != 0) {
+          Verify(Buffer, Size, Offset + std::countr_zero(Mask), OnMatch);
+          Mask &= Mask - 1;
+        }
+      }
+    }
+#endif
+
+    for (; Offset < Limit; Offset++) {
+      if (!Buckets_[Buffer[Offset]].empty()) {
+        Verify(Buffer, Size, Offset, OnMatch);
+      }
+    }
+  }
+};
+
+//
+// A pattern found at Va, in a page with Protection.
+//
+
+struct Hit_t {
+  uint64_t Va = 0;
+  uint32_t Pattern = 0;
+  ptables::Protection_t Protection = ptables::Protection_t::None;
+
+  bool operator<(const Hit_t &Other) const {
+    return Va < Other.Va || (Va == Other.Va && Pattern < Other.Pattern);
+  }
+};
+
+//
+// A 4KB page mapped by the directory base.
+//
+
+struct Page_t {
+  uint64_t Va = 0;
+  uint64_t Pa = 0;
+  ptables::Protection_t Protection = ptables::Protection_t::None;
+};
+
+//
+// Collect the mapped pages of a directory base, in VA order.
+//
+
+template <uint64_t NumberLevels>
+std::vector<Page_t> Collect(const kdmpparser::KernelDumpParser &DumpParser,
+                            const uint64_t DirectoryBase) {
+  std::vector<Page_t> Pages;
+  ptables::BasicPageTableWalker_t<NumberLevels> Walker(DumpParser,
+                                                       DirectoryBase);
+  ptables::EntryBatch_t Batch;
+  while (const uint64_t Size = Walker.NextBatch(Batch)) {
+    for (uint64_t Idx = 0; Idx < Size; Idx++) {
+      const uint64_t NumberPages = rmap::NumberPages(Batch.Types[Idx]);
+      const uint64_t Pa = page::Align(Batch.Pas[Idx]);
+      for (uint64_t Page = 0; Page < NumberPages; Page++) {
+        Pages.push_back({Batch.Vas[Idx] + (Page * page::Size),
+                         Pa + (Page * page::Size), Batch.Protections[Idx]});
+      }
+    }
+  }
+
+  return Pages;
+}
+
+//
+// Search the mapped memory of a directory base for patterns. The walk hands
+// out the physical page behind every virtual page, and every physical page is
+// scanned once however many times it is mapped; its hits are reported at all
+// of its virtual addresses. The patterns straddling two virtual pages are
+// found by scanning the junction of every pair of contiguous virtual pages.
+// The work is spread across threads; the hits are sorted by address.
+//
+
+template <uint64_t NumberLevels>
+std::vector<Hit_t> Search(const kdmpparser::KernelDumpParser &DumpParser,
+                          const uint64_t DirectoryBase,
+                          const Matcher_t &Matcher,
+                          const uint64_t NumberThreads) {
+  const auto Pages = Collect<NumberLevels>(DumpParser, DirectoryBase);
+  if (Pages.empty()) {
+    return {};
+  }
+
+  //
+  // Group the virtual pages by physical page.
+  //
+
+  std::vector<uint32_t> ByPa(Pages.size());
+  for (uint32_t Idx = 0; Idx < ByPa.size(); Idx++) {
+    ByPa[Idx] = Idx;
+  }
+
+  std::sort(ByPa.begin(), ByPa.end(), [&](const uint32_t A, const uint32_t B) {
+    return Pages[A].Pa < Pages[B].Pa || (Pages[A].Pa == Pages[B].Pa && A < B);
+  });
+
+  std::vector<uint64_t> Groups;
+  for (uint64_t Idx = 0; Idx < ByPa.size(); Idx++) {
+    if (Idx == 0 || Pages[ByPa[Idx]].Pa != Pages[ByPa[Idx - 1]].Pa) {
+      Groups.push_back(Idx);
+    }
+  }
+
+  Groups.push_back(ByPa.size());
+
+  //
+  // The junctions are made of the last bytes of a page followed by the first
+  // bytes of the next one; only the matches starting in the first page and
+  // ending in the second one are reported there.
+  //
+
+  const uint64_t Overlap = Matcher.MaxLength() - 1;
+  std::mutex HitsLock;
+  std::vector<Hit_t> Hits;
+  constexpr uint64_t PagesPerChunk = 0x100;
+  std::atomic<uint64_t> NextChunk = 0;
+  const uint64_t NumberGroups = Groups.size() - 1;
+  const uint64_t NumberChunks =
+      ((NumberGroups + PagesPerChunk - 1) / PagesPerChunk) +
+      ((Pages.size() + PagesPerChunk - 1) / PagesPerChunk);
+
+  auto ScanGroup = [&](const uint64_t GroupIdx, std::vector<Hit_t> &Local) {
+    const uint64_t Pa = Pages[ByPa[Groups[GroupIdx]]].Pa;
+    const uint8_t *Page = DumpParser.GetPhysicalPage(Pa);
+    if (Page == nullptr) {
+      return;
+    }
+
+    Matcher.Scan(Page, page::Size, page::Size,
+                 [&](const uint64_t Offset, const uint32_t PatternIdx) {
+                   for (uint64_t Idx = Groups[GroupIdx];
+                        Idx < Groups[GroupIdx + 1]; Idx++) {
+                     const Page_t &Mapping = Pages[ByPa[Idx]];
+                     Local.push_back(
+                         {Mapping.Va + Offset, PatternIdx, Mapping.Protection});
+                   }
+                 });
+
+    DumpParser.ReleasePhysicalPage(Pa);
+  };
+
+  auto ScanJunction = [&](const uint64_t PageIdx, std::vector<Hit_t> &Local,
+                          std::vector<uint8_t> &Junction) {
+    const Page_t &First = Pages[PageIdx];
+    const Page_t &Second = Pages[PageIdx + 1];
+    if (Overlap == 0 || (First.Va + page::Size) != Second.Va) {
+      return;
+    }
+
+    const uint8_t *FirstPage = DumpParser.GetPhysicalPage(First.Pa);
+    if (FirstPage == nullptr) {
+      return;
+    }
+
+    memcpy(Junction.data(), FirstPage + page::Size - Overlap, Overlap);
+    DumpParser.ReleasePhysicalPage(First.Pa);
+    const uint8_t *SecondPage = DumpParser.GetPhysicalPage(Second.Pa);
+    if (SecondPage == nullptr) {
+      return;
+    }
+
+    memcpy(Junction.data() + Overlap, SecondPage, Overlap);
+    DumpParser.ReleasePhysicalPage(Second.Pa);
+    Matcher.Scan(Junction.data(), Junction.size(), Overlap,
+                 [&](const uint64_t Offset, const uint32_t PatternIdx) {
+                   const uint64_t Length =
+                       Matcher.Patterns()[PatternIdx].size();
+                   if ((Offset + Length) > Overlap) {
+                     Local.push_back({First.Va + page::Size - Overlap + Offset,
+                                      PatternIdx, First.Protection});
+                   }
+                 });
+  };
+
+  auto Worker = [&]() {
+    std::vector<Hit_t> Local;
+    std::vector<uint8_t> Junction(Overlap * 2);
+    const uint64_t GroupChunks =
+        (NumberGroups + PagesPerChunk - 1) / PagesPerChunk;
+    for (uint64_t ChunkIdx = NextChunk++; ChunkIdx < NumberChunks;
+         ChunkIdx = NextChunk++) {
+      if (ChunkIdx < GroupChunks) {
+        const uint64_t First = ChunkIdx * PagesPerChunk;
+        const uint64_t Last = std::min(First + PagesPerChunk, NumberGroups);
+        for (uint64_t GroupIdx = First; GroupIdx < Last; GroupIdx++) {
+          ScanGroup(GroupIdx, Local);
+        }
+      } else {
+        const uint64_t First = (ChunkIdx - GroupChunks) * PagesPerChunk;
+        const uint64_t Last =
+            std::min(First + PagesPerChunk, uint64_t(Pages.size() - 1));
+        for (uint64_t PageIdx = First; PageIdx < Last; PageIdx++) {
+          ScanJunction(PageIdx, Local, Junction);
+        }
+      }
+    }
+
+    std::scoped_lock Guard(HitsLock);
+    Hits.insert(Hits.end(), Local.begin(), Local.end());
+  };
+
+  std::vector<std::thread> Threads;
+  const uint64_t NumberWorkers =
+      std::max(uint64_t(1), std::min(NumberThreads, NumberChunks));
+  for (uint64_t Idx = 1; Idx < NumberWorkers; Idx++) {
+    Threads.emplace_back(Worker);
+  }
+
+  Worker();
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+
+  std::sort(Hits.begin(), Hits.end());
+  return Hits;
+}
+
+inline std::vector<Hit_t>
+Search(const kdmpparser::KernelDumpParser &DumpParser,
+       const uint64_t DirectoryBase, const Matcher_t &Matcher,
+       const uint64_t NumberThreads, const bool La57 = false) {
+  return La57 ? Search<5>(DumpParser, DirectoryBase, Matcher, NumberThreads)
+              : Search<4>(DumpParser, DirectoryBase, Matcher, NumberThreads);
+}
+
+} // namespace clairvoyance::search
@@ -0,0 +1,499 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include "query.h"
+#include "stats.h"
+#include "tape.h"
+#include "visualizer.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(LINUX)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace clairvoyance::server {
+
+namespace fs = std::filesystem;
+
+//
+// How much memory the open dumps and their tapes can use by default.
+//
+
+constexpr uint64_t DefaultMemoryBudget = uint64_t(4) << 30;
+
+//
+// The configuration of the server. The requests are abandoned once Deadline
+// has passed, and the clients are sent the progress of the walks if Progress
+// is set.
+//
+
+struct Config_t {
+  fs::path SocketPath;
+  uint64_t MemoryBudget = DefaultMemoryBudget;
+  uint64_t NumberThreads = 1;
+  kdmpparser::ReaderType_t Reader = kdmpparser::ReaderType_t::Mmap;
+  uint64_t CacheSize = kdmpparser::PageCache_t::DefaultNumberPages;
+  GapPolicy_t GapPolicy;
+  std::optional<std::chrono::duration<double>> Deadline;
+  bool Progress = false;
+};
+
+//
+// The server keeps the dumps it opened parsed, along with the tapes of the
+// address spaces it walked, so that the following requests about them are
+// answered without parsing or walking anything. The dumps are kept in least
+// recently used order, and the least recently used ones are closed when the
+// memory they use goes over the budget. Requests are read off a Unix socket,
+// one per line, and every response ends with an "ok" or an "error <reason>"
+// line. A request is abandoned when its client hangs up or its deadline
+// passes, and "progress <how far>" lines come before the response while the
+// address space gets walked if the progress is reported:
+//   - render <dump path> <page dir pa>|- [text|binary|png|ppm|tiles]: write
+//     the picture of an address space in the working directory of the server
+//     and respond with its path,
+//   - query <dump path> <page dir pa>|- <query>...: answer queries about an
+//     address space, see query::Answer,
+//   - stats: list the open dumps along with the memory they use,
+//   - close <dump path>: close a dump,
+//   - shutdown: stop the server.
+// A '-' directory base is the one from the dump header.
+//
+
+class Server_t {
+  //
+  // An address space that has been walked, and its index.
+  //
+
+  struct AddressSpace_t {
+    Visualizer_t Visu;
+    query::Index_t Index;
+    uint64_t MemoryUsage = 0;
+
+    explicit AddressSpace_t(const GapPolicy_t &Policy) : Visu(Policy) {}
+  };
+
+  //
+  // A parsed dump and the address spaces walked in it.
+  //
+
+  struct Dump_t {
+    std::string Path;
+    kdmpparser::KernelDumpParser Parser;
+    std::unordered_map<uint64_t, std::unique_ptr<AddressSpace_t>>
+        AddressSpaces;
+
+    uint64_t MemoryUsage() const {
+      uint64_t MemoryUsage = Parser.GetMemoryUsage();
+      for (const auto &[_, AddressSpace] : AddressSpaces) {
+        MemoryUsage += AddressSpace->MemoryUsage;
+      }
+
+      return MemoryUsage;
+    }
+  };
+
+  Config_t Config_;
+
+  //
+  // The open dumps, the most recently used first.
+  //
+
+  std::list<std::unique_ptr<Dump_t>> Dumps_;
+  bool Stop_ = false;
+
+  //
+  // What abandons the request being executed, and where its progress goes.
+  //
+
+  const ptables::Cancellation_t *Cancellation_ = nullptr;
+  Visualizer_t::Progress_t Progress_;
+
+  //
+  // Get a dump, parsing it if it isn't open already.
+  //
+
+  Dump_t *OpenDump(const std::string &DumpFile, std::string &Error) {
+    std::error_code Ec;
+    const std::string Path = fs::canonical(DumpFile, Ec).string();
+    if (Ec) {
+      Error = fmt::format("{}: {}", DumpFile, Ec.message());
+      return nullptr;
+    }
+
+    for (auto It = Dumps_.begin(); It != Dumps_.end(); It++) {
+      if ((*It)->Path == Path) {
+        Dumps_.splice(Dumps_.begin(), Dumps_, It);
+        return Dumps_.front().get();
+      }
+    }
+
+    auto Dump = std::make_unique<Dump_t>();
+    Dump->Path = Path;
+    if (!Dump->Parser.Parse(Path.c_str(), Config_.Reader, Config_.CacheSize,
+                            Config_.NumberThreads)) {
+      Error = fmt::format("Parse of {} failed", Path);
+      return nullptr;
+    }
+
+    Dumps_.emplace_front(std::move(Dump));
+    return Dumps_.front().get();
+  }
+
+  //
+  // Get an address space of a dump, walking it if it hasn't been already.
+  //
+
+  AddressSpace_t *OpenAddressSpace(Dump_t &Dump, const uint64_t DirectoryBase,
+                                   std::string &Error) {
+    const auto &It = Dump.AddressSpaces.find(DirectoryBase);
+    if (It != Dump.AddressSpaces.end()) {
+      return It->second.get();
+    }
+
+    if (Dump.Parser.GetPhysicalPage(DirectoryBase) == nullptr) {
+      Error = fmt::format("The page directory {:#x} is not mapped in the dump",
+                          DirectoryBase);
+      return nullptr;
+    }
+
+    Dump.Parser.ReleasePhysicalPage(DirectoryBase);
+    auto AddressSpace = std::make_unique<AddressSpace_t>(Config_.GapPolicy);
+    AddressSpace->Visu.AbandonOn(Cancellation_);
+    const bool Parsed = AddressSpace->Visu.Parse(
+        Dump.Parser, DirectoryBase, Config_.NumberThreads, nullptr, Progress_);
+    AddressSpace->Visu.AbandonOn(nullptr);
+    if (!Parsed) {
+      Error = fmt::format("The walk of {:#x} {}", DirectoryBase,
+                          Cancellation_ != nullptr &&
+                                  Cancellation_->Cancelled()
+                              ? "was abandoned"
+                              : "failed");
+      return nullptr;
+    }
+
+    const auto &Builder = AddressSpace->Visu.Builder();
+    AddressSpace->Index = query::Index_t(Builder);
+    AddressSpace->MemoryUsage =
+        (Builder.Tape().NumberRuns() * sizeof(Tape_t::Run_t)) +
+        (Builder.Regions().size() * sizeof(Region_t)) +
+        AddressSpace->Index.MemoryUsage();
+    return Dump.AddressSpaces.emplace(DirectoryBase, std::move(AddressSpace))
+        .first->second.get();
+  }
+
+  //
+  // Close the least recently used dumps until the memory used fits in the
+  // budget; the most recently used dump is always kept.
+  //
+
+  void Evict() {
+    uint64_t MemoryUsage = 0;
+    for (const auto &Dump : Dumps_) {
+      MemoryUsage += Dump->MemoryUsage();
+    }
+
+    while (MemoryUsage > Config_.MemoryBudget && Dumps_.size() > 1) {
+      const uint64_t DumpMemoryUsage = Dumps_.back()->MemoryUsage();
+      fmt::print("Closing {} ({} bytes)\n", Dumps_.back()->Path,
+                 DumpMemoryUsage);
+      MemoryUsage -= DumpMemoryUsage;
+      Dumps_.pop_back();
+    }
+  }
+
+  //
+  // Parse the directory base argument of a request.
+  //
+
+  static uint64_t DirectoryBase(const Dump_t &Dump, const std::string &Arg) {
+    return page::Align(Arg == "-" ? Dump.Parser.GetDirectoryTableBase()
+                                  : strtoull(Arg.c_str(), nullptr, 0));
+  }
+
+  //
+  // Handle a request; the response goes in Out.
+  //
+
+  bool Handle(const std::vector<std::string> &Args, std::string &Out,
+              std::string &Error) {
+    const std::string_view Command = Args.empty() ? "" : Args[0];
+    if (Command == "stats") {
+      for (const auto &Dump : Dumps_) {
+        fmt::format_to(std::back_inserter(Out), "{} {} bytes, {} tapes\n",
+                       Dump->Path, Dump->MemoryUsage(),
+                       Dump->AddressSpaces.size());
+      }
+
+      return true;
+    }
+
+    if (Command == "shutdown") {
+      Stop_ = true;
+      return true;
+    }
+
+    if (Command == "close" && Args.size() == 2) {
+      std::error_code Ec;
+      const std::string Path = fs::canonical(Args[1], Ec).string();
+      Dumps_.remove_if([&](const std::unique_ptr<Dump_t> &Dump) {
+        return Dump->Path == Path;
+      });
+      return true;
+    }
+
+    const bool Render = Command == "render" && Args.size() >= 3 &&
+                        Args.size() <= 4;
+    const bool Query = Command == "query" && Args.size() >= 4;
+    if (!Render && !Query) {
+      Error = "Invalid request";
+      return false;
+    }
+
+    Dump_t *Dump = OpenDump(Args[1], Error);
+    if (Dump == nullptr) {
+      return false;
+    }
+
+    const uint64_t Base = DirectoryBase(*Dump, Args[2]);
+    AddressSpace_t *AddressSpace = OpenAddressSpace(*Dump, Base, Error);
+    if (AddressSpace == nullptr) {
+      return false;
+    }
+
+    if (Query) {
+      for (size_t Idx = 3; Idx < Args.size(); Idx++) {
+        query::Answer(AddressSpace->Index, Args[Idx], Out);
+      }
+
+      return true;
+    }
+
+    const std::string_view Name = Args.size() == 4 ? Args[3] : "text";
+    const OutputFormat_t Format = Name == "binary" ? OutputFormat_t::Binary
+                                  : Name == "png"  ? OutputFormat_t::Png
+                                  : Name == "ppm"  ? OutputFormat_t::Ppm
+                                  : Name == "tiles"
+                                      ? OutputFormat_t::Tiles
+                                      : OutputFormat_t::Text;
+    if (Format == OutputFormat_t::Text && Name != "text") {
+      Error = fmt::format("Unknown format {}", Name);
+      return false;
+    }
+
+    const fs::path OutFile =
+        fs::current_path() / fmt::format("{}-{:#x}.{}",
+                                         fs::path(Args[1]).stem().string(),
+                                         Base, Extension(Format));
+    AddressSpace->Visu.AbandonOn(Cancellation_);
+    const bool Written =
+        AddressSpace->Visu.Write(OutFile, Format, Config_.NumberThreads);
+    AddressSpace->Visu.AbandonOn(nullptr);
+    if (!Written) {
+      Error = fmt::format("Could not write {}", OutFile.string());
+      return false;
+    }
+
+    fmt::format_to(std::back_inserter(Out), "{}\n", OutFile.string());
+    return true;
+  }
+
+#if defined(LINUX)
+  //
+  // Send a whole buffer to a client.
+  //
+
+  static bool Send(const int Client, const std::string &Buffer) {
+    for (size_t Sent = 0; Sent < Buffer.size();) {
+      const ssize_t Amount = send(Client, Buffer.data() + Sent,
+                                  Buffer.size() - Sent, MSG_NOSIGNAL);
+      if (Amount < 0 && errno == EINTR) {
+        continue;
+      }
+
+      if (Amount <= 0) {
+        return false;
+      }
+
+      Sent += size_t(Amount);
+    }
+
+    return true;
+  }
+
+  //
+  // Execute a request of a client; it is abandoned if the client hangs up
+  // before its response is ready, which a watcher thread polls for.
+  //
+
+  std::string ExecuteFor(const int Client, const std::string &Line) {
+    constexpr int WatchIntervalMs = 100;
+    ptables::Cancellation_t Cancellation(Config_.Deadline);
+    std::atomic<bool> Finished = false;
+    std::thread Watcher([&]() {
+      pollfd Fd = {Client, 0, 0};
+      while (!Finished) {
+        if (poll(&Fd, 1, WatchIntervalMs) > 0 &&
+            (Fd.revents & (POLLHUP | POLLERR)) != 0) {
+          Cancellation.Cancel();
+          return;
+        }
+      }
+    });
+
+    stats::ProgressReport_t Report;
+    Visualizer_t::Progress_t Progress;
+    if (Config_.Progress) {
+      Progress = [&](const ptables::WalkProgress_t &WalkProgress) {
+        if (const auto &Line = Report.Line(WalkProgress)) {
+          Send(Client, fmt::format("progress {}\n", *Line));
+        }
+      };
+    }
+
+    std::string Response = Execute(Line, &Cancellation, Progress);
+    Finished = true;
+    Watcher.join();
+    return Response;
+  }
+
+  //
+  // Serve the requests of a client until it disconnects.
+  //
+
+  void ServeClient(const int Client) {
+    std::string Buffer;
+    char Chunk[0x1000];
+    while (!Stop_) {
+      const ssize_t Amount = recv(Client, Chunk, sizeof(Chunk), 0);
+      if (Amount < 0 && errno == EINTR) {
+        continue;
+      }
+
+      if (Amount <= 0) {
+        return;
+      }
+
+      Buffer.append(Chunk, size_t(Amount));
+      for (size_t End = Buffer.find('\n'); End != Buffer.npos && !Stop_;
+           End = Buffer.find('\n')) {
+        const std::string Line = Buffer.substr(0, End);
+        Buffer.erase(0, End + 1);
+        if (!Send(Client, ExecuteFor(Client, Line))) {
+          return;
+        }
+      }
+    }
+  }
+#endif
+
+public:
+  explicit Server_t(const Config_t &Config) : Config_(Config) {}
+
+  //
+  // Execute a request and get the response. The request is abandoned once
+  // Cancellation is cancelled, or once the deadline of the configuration has
+  // passed if there is none; Progress gets how far the walks went.
+  //
+
+  std::string Execute(const std::string &Line,
+                      const ptables::Cancellation_t *Cancellation = nullptr,
+                      const Visualizer_t::Progress_t &Progress = {}) {
+    const ptables::Cancellation_t Deadline(Config_.Deadline);
+    Cancellation_ = Cancellation != nullptr ? Cancellation : &Deadline;
+    Progress_ = Progress;
+    std::vector<std::string> Args;
+    for (size_t Begin = Line.find_first_not_of(" \t\r");
+         Begin != Line.npos; Begin = Line.find_first_not_of(" \t\r", Begin)) {
+      const size_t End = std::min(Line.find_first_of(" \t\r", Begin),
+                                  Line.size());
+      Args.emplace_back(Line.substr(Begin, End - Begin));
+      Begin = End;
+    }
+
+    std::string Out, Error;
+    const bool Success = Handle(Args, Out, Error);
+    Cancellation_ = nullptr;
+    Progress_ = {};
+    Evict();
+    Out += Success ? "ok\n" : fmt::format("error {}\n", Error);
+    return Out;
+  }
+
+  //
+  // Listen on the socket and serve clients, one at a time, until a shutdown
+  // request comes in.
+  //
+
+  bool Serve() {
+#if defined(LINUX)
+    const std::string Path = Config_.SocketPath.string();
+    sockaddr_un Address = {};
+    Address.sun_family = AF_UNIX;
+    if (Path.size() >= sizeof(Address.sun_path)) {
+      fmt::print("The socket path {} is too long\n", Path);
+      return false;
+    }
+
+    memcpy(Address.sun_path, Path.c_str(), Path.size());
+    const int Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Listener < 0) {
+      fmt::print("Could not create the socket: {}\n", strerror(errno));
+      return false;
+    }
+
+    unlink(Path.c_str());
+    if (bind(Listener, (const sockaddr *)&Address, sizeof(Address)) != 0 ||
+        listen(Listener, 16) != 0) {
+      fmt::print("Could not listen on {}: {}\n", Path, strerror(errno));
+      close(Listener);
+      return false;
+    }
+
+    fmt::print("Listening on {}\n", Path);
+    while (!Stop_) {
+      const int Client = accept(Listener, nullptr, nullptr);
+      if (Client < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        fmt::print("Could not accept a client: {}\n", strerror(errno));
+        break;
+      }
+
+      ServeClient(Client);
+      close(Client);
+    }
+
+    close(Listener);
+    unlink(Path.c_str());
+    return Stop_;
+#else
+    fmt::print("The server mode is only supported on Linux\n");
+    return false;
+#endif
+  }
+};
+
+} // namespace clairvoyance::server
@@ -0,0 +1,287 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "fmt/os.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include "reversemap.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace clairvoyance::sharing {
+
+namespace fs = std::filesystem;
+
+//
+// A user page of a directory base; Base is the index of the directory base.
+//
+
+struct Page_t {
+  uint64_t Pfn = 0;
+  uint64_t Va = 0;
+  uint32_t Base = 0;
+};
+
+//
+// Contiguous physical pages mapped by the same directory bases at contiguous
+// virtual addresses. Mappings holds the index of the directory base and the
+// virtual address of the first page for every one of them.
+//
+
+struct Range_t {
+  uint64_t Pfn = 0;
+  uint64_t NumberPages = 0;
+  std::vector<std::pair<uint32_t, uint64_t>> Mappings;
+};
+
+//
+// The physical pages shared by exactly the same directory bases.
+//
+
+struct Set_t {
+  std::vector<uint32_t> Bases;
+  uint64_t NumberPages = 0;
+  std::vector<Range_t> Ranges;
+};
+
+//
+// Sort the pages by PFN then by directory base with a LSD radix sort; only
+// the bytes that can be non-zero get a pass. The sort is stable, so the pages
+// of a directory base mapping the same PFN stay in VA order.
+//
+
+inline void RadixSort(std::vector<Page_t> &Pages, const uint64_t MaxPfn,
+                      const uint64_t MaxBase) {
+  std::vector<Page_t> Scratch(Pages.size());
+  auto Pass = [&](const auto &Key, const uint64_t Shift) {
+    std::array<uint64_t, 256> Offsets = {};
+    for (const auto &Page : Pages) {
+      Offsets[(Key(Page) >> Shift) & 0xff]++;
+    }
+
+    uint64_t Offset = 0;
+    for (auto &Count : Offsets) {
+      Offset += std::exchange(Count, Offset);
+    }
+
+    for (const auto &Page : Pages) {
+      Scratch[Offsets[(Key(Page) >> Shift) & 0xff]++] = Page;
+    }
+
+    Pages.swap(Scratch);
+  };
+
+  const auto Base = [](const Page_t &Page) { return uint64_t(Page.Base); };
+  const auto Pfn = [](const Page_t &Page) { return Page.Pfn; };
+  for (uint64_t Shift = 0; Shift < 64 && (MaxBase >> Shift) != 0; Shift += 8) {
+    Pass(Base, Shift);
+  }
+
+  for (uint64_t Shift = 0; Shift < 64 && (MaxPfn >> Shift) != 0; Shift += 8) {
+    Pass(Pfn, Shift);
+  }
+}
+
+//
+// Collect the user pages of a directory base, one per 4KB page.
+//
+
+template <uint64_t NumberLevels>
+std::vector<Page_t> Collect(const kdmpparser::KernelDumpParser &DumpParser,
+                            const uint64_t DirectoryBase, const uint32_t Base) {
+  std::vector<Page_t> Pages;
+  ptables::BasicPageTableWalker_t<NumberLevels> Walker(DumpParser,
+                                                       DirectoryBase);
+  ptables::EntryBatch_t Batch;
+  while (const uint64_t Size = Walker.NextBatch(Batch)) {
+    for (uint64_t Idx = 0; Idx < Size; Idx++) {
+      if (!ptables::IsUserAccessible(Batch.Protections[Idx])) {
+        continue;
+      }
+
+      const uint64_t NumberPages = rmap::NumberPages(Batch.Types[Idx]);
+      const uint64_t Pfn = (Batch.Pas[Idx] / page::Size) & ~(NumberPages - 1);
+      for (uint64_t Page = 0; Page < NumberPages; Page++) {
+        Pages.push_back(
+            {Pfn + Page, Batch.Vas[Idx] + (Page * page::Size), Base});
+      }
+    }
+  }
+
+  return Pages;
+}
+
+//
+// Page-align, sort and deduplicate directory bases; a directory base that is
+// passed twice would share all of its pages with itself.
+//
+
+inline std::vector<uint64_t>
+UniqueBases(const std::vector<uint64_t> &DirectoryBases) {
+  std::vector<uint64_t> Bases;
+  Bases.reserve(DirectoryBases.size());
+  for (const uint64_t DirectoryBase : DirectoryBases) {
+    Bases.emplace_back(page::Align(DirectoryBase));
+  }
+
+  std::sort(Bases.begin(), Bases.end());
+  Bases.erase(std::unique(Bases.begin(), Bases.end()), Bases.end());
+  return Bases;
+}
+
+//
+// Find the user pages backed by the same physical pages in several directory
+// bases, which have to be unique (see UniqueBases). The directory bases are
+// walked in parallel, then every mapped page is radix sorted by PFN which
+// puts the mappings of a physical page next to each other; this is linear in
+// the number of mapped pages instead of comparing the address spaces
+// pairwise. The sets are returned from the largest to the smallest.
+//
+
+inline std::vector<Set_t>
+FindSharedPages(const kdmpparser::KernelDumpParser &DumpParser,
+                const std::vector<uint64_t> &DirectoryBases,
+                const uint64_t NumberThreads, const bool La57 = false) {
+  std::vector<std::vector<Page_t>> PerBase(DirectoryBases.size());
+  std::atomic<uint64_t> Next = 0;
+  auto Worker = [&]() {
+    for (uint64_t Idx = Next++; Idx < DirectoryBases.size(); Idx = Next++) {
+      PerBase[Idx] = La57 ? Collect<5>(DumpParser, DirectoryBases[Idx], Idx)
+                          : Collect<4>(DumpParser, DirectoryBases[Idx], Idx);
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  const uint64_t NumberWorkers = std::max(
+      uint64_t(1), std::min(NumberThreads, uint64_t(DirectoryBases.size())));
+  for (uint64_t Idx = 1; Idx < NumberWorkers; Idx++) {
+    Threads.emplace_back(Worker);
+  }
+
+  Worker();
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+
+  std::vector<Page_t> Pages;
+  uint64_t MaxPfn = 0;
+  for (auto &BasePages : PerBase) {
+    for (const auto &Page : BasePages) {
+      MaxPfn = std::max(MaxPfn, Page.Pfn);
+    }
+
+    Pages.insert(Pages.end(), BasePages.begin(), BasePages.end());
+    BasePages = {};
+  }
+
+  RadixSort(Pages, MaxPfn, DirectoryBases.size());
+
+  //
+  // Walk the groups of pages mapping the same PFN; the ones mapped by at
+  // least two directory bases go in the set of their directory bases. A
+  // range is extended when the next PFN is mapped by the same directory
+  // bases at the next virtual addresses.
+  //
+
+  std::map<std::vector<uint32_t>, Set_t> Sets;
+  Range_t *Last = nullptr;
+  uint64_t LastPfn = 0;
+  for (uint64_t Idx = 0; Idx < Pages.size();) {
+    const uint64_t Pfn = Pages[Idx].Pfn;
+    const uint64_t First = Idx;
+    std::vector<uint32_t> Bases;
+    for (; Idx < Pages.size() && Pages[Idx].Pfn == Pfn; Idx++) {
+      if (Bases.empty() || Bases.back() != Pages[Idx].Base) {
+        Bases.push_back(Pages[Idx].Base);
+      }
+    }
+
+    if (Bases.size() < 2) {
+      Last = nullptr;
+      continue;
+    }
+
+    auto &Set = Sets[Bases];
+    if (Set.Bases.empty()) {
+      Set.Bases = Bases;
+    }
+
+    Set.NumberPages++;
+    const uint64_t Number = Idx - First;
+    const bool Extends =
+        Last != nullptr && !Set.Ranges.empty() && Last == &Set.Ranges.back() &&
+        LastPfn + 1 == Pfn && Last->Mappings.size() == Number &&
+        std::equal(Pages.begin() + First, Pages.begin() + Idx,
+                   Last->Mappings.begin(),
+                   [&](const Page_t &Page, const auto &Mapping) {
+                     return Page.Base == Mapping.first &&
+                            Page.Va == Mapping.second +
+                                           (Last->NumberPages * page::Size);
+                   });
+    if (Extends) {
+      Last->NumberPages++;
+    } else {
+      Range_t &Range = Set.Ranges.emplace_back();
+      Range.Pfn = Pfn;
+      Range.NumberPages = 1;
+      for (uint64_t PageIdx = First; PageIdx < Idx; PageIdx++) {
+        Range.Mappings.emplace_back(Pages[PageIdx].Base, Pages[PageIdx].Va);
+      }
+
+      Last = &Range;
+    }
+
+    LastPfn = Pfn;
+  }
+
+  std::vector<Set_t> Result;
+  Result.reserve(Sets.size());
+  for (auto &[Bases, Set] : Sets) {
+    Result.emplace_back(std::move(Set));
+  }
+
+  std::stable_sort(Result.begin(), Result.end(),
+                   [](const Set_t &A, const Set_t &B) {
+                     return A.NumberPages > B.NumberPages;
+                   });
+  return Result;
+}
+
+//
+// Write the sharing sets in a text file: a line for every set with its
+// directory bases, followed by a line for every range of physical pages with
+// the virtual address of its first page in every directory base.
+//
+
+inline bool Write(const fs::path &Filename, const std::vector<Set_t> &Sets,
+                  const std::vector<uint64_t> &DirectoryBases) {
+  auto Out = fmt::output_file(Filename.string());
+  for (const auto &Set : Sets) {
+    Out.print("{} pages shared by", Set.NumberPages);
+    for (const auto &Base : Set.Bases) {
+      Out.print(" {:#x}", DirectoryBases[Base]);
+    }
+
+    Out.print("\n");
+    for (const auto &Range : Set.Ranges) {
+      Out.print("  {:#x}-{:#x}", Range.Pfn * page::Size,
+                (Range.Pfn + Range.NumberPages) * page::Size);
+      for (const auto &[Base, Va] : Range.Mappings) {
+        Out.print(" {:#x}:{:#x}", DirectoryBases[Base], Va);
+      }
+
+      Out.print("\n");
+    }
+  }
+
+  return true;
+}
+
+} // namespace clairvoyance::sharing
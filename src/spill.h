@@ -0,0 +1,177 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <new>
+#include <string>
+
+#if defined(LINUX)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace clairvoyance {
+
+namespace fs = std::filesystem;
+
+//
+// A temporary file mapped in memory that hands out memory sequentially, so
+// that the data written in it only uses a budget of memory. The address space
+// of the mapping is reserved up front so that growing it never moves what is
+// in it, and the pages written so far are handed back to the OS once more
+// than the budget of them are resident; they are paged back in from the file
+// when they are read again, and the readers that go through them in order can
+// evict what they are done with. Spilling is only available on Linux.
+//
+
+class SpillFile_t {
+  static constexpr uint64_t PageSize = 0x1000;
+
+  //
+  // The address space reserved for the mapping; the file is grown in steps
+  // of FileGrowth bytes as the allocations come in.
+  //
+
+  static constexpr uint64_t ReservedBytes = uint64_t(64) << 30;
+  static constexpr uint64_t FileGrowth = uint64_t(16) << 20;
+
+  int Fd_ = -1;
+  uint8_t *Mapping_ = nullptr;
+  uint64_t FileSize_ = 0;
+  uint64_t Used_ = 0;
+  uint64_t BudgetBytes_ = 0;
+
+  //
+  // The offset in the file up to which the pages have been handed back.
+  //
+
+  uint64_t Evicted_ = 0;
+
+  //
+  // Hand the pages fully contained in [Begin, End) back to the OS; they are
+  // written back to the file first.
+  //
+
+  void EvictBytes(uint64_t Begin, uint64_t End) const {
+#if defined(LINUX)
+    Begin = (Begin + PageSize - 1) & ~(PageSize - 1);
+    End &= ~(PageSize - 1);
+    if (Begin >= End) {
+      return;
+    }
+
+    msync(Mapping_ + Begin, End - Begin, MS_ASYNC);
+    madvise(Mapping_ + Begin, End - Begin, MADV_DONTNEED);
+#else
+    (void)Begin;
+    (void)End;
+#endif
+  }
+
+public:
+  SpillFile_t() = default;
+  SpillFile_t(const SpillFile_t &) = delete;
+  SpillFile_t &operator=(const SpillFile_t &) = delete;
+
+  ~SpillFile_t() {
+#if defined(LINUX)
+    if (Mapping_ != nullptr) {
+      munmap(Mapping_, ReservedBytes);
+      close(Fd_);
+    }
+#endif
+  }
+
+  //
+  // Create the file in Directory; it is deleted right away so that it goes
+  // away whatever happens to the process.
+  //
+
+  bool Open(const fs::path &Directory, const uint64_t BudgetBytes) {
+#if defined(LINUX)
+    std::string Template = (Directory / "clairvoyance-XXXXXX").string();
+    const int Fd = mkstemp(Template.data());
+    if (Fd < 0) {
+      fmt::print("Could not create a spill file in {}\n", Directory.string());
+      return false;
+    }
+
+    unlink(Template.c_str());
+    void *Mapping = mmap(nullptr, ReservedBytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_NORESERVE, Fd, 0);
+    if (Mapping == MAP_FAILED) {
+      fmt::print("Could not map the spill file\n");
+      close(Fd);
+      return false;
+    }
+
+    Fd_ = Fd;
+    Mapping_ = (uint8_t *)Mapping;
+    BudgetBytes_ = BudgetBytes;
+    return true;
+#else
+    (void)Directory;
+    (void)BudgetBytes;
+    fmt::print("Spilling is not supported on this platform\n");
+    return false;
+#endif
+  }
+
+  uint64_t BudgetBytes() const { return BudgetBytes_; }
+
+  //
+  // Get Bytes (a multiple of the page size) of memory after the previous
+  // allocation, and hand back the pages written before the budget; like an
+  // allocator, this throws if the file can't grow.
+  //
+
+  void *Allocate(const uint64_t Bytes) {
+    const uint64_t End = Used_ + Bytes;
+#if defined(LINUX)
+    if (End > FileSize_) {
+      const uint64_t NewSize =
+          std::min(ReservedBytes, std::max(End, FileSize_ + FileGrowth));
+      if (End > NewSize || ftruncate(Fd_, off_t(NewSize)) != 0) {
+        fmt::print("Could not grow the spill file to {} bytes\n", End);
+        throw std::bad_alloc();
+      }
+
+      FileSize_ = NewSize;
+    }
+#endif
+
+    if ((Used_ - Evicted_) > (BudgetBytes_ / 2)) {
+      const uint64_t EvictEnd = Used_ - (BudgetBytes_ / 2);
+      EvictBytes(Evicted_, EvictEnd);
+      Evicted_ = EvictEnd & ~(PageSize - 1);
+    }
+
+    void *Memory = Mapping_ + Used_;
+    Used_ = End;
+    return Memory;
+  }
+
+  //
+  // Let the OS reclaim the memory in [Address, Address + Bytes).
+  //
+
+  void Evict(const void *Address, const uint64_t Bytes) const {
+    const uint64_t Begin = (const uint8_t *)Address - Mapping_;
+    EvictBytes(Begin, Begin + Bytes);
+  }
+
+  //
+  // Forget every allocation; the file is kept.
+  //
+
+  void Reset() {
+    EvictBytes(0, Used_);
+    Used_ = 0;
+    Evicted_ = 0;
+  }
+};
+
+} // namespace clairvoyance
@@ -0,0 +1,211 @@
+// Axel '0vercl0k' Souchet - October 15 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include "visualizer.h"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clairvoyance::stacks {
+
+using ptables::Protection_t;
+
+//
+// A kernel stack is a block of kernel read-write pages with unmapped guard
+// pages on both sides; the threads of a system all get stacks of the same
+// size, so the blocks of a size that doesn't recur enough are left out.
+//
+
+struct Limits_t {
+  uint64_t MinPages = 2;
+  uint64_t MaxPages = 32;
+  uint64_t MinRecurrences = 4;
+};
+
+//
+// A block of contiguous mapped pages; Candidate is set when they all are
+// kernel read-write.
+//
+
+struct Block_t {
+  uint64_t Va = 0;
+  uint64_t NumberPages = 0;
+  bool Candidate = false;
+
+  uint64_t End() const { return Va + (NumberPages * page::Size); }
+};
+
+//
+// Merge the ranges of a slice of the walk into blocks. A block is bounded by
+// unmapped pages once the next one starts, so the ones that can't be stacks
+// are dropped right away, except for the first and the last blocks of the
+// slice: they can continue in the neighbouring slices.
+//
+
+class Scanner_t {
+  std::vector<Block_t> Blocks_;
+  std::optional<Block_t> Open_;
+  Limits_t Limits_;
+
+public:
+  explicit Scanner_t(const Limits_t &Limits = {}) : Limits_(Limits) {}
+
+  void Add(const ptables::Range_t &Range) {
+    const bool Candidate = Range.Protection == Protection_t::KernelReadWrite;
+    if (Open_ && Open_->End() == Range.Va) {
+      Open_->NumberPages += Range.NumberPages;
+      Open_->Candidate &= Candidate;
+      return;
+    }
+
+    if (Open_ && (Blocks_.empty() || IsStack(*Open_, Limits_))) {
+      Blocks_.emplace_back(*Open_);
+    }
+
+    Open_ = Block_t{Range.Va, Range.NumberPages, Candidate};
+  }
+
+  //
+  // The blocks kept, in VA order, followed by the last one.
+  //
+
+  std::vector<Block_t> Drain() {
+    if (Open_) {
+      Blocks_.emplace_back(*Open_);
+      Open_.reset();
+    }
+
+    return std::move(Blocks_);
+  }
+
+  static bool IsStack(const Block_t &Block, const Limits_t &Limits) {
+    return Block.Candidate && Block.NumberPages >= Limits.MinPages &&
+           Block.NumberPages <= Limits.MaxPages;
+  }
+};
+
+//
+// The stacks of an address space, and how many blocks of every size were
+// found before the ones that don't recur were left out.
+//
+
+struct Report_t {
+  std::vector<Block_t> Stacks;
+  std::map<uint64_t, uint64_t> Sizes;
+
+  //
+  // The report as a line of JSON.
+  //
+
+  std::string ToJson(const uint64_t DirectoryBase) const {
+    std::vector<std::string> SizeFields;
+    for (const auto &[NumberPages, Count] : Sizes) {
+      SizeFields.emplace_back(fmt::format("\"{}\": {}", NumberPages, Count));
+    }
+
+    std::vector<std::string> StackFields;
+    for (const auto &Stack : Stacks) {
+      StackFields.emplace_back(fmt::format(
+          "{{\"va\": \"{:#x}\", \"end\": \"{:#x}\", \"pages\": {}}}",
+          Stack.Va, Stack.End(), Stack.NumberPages));
+    }
+
+    return fmt::format("{{\"directoryBase\": \"{:#x}\", \"sizes\": {{{}}}, "
+                       "\"stacks\": [{}]}}",
+                       DirectoryBase, fmt::join(SizeFields, ", "),
+                       fmt::join(StackFields, ", "));
+  }
+};
+
+//
+// Stitch the blocks of the slices back together in VA order, and close a
+// block once the next one doesn't start right where it ends.
+//
+
+class Detector_t {
+  std::vector<Block_t> Stacks_;
+  std::optional<Block_t> Open_;
+  Limits_t Limits_;
+
+  void Close() {
+    if (Open_ && Scanner_t::IsStack(*Open_, Limits_)) {
+      Stacks_.emplace_back(*Open_);
+    }
+
+    Open_.reset();
+  }
+
+public:
+  explicit Detector_t(const Limits_t &Limits) : Limits_(Limits) {}
+
+  void Push(const Block_t &Block) {
+    if (Open_ && Open_->End() == Block.Va) {
+      Open_->NumberPages += Block.NumberPages;
+      Open_->Candidate &= Block.Candidate;
+      return;
+    }
+
+    Close();
+    Open_ = Block;
+  }
+
+  Report_t Finish() {
+    Close();
+    Report_t Report;
+    for (const auto &Stack : Stacks_) {
+      Report.Sizes[Stack.NumberPages]++;
+    }
+
+    for (const auto &Stack : Stacks_) {
+      if (Report.Sizes[Stack.NumberPages] >= Limits_.MinRecurrences) {
+        Report.Stacks.emplace_back(Stack);
+      }
+    }
+
+    return Report;
+  }
+};
+
+//
+// Walk a directory base in parallel and find its kernel stacks; this only
+// goes through the ranges of the walk, like summary::Summarize. Nothing is
+// found if its top-level table is not in the dump.
+//
+
+template <uint64_t NumberLevels>
+Report_t Detect(const kdmpparser::KernelDumpParser &DumpParser,
+                const uint64_t DirectoryBase, const uint64_t NumberThreads,
+                const WalkOptions_t &Options, const Limits_t &Limits) {
+  Detector_t Detector(Limits);
+  ptables::SubtreeCache_t<Scanner_t> *NoCache = nullptr;
+  ptables::ParallelWalk<NumberLevels>(
+      DumpParser, DirectoryBase, NumberThreads, Scanner_t(Limits),
+      [](Scanner_t &Partial, const ptables::Range_t &Range) {
+        Partial.Add(Range);
+      },
+      [&](Scanner_t &&Partial) {
+        for (const auto &Block : Partial.Drain()) {
+          Detector.Push(Block);
+        }
+      },
+      NoCache, false, nullptr, Options.MaxTableVisits,
+      Options.SkipSelfReference, ptables::Va_t(Options.FirstVa),
+      ptables::Va_t(Options.LastVa));
+  return Detector.Finish();
+}
+
+inline Report_t Detect(const kdmpparser::KernelDumpParser &DumpParser,
+                       const uint64_t DirectoryBase,
+                       const uint64_t NumberThreads,
+                       const WalkOptions_t &Options, const Limits_t &Limits) {
+  return Options.La57 ? Detect<5>(DumpParser, DirectoryBase, NumberThreads,
+                                  Options, Limits)
+                      : Detect<4>(DumpParser, DirectoryBase, NumberThreads,
+                                  Options, Limits);
+}
+
+} // namespace clairvoyance::stacks
@@ -0,0 +1,159 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "fmt/os.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace clairvoyance::stats {
+
+namespace fs = std::filesystem;
+namespace chrono = std::chrono;
+
+//
+// Measure how long a phase takes.
+//
+
+class Stopwatch_t {
+  chrono::steady_clock::time_point Start_ = chrono::steady_clock::now();
+
+public:
+  double Seconds() const {
+    return chrono::duration<double>(chrono::steady_clock::now() - Start_)
+        .count();
+  }
+};
+
+//
+// Turn the progress of a walk into a line at most every Interval seconds,
+// with an estimate of the time left out of the fraction of the top-level
+// entries done so far.
+//
+
+class ProgressReport_t {
+  Stopwatch_t Stopwatch_;
+  double LastReport_ = 0;
+
+public:
+  static constexpr double Interval = 1;
+
+  std::optional<std::string> Line(const ptables::WalkProgress_t &Progress) {
+    const double Seconds = Stopwatch_.Seconds();
+    if ((Seconds - LastReport_) < Interval) {
+      return std::nullopt;
+    }
+
+    LastReport_ = Seconds;
+    const double Fraction = Progress.Fraction();
+    const std::string Eta =
+        Fraction > 0 ? fmt::format("{:.0f}s", Seconds * (1 - Fraction) /
+                                                  Fraction)
+                     : "?";
+    return fmt::format("{}/{} top-level entries, {} pages, ETA {}",
+                       Progress.TopIdx, Progress.NumberTopEntries,
+                       Progress.NumberPages, Eta);
+  }
+};
+
+//
+// What the rendering of a directory base went through: how long the walk
+// (the build of the tape) and the write took, what the walk visited and how
+// many gap pages got drawn.
+//
+
+struct DirectoryBase_t {
+  uint64_t DirectoryBase = 0;
+  double WalkSeconds = 0;
+  double WriteSeconds = 0;
+  ptables::WalkStats_t Walk;
+  uint64_t NumberGapPages = 0;
+};
+
+//
+// What the rendering of a dump went through; it is written as JSON so that
+// the slow dumps can be spotted by machines.
+//
+
+struct Report_t {
+  double MapSeconds = 0;
+  double PhysmemSeconds = 0;
+  std::vector<DirectoryBase_t> DirectoryBases;
+
+  void SetParseStats(const kdmpparser::ParseStats_t &Stats) {
+    MapSeconds = chrono::duration<double>(Stats.Map).count();
+    PhysmemSeconds = chrono::duration<double>(Stats.Physmem).count();
+  }
+
+  bool Write(const fs::path &Filename, const fs::path &DumpFile) const {
+    DirectoryBase_t Total;
+    for (const auto &DirectoryBase : DirectoryBases) {
+      Total.WalkSeconds += DirectoryBase.WalkSeconds;
+      Total.WriteSeconds += DirectoryBase.WriteSeconds;
+      Total.Walk += DirectoryBase.Walk;
+      Total.NumberGapPages += DirectoryBase.NumberGapPages;
+    }
+
+    auto File = fmt::output_file(Filename.string());
+    File.print("{{\n  \"dump\": \"{}\",\n  \"phases\": {{\"map\": {:.6f}, "
+               "\"physmem\": {:.6f}, \"walk\": {:.6f}, \"write\": {:.6f}}},\n",
+               Escape(DumpFile.string()), MapSeconds, PhysmemSeconds,
+               Total.WalkSeconds, Total.WriteSeconds);
+    File.print("  \"counters\": {},\n", Counters(Total));
+    File.print("  \"directoryBases\": [\n");
+    for (uint64_t Idx = 0; Idx < DirectoryBases.size(); Idx++) {
+      const auto &DirectoryBase = DirectoryBases[Idx];
+      File.print("    {{\"directoryBase\": \"{:#x}\", \"phases\": {{\"walk\": "
+                 "{:.6f}, \"write\": {:.6f}}}, \"counters\": {}}}{}\n",
+                 DirectoryBase.DirectoryBase, DirectoryBase.WalkSeconds,
+                 DirectoryBase.WriteSeconds, Counters(DirectoryBase),
+                 (Idx + 1) < DirectoryBases.size() ? "," : "");
+    }
+
+    File.print("  ]\n}}\n");
+    return true;
+  }
+
+private:
+  static std::string Counters(const DirectoryBase_t &DirectoryBase) {
+    const auto &Walk = DirectoryBase.Walk;
+    const auto &Missing = Walk.NumberMissingTables;
+    return fmt::format(
+        "{{\"tables\": {}, \"missingPml4s\": {}, \"missingPdpts\": {}, "
+        "\"missingPds\": {}, \"missingPts\": {}, \"hugeEntries\": {}, "
+        "\"largeEntries\": {}, \"normalEntries\": {}, "
+        "\"duplicateTables\": {}, \"selfReferences\": {}, "
+        "\"gapPages\": {}}}",
+        Walk.NumberTables, Missing[0], Missing[1], Missing[2], Missing[3],
+        Walk.NumberEntriesOf(ptables::PageType_t::Huge),
+        Walk.NumberEntriesOf(ptables::PageType_t::Large),
+        Walk.NumberEntriesOf(ptables::PageType_t::Normal),
+        Walk.NumberDuplicateTables, Walk.NumberSelfReferences,
+        DirectoryBase.NumberGapPages);
+  }
+
+  //
+  // Escape the backslashes and quotes of a path.
+  //
+
+  static std::string Escape(const std::string_view String) {
+    std::string Escaped;
+    for (const char C : String) {
+      if (C == '\\' || C == '"') {
+        Escaped.push_back('\\');
+      }
+
+      Escaped.push_back(C);
+    }
+
+    return Escaped;
+  }
+};
+
+} // namespace clairvoyance::stats
@@ -0,0 +1,423 @@
+// Axel '0vercl0k' Souchet - October 15 2026
+#pragma once
+#include "binaryformat.h"
+#include "fmt/format.h"
+#include "pagetables.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace clairvoyance::store {
+
+namespace fs = std::filesystem;
+
+//
+// A store keeps binary .clairvoyance files of many dumps in a directory
+// without storing twice what they have in common. The runs of every region
+// are cut at every Window of address space, and every piece is a chunk
+// stored once under the hash of its content in chunks/; dumps of the same
+// build share most of their kernel half, so most of their chunks. A file is
+// described by a manifest in manifests/ holding its header, its regions and
+// the list of its chunks:
+//   - a ManifestHeader_t,
+//   - ManifestHeader_t::NumberRegions binary::Region_t entries,
+//   - ManifestHeader_t::NumberChunks ChunkRef_t entries, in order.
+// The labels section of a file, if there is one, is stored as a chunk of its
+// own. A run crossing a window is split in two pieces which get merged back
+// when the file is rebuilt, so the rebuilt file is identical to the one that
+// got stored. The regions of version 1 didn't have a scale (see
+// binary::Region_t).
+//
+
+constexpr uint64_t Window = uint64_t(1) << 30;
+constexpr uint32_t Magic = 0x53'56'4c'43; // 'CLVS'
+constexpr uint32_t Version = 2;
+
+using Hash_t = std::array<uint64_t, 2>;
+
+struct ManifestHeader_t {
+  uint32_t Magic = store::Magic;
+  uint32_t Version = store::Version;
+  uint64_t Width = 0;
+  uint64_t Height = 0;
+  uint64_t NumberRegions = 0;
+  uint64_t NumberChunks = 0;
+  uint64_t LabelsSize = 0;
+  Hash_t Labels = {};
+};
+
+static_assert(sizeof(ManifestHeader_t) == 0x40);
+
+struct ChunkRef_t {
+  uint64_t Region = 0;
+  uint64_t Size = 0;
+  Hash_t Hash = {};
+};
+
+static_assert(sizeof(ChunkRef_t) == 0x20);
+
+//
+// Hash the content of a chunk on 128 bits; two lanes go through the 8-byte
+// words of the content with different multipliers and get mixed at the end.
+//
+
+inline Hash_t Hash(std::span<const uint8_t> Bytes) {
+  const auto Mix = [](uint64_t Value) {
+    Value = (Value ^ (Value >> 30)) * 0xbf'58'47'6d'1c'e4'e5'b9ull;
+    Value = (Value ^ (Value >> 27)) * 0x94'd0'49'bb'13'31'11'ebull;
+    return Value ^ (Value >> 31);
+  };
+
+  uint64_t A = 0xcb'f2'9c'e4'84'22'23'25ull ^ Bytes.size();
+  uint64_t B = 0x9e'37'79'b9'7f'4a'7c'15ull + Bytes.size();
+  for (size_t Offset = 0; Offset < Bytes.size(); Offset += sizeof(uint64_t)) {
+    uint64_t Word = 0;
+    memcpy(&Word, Bytes.data() + Offset,
+           std::min(sizeof(Word), Bytes.size() - Offset));
+    A = std::rotl(A ^ Word, 29) * 0x00'00'01'00'00'00'01'b3ull;
+    B = std::rotl(B + (Word * 0xc2'b2'ae'3d'27'd4'eb'4full), 31) *
+        0x9e'37'79'b9'7f'4a'7c'15ull;
+  }
+
+  return {Mix(A ^ std::rotl(B, 17)), Mix(B ^ std::rotl(A, 41))};
+}
+
+//
+// What putting files in the store, or getting them out of it, went through.
+//
+
+struct Stats_t {
+  uint64_t NumberChunks = 0;
+  uint64_t NumberNewChunks = 0;
+  uint64_t NumberBytes = 0;
+  uint64_t NumberNewBytes = 0;
+};
+
+class Store_t {
+  struct HashHash_t {
+    size_t operator()(const Hash_t &Hash) const { return size_t(Hash[0]); }
+  };
+
+  using Chunks_t = std::unordered_map<Hash_t, std::vector<uint8_t>, HashHash_t>;
+
+  fs::path Root_;
+
+  //
+  // The chunks of the last file rebuilt; the next one only reads the chunks
+  // it doesn't share with it.
+  //
+
+  Chunks_t Last_;
+
+  Stats_t Stats_;
+
+  fs::path ChunkPath(const Hash_t &Hash) const {
+    const auto &Name = fmt::format("{:016x}{:016x}", Hash[0], Hash[1]);
+    return Root_ / "chunks" / Name.substr(0, 2) / Name;
+  }
+
+  fs::path ManifestPath(const std::string &Name) const {
+    return Root_ / "manifests" / (Name + ".manifest");
+  }
+
+  //
+  // Store a chunk unless it is already there; it is written in a temporary
+  // file first so that a chunk is either complete or missing.
+  //
+
+  bool PutChunk(std::span<const uint8_t> Bytes, Hash_t &Hash) {
+    Hash = store::Hash(Bytes);
+    Stats_.NumberChunks++;
+    Stats_.NumberBytes += Bytes.size();
+    const fs::path Path = ChunkPath(Hash);
+    std::error_code Ec;
+    if (fs::exists(Path, Ec)) {
+      return true;
+    }
+
+    fs::create_directories(Path.parent_path(), Ec);
+    fs::path Temporary = Path;
+    Temporary += ".tmp";
+    FILE *File = fopen(Temporary.string().c_str(), "wb");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Temporary.string());
+      return false;
+    }
+
+    const bool Written =
+        fwrite(Bytes.data(), 1, Bytes.size(), File) == Bytes.size();
+    if (fclose(File) != 0 || !Written) {
+      fmt::print("Could not write {}\n", Temporary.string());
+      return false;
+    }
+
+    fs::rename(Temporary, Path, Ec);
+    if (Ec) {
+      fmt::print("Could not rename {}\n", Temporary.string());
+      return false;
+    }
+
+    Stats_.NumberNewChunks++;
+    Stats_.NumberNewBytes += Bytes.size();
+    return true;
+  }
+
+  //
+  // Get a chunk out of the chunks of the last file, or read it from the
+  // store and check its hash.
+  //
+
+  const std::vector<uint8_t> *GetChunk(const Hash_t &Hash, const uint64_t Size,
+                                       const Chunks_t &Previous,
+                                       Chunks_t &Current) {
+    if (const auto &Chunk = Current.find(Hash); Chunk != Current.end()) {
+      return &Chunk->second;
+    }
+
+    Stats_.NumberChunks++;
+    Stats_.NumberBytes += Size;
+    if (const auto &Chunk = Previous.find(Hash); Chunk != Previous.end()) {
+      return &(Current[Hash] = Chunk->second);
+    }
+
+    const fs::path Path = ChunkPath(Hash);
+    std::ifstream File(Path, std::ios::binary);
+    std::vector<uint8_t> Bytes(Size);
+    if (!File.read((char *)Bytes.data(), Bytes.size()) ||
+        store::Hash(Bytes) != Hash) {
+      fmt::print("The chunk {} is missing or corrupt\n", Path.string());
+      return nullptr;
+    }
+
+    Stats_.NumberNewChunks++;
+    Stats_.NumberNewBytes += Size;
+    return &(Current[Hash] = std::move(Bytes));
+  }
+
+public:
+  explicit Store_t(const fs::path &Root) : Root_(Root) {}
+
+  //
+  // Put a binary .clairvoyance file in the store under Name.
+  //
+
+  bool Put(const fs::path &Filename, const std::string &Name) {
+    binary::Reader_t Reader;
+    if (!Reader.Read(Filename)) {
+      return false;
+    }
+
+    ManifestHeader_t Header;
+    Header.Width = Reader.Header().Width;
+    Header.Height = Reader.Header().Height;
+    Header.NumberRegions = Reader.Regions().size();
+    std::vector<ChunkRef_t> Refs;
+    std::vector<binary::Run_t> Piece;
+    auto Store = [&](const uint64_t RegionIdx) {
+      if (Piece.empty()) {
+        return true;
+      }
+
+      ChunkRef_t Ref;
+      Ref.Region = RegionIdx;
+      Ref.Size = Piece.size() * sizeof(binary::Run_t);
+      const bool Stored =
+          PutChunk({(const uint8_t *)Piece.data(), Ref.Size}, Ref.Hash);
+      Refs.emplace_back(Ref);
+      Piece.clear();
+      return Stored;
+    };
+
+    for (uint64_t RegionIdx = 0; RegionIdx < Reader.Regions().size();
+         RegionIdx++) {
+      const auto &Region = Reader.Regions()[RegionIdx];
+      const uint64_t PixelSize = Region.Scale * page::Size;
+      uint64_t Va = Region.Va;
+      for (binary::Run_t Run : Reader.Runs(Region)) {
+        while (Run.Length > 0) {
+          const uint64_t WindowEnd = (Va & ~(Window - 1)) + Window;
+          const uint64_t Length = std::min(
+              uint64_t(Run.Length),
+              std::max(uint64_t(1), (WindowEnd - Va) / PixelSize));
+          binary::Run_t Part = Run;
+          Part.Length = Length;
+          Piece.emplace_back(Part);
+          Run.Length = Run.Length - Length;
+          Va += Length * PixelSize;
+          if (Va >= WindowEnd && !Store(RegionIdx)) {
+            return false;
+          }
+        }
+      }
+
+      if (!Store(RegionIdx)) {
+        return false;
+      }
+    }
+
+    //
+    // The labels go in their own chunk.
+    //
+
+    if (!Reader.Labels().empty()) {
+      std::vector<uint8_t> Labels(
+          binary::LabelsSize(Reader.Labels(), Reader.LabelSpans().size()));
+      binary::EncodeLabels(Labels.data(), Reader.Labels(),
+                           Reader.LabelSpans());
+      Header.LabelsSize = Labels.size();
+      if (!PutChunk(Labels, Header.Labels)) {
+        return false;
+      }
+    }
+
+    //
+    // The manifest goes in last, so that it only points to chunks that are
+    // in the store.
+    //
+
+    Header.NumberChunks = Refs.size();
+    const fs::path Path = ManifestPath(Name);
+    std::error_code Ec;
+    fs::create_directories(Path.parent_path(), Ec);
+    FILE *File = fopen(Path.string().c_str(), "wb");
+    if (File == nullptr) {
+      fmt::print("Could not open {} for writing\n", Path.string());
+      return false;
+    }
+
+    const auto &Regions = Reader.Regions();
+    const bool Written =
+        fwrite(&Header, sizeof(Header), 1, File) == 1 &&
+        fwrite(Regions.data(), sizeof(binary::Region_t), Regions.size(),
+               File) == Regions.size() &&
+        fwrite(Refs.data(), sizeof(ChunkRef_t), Refs.size(), File) ==
+            Refs.size();
+    return fclose(File) == 0 && Written;
+  }
+
+  //
+  // Rebuild the binary .clairvoyance file stored under Name in Filename.
+  //
+
+  bool Get(const std::string &Name, const fs::path &Filename) {
+    const fs::path Path = ManifestPath(Name);
+    std::ifstream File(Path, std::ios::binary);
+    ManifestHeader_t Header;
+    if (!File.read((char *)&Header, sizeof(Header)) ||
+        Header.Magic != Magic || Header.Version == 0 ||
+        Header.Version > Version) {
+      fmt::print("{} is not a supported manifest\n", Path.string());
+      return false;
+    }
+
+    const size_t RegionSize =
+        Header.Version == 1 ? binary::RegionSize(3) : sizeof(binary::Region_t);
+    File.seekg(0, std::ios::end);
+    const uint64_t FileSize = uint64_t(File.tellg());
+    File.seekg(sizeof(Header));
+    if (Header.NumberRegions > FileSize || Header.NumberChunks > FileSize ||
+        (sizeof(Header) + (Header.NumberRegions * RegionSize) +
+         (Header.NumberChunks * sizeof(ChunkRef_t))) > FileSize) {
+      fmt::print("{} is truncated\n", Path.string());
+      return false;
+    }
+
+    std::vector<binary::Region_t> Regions(Header.NumberRegions);
+    std::vector<ChunkRef_t> Refs(Header.NumberChunks);
+    bool Truncated = false;
+    for (auto &Region : Regions) {
+      Truncated = Truncated || !File.read((char *)&Region, RegionSize);
+    }
+
+    if (Truncated ||
+        !File.read((char *)Refs.data(), Refs.size() * sizeof(ChunkRef_t))) {
+      fmt::print("{} is truncated\n", Path.string());
+      return false;
+    }
+
+    //
+    // Put the pieces back together; the runs that were split at a window
+    // are merged back by the writer.
+    //
+
+    const Chunks_t Previous = std::move(Last_);
+    Chunks_t Current;
+    binary::Writer_t Writer;
+    uint64_t RefIdx = 0;
+    for (uint64_t RegionIdx = 0; RegionIdx < Regions.size(); RegionIdx++) {
+      const auto &Region = Regions[RegionIdx];
+      Writer.BeginRegion(Region.Va, Region.Scale);
+      for (; RefIdx < Refs.size() && Refs[RefIdx].Region == RegionIdx;
+           RefIdx++) {
+        const auto &Ref = Refs[RefIdx];
+        const auto *Chunk = (Ref.Size % sizeof(binary::Run_t)) == 0
+                                ? GetChunk(Ref.Hash, Ref.Size, Previous,
+                                           Current)
+                                : nullptr;
+        if (Chunk == nullptr) {
+          return false;
+        }
+
+        for (uint64_t Offset = 0; Offset < Chunk->size();
+             Offset += sizeof(binary::Run_t)) {
+          binary::Run_t Run;
+          memcpy(&Run, Chunk->data() + Offset, sizeof(Run));
+          Writer.Append(ptables::Protection_t(Run.Protection), Run.Length,
+                        Run.Attributes);
+        }
+      }
+
+      Writer.Pad(Region.Padding);
+    }
+
+    if (RefIdx != Refs.size()) {
+      fmt::print("{} has chunks out of order\n", Path.string());
+      return false;
+    }
+
+    if (!Writer.Write(Filename, Header.Width, Header.Height)) {
+      return false;
+    }
+
+    //
+    // The labels section follows the document.
+    //
+
+    if (Header.LabelsSize > 0) {
+      const auto *Labels =
+          GetChunk(Header.Labels, Header.LabelsSize, Previous, Current);
+      FILE *Out = Labels != nullptr ? fopen(Filename.string().c_str(), "ab")
+                                    : nullptr;
+      if (Out == nullptr) {
+        return false;
+      }
+
+      const bool Written =
+          fwrite(Labels->data(), 1, Labels->size(), Out) == Labels->size();
+      if (fclose(Out) != 0 || !Written) {
+        return false;
+      }
+    }
+
+    if (!Writer.WriteIndex(Filename)) {
+      return false;
+    }
+
+    Last_ = std::move(Current);
+    return true;
+  }
+
+  const Stats_t &Stats() const { return Stats_; }
+};
+
+} // namespace clairvoyance::store
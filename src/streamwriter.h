@@ -0,0 +1,166 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "tape.h"
+#include "textformat.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace clairvoyance {
+
+namespace fs = std::filesystem;
+
+//
+// The stream writer encodes the text version of the .clairvoyance format in
+// its own thread while the tape is being built. Chunks of the tape are pushed
+// in a bounded queue, so a walk that is faster than the disk gets throttled
+// instead of piling up the whole tape in memory.
+//
+// The size of the curve is only known once the walk is over, so room is made
+// for the header at the beginning of the file and it gets written over at
+// the very end; it is padded with spaces.
+//
+
+class StreamWriter_t {
+  //
+  // The maximum number of chunks waiting to be written.
+  //
+
+  static constexpr size_t MaxChunks = 16;
+
+  //
+  // The room reserved for the "<width> <height>" line, new line included.
+  //
+
+  static constexpr size_t HeaderSize = 32;
+
+  FILE *File_ = nullptr;
+  std::thread Thread_;
+  std::mutex Lock_;
+  std::condition_variable NotEmpty_;
+  std::condition_variable NotFull_;
+  std::deque<TapeChunk_t> Queue_;
+  bool Closed_ = false;
+  bool Success_ = true;
+
+  //
+  // Encode every chunk that gets pushed until the writer is closed.
+  //
+
+  void Run() {
+    text::LineWriter_t Writer(File_);
+    while (true) {
+      TapeChunk_t Chunk;
+      {
+        std::unique_lock Guard(Lock_);
+        NotEmpty_.wait(Guard, [&]() { return Closed_ || !Queue_.empty(); });
+        if (Queue_.empty()) {
+          break;
+        }
+
+        Chunk = std::move(Queue_.front());
+        Queue_.pop_front();
+      }
+
+      NotFull_.notify_one();
+
+      auto Start = Chunk.Starts.begin();
+      for (uint64_t RunIdx = 0; RunIdx <= Chunk.Runs.size(); RunIdx++) {
+        for (; Start != Chunk.Starts.end() && Start->RunIdx == RunIdx;
+             Start++) {
+          Writer.Lines(Start->Padding, ptables::Protection_t::None);
+          Writer.Line(fmt::format("{:#x}", Start->Va));
+        }
+
+        if (RunIdx == Chunk.Runs.size()) {
+          break;
+        }
+
+        const auto &Run = Chunk.Runs[RunIdx];
+        Writer.Lines(Run.Length, Run.Prot());
+      }
+    }
+
+    if (!Writer.Flush()) {
+      Success_ = false;
+    }
+  }
+
+public:
+  ~StreamWriter_t() {
+    if (File_ != nullptr) {
+      Close(0, 0);
+    }
+  }
+
+  //
+  // Create the file and start the writer thread.
+  //
+
+  bool Open(const fs::path &Filename) {
+    File_ = fopen(Filename.string().c_str(), "wb");
+    if (File_ == nullptr) {
+      fmt::print("Could not open {} for writing\n", Filename.string());
+      return false;
+    }
+
+    const std::string Header(HeaderSize - 1, ' ');
+    if (fprintf(File_, "%s\n", Header.c_str()) < 0) {
+      Success_ = false;
+    }
+
+    Thread_ = std::thread([this]() { Run(); });
+    return true;
+  }
+
+  //
+  // Queue a chunk; this blocks if the writer is lagging behind.
+  //
+
+  void Push(TapeChunk_t &&Chunk) {
+    if (Chunk.Empty()) {
+      return;
+    }
+
+    {
+      std::unique_lock Guard(Lock_);
+      NotFull_.wait(Guard, [&]() { return Queue_.size() < MaxChunks; });
+      Queue_.emplace_back(std::move(Chunk));
+    }
+
+    NotEmpty_.notify_one();
+  }
+
+  //
+  // Wait for every chunk to be written, then write the header.
+  //
+
+  bool Close(const uint64_t Width, const uint64_t Height) {
+    {
+      std::scoped_lock Guard(Lock_);
+      Closed_ = true;
+    }
+
+    NotEmpty_.notify_one();
+    Thread_.join();
+
+    const auto &Header = fmt::format("{} {}", Width, Height);
+    if (fseek(File_, 0, SEEK_SET) != 0 ||
+        fprintf(File_, "%-*s", int(HeaderSize - 1), Header.c_str()) < 0) {
+      Success_ = false;
+    }
+
+    fclose(File_);
+    File_ = nullptr;
+    return Success_;
+  }
+};
+
+} // namespace clairvoyance
@@ -0,0 +1,132 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include "visualizer.h"
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace clairvoyance::summary {
+
+using ptables::Protection_t;
+
+//
+// How much of an address space is mapped with every protection: the number
+// of ranges and of pages. This is aggregated from the ranges of the walk, so
+// it is a lot cheaper than building a tape; a range crossing two slices of
+// the parallel walk counts as two.
+//
+
+struct Counters_t {
+  uint64_t NumberRanges = 0;
+  uint64_t NumberPages = 0;
+};
+
+class Summary_t {
+  static constexpr uint64_t NumberProtections =
+      uint64_t(Protection_t::KernelReadWriteExec) + 1;
+
+  std::array<Counters_t, NumberProtections> ByProtection_ = {};
+
+public:
+  void Add(const ptables::Range_t &Range) {
+    auto &Counters = ByProtection_[uint64_t(Range.Protection)];
+    Counters.NumberRanges++;
+    Counters.NumberPages += Range.NumberPages;
+  }
+
+  Summary_t &operator+=(const Summary_t &Other) {
+    for (uint64_t Idx = 0; Idx < NumberProtections; Idx++) {
+      ByProtection_[Idx].NumberRanges += Other.ByProtection_[Idx].NumberRanges;
+      ByProtection_[Idx].NumberPages += Other.ByProtection_[Idx].NumberPages;
+    }
+
+    return *this;
+  }
+
+  const Counters_t &Of(const Protection_t Protection) const {
+    return ByProtection_[uint64_t(Protection)];
+  }
+
+  //
+  // The totals of the user or kernel half: mapped, writable, executable and
+  // both writable and executable pages.
+  //
+
+  std::string Region(const bool User) const {
+    uint64_t NumberPages = 0, Writable = 0, Executable = 0, Rwx = 0;
+    for (uint64_t Idx = 1; Idx < NumberProtections; Idx++) {
+      const auto Protection = Protection_t(Idx);
+      if (ptables::IsUserAccessible(Protection) != User) {
+        continue;
+      }
+
+      const uint64_t Pages = ByProtection_[Idx].NumberPages;
+      const bool Write = ptables::IsWritable(Protection);
+      const bool Exec = ptables::IsExecutable(Protection);
+      NumberPages += Pages;
+      Writable += Write ? Pages : 0;
+      Executable += Exec ? Pages : 0;
+      Rwx += (Write && Exec) ? Pages : 0;
+    }
+
+    return fmt::format("{{\"pages\": {}, \"bytes\": {}, \"writablePages\": {}, "
+                       "\"executablePages\": {}, \"rwxPages\": {}}}",
+                       NumberPages, NumberPages * page::Size, Writable,
+                       Executable, Rwx);
+  }
+
+  //
+  // The summary as a line of JSON.
+  //
+
+  std::string ToJson(const uint64_t DirectoryBase) const {
+    std::string Protections;
+    for (uint64_t Idx = 1; Idx < NumberProtections; Idx++) {
+      const auto &Counters = ByProtection_[Idx];
+      Protections += fmt::format(
+          "{}\"{}\": {{\"ranges\": {}, \"pages\": {}}}", Idx > 1 ? ", " : "",
+          ptables::ToString(Protection_t(Idx)), Counters.NumberRanges,
+          Counters.NumberPages);
+    }
+
+    return fmt::format("{{\"directoryBase\": \"{:#x}\", \"user\": {}, "
+                       "\"kernel\": {}, \"protections\": {{{}}}}}",
+                       DirectoryBase, Region(true), Region(false), Protections);
+  }
+};
+
+//
+// Walk a directory base in parallel and summarize it; nothing is summarized
+// if its top-level table is not in the dump.
+//
+
+template <uint64_t NumberLevels>
+Summary_t Summarize(const kdmpparser::KernelDumpParser &DumpParser,
+                    const uint64_t DirectoryBase, const uint64_t NumberThreads,
+                    const WalkOptions_t &Options) {
+  Summary_t Summary;
+  ptables::SubtreeCache_t<Summary_t> *NoCache = nullptr;
+  ptables::ParallelWalk<NumberLevels>(
+      DumpParser, DirectoryBase, NumberThreads, Summary_t(),
+      [](Summary_t &Partial, const ptables::Range_t &Range) {
+        Partial.Add(Range);
+      },
+      [&](Summary_t &&Partial) { Summary += Partial; }, NoCache, false,
+      nullptr, Options.MaxTableVisits, Options.SkipSelfReference,
+      ptables::Va_t(Options.FirstVa), ptables::Va_t(Options.LastVa));
+  return Summary;
+}
+
+inline Summary_t Summarize(const kdmpparser::KernelDumpParser &DumpParser,
+                           const uint64_t DirectoryBase,
+                           const uint64_t NumberThreads,
+                           const WalkOptions_t &Options) {
+  return Options.La57
+             ? Summarize<5>(DumpParser, DirectoryBase, NumberThreads, Options)
+             : Summarize<4>(DumpParser, DirectoryBase, NumberThreads, Options);
+}
+
+} // namespace clairvoyance::summary
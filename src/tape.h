@@ -0,0 +1,787 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "chunked.h"
+#include "pagetables.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace clairvoyance {
+
+//
+// The tape is a succession of page protections; each one of them is a
+// distance on the curve. As huge and large pages expand into a lot of
+// identical pixels, the tape is stored as runs of identical protections. A
+// run also carries the attributes of its pages (see ptables::attr) when they
+// are recorded, so that they can be rendered without walking again. The runs
+// are stored in chunks that never move, so growing the tape doesn't copy it
+// and splicing a tape only moves its chunks; they can be spilled to a file
+// so that a tape doesn't use more than a budget of memory.
+//
+
+class Tape_t {
+public:
+  struct Run_t {
+    uint64_t Length : 48 = 0;
+    uint64_t Protection : 8 = 0;
+    uint64_t Attributes : 8 = 0;
+
+    constexpr ptables::Protection_t Prot() const {
+      return ptables::Protection_t(Protection);
+    }
+
+    //
+    // Do two runs describe the same pages?
+    //
+
+    constexpr bool SameAs(const Run_t &Other) const {
+      return Protection == Other.Protection && Attributes == Other.Attributes;
+    }
+  };
+
+  static_assert(sizeof(Run_t) == 8);
+
+private:
+  //
+  // The runs making up the tape.
+  //
+
+  using Runs_t = ChunkedVector_t<Run_t>;
+  Runs_t Runs_;
+
+  //
+  // The number of runs that have been drained out of the tape; run indexes
+  // are absolute so they keep counting them.
+  //
+
+  uint64_t FirstRun_ = 0;
+
+  //
+  // The total number of pixels in the tape.
+  //
+
+  uint64_t Size_ = 0;
+
+  //
+  // Is the next append allowed to extend the last run?
+  //
+
+  bool Mergeable_ = false;
+
+public:
+  //
+  // Append Length pixels of Protection at the end of the tape. This is O(1)
+  // regardless of the length.
+  //
+
+  void Append(const ptables::Protection_t Protection, const uint64_t Length,
+              const uint8_t Attributes = 0) {
+    if (Length == 0) {
+      return;
+    }
+
+    Size_ += Length;
+    Run_t Run;
+    Run.Length = Length;
+    Run.Protection = uint64_t(Protection);
+    Run.Attributes = Attributes;
+    if (Mergeable_ && Runs_.back().SameAs(Run)) {
+      Runs_.back().Length += Length;
+      return;
+    }
+
+    Runs_.emplace_back(Run);
+    Mergeable_ = true;
+  }
+
+  //
+  // Make sure the next append starts a new run; this is used to have region
+  // boundaries line up with run boundaries.
+  //
+
+  void Break() { Mergeable_ = false; }
+
+  //
+  // Keep the runs in a temporary file in Directory from now on, with at
+  // most BudgetBytes of them in memory.
+  //
+
+  bool Spill(const std::filesystem::path &Directory,
+             const uint64_t BudgetBytes) {
+    return Runs_.Spill(Directory, BudgetBytes);
+  }
+
+  //
+  // Let the runs in [Begin, End) be paged out if the tape is spilled; the
+  // readers going through the tape in order call this behind them.
+  //
+
+  void Evict(const uint64_t Begin, const uint64_t End) const {
+    Runs_.Evict(Begin - FirstRun_, End - FirstRun_);
+  }
+
+  //
+  // Empty the tape; the memory backing the runs is kept for the next one.
+  //
+
+  void Clear() {
+    Runs_.clear();
+    FirstRun_ = 0;
+    Size_ = 0;
+    Mergeable_ = false;
+  }
+
+  //
+  // Number of pixels in the tape.
+  //
+
+  uint64_t Size() const { return Size_; }
+
+  //
+  // Number of runs in the tape.
+  //
+
+  uint64_t NumberRuns() const { return FirstRun_ + Runs_.size(); }
+
+  //
+  // Index of the first run that hasn't been drained.
+  //
+
+  uint64_t FirstRun() const { return FirstRun_; }
+
+  //
+  // Can the last run still grow?
+  //
+
+  bool Mergeable() const { return Mergeable_; }
+
+  //
+  // Get the runs in [Begin, End).
+  //
+
+  Runs_t::Range_t Runs(const uint64_t Begin, const uint64_t End) const {
+    return Runs_.Range(Begin - FirstRun_, End - FirstRun_);
+  }
+
+  //
+  // Get a view of the runs that haven't been drained.
+  //
+
+  Runs_t::Range_t Runs() const { return Runs(FirstRun_, NumberRuns()); }
+
+  //
+  // Invoke Function with the contiguous spans of runs in [Begin, End).
+  //
+
+  template <typename Function_t>
+  void ForEachSpan(const uint64_t Begin, const uint64_t End,
+                   Function_t &&Function) const {
+    Runs_.ForEachSpan(Begin - FirstRun_, End - FirstRun_, Function);
+  }
+
+  //
+  // Get the runs that haven't been drained as a single span; they are moved
+  // to a single chunk first if needed.
+  //
+
+  std::span<const Run_t> Contiguous() { return Runs_.Contiguous(); }
+
+  //
+  // Move the runs up to End out of the tape.
+  //
+
+  std::vector<Run_t> Drain(const uint64_t End) {
+    const auto &Runs = Runs_.Range(0, End - FirstRun_);
+    std::vector<Run_t> Drained(Runs.begin(), Runs.end());
+    Runs_.EraseFront(End - FirstRun_);
+    FirstRun_ = End;
+    return Drained;
+  }
+
+  //
+  // Move the content of another tape at the end of this one. The first run
+  // of Other is merged with our last one if possible; the number of runs
+  // that got merged is returned.
+  //
+
+  uint64_t Splice(Tape_t &&Other) {
+    if (Other.Runs_.empty()) {
+      return 0;
+    }
+
+    uint64_t NumberMerged = 0;
+    const Run_t &First = Other.Runs_.front();
+    if (Mergeable_ && Runs_.back().SameAs(First)) {
+      Runs_.back().Length += First.Length;
+      Other.Runs_.EraseFront(1);
+      NumberMerged++;
+    }
+
+    Runs_.Splice(std::move(Other.Runs_));
+    Size_ += Other.Size_;
+    Mergeable_ = Other.Mergeable_;
+    Other = Tape_t();
+    return NumberMerged;
+  }
+};
+
+//
+// A region is a contiguous part of the tape that starts at Va. Regions end on
+// run boundaries. Padding is the number of empty pixels laid out between the
+// region and the next one; they are not stored in the tape. Every pixel of a
+// region stands for Scale pages.
+//
+
+struct Region_t {
+  uint64_t Va = 0;
+  uint64_t EndIdx = 0;
+  uint64_t EndRun = 0;
+  uint64_t Padding = 0;
+  uint64_t Scale = 1;
+};
+
+//
+// What a pixel stands for: a 4KB page, or a mapping (a 4KB page, a 2MB large
+// page or a 1GB huge page) so that the large and huge pages don't take 512
+// and 262144 pixels.
+//
+
+enum class Scaling_t { Page, Mapping };
+
+//
+// How the gaps in the address space are laid out: the gaps of up to
+// MaxGapPages pages are drawn entirely, and the larger ones start a new region
+// separated from the previous one by Padding empty pixels. With
+// Scaling_t::Mapping, the mappings of every size get their own regions, see
+// BasicTapeBuilder_t::Rescale.
+//
+
+struct GapPolicy_t {
+  static constexpr uint64_t DefaultMaxGapPages = 10'000;
+
+  uint64_t MaxGapPages = DefaultMaxGapPages;
+  uint64_t Padding = DefaultMaxGapPages + 1;
+  Scaling_t Scaling = Scaling_t::Page;
+};
+
+//
+// A chunk of runs drained out of a tape builder. Starts are the regions that
+// begin in the chunk: the index of their first run in Runs, their Va and the
+// padding that separates them from the previous region.
+//
+
+struct TapeChunk_t {
+  struct Start_t {
+    uint64_t RunIdx = 0;
+    uint64_t Va = 0;
+    uint64_t Padding = 0;
+  };
+
+  std::vector<Tape_t::Run_t> Runs;
+  std::vector<Start_t> Starts;
+
+  bool Empty() const { return Runs.empty() && Starts.empty(); }
+};
+
+//
+// The tape builder turns the entries returned by the page tables walker into
+// a tape and its regions. Builders can be partial: they only see a slice of
+// the address space, do not fill the gap preceding their first entry and get
+// spliced back, in order, into a complete builder. The verbosity policy
+// decides at compile time whether the mappings and the gaps get dumped.
+//
+
+template <typename Verbosity_t> class BasicTapeBuilder_t {
+  Tape_t Tape_;
+  std::vector<Region_t> Regions_;
+
+  //
+  // The region being built.
+  //
+
+  Region_t Region_;
+
+  //
+  // The last virtual address added to the tape.
+  //
+
+  uint64_t LastVa_ = 0;
+
+  //
+  // Partial builders keep track of their first entry.
+  //
+
+  bool Partial_ = false;
+  std::optional<uint64_t> FirstVa_;
+
+  //
+  // The gap layout policy, the number of padding pixels of the regions
+  // closed so far and the number of gap pages drawn in the tape.
+  //
+
+  GapPolicy_t Policy_;
+  uint64_t NumberPaddingPixels_ = 0;
+  uint64_t NumberGapPages_ = 0;
+
+  //
+  // The number of regions whose start has been drained, and whether the last
+  // region has been closed.
+  //
+
+  uint64_t NumberStarted_ = 0;
+  bool Finished_ = false;
+
+  //
+  // Print the mappings of an entry when the verbosity policy asks for it.
+  //
+
+  void DumpMappings(const ptables::Entry_t &Entry,
+                    const ptables::Protection_t Protection,
+                    const uint64_t NumberPixels) const {
+    if constexpr (Verbosity_t::DumpMappings) {
+      const auto &Pml5e =
+          Entry.Pml5eAddress != 0
+              ? fmt::format("PML5E:{:#x}, ", Entry.Pml5eAddress)
+              : std::string();
+      for (uint64_t Idx = 0; Idx < NumberPixels; Idx++) {
+        const uint64_t CurrentPa = ptables::AddressFromPfn(Entry.Pa, Idx);
+        const uint64_t CurrentVa = ptables::AddressFromPfn(Entry.Va, Idx);
+        fmt::print("VA:{:#x}, PA:{:#x} ({}, {}, {}PML4E:{:#x}, PDPTE:{:#x}, "
+                   "PDE:{:#x}, PTE:{:#x}, Dist:{})\n",
+                   CurrentVa, CurrentPa, ToString(Protection),
+                   ToString(Entry.Type), Pml5e, Entry.Pml4eAddress,
+                   Entry.PdpteAddress, Entry.PdeAddress, Entry.PteAddress,
+                   Size() + Idx);
+      }
+    }
+  }
+
+  //
+  // Gets the number of 4k pages that we need to draw on the curve for
+  // Huge/Large/Normal page.
+  //
+
+  static constexpr uint64_t
+  GetNumberPixels(const ptables::PageType_t PageType) {
+    //
+    // XXX: Use the below once clang and gcc supports the feature.
+    // using enum ptables::PageType_t;
+    //
+
+    switch (PageType) {
+    case ptables::PageType_t::Huge: {
+
+      //
+      // Huge pages are 1GB so we'll add the below number of pixels.
+      //
+
+      return (1024 * 1024 * 1024) / page::Size;
+    }
+
+    case ptables::PageType_t::Large: {
+
+      //
+      // Large pages are 2MB so we'll add the below number of pixels.
+      //
+
+      return (1024 * 1024 * 2) / page::Size;
+    }
+
+    case ptables::PageType_t::Normal: {
+
+      //
+      // This is a normal page, so we'll just materialize a single pixel.
+      //
+
+      return 1;
+    }
+    }
+
+    std::abort();
+  }
+
+  //
+  // Complete a region and make sure it ends on a run boundary.
+  //
+
+  void CloseRegion() {
+    Region_.EndIdx = Tape_.Size();
+    Region_.EndRun = Tape_.NumberRuns();
+    NumberPaddingPixels_ += Region_.Padding;
+    Regions_.emplace_back(Region_);
+    Region_ = Region_t();
+    Region_.Scale = Regions_.back().Scale;
+    Tape_.Break();
+  }
+
+  //
+  // If we have a gap in the address space, we fill it up the best we can.
+  //
+
+  void FillGap(const uint64_t Va) {
+    if ((LastVa_ + page::Size) == Va) {
+      return;
+    }
+
+    //
+    // If we haven't added anything to the tape, it means the address space
+    // starts with a gap. So it means that the first page is a gap and as a
+    // result we should not increase the last virtual address.
+    //
+
+    if (Tape_.Size() > 0) {
+      LastVa_ += page::Size;
+    }
+
+    //
+    // If the gap is small enough, it is drawn entirely.
+    //
+
+    const uint64_t GapEntries = (Va - LastVa_) / page::Size;
+    if (GapEntries <= Policy_.MaxGapPages) {
+      if constexpr (Verbosity_t::DumpGapMappings) {
+        for (uint64_t Idx = 0; Idx < GapEntries; Idx++) {
+          fmt::print("VA:{:#x} (Gap, Dist:{})\n",
+                     ptables::AddressFromPfn(LastVa_, Idx), Size() + Idx);
+        }
+      }
+
+      Tape_.Append(ptables::Protection_t::None, GapEntries / Region_.Scale);
+      NumberGapPages_ += GapEntries;
+      return;
+    }
+
+    //
+    // Otherwise, we close the current region and start a new one; they are
+    // separated by the padding which is not stored in the tape.
+    //
+
+    if constexpr (Verbosity_t::DumpGapMappings) {
+      for (uint64_t Idx = 0; Idx < Policy_.Padding; Idx++) {
+        fmt::print("VA:{:#x} (Gap, Dist:{})\n",
+                   ptables::AddressFromPfn(LastVa_, Idx), Size() + Idx);
+      }
+    }
+
+    if constexpr (Verbosity_t::DumpMappings) {
+      fmt::print("Huge gap from {:x} to {:x}, skipping\n",
+                 ptables::AddressFromPfn(LastVa_, Policy_.Padding), Va);
+    }
+
+    Region_.Padding = Policy_.Padding;
+    CloseRegion();
+    Region_.Va = Va;
+  }
+
+  //
+  // Get the tape ready to receive pages starting at Va. Partial builders
+  // don't know what precedes them, so the gap in front of their first entry
+  // is filled when they get spliced.
+  //
+
+  void Reach(const uint64_t Va, const uint64_t Scale = 1) {
+    if (Partial_ && !FirstVa_) {
+      FirstVa_ = Va;
+      Region_.Scale = Scale;
+    } else if (Scale != Region_.Scale) {
+      Rescale(Va, Scale);
+    } else {
+      FillGap(Va);
+    }
+  }
+
+  //
+  // Start a region of Scale pages per pixel at Va. The gap in front of it is
+  // not drawn in either of the regions since it might not be a whole number
+  // of pixels of the previous one; it becomes the padding between them
+  // instead, one pixel per page of the finer of the two (see FillGap for
+  // the large ones).
+  //
+
+  void Rescale(const uint64_t Va, const uint64_t Scale) {
+    if (Tape_.Size() == 0) {
+      Region_.Scale = Scale;
+      FillGap(Va);
+      return;
+    }
+
+    const uint64_t GapPages = (Va - LastVa_) / page::Size - 1;
+    Region_.Padding = GapPages > Policy_.MaxGapPages
+                          ? Policy_.Padding
+                          : GapPages / std::min(Region_.Scale, Scale);
+    CloseRegion();
+    Region_.Va = Va;
+    Region_.Scale = Scale;
+  }
+
+  //
+  // Get the number of pages a pixel stands for with the scaling of the
+  // policy.
+  //
+
+  uint64_t ScaleOf(const ptables::PageType_t PageType) const {
+    return Policy_.Scaling == Scaling_t::Mapping ? GetNumberPixels(PageType)
+                                                 : 1;
+  }
+
+public:
+  explicit BasicTapeBuilder_t(const bool Partial = false,
+                              const GapPolicy_t &Policy = GapPolicy_t())
+      : Partial_(Partial), Policy_(Policy) {}
+
+  //
+  // Start over to build another tape with the same policy; the memory of the
+  // tape and the regions is kept.
+  //
+
+  void Reset() {
+    Tape_.Clear();
+    Regions_.clear();
+    Region_ = Region_t();
+    LastVa_ = 0;
+    FirstVa_.reset();
+    NumberPaddingPixels_ = 0;
+    NumberGapPages_ = 0;
+    NumberStarted_ = 0;
+    Finished_ = false;
+  }
+
+  //
+  // Start the tape at Va instead of at the bottom of the address space, for
+  // the walks of a window of it; like at the bottom, LastVa_ is the first page
+  // of the gap in front of the first entry while the tape is empty. This needs
+  // to be done before anything is added.
+  //
+
+  void Start(const uint64_t Va) {
+    Region_.Va = Va;
+    LastVa_ = Va;
+  }
+
+  //
+  // Add an entry to the tape.
+  //
+
+  void Add(const ptables::Entry_t &Entry) {
+    const uint64_t Scale = ScaleOf(Entry.Type);
+    Reach(Entry.Va, Scale);
+
+    //
+    // Calculate the page protection from the PML4E/PDPTE/PDE/PTE.
+    //
+
+    const auto &Protection = Entry.Protection();
+
+    //
+    // Grab the number of pixels that we need for this page.
+    //
+
+    const uint64_t NumberPages = GetNumberPixels(Entry.Type);
+    const uint64_t NumberPixels = NumberPages / Scale;
+
+    //
+    // Dump the mappings if the user want to.
+    //
+
+    DumpMappings(Entry, Protection, NumberPixels);
+
+    //
+    // Time to populate the tape; the whole entry is a single run.
+    //
+
+    LastVa_ = ptables::AddressFromPfn(Entry.Va, NumberPages - 1);
+    Tape_.Append(Protection, NumberPixels, Entry.Attributes);
+  }
+
+  //
+  // Add an entry to the tape along with the content of its pages; Classify
+  // gets the physical address of every 4KB page of the entry and returns the
+  // attribute bits describing its content.
+  //
+
+  template <typename Classify_t>
+  void Add(const ptables::Entry_t &Entry, Classify_t &&Classify) {
+    Reach(Entry.Va);
+    const auto &Protection = Entry.Protection();
+    const uint64_t NumberPixels = GetNumberPixels(Entry.Type);
+    DumpMappings(Entry, Protection, NumberPixels);
+    for (uint64_t Idx = 0; Idx < NumberPixels; Idx++) {
+      const uint8_t Content = Classify(ptables::AddressFromPfn(Entry.Pa, Idx));
+      Tape_.Append(Protection, 1, Entry.Attributes | Content);
+    }
+
+    LastVa_ = ptables::AddressFromPfn(Entry.Va, NumberPixels - 1);
+  }
+
+  //
+  // Add a range of pages to the tape; the ranges are made of 4KB pages, or
+  // of mappings of Scale pages when a tape that was scaled is added back.
+  //
+
+  void Add(const ptables::Range_t &Range, const uint64_t Scale = 1) {
+    Reach(Range.Va, Scale);
+    LastVa_ = ptables::AddressFromPfn(Range.Va, Range.NumberPages - 1);
+    Tape_.Append(Range.Protection, Range.NumberPages / Scale,
+                 Range.Attributes);
+  }
+
+  //
+  // Append a partial builder that covers the part of the address space
+  // directly following ours.
+  //
+
+  void Splice(BasicTapeBuilder_t &&Partial) {
+    if (!Partial.FirstVa_) {
+      return;
+    }
+
+    const uint64_t FirstScale = Partial.Regions_.empty()
+                                    ? Partial.Region_.Scale
+                                    : Partial.Regions_.front().Scale;
+    if (FirstScale != Region_.Scale) {
+      Rescale(*Partial.FirstVa_, FirstScale);
+    } else {
+      FillGap(*Partial.FirstVa_);
+    }
+
+    //
+    // The first region of the partial builder is the continuation of the
+    // one we are building.
+    //
+
+    const uint64_t IdxBase = Tape_.Size();
+    const uint64_t NumberRuns = Tape_.NumberRuns();
+    const uint64_t RunBase =
+        NumberRuns - Tape_.Splice(std::move(Partial.Tape_));
+
+    for (uint64_t Idx = 0; Idx < Partial.Regions_.size(); Idx++) {
+      Region_t Region = Partial.Regions_[Idx];
+      if (Idx == 0) {
+        Region.Va = Region_.Va;
+      }
+
+      Region.EndIdx += IdxBase;
+      Region.EndRun += RunBase;
+      Regions_.emplace_back(Region);
+    }
+
+    if (!Partial.Regions_.empty()) {
+      Region_.Va = Partial.Region_.Va;
+      Region_.Scale = Partial.Region_.Scale;
+    }
+
+    NumberPaddingPixels_ += Partial.NumberPaddingPixels_;
+    NumberGapPages_ += Partial.NumberGapPages_;
+    LastVa_ = Partial.LastVa_;
+  }
+
+  //
+  // Complete the last region; the tape is now ready.
+  //
+
+  void Finish() {
+    CloseRegion();
+    Finished_ = true;
+  }
+
+  //
+  // Move the runs that can't change anymore out of the tape, along with the
+  // regions starting in them. This allows to consume the tape while it is
+  // being built.
+  //
+
+  TapeChunk_t Drain() {
+    TapeChunk_t Chunk;
+    const uint64_t Begin = Tape_.FirstRun();
+    const uint64_t End = Tape_.NumberRuns() - (Tape_.Mergeable() ? 1 : 0);
+    while (NumberStarted_ < Regions_.size() ||
+           (!Finished_ && NumberStarted_ == Regions_.size())) {
+      const bool Closed = NumberStarted_ < Regions_.size();
+      const uint64_t StartRun =
+          NumberStarted_ == 0 ? 0 : Regions_[NumberStarted_ - 1].EndRun;
+      if (StartRun > End) {
+        break;
+      }
+
+      Chunk.Starts.push_back(
+          {StartRun - Begin, Closed ? Regions_[NumberStarted_].Va : Region_.Va,
+           NumberStarted_ == 0 ? 0 : Regions_[NumberStarted_ - 1].Padding});
+      NumberStarted_++;
+    }
+
+    Chunk.Runs = Tape_.Drain(End);
+    return Chunk;
+  }
+
+  //
+  // Get the runs of the tape with the padding of the regions laid out as
+  // empty runs; this is what goes on the curve.
+  //
+
+  std::vector<Tape_t::Run_t> Layout() const {
+    std::vector<Tape_t::Run_t> Layout;
+    Layout.reserve(Tape_.NumberRuns() + Regions_.size());
+    uint64_t RunIdx = Tape_.FirstRun();
+    for (const auto &Region : Regions_) {
+      Tape_.ForEachSpan(RunIdx, Region.EndRun,
+                        [&](const std::span<const Tape_t::Run_t> &Runs) {
+                          Layout.insert(Layout.end(), Runs.begin(), Runs.end());
+                        });
+      Tape_.Evict(RunIdx, Region.EndRun);
+      if (Region.Padding > 0) {
+        Tape_t::Run_t Run;
+        Run.Length = Region.Padding;
+        Run.Protection = uint64_t(ptables::Protection_t::None);
+        Layout.emplace_back(Run);
+      }
+
+      RunIdx = Region.EndRun;
+    }
+
+    return Layout;
+  }
+
+  //
+  // Number of pixels on the curve.
+  //
+
+  uint64_t Size() const { return Tape_.Size() + NumberPaddingPixels_; }
+
+  //
+  // Number of pages of the gaps drawn on the curve.
+  //
+
+  uint64_t NumberGapPages() const { return NumberGapPages_; }
+
+  //
+  // Spill the runs of the tape to a file; see Tape_t::Spill.
+  //
+
+  bool Spill(const std::filesystem::path &Directory,
+             const uint64_t BudgetBytes) {
+    return Tape_.Spill(Directory, BudgetBytes);
+  }
+
+  //
+  // Get the runs of the tape as a single span; see Tape_t::Contiguous.
+  //
+
+  std::span<const Tape_t::Run_t> Contiguous() { return Tape_.Contiguous(); }
+
+  const GapPolicy_t &Policy() const { return Policy_; }
+  const Tape_t &Tape() const { return Tape_; }
+  const std::vector<Region_t> &Regions() const { return Regions_; }
+};
+
+//
+// The tape builder that doesn't dump anything.
+//
+
+using TapeBuilder_t = BasicTapeBuilder_t<ptables::QuietPolicy_t>;
+
+} // namespace clairvoyance
@@ -0,0 +1,136 @@
+// Axel '0vercl0k' Souchet - October 15 2026
+#pragma once
+#include "fmt/format.h"
+#include "kdmp-parser.h"
+#include "store.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace clairvoyance::tapecache {
+
+namespace fs = std::filesystem;
+
+//
+// The tape cache keeps the tapes that were walked out of a dump as binary
+// .clairvoyance documents, so that rendering them again with another format,
+// overlay or layout doesn't parse the dump or walk its page tables. A tape is
+// keyed by the identity of its dump, its directory base and the options that
+// shape it (see Cache_t::Path). The identity of a dump is its path, its size,
+// its modification time and the content of its header; hashing all of it
+// would cost about as much as parsing it.
+//
+
+class Cache_t {
+  fs::path Directory_;
+  store::Hash_t Dump_ = {};
+  uint64_t DirectoryTableBase_ = 0;
+
+public:
+  //
+  // Create the cache directory if needed and identify the dump.
+  //
+
+  bool Open(const fs::path &Directory, const fs::path &DumpFile) {
+    std::error_code Error;
+    fs::create_directories(Directory, Error);
+    if (Error) {
+      fmt::print("Could not create {}\n", Directory.string());
+      return false;
+    }
+
+    const auto &Path = fs::canonical(DumpFile, Error);
+    const uint64_t Size = Error ? 0 : fs::file_size(Path, Error);
+    const auto &Time =
+        Error ? fs::file_time_type() : fs::last_write_time(Path, Error);
+    if (Error) {
+      fmt::print("Could not identify {}\n", DumpFile.string());
+      return false;
+    }
+
+    kdmpparser::HEADER64 Header;
+    std::ifstream File(Path, std::ios::binary);
+    if (!File.read((char *)&Header, sizeof(Header))) {
+      fmt::print("Could not read the header of {}\n", DumpFile.string());
+      return false;
+    }
+
+    const auto &Identity = fmt::format("{}\n{}\n{}\n", Path.string(), Size,
+                                       Time.time_since_epoch().count());
+    std::vector<uint8_t> Bytes(Identity.begin(), Identity.end());
+    Bytes.insert(Bytes.end(), (const uint8_t *)&Header,
+                 (const uint8_t *)&Header + sizeof(Header));
+    Dump_ = store::Hash(Bytes);
+    Directory_ = Directory;
+    DirectoryTableBase_ = Header.DirectoryTableBase;
+    return true;
+  }
+
+  //
+  // Get the directory base of the dump header, without parsing the dump.
+  //
+
+  uint64_t DirectoryTableBase() const { return DirectoryTableBase_; }
+
+  //
+  // Get the path of the tape of a directory base walked with Options, a
+  // description of everything that shapes the tape.
+  //
+
+  fs::path Path(const uint64_t DirectoryBase,
+                const std::string &Options) const {
+    const auto &Key = fmt::format("{:016x}{:016x}\n{:#x}\n{}", Dump_[0],
+                                  Dump_[1], DirectoryBase, Options);
+    const auto &Hash =
+        store::Hash(std::span((const uint8_t *)Key.data(), Key.size()));
+    return Directory_ / fmt::format("{:016x}{:016x}.clairvoyance", Hash[0],
+                                    Hash[1]);
+  }
+
+  //
+  // Is the tape of a directory base in the cache?
+  //
+
+  bool Contains(const uint64_t DirectoryBase,
+                const std::string &Options) const {
+    std::error_code Error;
+    return fs::is_regular_file(Path(DirectoryBase, Options), Error);
+  }
+
+  //
+  // Store a tape in the cache; Write writes it in the file it is passed. It
+  // is written next to its final path and renamed over it, so that a
+  // concurrent render never sees a tape that is not complete.
+  //
+
+  template <typename Write_t>
+  bool Put(const uint64_t DirectoryBase, const std::string &Options,
+           Write_t &&Write) const {
+    const auto &Final = Path(DirectoryBase, Options);
+    fs::path Temporary = Final;
+    Temporary += fmt::format(
+        ".{:x}", std::chrono::steady_clock::now().time_since_epoch().count());
+    std::error_code Error;
+    if (!Write(Temporary)) {
+      fs::remove(Temporary, Error);
+      return false;
+    }
+
+    fs::rename(Temporary, Final, Error);
+    if (Error) {
+      fs::remove(Temporary, Error);
+      fmt::print("Could not store {} in the tape cache\n",
+                 Final.filename().string());
+      return false;
+    }
+
+    return true;
+  }
+};
+
+} // namespace clairvoyance::tapecache
@@ -0,0 +1,141 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "pagetables.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace clairvoyance::text {
+
+//
+// The text version of the .clairvoyance format has a line per pixel with its
+// protection in hexadecimal; the protections go from 0 to 8 so every line is
+// the same two characters for a run of pixels. The runs are expanded by
+// storing a pattern of lines instead of formatting every one of them.
+//
+
+constexpr uint64_t LineSize = 2;
+
+inline void FillLines(uint8_t *Data, uint64_t NumberLines,
+                      const ptables::Protection_t Protection) {
+  constexpr uint64_t LinesPerBlock = 32;
+  const uint8_t Digit = uint8_t("0123456789abcdef"[uint64_t(Protection) & 0xf]);
+  uint8_t Block[LinesPerBlock * LineSize];
+  for (uint64_t Idx = 0; Idx < LinesPerBlock; Idx++) {
+    Block[Idx * LineSize] = Digit;
+    Block[(Idx * LineSize) + 1] = '\n';
+  }
+
+#if defined(__AVX2__)
+  const __m256i Pattern = _mm256_loadu_si256((const __m256i *)Block);
+  for (; NumberLines >= (LinesPerBlock / 2); NumberLines -= LinesPerBlock / 2) {
+    _mm256_storeu_si256((__m256i *)Data, Pattern);
+    Data += sizeof(Pattern);
+  }
+#else
+  for (; NumberLines >= LinesPerBlock; NumberLines -= LinesPerBlock) {
+    memcpy(Data, Block, sizeof(Block));
+    Data += sizeof(Block);
+  }
+#endif
+
+  memcpy(Data, Block, NumberLines * LineSize);
+}
+
+//
+// Where the lines go; a file by default. An output can swap the buffer it is
+// handed with another one instead of copying it.
+//
+
+class FileOutput_t {
+  FILE *File_ = nullptr;
+
+public:
+  FileOutput_t(FILE *File) : File_(File) {}
+
+  bool Write(std::vector<uint8_t> &Buffer, const uint64_t Size) {
+    return fwrite(Buffer.data(), Size, 1, File_) == 1;
+  }
+};
+
+//
+// Write lines in an output through a buffer that is flushed in writes of a
+// few megabytes.
+//
+
+template <typename Output_t> class BasicLineWriter_t {
+  static constexpr uint64_t FlushSize = 4 * 1024 * 1024;
+
+  Output_t Output_;
+  std::vector<uint8_t> Buffer_;
+  uint64_t Used_ = 0;
+  bool Success_ = true;
+
+public:
+  explicit BasicLineWriter_t(Output_t Output)
+      : Output_(Output), Buffer_(FlushSize) {}
+
+  ~BasicLineWriter_t() { Flush(); }
+
+  BasicLineWriter_t(const BasicLineWriter_t &) = delete;
+  BasicLineWriter_t &operator=(const BasicLineWriter_t &) = delete;
+
+  //
+  // Append NumberLines lines of a protection.
+  //
+
+  void Lines(uint64_t NumberLines, const ptables::Protection_t Protection) {
+    while (NumberLines > 0) {
+      const uint64_t Room = (FlushSize - Used_) / LineSize;
+      if (Room == 0) {
+        Flush();
+        continue;
+      }
+
+      const uint64_t Size = std::min(NumberLines, Room);
+      FillLines(Buffer_.data() + Used_, Size, Protection);
+      Used_ += Size * LineSize;
+      NumberLines -= Size;
+    }
+  }
+
+  //
+  // Append a line of text, like the address starting a region.
+  //
+
+  void Line(const std::string_view Text) {
+    const uint64_t Size = Text.size() + 1;
+    if ((Used_ + Size) > FlushSize) {
+      Flush();
+    }
+
+    memcpy(Buffer_.data() + Used_, Text.data(), Text.size());
+    Buffer_[Used_ + Size - 1] = '\n';
+    Used_ += Size;
+  }
+
+  //
+  // Hand what is buffered to the output; returns false if any write failed.
+  //
+
+  bool Flush() {
+    if (Used_ > 0 && !Output_.Write(Buffer_, Used_)) {
+      Success_ = false;
+    }
+
+    Buffer_.resize(FlushSize);
+    Used_ = 0;
+    return Success_;
+  }
+};
+
+using LineWriter_t = BasicLineWriter_t<FileOutput_t>;
+
+} // namespace clairvoyance::text
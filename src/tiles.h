@@ -0,0 +1,167 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "fmt/format.h"
+#include "fmt/os.h"
+#include "image.h"
+#include "tape.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <span>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace clairvoyance::tiles {
+
+namespace fs = std::filesystem;
+
+//
+// Tiles are 256x256 pixels.
+//
+
+constexpr uint64_t TileOrder = 8;
+constexpr uint64_t TileSize = uint64_t(1) << TileOrder;
+
+//
+// Write the tiles of a level of the pyramid in Directory/<zoom>/<x>/<y>.png.
+// The tiles that are only made of background are not written.
+//
+
+inline bool WriteLevel(const fs::path &Directory, const Image_t &Level,
+                       const uint64_t Zoom, const uint64_t NumberThreads) {
+  const uint64_t Size = std::min(TileSize, Level.Height());
+  const uint64_t NumberColumns = Level.Width() / Size;
+  const uint64_t NumberTiles = NumberColumns * (Level.Height() / Size);
+  const uint8_t *Pixels = Level.Pixels().data();
+
+  //
+  // Create the directories up front so that the threads don't race on it.
+  //
+
+  for (uint64_t X = 0; X < NumberColumns; X++) {
+    std::error_code Ec;
+    fs::create_directories(Directory / fmt::format("{}/{}", Zoom, X), Ec);
+    if (Ec) {
+      fmt::print("Could not create the tiles directory: {}\n", Ec.message());
+      return false;
+    }
+  }
+
+  std::atomic<uint64_t> NextTile = 0;
+  std::atomic<bool> Success = true;
+  auto Worker = [&]() {
+    for (uint64_t TileIdx = NextTile++; TileIdx < NumberTiles;
+         TileIdx = NextTile++) {
+      const uint64_t X = TileIdx % NumberColumns;
+      const uint64_t Y = TileIdx / NumberColumns;
+      const uint8_t *Tile = Pixels + (Y * Size * Level.Width()) + (X * Size);
+      bool Empty = true;
+      for (uint64_t Row = 0; Row < Size && Empty; Row++) {
+        const uint8_t *Line = Tile + (Row * Level.Width());
+        Empty = std::all_of(Line, Line + Size, [](const uint8_t Pixel) {
+          return Pixel == BackgroundIdx;
+        });
+      }
+
+      if (Empty) {
+        continue;
+      }
+
+      const auto &Filename =
+          Directory / fmt::format("{}/{}/{}.png", Zoom, X, Y);
+      FILE *File = fopen(Filename.string().c_str(), "wb");
+      if (File == nullptr) {
+        fmt::print("Could not open {} for writing\n", Filename.string());
+        Success = false;
+        continue;
+      }
+
+      if (!png::Write(File, Tile, Size, Size, Level.Width())) {
+        Success = false;
+      }
+
+      fclose(File);
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  const uint64_t NumberWorkers =
+      std::max(uint64_t(1), std::min(NumberThreads, NumberTiles));
+  for (uint64_t Idx = 1; Idx < NumberWorkers; Idx++) {
+    Threads.emplace_back(Worker);
+  }
+
+  Worker();
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+
+  return Success;
+}
+
+//
+// Write an image as an XYZ pyramid of tiles: the most detailed zoom level has
+// one pixel per page, and every level above it is half the size of the one
+// below; a pixel of a coarser level is the most permissive protection of the
+// block it covers. Zoom 0 is a single tile (a row of them for a packed
+// layout, see hilbert::Layout_t). An index.json file describes the pyramid
+// and where the regions are on the curve, so that a viewer can go from a
+// pixel back to its virtual address; a pixel of a region is scale pages.
+//
+
+inline bool Write(const fs::path &Directory, const Image_t &Image,
+                  const std::vector<Region_t> &Regions,
+                  const uint64_t NumberThreads) {
+  const uint64_t MaxZoom =
+      Image.Order() > TileOrder ? Image.Order() - TileOrder : 0;
+
+  std::error_code Ec;
+  fs::create_directories(Directory, Ec);
+  if (Ec) {
+    fmt::print("Could not create {}: {}\n", Directory.string(), Ec.message());
+    return false;
+  }
+
+  auto Index = fmt::output_file((Directory / "index.json").string());
+  Index.print("{{\n  \"width\": {},\n  \"height\": {},\n  \"tileSize\": {},\n"
+              "  \"maxZoom\": {},\n  \"regions\": [\n",
+              Image.Width(), Image.Height(),
+              std::min(TileSize, Image.Height()), MaxZoom);
+  uint64_t Begin = 0, RegionBegin = 0;
+  for (uint64_t Idx = 0; Idx < Regions.size(); Idx++) {
+    const auto &Region = Regions[Idx];
+    const uint64_t End = Begin + (Region.EndIdx - RegionBegin);
+    Index.print("    {{\"va\": \"{:#x}\", \"begin\": {}, \"end\": {}, "
+                "\"scale\": {}}}{}\n",
+                Region.Va, Begin, End, Region.Scale,
+                (Idx + 1) < Regions.size() ? "," : "");
+    Begin = End + Region.Padding;
+    RegionBegin = Region.EndIdx;
+  }
+
+  Index.print("  ]\n}}\n");
+  Index.close();
+
+  //
+  // Start from the most detailed level and go up.
+  //
+
+  if (!WriteLevel(Directory, Image, MaxZoom, NumberThreads)) {
+    return false;
+  }
+
+  Image_t Level;
+  for (uint64_t Zoom = MaxZoom; Zoom > 0; Zoom--) {
+    Level = (Zoom == MaxZoom ? Image : Level).Downsample();
+    if (!WriteLevel(Directory, Level, Zoom - 1, NumberThreads)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace clairvoyance::tiles
@@ -0,0 +1,229 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "kdmp-parser.h"
+#include "pagetables.h"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+namespace clairvoyance::translation {
+
+//
+// A translation: the physical address of a virtual address, and the
+// protection of the page it is in.
+//
+
+struct Translation_t {
+  uint64_t Pa = 0;
+  ptables::Protection_t Protection = ptables::Protection_t::None;
+};
+
+//
+// A page returned by Tlb_t::GetVirtualPage: its content and the physical
+// address to release it with.
+//
+
+struct VirtualPage_t {
+  const uint8_t *Content = nullptr;
+  uint64_t Pa = 0;
+};
+
+//
+// A software TLB for the tools that translate a lot of virtual addresses;
+// KernelDumpParser::VirtTranslate walks the page tables every time. The
+// entries are keyed by directory base and virtual page number, with a table
+// for every page size, so a large page is a single entry. The TLB is filled
+// on misses, or ahead of time with a walk of a whole directory base. It is
+// not thread-safe; every thread should have its own.
+//
+
+class Tlb_t {
+public:
+  struct Stats_t {
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    uint64_t NumberEntries = 0;
+  };
+
+private:
+  struct Key_t {
+    uint64_t DirectoryBase = 0;
+    uint64_t PageNumber = 0;
+
+    bool operator==(const Key_t &Other) const = default;
+  };
+
+  struct KeyHash_t {
+    size_t operator()(const Key_t &Key) const {
+      return size_t((Key.PageNumber * 0x9e'37'79'b9'7f'4a'7c'15ull) ^
+                    (Key.DirectoryBase / page::Size));
+    }
+  };
+
+  //
+  // The shift of the page sizes, from the smallest to the largest.
+  //
+
+  static constexpr std::array<uint64_t, 3> Shifts = {12, 21, 30};
+
+  const kdmpparser::KernelDumpParser &DumpParser_;
+  bool La57_ = false;
+  using Entries_t = std::unordered_map<Key_t, Translation_t, KeyHash_t>;
+  std::array<Entries_t, Shifts.size()> Entries_;
+  Stats_t Stats_;
+
+  static constexpr uint64_t ShiftIdx(const ptables::PageType_t Type) {
+    return Type == ptables::PageType_t::Huge    ? 2
+           : Type == ptables::PageType_t::Large ? 1
+                                                : 0;
+  }
+
+  uint64_t Canonical(const uint64_t Va) const {
+    return ptables::CanonicalVa(La57_ ? 5 : 4, Va);
+  }
+
+  void Insert(const uint64_t DirectoryBase, const uint64_t Va,
+              const uint64_t Pa, const ptables::Protection_t Protection,
+              const ptables::PageType_t Type) {
+    const uint64_t Idx = ShiftIdx(Type);
+    const uint64_t Mask = (uint64_t(1) << Shifts[Idx]) - 1;
+    const Key_t Key = {DirectoryBase, Canonical(Va) >> Shifts[Idx]};
+    Entries_[Idx][Key] = {Pa & ~Mask, Protection};
+  }
+
+  std::optional<Translation_t> Lookup(const uint64_t DirectoryBase,
+                                      const uint64_t Va) const {
+    for (uint64_t Idx = 0; Idx < Shifts.size(); Idx++) {
+      const auto &Entries = Entries_[Idx];
+      if (Entries.empty()) {
+        continue;
+      }
+
+      const auto &Entry = Entries.find({DirectoryBase, Va >> Shifts[Idx]});
+      if (Entry != Entries.end()) {
+        const uint64_t Mask = (uint64_t(1) << Shifts[Idx]) - 1;
+        return Translation_t{Entry->second.Pa | (Va & Mask),
+                             Entry->second.Protection};
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  //
+  // Walk the page tables down to the leaf entry mapping Va.
+  //
+
+  template <uint64_t NumberLevels>
+  bool Fill(const uint64_t DirectoryBase, const uint64_t Va) {
+    ptables::BasicPageTableWalker_t<NumberLevels> Walker(
+        DumpParser_, DirectoryBase, ptables::Va_t(Va), ptables::Va_t(Va));
+    const auto &Entry = Walker.template Next<ptables::QuietPolicy_t>();
+    if (!Entry) {
+      return false;
+    }
+
+    Insert(DirectoryBase, Entry->Va, Entry->Pa, Entry->Protection(),
+           Entry->Type);
+    return true;
+  }
+
+public:
+  explicit Tlb_t(const kdmpparser::KernelDumpParser &DumpParser,
+                 const bool La57 = false)
+      : DumpParser_(DumpParser), La57_(La57) {}
+
+  //
+  // Walk a directory base and insert every one of its leaf entries.
+  //
+
+  void Prepopulate(const uint64_t DirectoryBase) {
+    if (La57_) {
+      Prepopulate<5>(page::Align(DirectoryBase));
+    } else {
+      Prepopulate<4>(page::Align(DirectoryBase));
+    }
+  }
+
+  //
+  // Translate a virtual address; a miss walks the page tables and fills the
+  // TLB. Returns nothing if the address isn't mapped.
+  //
+
+  std::optional<Translation_t> Translate(const uint64_t DirectoryBase,
+                                         const uint64_t VirtualAddress) {
+    const uint64_t Base = page::Align(DirectoryBase);
+    const uint64_t Va = Canonical(VirtualAddress);
+    if (const auto &Translation = Lookup(Base, Va)) {
+      Stats_.Hits++;
+      return Translation;
+    }
+
+    Stats_.Misses++;
+    const bool Filled = La57_ ? Fill<5>(Base, Va) : Fill<4>(Base, Va);
+    if (!Filled) {
+      return std::nullopt;
+    }
+
+    return Lookup(Base, Va);
+  }
+
+  //
+  // Get the content of the page a virtual address is in, like
+  // KernelDumpParser::GetVirtualPage, along with its physical address. The
+  // page is pinned in the page cache of the parser until
+  // KernelDumpParser::ReleasePhysicalPage is called with that address.
+  //
+
+  std::optional<VirtualPage_t> GetVirtualPage(const uint64_t DirectoryBase,
+                                              const uint64_t VirtualAddress) {
+    const auto &Translation = Translate(DirectoryBase, VirtualAddress);
+    if (!Translation) {
+      return std::nullopt;
+    }
+
+    const uint64_t Pa = page::Align(Translation->Pa);
+    const uint8_t *Content = DumpParser_.GetPhysicalPage(Pa);
+    if (Content == nullptr) {
+      return std::nullopt;
+    }
+
+    return VirtualPage_t{Content, Pa};
+  }
+
+  //
+  // Forget every translation, for when the page tables changed.
+  //
+
+  void Flush() {
+    for (auto &Entries : Entries_) {
+      Entries.clear();
+    }
+  }
+
+  Stats_t Stats() const {
+    Stats_t Stats = Stats_;
+    for (const auto &Entries : Entries_) {
+      Stats.NumberEntries += Entries.size();
+    }
+
+    return Stats;
+  }
+
+private:
+  template <uint64_t NumberLevels>
+  void Prepopulate(const uint64_t DirectoryBase) {
+    ptables::BasicPageTableWalker_t<NumberLevels> Walker(DumpParser_,
+                                                         DirectoryBase);
+    ptables::EntryBatch_t Batch;
+    while (const uint64_t Size = Walker.NextBatch(Batch)) {
+      for (uint64_t Idx = 0; Idx < Size; Idx++) {
+        Insert(DirectoryBase, Batch.Vas[Idx], Batch.Pas[Idx],
+               Batch.Protections[Idx], Batch.Types[Idx]);
+      }
+    }
+  }
+};
+
+} // namespace clairvoyance::translation
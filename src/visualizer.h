@@ -0,0 +1,841 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+#include "attribution.h"
+#include "binaryformat.h"
+#include "entropy.h"
+#include "fmt/format.h"
+#include "gzip.h"
+#include "hilbert.h"
+#include "image.h"
+#include "kdmp-parser.h"
+#include "mappedfile.h"
+#include "pagetables.h"
+#include "streamwriter.h"
+#include "tape.h"
+#include "textformat.h"
+#include "tiles.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace clairvoyance {
+
+namespace fs = std::filesystem;
+
+//
+// The output formats supported.
+//
+
+enum class OutputFormat_t { Text, Binary, Png, Ppm, Tiles };
+
+//
+// The extension of the files written in a format.
+//
+
+constexpr std::string_view Extension(const OutputFormat_t Format) {
+  return Format == OutputFormat_t::Png     ? "png"
+         : Format == OutputFormat_t::Ppm   ? "ppm"
+         : Format == OutputFormat_t::Tiles ? "tiles"
+                                           : "clairvoyance";
+}
+
+//
+// What the walk of a directory base records in the tape besides the
+// protection of the pages: La57 walks five-level page tables, Attributes
+// records the bits of the leaf entries and Content classifies the bytes of
+// every mapped page. MaxTableVisits bounds how many times the same table is
+// entered, for corrupt page tables (zero means no limit), and
+// SkipSelfReference leaves out the window the self-reference entry maps the
+// page tables in. Only the addresses between FirstVa and LastVa (inclusive)
+// are walked, and the walk doesn't descend past the tables mapping pages of
+// type Finest.
+//
+
+struct WalkOptions_t {
+  bool La57 = false;
+  bool Attributes = false;
+  bool Content = false;
+  uint64_t MaxTableVisits = 0;
+  bool SkipSelfReference = false;
+  uint64_t FirstVa = 0;
+  uint64_t LastVa = ~uint64_t(0);
+  ptables::PageType_t Finest = ptables::PageType_t::Normal;
+};
+
+//
+// The cache of kernel subtrees shared by the walks of a batch.
+//
+
+using SubtreeCache_t = ptables::SubtreeCache_t<TapeBuilder_t>;
+
+//
+// The visualizer is the class that generates the pictures. It reads the dump,
+// parses the page tables hierarchy and puts the address space onto a hilbert
+// curve. A visualizer can be reset and reused for another directory base; the
+// memory backing its tape is kept around. The verbosity policy selects at
+// compile time whether the mappings get dumped while walking.
+//
+
+template <typename Verbosity_t> class BasicVisualizer_t {
+public:
+  using Builder_t = BasicTapeBuilder_t<Verbosity_t>;
+  using Cache_t = ptables::SubtreeCache_t<Builder_t>;
+  using Progress_t = std::function<void(const ptables::WalkProgress_t &)>;
+
+private:
+  //
+  // The tape is basically a succession of page table properties. This is used
+  // as distances on the curve. We also keep track of contiguous regions of
+  // memory.
+  //
+
+  Builder_t Builder_;
+
+  //
+  // What gets recorded while walking.
+  //
+
+  WalkOptions_t Options_;
+
+  //
+  // What the walk of the last tape went through.
+  //
+
+  ptables::WalkStats_t Stats_;
+
+  //
+  // The owners of the pixels of the last tape, if they were attributed.
+  //
+
+  attribution::Channel_t Labels_;
+
+  //
+  // What abandons the walks and the writes, if anything.
+  //
+
+  const ptables::Cancellation_t *Cancellation_ = nullptr;
+
+  //
+  // The shape of the layouts the tapes are put on.
+  //
+
+  hilbert::Shape_t Shape_ = hilbert::Shape_t::Square;
+
+  bool Cancelled() const {
+    return Cancellation_ != nullptr && Cancellation_->Cancelled();
+  }
+
+  //
+  // Add an entry with the content of its pages.
+  //
+
+  static void AddContent(Builder_t &Builder,
+                         const kdmpparser::KernelDumpParser &DumpParser,
+                         const ptables::Entry_t &Entry) {
+    Builder.Add(Entry, [&](const uint64_t Pa) {
+      return entropy::ToAttributes(entropy::Classify(DumpParser, Pa));
+    });
+  }
+
+  //
+  // The tape of a window of the address space starts at its first address,
+  // so that it doesn't open with the gap below it.
+  //
+
+  void StartWindow() {
+    if (Options_.FirstVa != 0) {
+      Builder_.Start(Options_.FirstVa);
+    }
+  }
+
+  //
+  // Walk a hierarchy of NumberLevels levels and build the tape.
+  //
+
+  template <uint64_t NumberLevels>
+  void Walk(const kdmpparser::KernelDumpParser &DumpParser,
+            const uint64_t DirectoryBase, const uint64_t NumberThreads,
+            Cache_t *Cache, const Progress_t &Progress) {
+    StartWindow();
+
+    //
+    // The verbose modes print the mappings in order, so we walk in a single
+    // thread if any of them is turned on.
+    //
+
+    if constexpr (Verbosity_t::DumpMappings || Verbosity_t::DumpGapMappings) {
+
+      //
+      // Initialize the page tables walker.
+      //
+
+      ptables::BasicPageTableWalker_t<NumberLevels> Walker(
+          DumpParser, DirectoryBase, ptables::Va_t(Options_.FirstVa),
+          ptables::Va_t(Options_.LastVa));
+      if (Options_.Attributes) {
+        Walker.RecordAttributes();
+      }
+
+      Walker.LimitTableVisits(Options_.MaxTableVisits);
+      if (Options_.SkipSelfReference) {
+        Walker.SkipSelfReference();
+      }
+
+      Walker.StopAt(Options_.Finest);
+
+      //
+      // Let's go!
+      //
+
+      const uint64_t RootShift = ptables::LevelShift(NumberLevels, 0);
+      ptables::WalkProgress_t WalkProgress;
+      uint64_t NumberEntries = 0;
+      while (const auto &Entry = Walker.template Next<Verbosity_t>()) {
+        if (Options_.Content) {
+          AddContent(Builder_, DumpParser, *Entry);
+        } else {
+          Builder_.Add(*Entry);
+        }
+
+        WalkProgress.NumberPages +=
+            ptables::PageSize(Entry->Type) / page::Size;
+        if ((++NumberEntries % ptables::Cancellation_t::PollInterval) != 0) {
+          continue;
+        }
+
+        if (Cancelled()) {
+          break;
+        }
+
+        if (Progress) {
+          WalkProgress.TopIdx = (Entry->Va >> RootShift) %
+                                WalkProgress.NumberTopEntries;
+          Progress(WalkProgress);
+        }
+      }
+
+      Stats_ = Walker.Stats();
+    } else {
+
+      //
+      // Walk slices of the address space in parallel, each of them building
+      // its own partial tape; then stitch them back together in order. The
+      // slices already walked for another directory base are grabbed from
+      // the cache. The content of the pages needs their physical address, so
+      // the slices are walked entry by entry in that case.
+      //
+
+      auto Walk = [&](auto &&Visit) {
+        ptables::ParallelWalk<NumberLevels>(
+            DumpParser, DirectoryBase, NumberThreads,
+            Builder_t(true, Builder_.Policy()), Visit,
+            [&](Builder_t &&Partial,
+                const ptables::WalkProgress_t &WalkProgress) {
+              Builder_.Splice(std::move(Partial));
+              if (Progress) {
+                Progress(WalkProgress);
+              }
+            },
+            Cache, Options_.Attributes, &Stats_, Options_.MaxTableVisits,
+            Options_.SkipSelfReference, ptables::Va_t(Options_.FirstVa),
+            ptables::Va_t(Options_.LastVa), Options_.Finest, Cancellation_);
+      };
+
+      if (Options_.Content) {
+        Walk([&](Builder_t &Partial, const ptables::Entry_t &Entry) {
+          AddContent(Partial, DumpParser, Entry);
+        });
+      } else if (Builder_.Policy().Scaling == Scaling_t::Mapping) {
+        Walk([](Builder_t &Partial, const ptables::Entry_t &Entry) {
+          Partial.Add(Entry);
+        });
+      } else {
+        Walk([](Builder_t &Partial, const ptables::Range_t &Range) {
+          Partial.Add(Range);
+        });
+      }
+    }
+  }
+
+public:
+  explicit BasicVisualizer_t(const GapPolicy_t &Policy = GapPolicy_t(),
+                             const WalkOptions_t &Options = WalkOptions_t())
+      : Builder_(false, Policy), Options_(Options) {}
+
+  //
+  // Keep at most BudgetBytes of the tape in memory; the rest of it is
+  // spilled to a temporary file in Directory.
+  //
+
+  bool Spill(const fs::path &Directory, const uint64_t BudgetBytes) {
+    return Builder_.Spill(Directory, BudgetBytes);
+  }
+
+  //
+  // Lay the tapes out on layouts of a shape; the square curves are the
+  // default, the packed layouts waste fewer pixels (see hilbert::LayoutFor).
+  //
+
+  void LayOutAs(const hilbert::Shape_t Shape) { Shape_ = Shape; }
+
+  //
+  // Abandon the walks and the writes once Cancellation is cancelled or its
+  // deadline has passed; Parse and Write return false then, and what got
+  // written of the file is removed.
+  //
+
+  void AbandonOn(const ptables::Cancellation_t *Cancellation) {
+    Cancellation_ = Cancellation;
+  }
+
+  //
+  // Forget about the last tape (and what abandoned it) to get ready for
+  // another one.
+  //
+
+  void Reset() {
+    Builder_.Reset();
+    Stats_ = ptables::WalkStats_t();
+    Labels_ = attribution::Channel_t();
+    Cancellation_ = nullptr;
+  }
+
+  //
+  // Label the pixels of the tape with their owners in Table; the labels get
+  // written along with the binary format.
+  //
+
+  void Attribute(const attribution::Table_t &Table) {
+    Labels_ = attribution::Channel_t::Join(Table, Builder_);
+    fmt::print("Attributed {} pixels to {} labels in {} spans\n",
+               Labels_.NumberOwnedPixels(), Labels_.Labels().size() - 1,
+               Labels_.Spans().size());
+  }
+
+  //
+  // Parses and prepares the tape. Progress is invoked regularly while the
+  // tape is being built with how far the walk went, which allows to drain it.
+  //
+
+  bool Parse(const kdmpparser::KernelDumpParser &DumpParser,
+             const uint64_t DirectoryBase, const uint64_t NumberThreads = 1,
+             Cache_t *Cache = nullptr, const Progress_t &Progress = {}) {
+    if (Options_.La57) {
+      Walk<5>(DumpParser, DirectoryBase, NumberThreads, Cache, Progress);
+    } else {
+      Walk<4>(DumpParser, DirectoryBase, NumberThreads, Cache, Progress);
+    }
+
+    if (Cancelled()) {
+      fmt::print("The walk of {:#x} was abandoned\n", DirectoryBase);
+      return false;
+    }
+
+    //
+    // When we're done, complete the segment.
+    //
+
+    Builder_.Finish();
+
+    //
+    // We're done.
+    //
+
+    fmt::print(
+        "Extracted {} properties and {} contiguous regions from the dump \n",
+        Builder_.Size(), Builder_.Regions().size());
+    return true;
+  }
+
+  //
+  // Rebuild the tape out of a binary document that was written by a
+  // visualizer with the same gap policy, instead of walking the page tables
+  // again: its mapped runs are added back as ranges and the gaps get laid out
+  // like they were.
+  //
+
+  void Load(const binary::Reader_t &Reader) {
+    StartWindow();
+    for (const auto &Region : Reader.Regions()) {
+      uint64_t Va = Region.Va;
+      for (const auto &Run : Reader.Runs(Region)) {
+        const uint64_t NumberPages = Run.Length * Region.Scale;
+        if (Run.Protection != uint64_t(ptables::Protection_t::None)) {
+          Builder_.Add(ptables::Range_t{Va, NumberPages,
+                                        ptables::Protection_t(Run.Protection),
+                                        uint8_t(Run.Attributes)},
+                       Region.Scale);
+        }
+
+        Va += NumberPages * page::Size;
+      }
+    }
+
+    Builder_.Finish();
+    fmt::print("Loaded {} properties and {} contiguous regions from the tape "
+               "cache\n",
+               Builder_.Size(), Builder_.Regions().size());
+  }
+
+  //
+  // Parses the dump and writes the tape on the disk in the text format while
+  // it is being built.
+  //
+
+  bool Stream(const kdmpparser::KernelDumpParser &DumpParser,
+              const uint64_t DirectoryBase, const fs::path &Filename,
+              const uint64_t NumberThreads = 1, Cache_t *Cache = nullptr,
+              const Progress_t &Progress = {}) {
+    if (!Textual()) {
+      return false;
+    }
+
+    StreamWriter_t Writer;
+    if (!Writer.Open(Filename)) {
+      return false;
+    }
+
+    const bool Parsed =
+        Parse(DumpParser, DirectoryBase, NumberThreads, Cache,
+              [&](const ptables::WalkProgress_t &WalkProgress) {
+                Writer.Push(Builder_.Drain());
+                if (Progress) {
+                  Progress(WalkProgress);
+                }
+              });
+    if (!Parsed) {
+      Writer.Close(0, 0);
+      return Abandon(Filename);
+    }
+
+    Writer.Push(Builder_.Drain());
+
+    const auto &Layout = GetLayout();
+    return Writer.Close(Layout.Width(), Layout.Height()) && Parsed;
+  }
+
+  //
+  // Write the tape on the disk. The images are rendered with NumberThreads
+  // threads and an overlay. The text format is compressed with gzip if
+  // Compress is set.
+  //
+
+  bool Write(const fs::path &Filename,
+             const OutputFormat_t Format = OutputFormat_t::Text,
+             const uint64_t NumberThreads = 1,
+             const Overlay_t Overlay = Overlay_t::Protection,
+             const bool Compress = false) const {
+    const auto &Layout = GetLayout();
+    const uint64_t Width = Layout.Width();
+    const uint64_t Height = Layout.Height();
+
+    if (Format == OutputFormat_t::Binary) {
+      return WriteBinary(Filename, Width, Height, NumberThreads);
+    }
+
+    if (Format == OutputFormat_t::Png || Format == OutputFormat_t::Ppm ||
+        Format == OutputFormat_t::Tiles) {
+      Image_t Image;
+      Image.Render(Builder_.Layout(), Layout, NumberThreads, Overlay);
+      if (Cancelled()) {
+        return Abandon(Filename);
+      }
+
+      if (Format == OutputFormat_t::Tiles) {
+        return tiles::Write(Filename, Image, Builder_.Regions(),
+                            NumberThreads);
+      }
+
+      return Image.Write(Filename, Format == OutputFormat_t::Png
+                                       ? ImageFormat_t::Png
+                                       : ImageFormat_t::Ppm);
+    }
+
+    if (!Textual()) {
+      return false;
+    }
+
+    if (Compress) {
+      return WriteCompressedText(Filename, Width, Height);
+    }
+
+    return WriteText(Filename, Width, Height, NumberThreads);
+  }
+
+  //
+  // Append the tape to a binary file as a finer picture of the same address
+  // space; this is how a progressive file is refined (see binary::Reader_t).
+  //
+
+  bool Append(const fs::path &Filename,
+              const uint64_t NumberThreads = 1) const {
+    std::error_code Error;
+    const uint64_t Offset = fs::file_size(Filename, Error);
+    if (Error) {
+      fmt::print("Could not get the size of {}\n", Filename.string());
+      return false;
+    }
+
+    const auto &Layout = GetLayout();
+    return WriteBinary(Filename, Layout.Width(), Layout.Height(),
+                       NumberThreads, Offset);
+  }
+
+  //
+  // Get the tape and its regions, to build a query::Index_t for example.
+  //
+
+  const Builder_t &Builder() const { return Builder_; }
+
+  //
+  // Get what the walk of the tape went through.
+  //
+
+  const ptables::WalkStats_t &Stats() const { return Stats_; }
+
+  //
+  // Get the owners of the pixels of the tape.
+  //
+
+  const attribution::Channel_t &Labels() const { return Labels_; }
+
+private:
+  //
+  // Get rid of what got written of an abandoned file: it is removed, or
+  // truncated back to Offset if the tape was being appended to it.
+  //
+
+  static bool Abandon(const fs::path &Filename, const uint64_t Offset = 0) {
+    std::error_code Error;
+    if (Offset == 0) {
+      fs::remove(Filename, Error);
+    } else {
+      fs::resize_file(Filename, Offset, Error);
+    }
+
+    fmt::print("The write of {} was abandoned\n", Filename.string());
+    return false;
+  }
+
+  //
+  // Get the smallest layout of the shape that fits the tape.
+  //
+
+  hilbert::Layout_t GetLayout() const {
+    const auto &Layout = hilbert::LayoutFor(Builder_.Size(), Shape_);
+    if (Layout.NumberTiles == 1) {
+      fmt::print(
+          "Laying it out on an hilbert-curve order {} ({} total pixels)\n",
+          Layout.Order, Layout.NumberPixels());
+    } else {
+      fmt::print("Laying it out on {} hilbert-curves order {} ({} total "
+                 "pixels)\n",
+                 Layout.NumberTiles, Layout.Order, Layout.NumberPixels());
+    }
+
+    return Layout;
+  }
+
+  //
+  // Invoke Body(Begin, End, FirstPixel) on slices of the runs of the regions
+  // in parallel, FirstPixel being the index of the first pixel of the slice
+  // in the tape. The slices left are skipped once the write is abandoned.
+  //
+
+  template <typename Body_t>
+  void ForEachSliceOfRuns(const uint64_t NumberThreads, Body_t &&Body) const {
+    constexpr uint64_t RunsPerSlice = 0x10'000;
+    const auto &Regions = Builder_.Regions();
+    const uint64_t NumberRuns = Regions.empty() ? 0 : Regions.back().EndRun;
+    std::vector<uint64_t> SlicePixels(NumberThreads + 1, 0);
+    kdmpparser::ParallelFor(
+        NumberThreads, NumberRuns, RunsPerSlice,
+        [&](const uint64_t SliceIdx, const uint64_t Begin, const uint64_t End) {
+          uint64_t NumberPixels = 0;
+          Builder_.Tape().ForEachSpan(
+              Begin, End, [&](const std::span<const Tape_t::Run_t> &Runs) {
+                for (const auto &Run : Runs) {
+                  NumberPixels += Run.Length;
+                }
+              });
+
+          SlicePixels[SliceIdx + 1] = NumberPixels;
+        });
+
+    for (uint64_t SliceIdx = 1; SliceIdx <= NumberThreads; SliceIdx++) {
+      SlicePixels[SliceIdx] += SlicePixels[SliceIdx - 1];
+    }
+
+    kdmpparser::ParallelFor(
+        NumberThreads, NumberRuns, RunsPerSlice,
+        [&](const uint64_t SliceIdx, const uint64_t Begin, const uint64_t End) {
+          if (Cancelled()) {
+            return;
+          }
+
+          Body(Begin, End, SlicePixels[SliceIdx]);
+          Builder_.Tape().Evict(Begin, End);
+        });
+  }
+
+  //
+  // Can the tape be written with the text format? It doesn't have a scale,
+  // so a pixel has to be a page.
+  //
+
+  bool Textual() const {
+    if (Builder_.Policy().Scaling == Scaling_t::Page) {
+      return true;
+    }
+
+    fmt::print("The pixels are not pages, the tape can't be written with the "
+               "text format\n");
+    return false;
+  }
+
+  //
+  // Write the tape on the disk with the text format: a line per pixel. Every
+  // line is two characters long, so the size of the file and where every
+  // region goes in it are known up front; the file is mapped and the runs are
+  // encoded in place from several threads.
+  //
+
+  bool WriteText(const fs::path &Filename, const uint64_t Width,
+                 const uint64_t Height, const uint64_t NumberThreads) const {
+    using text::LineSize;
+    const auto &Regions = Builder_.Regions();
+    const std::string Header = fmt::format("{} {}\n", Width, Height);
+    std::vector<uint64_t> RegionOffsets(Regions.size());
+    uint64_t Size = Header.size();
+    uint64_t PixelIdx = 0;
+    for (uint64_t Idx = 0; Idx < Regions.size(); Idx++) {
+      const auto &Region = Regions[Idx];
+      Size += fmt::formatted_size("{:#x}\n", Region.Va);
+      RegionOffsets[Idx] = Size;
+      Size += (Region.EndIdx - PixelIdx + Region.Padding) * LineSize;
+      PixelIdx = Region.EndIdx;
+    }
+
+    MappedFile_t File;
+    if (!File.Open(Filename, Size)) {
+      return false;
+    }
+
+    uint8_t *Data = File.Data();
+    memcpy(Data, Header.data(), Header.size());
+    PixelIdx = 0;
+    for (uint64_t Idx = 0; Idx < Regions.size(); Idx++) {
+      const auto &Region = Regions[Idx];
+      const std::string Line = fmt::format("{:#x}\n", Region.Va);
+      memcpy(Data + RegionOffsets[Idx] - Line.size(), Line.data(),
+             Line.size());
+      text::FillLines(Data + RegionOffsets[Idx] +
+                    ((Region.EndIdx - PixelIdx) * LineSize),
+                Region.Padding, ptables::Protection_t::None);
+      PixelIdx = Region.EndIdx;
+    }
+
+    ForEachSliceOfRuns(NumberThreads, [&](const uint64_t Begin,
+                                          const uint64_t End,
+                                          const uint64_t FirstPixel) {
+      //
+      // Find the region of the first run, and where it goes in it.
+      //
+
+      uint64_t RegionIdx =
+          std::upper_bound(Regions.begin(), Regions.end(), Begin,
+                           [](const uint64_t RunIdx, const Region_t &Region) {
+                             return RunIdx < Region.EndRun;
+                           }) -
+          Regions.begin();
+      const uint64_t RegionPixel =
+          RegionIdx == 0 ? 0 : Regions[RegionIdx - 1].EndIdx;
+      uint8_t *Line = Data + RegionOffsets[RegionIdx] +
+                      ((FirstPixel - RegionPixel) * LineSize);
+      uint64_t RunIdx = Begin;
+      Builder_.Tape().ForEachSpan(
+          Begin, End, [&](const std::span<const Tape_t::Run_t> &Runs) {
+            for (const auto &Run : Runs) {
+              for (; RunIdx >= Regions[RegionIdx].EndRun; RegionIdx++) {
+                Line = Data + RegionOffsets[RegionIdx + 1];
+              }
+
+              text::FillLines(Line, Run.Length, Run.Prot());
+              Line += Run.Length * LineSize;
+              RunIdx++;
+            }
+          });
+    });
+
+    if (Cancelled()) {
+      File.Close();
+      return Abandon(Filename);
+    }
+
+    return File.Close();
+  }
+
+  //
+  // Write the tape on the disk with the text format compressed with gzip; the
+  // lines are encoded in this thread while the compression runs in another.
+  //
+
+  bool WriteCompressedText(const fs::path &Filename, const uint64_t Width,
+                           const uint64_t Height) const {
+    gzip::Writer_t File;
+    if (!File.Open(Filename)) {
+      return false;
+    }
+
+    bool Success = true;
+    {
+      text::BasicLineWriter_t<gzip::Writer_t &> Writer(File);
+      Writer.Line(fmt::format("{} {}", Width, Height));
+      uint64_t RunIdx = 0;
+      for (const auto &Region : Builder_.Regions()) {
+        if (Cancelled()) {
+          break;
+        }
+
+        Writer.Line(fmt::format("{:#x}", Region.Va));
+        Builder_.Tape().ForEachSpan(
+            RunIdx, Region.EndRun,
+            [&](const std::span<const Tape_t::Run_t> &Runs) {
+              for (const auto &Run : Runs) {
+                Writer.Lines(Run.Length, Run.Prot());
+              }
+            });
+
+        Builder_.Tape().Evict(RunIdx, Region.EndRun);
+        Writer.Lines(Region.Padding, ptables::Protection_t::None);
+        RunIdx = Region.EndRun;
+      }
+
+      Success = Writer.Flush();
+    }
+
+    Success = File.Close() && Success;
+    if (Cancelled()) {
+      return Abandon(Filename);
+    }
+
+    return Success;
+  }
+
+  //
+  // Write the tape on the disk with the binary run-length encoded format. The
+  // runs of the tape are the ones of the format (the tape merges the
+  // identical runs of a region already), so the file is mapped and they are
+  // copied in place from several threads. The labels section follows the
+  // runs if the tape was attributed, and the index section ends the file.
+  // The file is written at Offset, and the header goes in last so that a
+  // reader never sees the header of a file that isn't complete.
+  //
+
+  bool WriteBinary(const fs::path &Filename, const uint64_t Width,
+                   const uint64_t Height, const uint64_t NumberThreads,
+                   const uint64_t Offset = 0) const {
+    const auto &Regions = Builder_.Regions();
+    binary::Header_t Header;
+    Header.Width = Width;
+    Header.Height = Height;
+    Header.NumberRegions = Regions.size();
+    Header.NumberRuns = Regions.empty() ? 0 : Regions.back().EndRun;
+    const uint64_t RegionsOffset = sizeof(Header);
+    const uint64_t RunsOffset =
+        RegionsOffset + (Header.NumberRegions * sizeof(binary::Region_t));
+    const uint64_t LabelsOffset =
+        RunsOffset + (Header.NumberRuns * sizeof(binary::Run_t));
+    const uint64_t LabelsSize = Labels_.Empty() ? 0 : Labels_.EncodedSize();
+    const uint64_t IndexOffset = LabelsOffset + LabelsSize;
+    uint64_t NumberDistances = Regions.empty() ? 0 : Regions.back().EndIdx;
+    for (const auto &Region : Regions) {
+      NumberDistances += Region.Padding;
+    }
+
+    const uint64_t IndexSize =
+        binary::IndexBuilder_t::EncodedSize(NumberDistances);
+    MappedFile_t File;
+    if (!File.Open(Filename, IndexOffset + IndexSize, Offset)) {
+      return false;
+    }
+
+    uint8_t *Data = File.Data();
+    uint64_t RunIdx = 0;
+    uint64_t PixelIdx = 0;
+    for (uint64_t Idx = 0; Idx < Regions.size(); Idx++) {
+      const auto &Region = Regions[Idx];
+      binary::Region_t Out;
+      Out.Va = Region.Va;
+      Out.NumberPixels = Region.EndIdx - PixelIdx;
+      Out.FirstRun = RunIdx;
+      Out.NumberRuns = Region.EndRun - RunIdx;
+      Out.Padding = Region.Padding;
+      Out.Scale = Region.Scale;
+      memcpy(Data + RegionsOffset + (Idx * sizeof(Out)), &Out, sizeof(Out));
+      Header.NumberPixels += Out.NumberPixels;
+      RunIdx = Region.EndRun;
+      PixelIdx = Region.EndIdx;
+    }
+
+    ForEachSliceOfRuns(NumberThreads, [&](const uint64_t Begin,
+                                          const uint64_t End, const uint64_t) {
+      uint8_t *Out = Data + RunsOffset + (Begin * sizeof(binary::Run_t));
+      Builder_.Tape().ForEachSpan(
+          Begin, End, [&](const std::span<const Tape_t::Run_t> &Runs) {
+            for (const auto &Run : Runs) {
+              binary::Run_t Encoded;
+              Encoded.Length = Run.Length;
+              Encoded.Protection = Run.Protection;
+              Encoded.Attributes = Run.Attributes;
+              memcpy(Out, &Encoded, sizeof(Encoded));
+              Out += sizeof(Encoded);
+            }
+          });
+    });
+
+    if (Cancelled()) {
+      File.Close();
+      return Abandon(Filename, Offset);
+    }
+
+    if (LabelsSize > 0) {
+      Labels_.Encode(Data + LabelsOffset);
+    }
+
+    binary::IndexBuilder_t Index;
+    RunIdx = 0;
+    for (uint64_t Idx = 0; Idx < Regions.size(); Idx++) {
+      const auto &Region = Regions[Idx];
+      Index.BeginRegion(Idx, Region.Va, RunIdx, Region.Scale);
+      Builder_.Tape().ForEachSpan(
+          RunIdx, Region.EndRun,
+          [&](const std::span<const Tape_t::Run_t> &Runs) {
+            for (const auto &Run : Runs) {
+              Index.Run(Run.Length);
+            }
+          });
+
+      Index.Pad(Region.Padding);
+      RunIdx = Region.EndRun;
+    }
+
+    Index.Encode(Data + IndexOffset, Offset, Offset + IndexOffset);
+    memcpy(Data, &Header, sizeof(Header));
+    return File.Close();
+  }
+};
+
+//
+// The visualizer that doesn't dump anything.
+//
+
+using Visualizer_t = BasicVisualizer_t<ptables::QuietPolicy_t>;
+
+} // namespace clairvoyance
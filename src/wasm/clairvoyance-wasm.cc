@@ -0,0 +1,128 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#include "kdmp-parser.h"
+#include "visualizer.h"
+#include <cstdint>
+#include <emscripten.h>
+#include <memory>
+
+//
+// The WebAssembly build runs in a web worker: the page hands it the dump as a
+// File (or any Blob) in Module.dump, and the parser reads it lazily, a page
+// at a time, with FileReaderSync. Only the headers and the pages the walk
+// goes through get read, so a dump of several gigabytes is never loaded in
+// memory. The tape is written in the Emscripten file system in the text
+// format, where the page picks it up with FS.readFile.
+//
+// The offsets and sizes go through doubles, which hold integers up to 2^53,
+// so that the JavaScript side only deals with Numbers.
+//
+
+// clang-format off
+EM_JS(double, BlobSize, (), {
+  return Module['dump'].size;
+});
+
+EM_JS(int, BlobRead, (double Offset, void *Buffer, double Size), {
+  const Slice = Module['dump'].slice(Offset, Offset + Size);
+  const Bytes = new FileReaderSync().readAsArrayBuffer(Slice);
+  if (Bytes.byteLength != Size) {
+    return 0;
+  }
+
+  HEAPU8.set(new Uint8Array(Bytes), Number(Buffer));
+  return 1;
+});
+// clang-format on
+
+//
+// Read the dump out of the Blob of the page.
+//
+
+class BlobReader_t : public Reader_t {
+  uint64_t Size_ = uint64_t(BlobSize());
+
+public:
+  uint64_t Size() const override { return Size_; }
+
+  bool Read(const uint64_t Offset, void *Buffer,
+            const uint64_t Size) const override {
+    if ((Offset + Size) > Size_) {
+      return false;
+    }
+
+    return BlobRead(double(Offset), Buffer, double(Size)) == 1;
+  }
+
+  //
+  // The Blob is read synchronously, so there is nothing to prefetch.
+  //
+
+  void WillNeed(const uint64_t, const uint64_t) const override {}
+};
+
+static std::unique_ptr<kdmpparser::KernelDumpParser> DumpParser;
+
+extern "C" {
+
+//
+// Parse the dump in Module.dump; Name is its file name, which tells the raw
+// snapshots apart.
+//
+
+EMSCRIPTEN_KEEPALIVE int clairvoyance_open(const char *Name) {
+  auto Parser = std::make_unique<kdmpparser::KernelDumpParser>();
+  if (!Parser->ParseReader(Name, std::make_unique<BlobReader_t>())) {
+    fmt::print("Parsing the dump failed\n");
+    return 0;
+  }
+
+  DumpParser = std::move(Parser);
+  return 1;
+}
+
+//
+// Get the directory base of the dump header.
+//
+
+EMSCRIPTEN_KEEPALIVE double clairvoyance_directory_base() {
+  if (DumpParser == nullptr) {
+    return 0;
+  }
+
+  return double(page::Align(DumpParser->GetDirectoryTableBase()));
+}
+
+//
+// Walk a directory base and write its tape in Filename, in the text format.
+//
+
+EMSCRIPTEN_KEEPALIVE int clairvoyance_render(const double DirectoryBase,
+                                             const int La57,
+                                             const char *Filename) {
+  if (DumpParser == nullptr) {
+    fmt::print("There is no dump to render\n");
+    return 0;
+  }
+
+  clairvoyance::WalkOptions_t Options;
+  Options.La57 = La57 != 0;
+  clairvoyance::Visualizer_t Visu(clairvoyance::GapPolicy_t(), Options);
+  if (!Visu.Parse(*DumpParser, uint64_t(DirectoryBase))) {
+    fmt::print("Parse failed\n");
+    return 0;
+  }
+
+  if (!Visu.Write(Filename)) {
+    fmt::print("Write failed\n");
+    return 0;
+  }
+
+  return 1;
+}
+
+//
+// Forget about the dump.
+//
+
+EMSCRIPTEN_KEEPALIVE void clairvoyance_close() { DumpParser.reset(); }
+}
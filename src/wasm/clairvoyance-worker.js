@@ -0,0 +1,31 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+//
+// Render a dump in a web worker; post it {dump: File, la57: bool} and it
+// posts back {text: Uint8Array} with the tape in the text format, or
+// {error: string}.
+//
+
+importScripts('clairvoyance-wasm.js');
+
+onmessage = async (Event) => {
+  const Module = await ClairvoyanceModule({dump: Event.data.dump});
+  if (!Module.ccall('clairvoyance_open', 'number', ['string'],
+                    [Event.data.dump.name])) {
+    postMessage({error: 'Could not parse the dump'});
+    return;
+  }
+
+  const DirectoryBase =
+      Module.ccall('clairvoyance_directory_base', 'number', [], []);
+  const Filename = '/dump.clairvoyance';
+  const Rendered = Module.ccall(
+      'clairvoyance_render', 'number', ['number', 'number', 'string'],
+      [DirectoryBase, Event.data.la57 ? 1 : 0, Filename]);
+  Module.ccall('clairvoyance_close', null, [], []);
+  if (!Rendered) {
+    postMessage({error: 'Could not render the dump'});
+    return;
+  }
+
+  postMessage({text: Module.FS.readFile(Filename)});
+};
@@ -0,0 +1,476 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+//
+// Render the binary .clairvoyance files with WebGPU. The runs are uploaded
+// once; after that, panning, zooming or switching the overlay only
+// dispatches compute shaders (clairvoyance-render.wgsl), so they stay
+// interactive even for curves of a billion pixels.
+//
+//   const Renderer = await createRenderer(Device, await File.arrayBuffer());
+//   Renderer.render(Texture, {zoom: 4, x: 0, y: 0, overlay: 'dirty'});
+//
+// The texture is a rgba8unorm texture with the STORAGE_BINDING usage; its
+// pixel (0, 0) is the pixel (x, y) of the curve zoomed out zoom times.
+//
+//   const Pixel = locate(Buffer, Distance);
+//
+// finds the address behind a pixel with the index of the file, without
+// laying it out.
+//
+
+const Magic = 0x59564c43; // 'CLVY'
+const FirstVersion = 3;
+const Version = 4;
+const HeaderSize = 0x30;
+const RunSize = 8;
+const IndexMagic = 0x58564c43; // 'CLVX'
+const IndexHeaderSize = 0x20;
+const IndexEntrySize = 0x20;
+const IndexFooterSize = 0x10;
+const PageSize = 0x1000n;
+
+//
+// The distances are 32-bit in the shaders.
+//
+
+const MaxOrder = 16;
+const MaxPixels = 2 ** 32;
+
+//
+// The runs are reduced in a 16-ary tree of at most eight levels.
+//
+
+const Arity = 16;
+const MaxLevels = 8;
+
+//
+// The size of the Params structure of the shaders, in 32-bit integers.
+//
+
+const ParamsSize = 28;
+
+//
+// Get the size of the regions of a document, or 0 if its version is not
+// supported; version 3 didn't have the scale of the pixels.
+//
+
+function regionSizeOf(View, Document) {
+  const DocumentVersion = View.getUint32(Document + 4, true);
+  if (DocumentVersion < FirstVersion || DocumentVersion > Version) {
+    return 0;
+  }
+
+  return DocumentVersion == 3 ? 0x28 : 0x30;
+}
+
+export const Overlays = [
+  'protection', 'accessed', 'dirty', 'cache-disable', 'write-through',
+  'content'
+];
+
+//
+// Get the offset of the index section the footer at the end of the file
+// points to, or -1 if there is none.
+//
+
+function findIndex(View) {
+  const Footer = View.byteLength - IndexFooterSize;
+  if (Footer < 0 || View.getUint32(Footer + 8, true) != IndexMagic) {
+    return -1;
+  }
+
+  const Index = Number(View.getBigUint64(Footer, true));
+  if ((Index + IndexHeaderSize) > Footer ||
+      View.getUint32(Index, true) != IndexMagic) {
+    return -1;
+  }
+
+  const NumberEntries = Number(View.getBigUint64(Index + 0x10, true));
+  if ((Index + IndexHeaderSize + (NumberEntries * IndexEntrySize)) !=
+      Footer) {
+    return -1;
+  }
+
+  return Index;
+}
+
+//
+// Get the offset of the finest complete document of a progressive file (or
+// of the only one of the others), see binaryformat.h. The index points to
+// it right away; without one, the documents are scanned and the index
+// sections between them are skipped.
+//
+
+function findDocument(View) {
+  const Index = findIndex(View);
+  if (Index >= 0) {
+    const Document = Number(View.getBigUint64(Index + 0x18, true));
+    if ((Document + HeaderSize) <= Index &&
+        View.getUint32(Document, true) == Magic &&
+        regionSizeOf(View, Document) != 0) {
+      return Document;
+    }
+  }
+
+  let Found = -1;
+  for (let Offset = 0; (Offset + HeaderSize) <= View.byteLength;) {
+    if (View.getUint32(Offset, true) == IndexMagic) {
+      const NumberEntries = Number(View.getBigUint64(Offset + 0x10, true));
+      Offset += IndexHeaderSize + (NumberEntries * IndexEntrySize) +
+                IndexFooterSize;
+      continue;
+    }
+
+    const RegionSize = View.getUint32(Offset, true) == Magic
+                           ? regionSizeOf(View, Offset)
+                           : 0;
+    if (RegionSize == 0) {
+      break;
+    }
+
+    const NumberRegions = Number(View.getBigUint64(Offset + 0x20, true));
+    const NumberRuns = Number(View.getBigUint64(Offset + 0x28, true));
+    const End = Offset + HeaderSize + (NumberRegions * RegionSize) +
+                (NumberRuns * RunSize);
+    if (End > View.byteLength) {
+      break;
+    }
+
+    Found = Offset;
+    Offset = End;
+  }
+
+  if (Found < 0) {
+    throw new Error('Not a version 3 or 4 binary .clairvoyance file');
+  }
+
+  return Found;
+}
+
+//
+// Lay out the runs of a binary .clairvoyance file with the padding of the
+// regions as empty runs, like TapeBuilder_t::Layout. Every run takes two
+// integers: the distance of its last pixel, then its protection in the low
+// byte and its attributes in the next one. The picture is made of
+// Width / Height curves of order log2(Height) side by side, see
+// hilbert::LayoutOf.
+//
+
+export function layOut(Buffer) {
+  const File = new DataView(Buffer);
+  const Document = findDocument(File);
+  const RegionSize = regionSizeOf(File, Document);
+  const View = new DataView(Buffer, Document);
+  const Width = Number(View.getBigUint64(0x08, true));
+  const Height = Number(View.getBigUint64(0x10, true));
+  const NumberRegions = Number(View.getBigUint64(0x20, true));
+  const NumberRuns = Number(View.getBigUint64(0x28, true));
+  const Order = Math.log2(Height);
+  const NumberTiles = Width / Height;
+  if (!Number.isInteger(Order) || Order > MaxOrder ||
+      !Number.isInteger(NumberTiles) || NumberTiles == 0 ||
+      (NumberTiles * 4 ** Order) > MaxPixels) {
+    throw new Error(`Pictures of ${Width}x${Height} are not supported`);
+  }
+
+  const Runs = new Uint32Array(2 * (NumberRuns + NumberRegions));
+  const RunsOffset = HeaderSize + (NumberRegions * RegionSize);
+  let Last = -1;
+  let Count = 0;
+  const Push = (Length, Properties) => {
+    Last += Length;
+    Runs[2 * Count] = Last;
+    Runs[(2 * Count) + 1] = Properties;
+    Count++;
+  };
+
+  for (let RegionIdx = 0; RegionIdx < NumberRegions; RegionIdx++) {
+    const Region = HeaderSize + (RegionIdx * RegionSize);
+    const FirstRun = Number(View.getBigUint64(Region + 0x10, true));
+    const NumberRegionRuns = Number(View.getBigUint64(Region + 0x18, true));
+    const Padding = Number(View.getBigUint64(Region + 0x20, true));
+    for (let RunIdx = 0; RunIdx < NumberRegionRuns; RunIdx++) {
+      const Run = RunsOffset + ((FirstRun + RunIdx) * RunSize);
+      const Low = View.getUint32(Run, true);
+      const High = View.getUint32(Run + 4, true);
+      Push(Low + ((High & 0xffff) * 2 ** 32), High >>> 16);
+    }
+
+    if (Padding > 0) {
+      Push(Padding, 0);
+    }
+  }
+
+  if (Count == 0 || Last >= NumberTiles * 4 ** Order) {
+    throw new Error('The tape does not fit on its curves');
+  }
+
+  return {
+    Order,
+    NumberTiles,
+    NumberRuns: Count,
+    Runs: Runs.subarray(0, 2 * Count)
+  };
+}
+
+//
+// Find the pixel at a distance on the curve with the index of a binary
+// .clairvoyance file, like binary::Seeker_t: only an index entry and at most
+// a stride worth of runs are read. The result is null past the end of the
+// tape, {padding: true} for the padding between regions, and the address of
+// the pixel (a BigInt), the number of pages it stands for, its protection
+// and its attributes otherwise.
+//
+
+export function locate(Buffer, Distance) {
+  const View = new DataView(Buffer);
+  const Index = findIndex(View);
+  if (Index < 0) {
+    throw new Error('The file does not have an index');
+  }
+
+  const Stride = Number(View.getBigUint64(Index + 0x08, true));
+  const NumberEntries = Number(View.getBigUint64(Index + 0x10, true));
+  const Document = Number(View.getBigUint64(Index + 0x18, true));
+  const EntryIdx = Math.floor(Distance / Stride);
+  if (EntryIdx >= NumberEntries) {
+    return null;
+  }
+
+  const RegionSize = regionSizeOf(View, Document);
+  if (RegionSize == 0) {
+    throw new Error('The index does not point to a supported document');
+  }
+
+  const NumberRegions = Number(View.getBigUint64(Document + 0x20, true));
+  const RunsOffset = Document + HeaderSize + (NumberRegions * RegionSize);
+  const Entry = Index + IndexHeaderSize + (EntryIdx * IndexEntrySize);
+  let RegionIdx = Number(View.getBigUint64(Entry, true));
+  let RunIdx = Number(View.getBigUint64(Entry + 0x08, true));
+  let Left = Number(View.getBigUint64(Entry + 0x10, true)) +
+             (Distance % Stride);
+  let Va = View.getBigUint64(Entry + 0x18, true);
+  for (; RegionIdx < NumberRegions; RegionIdx++) {
+    const Region = Document + HeaderSize + (RegionIdx * RegionSize);
+    const FirstRun = Number(View.getBigUint64(Region + 0x10, true));
+    const EndRun = FirstRun + Number(View.getBigUint64(Region + 0x18, true));
+    const Padding = Number(View.getBigUint64(Region + 0x20, true));
+    const Scale =
+        RegionSize > 0x28 ? View.getBigUint64(Region + 0x28, true) : 1n;
+    if (Va === null) {
+      Va = View.getBigUint64(Region, true);
+      RunIdx = FirstRun;
+    }
+
+    for (; RunIdx < EndRun; RunIdx++) {
+      const Run = RunsOffset + (RunIdx * RunSize);
+      const High = View.getUint32(Run + 4, true);
+      const Length = View.getUint32(Run, true) + ((High & 0xffff) * 2 ** 32);
+      if (Left < Length) {
+        return {
+          va: Va + (BigInt(Left) * Scale * PageSize),
+          pages: Scale,
+          protection: (High >>> 16) & 0xff,
+          attributes: High >>> 24,
+        };
+      }
+
+      Left -= Length;
+      Va += BigInt(Length) * Scale * PageSize;
+    }
+
+    if (Left < Padding) {
+      return {padding: true};
+    }
+
+    Left -= Padding;
+    Va = null;
+  }
+
+  return null;
+}
+
+//
+// Get the sizes and the offsets of the levels of the tree of the runs.
+//
+
+export function levelsOf(NumberRuns) {
+  const Sizes = [NumberRuns];
+  const Offsets = [0];
+  while (Sizes.at(-1) > Arity && Sizes.length < MaxLevels) {
+    Offsets.push(Offsets.at(-1) + Sizes.at(-1));
+    Sizes.push(Math.ceil(Sizes.at(-1) / Arity));
+  }
+
+  return {Sizes, Offsets, Total: Offsets.at(-1) + Sizes.at(-1)};
+}
+
+//
+// Get the workgroups that cover NumberItems items, 64 in each of them; the
+// dispatches are two-dimensional past 65535 workgroups.
+//
+
+function workgroupsOf(NumberItems) {
+  const NumberWorkgroups = Math.max(1, Math.ceil(NumberItems / 64));
+  const X = Math.min(NumberWorkgroups, 65535);
+  return {X, Y: Math.ceil(NumberWorkgroups / X), Pitch: X * 64};
+}
+
+class Renderer_t {
+  constructor(Device, Tape, Module) {
+    this.Device = Device;
+    this.Order = Tape.Order;
+    this.NumberTiles = Tape.NumberTiles;
+    this.NumberRuns = Tape.NumberRuns;
+    this.Levels = levelsOf(Tape.NumberRuns);
+    this.Overlay = -1;
+
+    const Storage = GPUBufferUsage.STORAGE | GPUBufferUsage.COPY_DST;
+    this.RunsBuffer = Device.createBuffer({
+      size: Tape.Runs.byteLength,
+      usage: Storage,
+    });
+
+    Device.queue.writeBuffer(this.RunsBuffer, 0, Tape.Runs);
+    this.LevelsBuffer = Device.createBuffer({
+      size: this.Levels.Total * 4,
+      usage: GPUBufferUsage.STORAGE,
+    });
+
+    const Compute = GPUShaderStage.COMPUTE;
+    this.TapeLayout = Device.createBindGroupLayout({
+      entries: [
+        {binding: 0, visibility: Compute, buffer: {type: 'uniform'}},
+        {binding: 1, visibility: Compute, buffer: {type: 'read-only-storage'}},
+        {binding: 2, visibility: Compute, buffer: {type: 'storage'}},
+      ],
+    });
+
+    this.OutputLayout = Device.createBindGroupLayout({
+      entries: [{
+        binding: 0,
+        visibility: Compute,
+        storageTexture: {access: 'write-only', format: 'rgba8unorm'},
+      }],
+    });
+
+    const Pipeline = (EntryPoint, Layouts) => Device.createComputePipeline({
+      layout: Device.createPipelineLayout({bindGroupLayouts: Layouts}),
+      compute: {module: Module, entryPoint: EntryPoint},
+    });
+
+    this.Classify = Pipeline('Classify', [this.TapeLayout]);
+    this.Reduce = Pipeline('Reduce', [this.TapeLayout]);
+    this.Render = Pipeline('Render', [this.TapeLayout, this.OutputLayout]);
+
+    //
+    // Every pass gets its own parameters as they are all written before the
+    // commands are submitted: the first level, every level above it, and
+    // the viewport.
+    //
+
+    this.Passes = [];
+    for (let Level = 0; Level <= this.Levels.Sizes.length; Level++) {
+      const Params = Device.createBuffer({
+        size: ParamsSize * 4,
+        usage: GPUBufferUsage.UNIFORM | GPUBufferUsage.COPY_DST,
+      });
+
+      const Group = Device.createBindGroup({
+        layout: this.TapeLayout,
+        entries: [
+          {binding: 0, resource: {buffer: Params}},
+          {binding: 1, resource: {buffer: this.RunsBuffer}},
+          {binding: 2, resource: {buffer: this.LevelsBuffer}},
+        ],
+      });
+
+      this.Passes.push({Params, Group});
+    }
+  }
+
+  params({Zoom = 0, X = 0, Y = 0, Width = 0, Height = 0, Overlay = 0,
+          Level = 0, Pitch = 0}) {
+    const Params = new Uint32Array(ParamsSize);
+    Params.set([
+      this.Order, Zoom, X, Y, Width, Height, this.NumberRuns, Overlay, Level,
+      this.Levels.Sizes.length, Pitch, this.NumberTiles
+    ]);
+
+    Params.set(this.Levels.Offsets, 12);
+    Params.set(this.Levels.Sizes, 20);
+    return Params;
+  }
+
+  //
+  // Fill the tree of the runs with the palette entries of an overlay.
+  //
+
+  classify(Encoder, Overlay) {
+    const Pass = Encoder.beginComputePass();
+    for (let Level = 0; Level < this.Levels.Sizes.length; Level++) {
+      const Workgroups = workgroupsOf(this.Levels.Sizes[Level]);
+      const {Params, Group} = this.Passes[Level];
+      this.Device.queue.writeBuffer(
+          Params, 0,
+          this.params({Overlay, Level, Pitch: Workgroups.Pitch}));
+      Pass.setPipeline(Level == 0 ? this.Classify : this.Reduce);
+      Pass.setBindGroup(0, Group);
+      Pass.dispatchWorkgroups(Workgroups.X, Workgroups.Y);
+    }
+
+    Pass.end();
+  }
+
+  //
+  // Render a viewport of the curve zoomed out zoom times in a texture, with
+  // an overlay.
+  //
+
+  render(Texture, {zoom = 0, x = 0, y = 0, overlay = 'protection'} = {}) {
+    const Overlay = Overlays.indexOf(overlay);
+    if (Overlay < 0 || zoom < 0 || zoom > this.Order) {
+      throw new Error('Invalid overlay or zoom');
+    }
+
+    const Encoder = this.Device.createCommandEncoder();
+    if (Overlay != this.Overlay) {
+      this.classify(Encoder, Overlay);
+      this.Overlay = Overlay;
+    }
+
+    const {Params, Group} = this.Passes.at(-1);
+    this.Device.queue.writeBuffer(Params, 0, this.params({
+      Zoom: zoom,
+      X: x,
+      Y: y,
+      Width: Texture.width,
+      Height: Texture.height,
+      Overlay,
+    }));
+
+    const Output = this.Device.createBindGroup({
+      layout: this.OutputLayout,
+      entries: [{binding: 0, resource: Texture.createView()}],
+    });
+
+    const Pass = Encoder.beginComputePass();
+    Pass.setPipeline(this.Render);
+    Pass.setBindGroup(0, Group);
+    Pass.setBindGroup(1, Output);
+    Pass.dispatchWorkgroups(Math.ceil(Texture.width / 8),
+                            Math.ceil(Texture.height / 8));
+    Pass.end();
+    this.Device.queue.submit([Encoder.finish()]);
+  }
+}
+
+//
+// Upload the runs of a binary .clairvoyance file and compile the shaders.
+//
+
+export async function createRenderer(Device, Buffer) {
+  const Tape = layOut(Buffer);
+  const Url = new URL('clairvoyance-render.wgsl', import.meta.url);
+  const Code = await (await fetch(Url)).text();
+  return new Renderer_t(Device, Tape, Device.createShaderModule({code: Code}));
+}
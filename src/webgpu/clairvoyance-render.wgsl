@@ -0,0 +1,237 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+//
+// Render a tape on its hilbert-curve with compute shaders. The runs are
+// uploaded once as the distance of their last pixel and their properties.
+// Every output pixel covers an aligned square of 4^Zoom pixels of the curve,
+// which is a contiguous range of distances. The pixel becomes the most
+// permissive palette entry of the runs of that range, like Image_t::Downsample
+// does. To keep that cheap when zoomed out, the palette entries of the runs
+// are reduced into a 16-ary tree: Classify fills its first level for an
+// overlay, and Reduce builds every level above it.
+//
+// The distances are 32-bit, so the curves go up to order 16. A picture can
+// be made of NumberTiles curves side by side, see hilbert::Layout_t.
+//
+
+struct Params {
+  Order: u32,
+  Zoom: u32,
+  OriginX: u32,
+  OriginY: u32,
+  Width: u32,
+  Height: u32,
+  NumberRuns: u32,
+  Overlay: u32,
+  Level: u32,
+  NumberLevels: u32,
+  Pitch: u32,
+  NumberTiles: u32,
+  LevelOffsets: array<vec4<u32>, 2>,
+  LevelSizes: array<vec4<u32>, 2>,
+};
+
+@group(0) @binding(0) var<uniform> P: Params;
+@group(0) @binding(1) var<storage, read> Runs: array<vec2<u32>>;
+@group(0) @binding(2) var<storage, read_write> Levels: array<u32>;
+@group(1) @binding(0) var Output: texture_storage_2d<rgba8unorm, write>;
+
+//
+// The palette and the permissiveness of its entries, see image.h.
+//
+
+const UnsetIdx: u32 = 9u;
+const BackgroundIdx: u32 = 20u;
+const Arity: u32 = 16u;
+
+var<private> Palette: array<u32, 21> = array<u32, 21>(
+    0x000000u, 0xa9ff52u, 0xffff99u, 0xe0b0ffu, 0xff7f7fu, 0x00ff00u,
+    0xffff00u, 0xa020f0u, 0xfe0000u, 0x808080u, 0x000080u, 0x007fffu,
+    0x440154u, 0x46327eu, 0x365c8du, 0x277f8eu, 0x1fa187u, 0x4ac16du,
+    0xa0da39u, 0xfde725u, 0xffffffu);
+
+var<private> Permissiveness: array<u32, 21> = array<u32, 21>(
+    1u, 4u, 6u, 8u, 10u, 3u, 5u, 7u, 9u, 2u, 11u, 12u, 13u, 14u, 15u, 16u,
+    17u, 18u, 19u, 20u, 0u);
+
+//
+// The attribute bit every overlay shows, in the order of Overlays in
+// clairvoyance-gpu.js; the last one is the content overlay.
+//
+
+const ContentOverlay: u32 = 5u;
+
+var<private> OverlayAttributes: array<u32, 6> =
+    array<u32, 6>(0u, 1u, 2u, 4u, 8u, 0u);
+
+fn MostPermissive(A: u32, B: u32) -> u32 {
+  return select(B, A, Permissiveness[A] >= Permissiveness[B]);
+}
+
+fn LevelOffset(Level: u32) -> u32 {
+  return P.LevelOffsets[Level / 4u][Level % 4u];
+}
+
+fn LevelSize(Level: u32) -> u32 {
+  return P.LevelSizes[Level / 4u][Level % 4u];
+}
+
+//
+// Get the palette entry of a run with the overlay, like PaletteIdx in
+// image.h; the protection is in the low byte of the properties and the
+// attributes in the next one.
+//
+
+fn PaletteIdx(Properties: u32) -> u32 {
+  let Protection = Properties & 0xffu;
+  let Attributes = (Properties >> 8u) & 0xffu;
+  if (Protection == 0u) {
+    return 0u;
+  }
+
+  if (P.Overlay == ContentOverlay) {
+    return UnsetIdx + (Attributes >> 4u);
+  }
+
+  let Attribute = OverlayAttributes[P.Overlay];
+  if (Attribute == 0u || (Attributes & Attribute) != 0u) {
+    return Protection;
+  }
+
+  return UnsetIdx;
+}
+
+@compute @workgroup_size(64)
+fn Classify(@builtin(global_invocation_id) Id: vec3<u32>) {
+  let Idx = Id.x + (Id.y * P.Pitch);
+  if (Idx >= P.NumberRuns) {
+    return;
+  }
+
+  Levels[Idx] = PaletteIdx(Runs[Idx].y);
+}
+
+@compute @workgroup_size(64)
+fn Reduce(@builtin(global_invocation_id) Id: vec3<u32>) {
+  let Idx = Id.x + (Id.y * P.Pitch);
+  if (Idx >= LevelSize(P.Level)) {
+    return;
+  }
+
+  let Below = LevelOffset(P.Level - 1u);
+  let First = Idx * Arity;
+  let Last = min(First + Arity, LevelSize(P.Level - 1u));
+  var Most = BackgroundIdx;
+  for (var Child = First; Child < Last; Child = Child + 1u) {
+    Most = MostPermissive(Most, Levels[Below + Child]);
+  }
+
+  Levels[LevelOffset(P.Level) + Idx] = Most;
+}
+
+//
+// Get the index of the run that contains a distance of the tape.
+//
+
+fn FindRun(Distance: u32) -> u32 {
+  var Lo = 0u;
+  var Hi = P.NumberRuns - 1u;
+  while (Lo < Hi) {
+    let Mid = Lo + ((Hi - Lo) / 2u);
+    if (Runs[Mid].x < Distance) {
+      Lo = Mid + 1u;
+    } else {
+      Hi = Mid;
+    }
+  }
+
+  return Lo;
+}
+
+//
+// Get the most permissive palette entry of the runs [First, Last]: the
+// partial groups at both ends are scanned and the tree takes care of the
+// groups in between.
+//
+
+fn RangeMost(First: u32, Last: u32) -> u32 {
+  var Lo = First;
+  var Hi = Last;
+  var Most = BackgroundIdx;
+  for (var Level = 0u; Level < P.NumberLevels; Level = Level + 1u) {
+    let Offset = LevelOffset(Level);
+    if ((Lo / Arity) == (Hi / Arity) || (Level + 1u) == P.NumberLevels) {
+      for (var Idx = Lo; Idx <= Hi; Idx = Idx + 1u) {
+        Most = MostPermissive(Most, Levels[Offset + Idx]);
+      }
+
+      break;
+    }
+
+    for (var Idx = Lo; Idx <= (Lo | (Arity - 1u)); Idx = Idx + 1u) {
+      Most = MostPermissive(Most, Levels[Offset + Idx]);
+    }
+
+    for (var Idx = Hi & ~(Arity - 1u); Idx <= Hi; Idx = Idx + 1u) {
+      Most = MostPermissive(Most, Levels[Offset + Idx]);
+    }
+
+    Lo = (Lo / Arity) + 1u;
+    Hi = (Hi / Arity) - 1u;
+    if (Lo > Hi) {
+      break;
+    }
+  }
+
+  return Most;
+}
+
+//
+// Convert (x, y) coordinates to a distance on a hilbert-curve of a given
+// order; this is the inverse of the state machine of hilbert::D2xy.
+//
+
+fn Xy2d(X: u32, Y: u32, Order: u32) -> u32 {
+  var State = 0u;
+  var Distance = 0u;
+  for (var Bit = Order; Bit > 0u; Bit = Bit - 1u) {
+    let Row = (4u * State) | (((X >> (Bit - 1u)) & 1u) << 1u) |
+              ((Y >> (Bit - 1u)) & 1u);
+    Distance = (Distance << 2u) | ((0x361e9cb4u >> (2u * Row)) & 3u);
+    State = (0x8fe65831u >> (2u * Row)) & 3u;
+  }
+
+  return Distance;
+}
+
+//
+// Render the viewport starting at (OriginX, OriginY) on the curves of order
+// Order - Zoom; the tile a pixel is on gives the high bits of its distance.
+//
+
+@compute @workgroup_size(8, 8)
+fn Render(@builtin(global_invocation_id) Id: vec3<u32>) {
+  if (Id.x >= P.Width || Id.y >= P.Height) {
+    return;
+  }
+
+  let Order = P.Order - P.Zoom;
+  let X = P.OriginX + Id.x;
+  let Y = P.OriginY + Id.y;
+  var Idx = BackgroundIdx;
+  if (X < (P.NumberTiles << Order) && Y < (1u << Order)) {
+    let Shift = 2u * P.Zoom;
+    let Whole = Shift >= 32u;
+    let Mask = select((1u << Shift) - 1u, 0xffffffffu, Whole);
+    let Tile = select((X >> Order) << (2u * P.Order), 0u, P.Order >= 16u);
+    let Curve = Xy2d(X & ((1u << Order) - 1u), Y, Order);
+    let First = Tile | select(Curve << Shift, 0u, Whole);
+    let End = Runs[P.NumberRuns - 1u].x;
+    if (First <= End) {
+      Idx = RangeMost(FindRun(First), FindRun(min(First + Mask, End)));
+    }
+  }
+
+  let Color = Palette[Idx];
+  let Rgb = vec3<u32>(Color >> 16u, Color >> 8u, Color) & vec3<u32>(0xffu);
+  textureStore(Output, Id.xy, vec4<f32>(vec3<f32>(Rgb) / 255.0, 1.0));
+}
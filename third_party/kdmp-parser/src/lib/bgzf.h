@@ -0,0 +1,334 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+
+#include "filemap.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace kdmpparser {
+
+//
+// Reads a file compressed in the BGZF format (what bgzip produces): a series of
+// independent gzip members of at most 64KB of uncompressed data each, that
+// carry their compressed size in a 'BC' extra field. The blocks are indexed
+// when the file is opened, either from the .gzi index that bgzip -i writes
+// next to the file or by hopping from block header to block header, and only
+// the blocks that are read get decompressed. The last decompressed blocks are
+// kept in a small cache.
+//
+
+class BgzfReader_t : public Reader_t {
+  //
+  // Where a block starts in the compressed and uncompressed streams.
+  //
+
+  struct Block_t {
+    uint64_t CompressedOffset = 0;
+    uint64_t UncompressedOffset = 0;
+  };
+
+  //
+  // The size of the fixed part of a block header and of the trailer.
+  //
+
+  static constexpr uint64_t HeaderSize = 12;
+  static constexpr uint64_t TrailerSize = 8;
+  static constexpr uint64_t MaxBlockSize = 0x1'0000;
+
+  //
+  // A decompressed block.
+  //
+
+  struct CachedBlock_t {
+    uint64_t BlockIdx = ~0ULL;
+    uint64_t LastUse = 0;
+    std::vector<uint8_t> Data;
+  };
+
+  //
+  // The cache of decompressed blocks is sharded by block index.
+  //
+
+  static constexpr uint64_t NumberShards = 16;
+  static constexpr uint64_t BlocksPerShard = 4;
+
+  struct Shard_t {
+    std::mutex Lock;
+    std::array<CachedBlock_t, BlocksPerShard> Blocks;
+    uint64_t Clock = 0;
+  };
+
+  FileReader_t File_;
+  std::vector<Block_t> Blocks_;
+  uint64_t Size_ = 0;
+  mutable std::array<Shard_t, NumberShards> Shards_;
+
+  //
+  // Where a block ends in the compressed and uncompressed streams.
+  //
+
+  uint64_t CompressedEnd(const uint64_t BlockIdx) const {
+    return (BlockIdx + 1) < Blocks_.size()
+               ? Blocks_[BlockIdx + 1].CompressedOffset
+               : File_.Size();
+  }
+
+  uint64_t UncompressedEnd(const uint64_t BlockIdx) const {
+    return (BlockIdx + 1) < Blocks_.size()
+               ? Blocks_[BlockIdx + 1].UncompressedOffset
+               : Size_;
+  }
+
+  //
+  // Find the block holding an uncompressed offset.
+  //
+
+  uint64_t FindBlock(const uint64_t Offset) const {
+    const auto &It = std::upper_bound(
+        Blocks_.begin(), Blocks_.end(), Offset,
+        [](const uint64_t Offset, const Block_t &Block) {
+          return Offset < Block.UncompressedOffset;
+        });
+
+    return uint64_t(It - Blocks_.begin()) - 1;
+  }
+
+  //
+  // Read the header of the block at Offset and return its compressed size.
+  //
+
+  uint64_t ReadBlockSize(const uint64_t Offset) const {
+    uint8_t Header[HeaderSize];
+    if (!File_.Read(Offset, Header, sizeof(Header)) || Header[0] != 0x1f ||
+        Header[1] != 0x8b || Header[2] != 8 || (Header[3] & 4) == 0) {
+      return 0;
+    }
+
+    //
+    // Look for the 'BC' subfield in the extra field.
+    //
+
+    const uint16_t ExtraSize = uint16_t(Header[10] | (Header[11] << 8));
+    std::vector<uint8_t> Extra(ExtraSize);
+    if (!File_.Read(Offset + HeaderSize, Extra.data(), Extra.size())) {
+      return 0;
+    }
+
+    for (uint64_t Idx = 0; (Idx + 4) <= Extra.size();) {
+      const uint16_t Length = uint16_t(Extra[Idx + 2] | (Extra[Idx + 3] << 8));
+      if (Extra[Idx] == 'B' && Extra[Idx + 1] == 'C' && Length == 2 &&
+          (Idx + 6) <= Extra.size()) {
+        return uint64_t(Extra[Idx + 4] | (Extra[Idx + 5] << 8)) + 1;
+      }
+
+      Idx += 4 + Length;
+    }
+
+    return 0;
+  }
+
+  //
+  // Read the size of the uncompressed data of a block off its trailer.
+  //
+
+  uint32_t ReadUncompressedSize(const uint64_t Offset,
+                                const uint64_t BlockSize) const {
+    uint8_t Size[4];
+    if (!File_.Read(Offset + BlockSize - sizeof(Size), Size, sizeof(Size))) {
+      return 0;
+    }
+
+    return uint32_t(Size[0]) | (uint32_t(Size[1]) << 8) |
+           (uint32_t(Size[2]) << 16) | (uint32_t(Size[3]) << 24);
+  }
+
+  //
+  // Load the blocks listed in the .gzi index, if there is one. It starts with
+  // the number of entries followed by (compressed offset, uncompressed
+  // offset) pairs for every block but the first one.
+  //
+
+  void LoadIndex(const char *PathFile) {
+    FileReader_t Index;
+    const std::string IndexPath = std::string(PathFile) + ".gzi";
+    FILE *Probe = fopen(IndexPath.c_str(), "rb");
+    if (Probe == nullptr) {
+      return;
+    }
+
+    fclose(Probe);
+    uint64_t NumberEntries = 0;
+    if (!Index.Open(IndexPath.c_str()) ||
+        !Index.Read(0, &NumberEntries, sizeof(NumberEntries)) ||
+        Index.Size() != (sizeof(NumberEntries) +
+                         (NumberEntries * 2 * sizeof(uint64_t)))) {
+      return;
+    }
+
+    std::vector<Block_t> Blocks(NumberEntries);
+    if (!Index.Read(sizeof(NumberEntries), Blocks.data(),
+                    NumberEntries * sizeof(Block_t))) {
+      return;
+    }
+
+    Blocks_.insert(Blocks_.end(), Blocks.begin(), Blocks.end());
+  }
+
+  //
+  // Decompress a block.
+  //
+
+  bool Decompress(const uint64_t BlockIdx, std::vector<uint8_t> &Data) const {
+    const Block_t &Block = Blocks_[BlockIdx];
+    std::vector<uint8_t> Compressed(CompressedEnd(BlockIdx) -
+                                    Block.CompressedOffset);
+    if (!File_.Read(Block.CompressedOffset, Compressed.data(),
+                    Compressed.size())) {
+      return false;
+    }
+
+    Data.resize(UncompressedEnd(BlockIdx) - Block.UncompressedOffset);
+    z_stream Stream = {};
+    if (inflateInit2(&Stream, 16 + MAX_WBITS) != Z_OK) {
+      return false;
+    }
+
+    Stream.next_in = Compressed.data();
+    Stream.avail_in = uInt(Compressed.size());
+    Stream.next_out = Data.data();
+    Stream.avail_out = uInt(Data.size());
+    const int Result = inflate(&Stream, Z_FINISH);
+    inflateEnd(&Stream);
+    return Result == Z_STREAM_END && Stream.avail_out == 0;
+  }
+
+  //
+  // Copy bytes out of a block, decompressing it if it isn't in the cache.
+  //
+
+  bool Copy(const uint64_t BlockIdx, const uint64_t Offset, uint8_t *Buffer,
+            const uint64_t Size) const {
+    Shard_t &Shard = Shards_[BlockIdx % NumberShards];
+    std::lock_guard<std::mutex> Lock(Shard.Lock);
+    CachedBlock_t *Cached = nullptr;
+    for (auto &Block : Shard.Blocks) {
+      if (Block.BlockIdx == BlockIdx) {
+        Cached = &Block;
+        break;
+      }
+
+      if (Cached == nullptr || Block.LastUse < Cached->LastUse) {
+        Cached = &Block;
+      }
+    }
+
+    if (Cached->BlockIdx != BlockIdx) {
+      Cached->BlockIdx = ~0ULL;
+      if (!Decompress(BlockIdx, Cached->Data)) {
+        return false;
+      }
+
+      Cached->BlockIdx = BlockIdx;
+    }
+
+    Cached->LastUse = ++Shard.Clock;
+    memcpy(Buffer, Cached->Data.data() + Offset, Size);
+    return true;
+  }
+
+public:
+  BgzfReader_t() = default;
+  BgzfReader_t(const BgzfReader_t &) = delete;
+  BgzfReader_t &operator=(const BgzfReader_t &) = delete;
+
+  bool Open(const char *PathFile) {
+    if (!File_.Open(PathFile)) {
+      return false;
+    }
+
+    //
+    // Start from the index if there is one, and walk the block headers from
+    // the last block it knows about.
+    //
+
+    Blocks_.push_back({0, 0});
+    LoadIndex(PathFile);
+    Block_t Block = Blocks_.back();
+    Blocks_.pop_back();
+    while (Block.CompressedOffset < File_.Size()) {
+      const uint64_t BlockSize = ReadBlockSize(Block.CompressedOffset);
+      if (BlockSize < (HeaderSize + TrailerSize) ||
+          (Block.CompressedOffset + BlockSize) > File_.Size()) {
+        printf("The block at %#llx is not a BGZF block; compress the dump with "
+               "bgzip.\n",
+               (unsigned long long)Block.CompressedOffset);
+        return false;
+      }
+
+      const uint32_t UncompressedSize =
+          ReadUncompressedSize(Block.CompressedOffset, BlockSize);
+      if (UncompressedSize > MaxBlockSize) {
+        printf("The block at %#llx is too large.\n",
+               (unsigned long long)Block.CompressedOffset);
+        return false;
+      }
+
+      //
+      // Empty blocks (like the end-of-file marker) are not worth indexing.
+      //
+
+      if (UncompressedSize != 0) {
+        Blocks_.push_back(Block);
+      }
+
+      Block.CompressedOffset += BlockSize;
+      Block.UncompressedOffset += UncompressedSize;
+    }
+
+    Size_ = Block.UncompressedOffset;
+    return true;
+  }
+
+  uint64_t Size() const override { return Size_; }
+
+  bool Read(const uint64_t Offset, void *Buffer,
+            const uint64_t Size) const override {
+    if ((Offset + Size) > Size_) {
+      return false;
+    }
+
+    uint8_t *Bytes = (uint8_t *)Buffer;
+    for (uint64_t Done = 0; Done < Size;) {
+      const uint64_t Current = Offset + Done;
+      const uint64_t BlockIdx = FindBlock(Current);
+      const uint64_t Amount =
+          std::min(Size - Done, UncompressedEnd(BlockIdx) - Current);
+      if (!Copy(BlockIdx, Current - Blocks_[BlockIdx].UncompressedOffset,
+                Bytes + Done, Amount)) {
+        return false;
+      }
+
+      Done += Amount;
+    }
+
+    return true;
+  }
+
+  void WillNeed(const uint64_t Offset, const uint64_t Size) const override {
+    if (Size == 0 || (Offset + Size) > Size_) {
+      return;
+    }
+
+    const uint64_t Start = Blocks_[FindBlock(Offset)].CompressedOffset;
+    const uint64_t End = CompressedEnd(FindBlock(Offset + Size - 1));
+    File_.WillNeed(Start, End - Start);
+  }
+};
+
+} // namespace kdmpparser
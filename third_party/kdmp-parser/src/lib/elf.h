@@ -0,0 +1,89 @@
+// Axel '0vercl0k' Souchet - October 14 2026
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace kdmpparser::elf {
+
+//
+// The parts of the ELF format needed to read the memory out of the cores that
+// QEMU/KVM's dump-guest-memory writes: the physical memory is described by the
+// PT_LOAD segments (their physical address is in p_paddr) and the CPU states
+// are in PT_NOTE segments.
+//
+
+#pragma pack(push)
+#pragma pack(1)
+
+struct Header_t {
+  uint8_t Ident[16];
+  uint16_t Type;
+  uint16_t Machine;
+  uint32_t Version;
+  uint64_t Entry;
+  uint64_t ProgramHeaderOffset;
+  uint64_t SectionHeaderOffset;
+  uint32_t Flags;
+  uint16_t HeaderSize;
+  uint16_t ProgramHeaderSize;
+  uint16_t NumberProgramHeaders;
+  uint16_t SectionHeaderSize;
+  uint16_t NumberSectionHeaders;
+  uint16_t SectionNamesIdx;
+};
+
+struct ProgramHeader_t {
+  uint32_t Type;
+  uint32_t Flags;
+  uint64_t Offset;
+  uint64_t VirtualAddress;
+  uint64_t PhysicalAddress;
+  uint64_t FileSize;
+  uint64_t MemorySize;
+  uint64_t Align;
+};
+
+struct NoteHeader_t {
+  uint32_t NameSize;
+  uint32_t DescriptionSize;
+  uint32_t Type;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(Header_t) == 0x40, "Header_t's size looks wrong.");
+static_assert(sizeof(ProgramHeader_t) == 0x38,
+              "ProgramHeader_t's size looks wrong.");
+
+constexpr uint8_t Class64 = 2;
+constexpr uint8_t LittleEndian = 1;
+constexpr uint16_t TypeCore = 4;
+constexpr uint16_t MachineX64 = 62;
+constexpr uint32_t SegmentLoad = 1;
+constexpr uint32_t SegmentNote = 4;
+
+//
+// QEMU stores the state of every vCPU in a "QEMU" note (QEMUCPUState in
+// target/i386/arch_dump.c): a version and a size, the general purpose
+// registers, rip, rflags, ten segments of 24 bytes and then cr0 to cr4.
+//
+
+constexpr char QemuNoteName[] = "QEMU";
+constexpr uint64_t QemuCr3Offset = 8 + (18 * 8) + (10 * 24) + (3 * 8);
+
+inline bool LooksLikeElf(const uint8_t *Bytes, const uint64_t Size) {
+  return Size >= 4 && Bytes[0] == 0x7f && memcmp(Bytes + 1, "ELF", 3) == 0;
+}
+
+//
+// Is this the header of a 64-bit little-endian x64 core?
+//
+
+inline bool LooksGood(const Header_t &Header) {
+  return Header.Ident[4] == Class64 && Header.Ident[5] == LittleEndian &&
+         Header.Type == TypeCore && Header.Machine == MachineX64 &&
+         Header.ProgramHeaderSize == sizeof(ProgramHeader_t);
+}
+
+} // namespace kdmpparser::elf
@@ -1,8 +1,132 @@
 // Axel '0vercl0k' Souchet - April 28 2020
+#pragma once
 #include "platform.h"
+#include <cstdint>
 #include <cstdio>
 
+//
+// Something that can be read from at any offset, by several threads at the
+// same time.
+//
+
+class Reader_t {
+public:
+  virtual ~Reader_t() = default;
+
+  //
+  // Size of the content, in bytes.
+  //
+
+  virtual uint64_t Size() const = 0;
+
+  //
+  // Read Size bytes at Offset.
+  //
+
+  virtual bool Read(const uint64_t Offset, void *Buffer,
+                    const uint64_t Size) const = 0;
+
+  //
+  // Let the OS know that a range is about to be read.
+  //
+
+  virtual void WillNeed(const uint64_t Offset, const uint64_t Size) const = 0;
+};
+
 #if defined(WINDOWS)
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//
+// Is a file on a network share? Faulting the pages of a view of such a file
+// is served one page at a time by the redirector.
+//
+
+inline bool IsOnNetworkShare(const char *PathFile) {
+  char FullPath[MAX_PATH];
+  const DWORD Length = GetFullPathNameA(PathFile, MAX_PATH, FullPath, nullptr);
+  if (Length < 3 || Length >= MAX_PATH) {
+    return false;
+  }
+
+  if (FullPath[0] == '\\' && FullPath[1] == '\\') {
+    return true;
+  }
+
+  const char Root[] = {FullPath[0], ':', '\\', '\0'};
+  return GetDriveTypeA(Root) == DRIVE_REMOTE;
+}
+
+//
+// Memory backing the page cache, in large pages when the user has the right
+// to lock pages in memory (SeLockMemoryPrivilege), so that walking a large
+// cache doesn't miss the TLB on every page.
+//
+
+class PageArena_t {
+  uint8_t *Base_ = nullptr;
+
+  //
+  // Enable SeLockMemoryPrivilege in the token of the process; large pages
+  // can't be allocated if the privilege is only held, and it is disabled by
+  // default.
+  //
+
+  static bool EnableLockMemoryPrivilege() {
+    HANDLE Token = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(),
+                          TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &Token)) {
+      return false;
+    }
+
+    TOKEN_PRIVILEGES Privileges = {};
+    Privileges.PrivilegeCount = 1;
+    Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    const bool Enabled =
+        LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege",
+                              &Privileges.Privileges[0].Luid) &&
+        AdjustTokenPrivileges(Token, FALSE, &Privileges, 0, nullptr,
+                              nullptr) &&
+        GetLastError() == ERROR_SUCCESS;
+    CloseHandle(Token);
+    return Enabled;
+  }
+
+public:
+  ~PageArena_t() {
+    if (Base_ != nullptr) {
+      VirtualFree(Base_, 0, MEM_RELEASE);
+      Base_ = nullptr;
+    }
+  }
+
+  PageArena_t() = default;
+  PageArena_t(const PageArena_t &) = delete;
+  PageArena_t &operator=(const PageArena_t &) = delete;
+
+  uint8_t *Base() const { return Base_; }
+
+  bool Allocate(const uint64_t Size) {
+    const uint64_t LargePage = GetLargePageMinimum();
+    if (LargePage != 0 && EnableLockMemoryPrivilege()) {
+      const uint64_t LargeSize = (Size + LargePage - 1) & ~(LargePage - 1);
+      Base_ = (uint8_t *)VirtualAlloc(
+          nullptr, LargeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+          PAGE_READWRITE);
+    }
+
+    if (Base_ == nullptr) {
+      Base_ = (uint8_t *)VirtualAlloc(nullptr, Size, MEM_RESERVE | MEM_COMMIT,
+                                      PAGE_READWRITE);
+    }
+
+    return Base_ != nullptr;
+  }
+};
+
 class FileMap_t {
   //
   // Handle to the input file.
@@ -22,6 +146,12 @@ class FileMap_t {
 
   PVOID ViewBase_ = nullptr;
 
+  //
+  // Size of the file view.
+  //
+
+  uint64_t ViewSize_ = 0;
+
 public:
   ~FileMap_t() {
     //
@@ -57,6 +187,19 @@ public:
   FileMap_t &operator=(const FileMap_t &) = delete;
 
   void *ViewBase() { return ViewBase_; }
+  uint64_t ViewSize() const { return ViewSize_; }
+
+  //
+  // Let the OS know that a range of the view is about to be read, so that it
+  // pages it in in the background.
+  //
+
+  void WillNeed(const uint64_t Offset, const uint64_t Size) const {
+    WIN32_MEMORY_RANGE_ENTRY Range;
+    Range.VirtualAddress = (uint8_t *)ViewBase_ + Offset;
+    Range.NumberOfBytes = Size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+  }
 
   bool MapFile(const char *PathFile) {
     bool Success = true;
@@ -139,6 +282,11 @@ public:
     ViewBase_ = ViewBase;
     ViewBase = nullptr;
 
+    LARGE_INTEGER Size;
+    if (GetFileSizeEx(File_, &Size)) {
+      ViewSize_ = Size.QuadPart;
+    }
+
   clean:
 
     //
@@ -163,6 +311,190 @@ public:
   }
 };
 
+//
+// Reads the file with explicit reads instead of mapping it; page faults are
+// slow on some storages (network shares, FUSE file systems) and they defeat
+// readahead.
+//
+
+class FileReader_t : public Reader_t {
+  //
+  // Handle to the input file and its size.
+  //
+
+  HANDLE File_ = INVALID_HANDLE_VALUE;
+  uint64_t Size_ = 0;
+
+  //
+  // The file is opened for overlapped I/O. There is no readahead hint for file
+  // handles, so WillNeed issues overlapped reads into buffers that are thrown
+  // away: they go through the system cache, so the reads that follow are
+  // served from memory. Their completions are queued on a completion port and
+  // reaped in batches when the buffers run out; the hints are dropped when
+  // MaxReadaheads reads are already in flight.
+  //
+
+  static constexpr uint64_t MaxReadaheads = 64;
+  static constexpr uint64_t ReadaheadSize = 0x1'0000;
+
+  struct Readahead_t {
+    OVERLAPPED Overlapped = {};
+    uint8_t Buffer[ReadaheadSize];
+  };
+
+  HANDLE Port_ = nullptr;
+  mutable std::mutex Lock_;
+  mutable std::vector<std::unique_ptr<Readahead_t>> Readaheads_;
+  mutable std::vector<Readahead_t *> Free_;
+
+  //
+  // Get back the buffers of the readaheads that completed; this waits for at
+  // least one of them for up to Timeout milliseconds.
+  //
+
+  void Reap(const DWORD Timeout) const {
+    OVERLAPPED_ENTRY Entries[MaxReadaheads];
+    ULONG NumberEntries = 0;
+    if (!GetQueuedCompletionStatusEx(Port_, Entries, MaxReadaheads,
+                                     &NumberEntries, Timeout, FALSE)) {
+      return;
+    }
+
+    for (ULONG Idx = 0; Idx < NumberEntries; Idx++) {
+      Free_.emplace_back(CONTAINING_RECORD(Entries[Idx].lpOverlapped,
+                                           Readahead_t, Overlapped));
+    }
+  }
+
+  //
+  // An event per thread to wait for its reads with; the low bit of the handle
+  // keeps their completions off the port.
+  //
+
+  struct Event_t {
+    HANDLE Handle = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    ~Event_t() { CloseHandle(Handle); }
+  };
+
+public:
+  ~FileReader_t() override {
+    if (Port_ != nullptr) {
+      CancelIoEx(File_, nullptr);
+      while (Free_.size() < Readaheads_.size()) {
+        Reap(INFINITE);
+      }
+
+      CloseHandle(Port_);
+      Port_ = nullptr;
+    }
+
+    if (File_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(File_);
+      File_ = INVALID_HANDLE_VALUE;
+    }
+  }
+
+  FileReader_t() = default;
+  FileReader_t(const FileReader_t &) = delete;
+  FileReader_t &operator=(const FileReader_t &) = delete;
+
+  uint64_t Size() const override { return Size_; }
+
+  bool Open(const char *PathFile) {
+    File_ = CreateFileA(PathFile, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING,
+                        FILE_FLAG_RANDOM_ACCESS | FILE_FLAG_OVERLAPPED,
+                        nullptr);
+
+    if (File_ == INVALID_HANDLE_VALUE) {
+      printf("CreateFile failed with GLE=%lu.\n", GetLastError());
+      return false;
+    }
+
+    LARGE_INTEGER Size;
+    if (!GetFileSizeEx(File_, &Size)) {
+      printf("GetFileSizeEx failed with GLE=%lu.\n", GetLastError());
+      return false;
+    }
+
+    Port_ = CreateIoCompletionPort(File_, nullptr, 0, 1);
+    if (Port_ == nullptr) {
+      printf("CreateIoCompletionPort failed with GLE=%lu.\n", GetLastError());
+      return false;
+    }
+
+    Size_ = Size.QuadPart;
+    return true;
+  }
+
+  //
+  // Read Size bytes at Offset; this can be called by several threads at the
+  // same time.
+  //
+
+  bool Read(const uint64_t Offset, void *Buffer,
+            const uint64_t Size) const override {
+    thread_local Event_t Event;
+    uint8_t *Bytes = (uint8_t *)Buffer;
+    for (uint64_t Done = 0; Done < Size;) {
+      const uint64_t Current = Offset + Done;
+      OVERLAPPED Overlapped = {};
+      Overlapped.Offset = DWORD(Current);
+      Overlapped.OffsetHigh = DWORD(Current >> 32);
+      Overlapped.hEvent = HANDLE(ULONG_PTR(Event.Handle) | 1);
+      const uint64_t Left = Size - Done;
+      const DWORD Amount = Left > 0x1000'0000 ? 0x1000'0000 : DWORD(Left);
+      DWORD AmountRead = 0;
+      if (!ReadFile(File_, Bytes + Done, Amount, nullptr, &Overlapped) &&
+          GetLastError() != ERROR_IO_PENDING) {
+        return false;
+      }
+
+      if (!GetOverlappedResult(File_, &Overlapped, &AmountRead, TRUE) ||
+          AmountRead == 0) {
+        return false;
+      }
+
+      Done += AmountRead;
+    }
+
+    return true;
+  }
+
+  //
+  // Read a range of the file in the background, so that it is in the system
+  // cache by the time it is read.
+  //
+
+  void WillNeed(const uint64_t Offset, const uint64_t Size) const override {
+    std::lock_guard<std::mutex> Lock(Lock_);
+    if (Free_.empty()) {
+      Reap(0);
+    }
+
+    if (Free_.empty()) {
+      if (Readaheads_.size() == MaxReadaheads) {
+        return;
+      }
+
+      Readaheads_.emplace_back(std::make_unique<Readahead_t>());
+      Free_.emplace_back(Readaheads_.back().get());
+    }
+
+    Readahead_t *Readahead = Free_.back();
+    Free_.pop_back();
+    Readahead->Overlapped = {};
+    Readahead->Overlapped.Offset = DWORD(Offset);
+    Readahead->Overlapped.OffsetHigh = DWORD(Offset >> 32);
+    const DWORD Amount = DWORD((std::min)(Size, ReadaheadSize));
+    if (!ReadFile(File_, Readahead->Buffer, Amount, nullptr,
+                  &Readahead->Overlapped) &&
+        GetLastError() != ERROR_IO_PENDING) {
+      Free_.emplace_back(Readahead);
+    }
+  }
+};
+
 #elif defined(LINUX)
 
 #include <errno.h>
@@ -172,6 +504,45 @@ public:
 #include <sys/types.h>
 #include <unistd.h>
 
+//
+// Memory backing the page cache, in transparent huge pages when the kernel
+// allows it, so that walking a large cache doesn't miss the TLB on every page.
+//
+
+class PageArena_t {
+  uint8_t *Base_ = nullptr;
+  uint64_t Size_ = 0;
+
+public:
+  ~PageArena_t() {
+    if (Base_ != nullptr) {
+      munmap(Base_, Size_);
+      Base_ = nullptr;
+    }
+  }
+
+  PageArena_t() = default;
+  PageArena_t(const PageArena_t &) = delete;
+  PageArena_t &operator=(const PageArena_t &) = delete;
+
+  uint8_t *Base() const { return Base_; }
+
+  bool Allocate(const uint64_t Size) {
+    void *Base = mmap(nullptr, Size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (Base == MAP_FAILED) {
+      return false;
+    }
+
+#if defined(MADV_HUGEPAGE)
+    madvise(Base, Size, MADV_HUGEPAGE);
+#endif
+    Base_ = (uint8_t *)Base;
+    Size_ = Size;
+    return true;
+  }
+};
+
 class FileMap_t {
   void *ViewBase_ = nullptr;
   off_t ViewSize_ = 0;
@@ -196,6 +567,19 @@ public:
   FileMap_t &operator=(const FileMap_t &) = delete;
 
   void *ViewBase() { return ViewBase_; }
+  uint64_t ViewSize() const { return ViewSize_; }
+
+  //
+  // Let the OS know that a range of the view is about to be read, so that it
+  // pages it in in the background.
+  //
+
+  void WillNeed(const uint64_t Offset, const uint64_t Size) const {
+    const uint64_t PageMask = 0xfff;
+    const uint64_t Start = Offset & ~PageMask;
+    const uint64_t End = (Offset + Size + PageMask) & ~PageMask;
+    madvise((uint8_t *)ViewBase_ + Start, End - Start, MADV_WILLNEED);
+  }
 
   bool MapFile(const char *PathFile) {
     Fd_ = open(PathFile, O_RDONLY);
@@ -216,4 +600,81 @@ public:
   }
 };
 
-#endif
\ No newline at end of file
+//
+// Reads the file with explicit reads instead of mapping it; page faults are
+// slow on some storages (network shares, FUSE file systems) and they defeat
+// readahead.
+//
+
+class FileReader_t : public Reader_t {
+  int Fd_ = -1;
+  uint64_t Size_ = 0;
+
+public:
+  ~FileReader_t() override {
+    if (Fd_ != -1) {
+      close(Fd_);
+      Fd_ = -1;
+    }
+  }
+
+  FileReader_t() = default;
+  FileReader_t(const FileReader_t &) = delete;
+  FileReader_t &operator=(const FileReader_t &) = delete;
+
+  uint64_t Size() const override { return Size_; }
+
+  bool Open(const char *PathFile) {
+    Fd_ = open(PathFile, O_RDONLY);
+    if (Fd_ < 0) {
+      perror("Could not open dump file.\n");
+      return false;
+    }
+
+    struct stat Stat;
+    if (fstat(Fd_, &Stat) < 0) {
+      perror("Could not stat dump file.\n");
+      return false;
+    }
+
+    Size_ = Stat.st_size;
+    posix_fadvise(Fd_, 0, 0, POSIX_FADV_RANDOM);
+    return true;
+  }
+
+  //
+  // Read Size bytes at Offset; this can be called by several threads at the
+  // same time.
+  //
+
+  bool Read(const uint64_t Offset, void *Buffer,
+            const uint64_t Size) const override {
+    uint8_t *Bytes = (uint8_t *)Buffer;
+    for (uint64_t Done = 0; Done < Size;) {
+      const ssize_t AmountRead =
+          pread(Fd_, Bytes + Done, Size - Done, off_t(Offset + Done));
+      if (AmountRead < 0 && errno == EINTR) {
+        continue;
+      }
+
+      if (AmountRead <= 0) {
+        return false;
+      }
+
+      Done += AmountRead;
+    }
+
+    return true;
+  }
+
+  //
+  // Let the OS know that a range of the file is about to be read, so that it
+  // reads it in the background.
+  //
+
+  void WillNeed(const uint64_t Offset, const uint64_t Size) const override {
+    posix_fadvise(Fd_, off_t(Offset), off_t(Size), POSIX_FADV_WILLNEED);
+  }
+};
+
+#endif
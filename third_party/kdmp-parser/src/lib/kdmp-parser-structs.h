@@ -20,7 +20,20 @@ struct uint128_t {
 
 static_assert(sizeof(uint128_t) == 16, "uint128_t's size looks wrong.");
 
-enum class DumpType_t : uint32_t { FullDump = 1, KernelDump = 2, BMPDump = 5 };
+//
+// The type of a dump; the last ones aren't Windows crash-dumps: memory
+// snapshots (an ELF core from QEMU's dump-guest-memory, or a raw copy of the
+// physical memory) and the memory of a live target.
+//
+
+enum class DumpType_t : uint32_t {
+  FullDump = 1,
+  KernelDump = 2,
+  BMPDump = 5,
+  ElfDump = 0x1'00,
+  RawDump = 0x1'01,
+  LiveDump = 0x1'02
+};
 
 //
 // Save off the alignement setting and disable
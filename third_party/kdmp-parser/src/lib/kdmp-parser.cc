@@ -3,58 +3,286 @@
 
 namespace kdmpparser {
 
-bool KernelDumpParser::Parse(const char *PathFile) {
+//
+// The bits of the address of the next table (or of the page) in an EPT or a
+// nested page table entry.
+//
+
+constexpr uint64_t NestedAddressMask = 0x000f'ffff'ffff'f000;
+
+bool KernelDumpParser::Parse(const char *PathFile,
+                             const ReaderType_t ReaderType,
+                             const uint64_t CacheSize,
+                             const uint64_t NumberThreads) {
 
   //
   // Copy the path file.
   //
 
   PathFile_ = PathFile;
+  ReaderType_ = ReaderType;
+  NumberThreads_ = std::max(uint64_t(1), NumberThreads);
+  PageCache_.SetCapacity(CacheSize);
 
   //
-  // Map a view of the file.
+  // A compressed dump can't be mapped; the dumps read through a reader of the
+  // user are read as they are.
   //
 
-  if (!MapFile()) {
-    printf("MapFile failed.\n");
+  if (Reader_ == nullptr && IsCompressed(PathFile_)) {
+#if defined(KDMP_BGZF)
+    ReaderType_ = ReaderType_t::Pread;
+#else
+    printf("The dump is compressed but the parser was built without zlib.\n");
     return false;
+#endif
+  }
+
+#if defined(WINDOWS)
+  //
+  // The faults on a view of a dump on a network share are served a page at a
+  // time, so those are read (with readaheads) instead of being mapped.
+  //
+
+  if (Reader_ == nullptr && IsOnNetworkShare(PathFile_)) {
+    ReaderType_ = ReaderType_t::Pread;
   }
+#endif
 
   //
-  // Parse the DMP_HEADER.
+  // Map a view of the file, or read its headers.
   //
 
-  if (!ParseDmpHeader()) {
-    printf("ParseDmpHeader failed.\n");
+  using Clock_t = std::chrono::steady_clock;
+  const auto MapStart = Clock_t::now();
+  if (ReaderType_ == ReaderType_t::Pread) {
+    if (!ReadHeaders()) {
+      printf("ReadHeaders failed.\n");
+      return false;
+    }
+  } else if (!MapFile()) {
+    printf("MapFile failed.\n");
     return false;
   }
 
+  View_ = (const uint8_t *)FileMap_.ViewBase();
+
   //
-  // Retrieve the physical memory according to the type of dump we have.
+  // Memory snapshots (ELF cores and raw copies of the physical memory)
+  // describe their memory on their own; everything else is a crash-dump.
   //
 
-  if (DmpHdr_->DumpType == DumpType_t::FullDump) {
-    if (!BuildPhysmemFullDump()) {
-      printf("BuildPhysmemFullDump failed.\n");
+  const auto PhysmemStart = Clock_t::now();
+  const uint8_t *Magic = GetHeaderBytes(0, 4);
+  if (Magic != nullptr && elf::LooksLikeElf(Magic, 4)) {
+    ParseStats_.Map = PhysmemStart - MapStart;
+    DumpType_ = DumpType_t::ElfDump;
+    if (!BuildPhysmemElfDump()) {
+      printf("BuildPhysmemElfDump failed.\n");
+      return false;
+    }
+
+    PhysmemBuilt_ = true;
+  } else if (IsRaw(PathFile_)) {
+    ParseStats_.Map = PhysmemStart - MapStart;
+    DumpType_ = DumpType_t::RawDump;
+    if (!BuildPhysmemRawDump()) {
+      printf("BuildPhysmemRawDump failed.\n");
+      return false;
+    }
+
+    PhysmemBuilt_ = true;
+  } else {
+
+    //
+    // Parse the DMP_HEADER.
+    //
+
+    if (!ParseDmpHeader()) {
+      printf("ParseDmpHeader failed.\n");
       return false;
     }
-  } else if (DmpHdr_->DumpType == DumpType_t::BMPDump) {
-    if (!BuildPhysmemBMPDump()) {
-      printf("BuildPhysmemBMPDump failed.\n");
+
+    ParseStats_.Map = PhysmemStart - MapStart;
+    DumpType_ = DmpHdr_->DumpType;
+    DirectoryTableBase_ = DmpHdr_->DirectoryTableBase;
+
+    //
+    // Retrieve the physical memory according to the type of dump we have.
+    //
+
+    if (DumpType_ == DumpType_t::FullDump) {
+      if (!BuildPhysmemFullDump()) {
+        printf("BuildPhysmemFullDump failed.\n");
+        return false;
+      }
+
+      PhysmemBuilt_ = true;
+    } else if (DumpType_ == DumpType_t::BMPDump) {
+
+      //
+      // The pages of a BMP dump are looked up on demand through the bitmap;
+      // the physmem is only built if the user asks for it.
+      //
+
+      if (!BuildBitmapIndex()) {
+        printf("BuildBitmapIndex failed.\n");
+        return false;
+      }
+    }
+  }
+
+  ParseStats_.Physmem = Clock_t::now() - PhysmemStart;
+  return true;
+}
+
+bool KernelDumpParser::ParseReader(const char *Name,
+                                   std::unique_ptr<Reader_t> Reader,
+                                   const uint64_t CacheSize) {
+
+  //
+  // ReadHeaders only opens the file if there isn't a reader already.
+  //
+
+  Reader_ = std::move(Reader);
+  return Parse(Name, ReaderType_t::Pread, CacheSize);
+}
+
+bool KernelDumpParser::ParseLive(const char *PathFile,
+                                 const std::vector<MemoryRegion_t> &Regions,
+                                 const uint64_t CacheSize) {
+  PathFile_ = PathFile;
+  ReaderType_ = ReaderType_t::Pread;
+  DumpType_ = DumpType_t::LiveDump;
+  PageCache_.SetCapacity(CacheSize);
+
+  using Clock_t = std::chrono::steady_clock;
+  const auto MapStart = Clock_t::now();
+  auto File = std::make_unique<FileReader_t>();
+  if (!File->Open(PathFile_)) {
+    printf("Could not open %s.\n", PathFile_);
+    return false;
+  }
+
+  Reader_ = std::move(File);
+  const auto PhysmemStart = Clock_t::now();
+  ParseStats_.Map = PhysmemStart - MapStart;
+  for (const auto &Region : Regions) {
+    if (Page::Offset(Region.PhysicalAddress) != 0 ||
+        Page::Offset(Region.Offset) != 0) {
+      printf("The region at %#" PRIx64 " isn't page aligned.\n",
+             Region.PhysicalAddress);
       return false;
     }
+
+    Physmem_.AddRun(Region.PhysicalAddress / Page::Size,
+                    Region.Size / Page::Size, Region.Offset);
   }
 
+  Physmem_.Finalize();
+  PhysmemBuilt_ = true;
+  ParseStats_.Physmem = Clock_t::now() - PhysmemStart;
   return true;
 }
 
+bool KernelDumpParser::Nest(const uint64_t Pointer, const NestedPaging_t Type) {
+
+  //
+  // The page-walk length of an EPT pointer (bits 5:3) is the number of levels
+  // minus one; the nested page tables have the same number of levels as the
+  // host.
+  //
+
+  uint64_t NumberLevels = 4;
+  if (Type == NestedPaging_t::Ept) {
+    NumberLevels = ((Pointer >> 3) & 7) + 1;
+    if (NumberLevels != 4 && NumberLevels != 5) {
+      printf("The EPT pointer %#" PRIx64 " has a page-walk length of %" PRIu64
+             ".\n",
+             Pointer, NumberLevels - 1);
+      return false;
+    }
+  }
+
+  Physmem_t Guest;
+  WalkNested(Type, Page::Align(Pointer) & NestedAddressMask, NumberLevels - 1,
+             0, Guest);
+  if (Guest.size() == 0) {
+    printf("The second stage at %#" PRIx64 " doesn't map anything.\n",
+           Pointer);
+    return false;
+  }
+
+  Guest.Finalize();
+  Physmem_ = std::move(Guest);
+  PhysmemBuilt_ = true;
+  Nested_ = true;
+  DirectoryTableBase_ = 0;
+  return true;
+}
+
+void KernelDumpParser::WalkNested(const NestedPaging_t Type,
+                                  const uint64_t TableAddress,
+                                  const uint64_t Level,
+                                  const uint64_t GuestBase,
+                                  Physmem_t &Guest) const {
+  const uint8_t *Table = GetPhysicalPage(TableAddress);
+  if (Table == nullptr) {
+    return;
+  }
+
+  std::array<uint64_t, 512> Entries;
+  memcpy(Entries.data(), Table, sizeof(Entries));
+  ReleasePhysicalPage(TableAddress);
+
+  //
+  // An EPT entry is present if it can be read, written or executed; a nested
+  // page table entry is a regular page table entry. Both have the large page
+  // bit at the same place.
+  //
+
+  const uint64_t PresentMask = Type == NestedPaging_t::Ept ? 0b111 : 0b1;
+  const uint64_t Shift = 12 + (9 * Level);
+  const uint64_t Size = 1ULL << Shift;
+  for (uint64_t Idx = 0; Idx < Entries.size(); Idx++) {
+    const uint64_t Entry = Entries[Idx];
+    if ((Entry & PresentMask) == 0) {
+      continue;
+    }
+
+    const uint64_t GuestAddress = GuestBase + (Idx << Shift);
+    const bool Large = (Level == 1 || Level == 2) && (Entry & 0x80) != 0;
+    if (Level != 0 && !Large) {
+      WalkNested(Type, Entry & NestedAddressMask, Level - 1, GuestAddress,
+                 Guest);
+      continue;
+    }
+
+    //
+    // Map the pages of the leaf that are in the dump; the ones that aren't
+    // are left out like the pages missing from a crash-dump.
+    //
+
+    const uint64_t HostAddress = Entry & NestedAddressMask & ~(Size - 1);
+    for (uint64_t Offset = 0; Offset < Size; Offset += Page::Size) {
+      if (const auto &FileOffset = FindPhysicalPage(HostAddress + Offset)) {
+        Guest.AddRun((GuestAddress + Offset) / Page::Size, 1, *FileOffset);
+      }
+    }
+  }
+}
+
 bool KernelDumpParser::ParseDmpHeader() {
 
   //
-  // The base of the view points on the HEADER64.
+  // The base of the view (or the headers we read) points on the HEADER64.
   //
 
-  DmpHdr_ = (HEADER64 *)FileMap_.ViewBase();
+  DmpHdr_ = (HEADER64 *)GetHeaderBytes(0, sizeof(HEADER64));
+  if (DmpHdr_ == nullptr) {
+    printf("The file is too small to be a dump.\n");
+    return false;
+  }
 
   //
   // Now let's make sure the structures look right.
@@ -74,7 +302,7 @@ const CONTEXT *KernelDumpParser::GetContext() {
   // Give the user a view of the context record.
   //
 
-  return &DmpHdr_->ContextRecord;
+  return DmpHdr_ == nullptr ? nullptr : &DmpHdr_->ContextRecord;
 }
 
 const BugCheckParameters_t KernelDumpParser::GetBugCheckParameters() {
@@ -83,6 +311,10 @@ const BugCheckParameters_t KernelDumpParser::GetBugCheckParameters() {
   // Give the user a view of the bugcheck parameters.
   //
 
+  if (DmpHdr_ == nullptr) {
+    return {};
+  }
+
   BugCheckParameters_t Parameters = {
       DmpHdr_->BugCheckCode,
       {DmpHdr_->BugCheckCodeParameter[0], DmpHdr_->BugCheckCodeParameter[1],
@@ -91,48 +323,293 @@ const BugCheckParameters_t KernelDumpParser::GetBugCheckParameters() {
   return Parameters;
 }
 
-DumpType_t KernelDumpParser::GetDumpType() { return DmpHdr_->DumpType; }
+DumpType_t KernelDumpParser::GetDumpType() { return DumpType_; }
 
 bool KernelDumpParser::MapFile() { return FileMap_.MapFile(PathFile_); }
 
-bool KernelDumpParser::BuildPhysmemBMPDump() {
-  const uint8_t *Page = (uint8_t *)DmpHdr_ + DmpHdr_->BmpHeader.FirstPage;
-  const uint64_t BitmapSize = DmpHdr_->BmpHeader.Pages / 8;
-  const uint8_t *Bitmap = DmpHdr_->BmpHeader.Bitmap;
+bool KernelDumpParser::IsCompressed(const char *PathFile) {
+  FileReader_t File;
+  uint8_t Magic[2] = {};
+  return File.Open(PathFile) && File.Read(0, Magic, sizeof(Magic)) &&
+         Magic[0] == 0x1f && Magic[1] == 0x8b;
+}
+
+bool KernelDumpParser::ReadHeaders() {
+#if defined(KDMP_BGZF)
+  if (Reader_ == nullptr && IsCompressed(PathFile_)) {
+    auto Bgzf = std::make_unique<BgzfReader_t>();
+    if (!Bgzf->Open(PathFile_)) {
+      return false;
+    }
+
+    Reader_ = std::move(Bgzf);
+  }
+#endif
+
+  if (Reader_ == nullptr) {
+    auto File = std::make_unique<FileReader_t>();
+    if (!File->Open(PathFile_)) {
+      return false;
+    }
+
+    Reader_ = std::move(File);
+  }
 
   //
-  // Walk the bitmap byte per byte.
+  // Read the HEADER64 first; BMP dumps have the bitmap right after it, and
+  // the first page tells us where it ends.
   //
 
-  for (uint64_t BitmapIdx = 0; BitmapIdx < BitmapSize; BitmapIdx++) {
+  Headers_.resize(std::min(uint64_t(sizeof(HEADER64)), Reader_->Size()));
+  if (!Reader_->Read(0, Headers_.data(), Headers_.size())) {
+    printf("Could not read the header.\n");
+    return false;
+  }
+
+  if (Headers_.size() < sizeof(HEADER64)) {
+    return true;
+  }
+
+  const HEADER64 *Header = (HEADER64 *)Headers_.data();
+  if (!Header->LooksGood() || Header->DumpType != DumpType_t::BMPDump) {
+    return true;
+  }
+
+  const uint64_t FirstPage = Header->BmpHeader.FirstPage;
+  const uint64_t BitmapEnd =
+      uint64_t(Header->BmpHeader.Bitmap - (uint8_t *)Header) +
+      (Header->BmpHeader.Pages / 8);
+  if (FirstPage > Reader_->Size() || BitmapEnd > FirstPage) {
+    printf("The bitmap looks wrong.\n");
+    return false;
+  }
+
+  if (FirstPage > Headers_.size()) {
+    const uint64_t Size = Headers_.size();
+    Headers_.resize(FirstPage);
+    if (!Reader_->Read(Size, Headers_.data() + Size, FirstPage - Size)) {
+      printf("Could not read the bitmap.\n");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const uint8_t *KernelDumpParser::GetHeaderBytes(const uint64_t Offset,
+                                                const uint64_t Size) {
+  const uint64_t End = Offset + Size;
+  if (End < Offset) {
+    return nullptr;
+  }
+
+  if (ReaderType_ != ReaderType_t::Pread) {
+    return End <= FileMap_.ViewSize() ? View_ + Offset : nullptr;
+  }
+
+  //
+  // Read what is missing; this moves the headers read so far.
+  //
+
+  if (End > Reader_->Size()) {
+    return nullptr;
+  }
+
+  if (End > Headers_.size()) {
+    const uint64_t Read = Headers_.size();
+    Headers_.resize(End);
+    if (!Reader_->Read(Read, Headers_.data() + Read, End - Read)) {
+      Headers_.resize(Read);
+      return nullptr;
+    }
+  }
+
+  return Headers_.data() + Offset;
+}
+
+bool KernelDumpParser::IsRaw(const char *PathFile) {
+  const char *Extension = strrchr(PathFile, '.');
+  return Extension != nullptr &&
+         (strcmp(Extension, ".raw") == 0 || strcmp(Extension, ".mem") == 0);
+}
+
+bool KernelDumpParser::BuildPhysmemElfDump() {
+  const uint8_t *HeaderBytes = GetHeaderBytes(0, sizeof(elf::Header_t));
+  if (HeaderBytes == nullptr) {
+    printf("The file is too small to be an ELF core.\n");
+    return false;
+  }
+
+  elf::Header_t Header;
+  memcpy(&Header, HeaderBytes, sizeof(Header));
+  if (!elf::LooksGood(Header)) {
+    printf("Only the ELF cores of x64 machines are supported.\n");
+    return false;
+  }
+
+  //
+  // Copy the program headers as reading the notes might move them.
+  //
+
+  std::vector<elf::ProgramHeader_t> Segments(Header.NumberProgramHeaders);
+  const uint64_t SegmentsSize = Segments.size() * sizeof(elf::ProgramHeader_t);
+  const uint8_t *SegmentBytes =
+      GetHeaderBytes(Header.ProgramHeaderOffset, SegmentsSize);
+  if (SegmentBytes == nullptr) {
+    printf("The program headers look wrong.\n");
+    return false;
+  }
+
+  memcpy(Segments.data(), SegmentBytes, SegmentsSize);
+  const uint64_t FileSize = ReaderType_ == ReaderType_t::Pread
+                                ? Reader_->Size()
+                                : FileMap_.ViewSize();
+  for (const auto &Segment : Segments) {
+    if (Segment.Type == elf::SegmentNote) {
+      FindQemuDirectoryTableBase(Segment);
+      continue;
+    }
+
+    if (Segment.Type != elf::SegmentLoad || Segment.FileSize == 0) {
+      continue;
+    }
+
+    if (Page::Offset(Segment.PhysicalAddress) != 0 ||
+        Page::Offset(Segment.Offset) != 0) {
+      printf("Skipping the segment at %#" PRIx64 " (not page aligned).\n",
+             Segment.PhysicalAddress);
+      continue;
+    }
+
+    if ((Segment.Offset + Segment.FileSize) > FileSize) {
+      printf("The segment at %#" PRIx64 " is past the end of the file.\n",
+             Segment.PhysicalAddress);
+      return false;
+    }
 
     //
-    // Now walk the bits of the current byte.
+    // The pages of a segment that aren't in the file (past p_filesz) are
+    // left out, like the pages missing from a crash-dump.
     //
 
-    const uint8_t Byte = Bitmap[BitmapIdx];
-    for (uint8_t BitIdx = 0; BitIdx < 8; BitIdx++) {
+    Physmem_.AddRun(Segment.PhysicalAddress / Page::Size,
+                    Segment.FileSize / Page::Size, Segment.Offset);
+  }
 
-      //
-      // If the bit is not set we just skip to the next.
-      //
+  Physmem_.Finalize();
+  return true;
+}
 
-      const bool BitSet = ((Byte >> BitIdx) & 1) == 1;
-      if (!BitSet) {
-        continue;
-      }
+void KernelDumpParser::FindQemuDirectoryTableBase(
+    const elf::ProgramHeader_t &Segment) {
+  if (DirectoryTableBase_ != 0) {
+    return;
+  }
 
-      //
-      // If the bit is one we add the page to the physmem.
-      //
+  const uint8_t *Notes = GetHeaderBytes(Segment.Offset, Segment.FileSize);
+  if (Notes == nullptr) {
+    return;
+  }
+
+  //
+  // Walk the notes until the first QEMU one; its name and its description
+  // are padded to 4 bytes.
+  //
 
-      const uint64_t Pfn = (BitmapIdx * 8) + BitIdx;
-      const uint64_t Pa = Pfn * 0x1000;
-      Physmem_.try_emplace(Pa, Page);
-      Page += 0x1000;
+  const auto &Align = [](const uint64_t Size) { return (Size + 3) & ~3ULL; };
+  uint64_t Offset = 0;
+  while ((Offset + sizeof(elf::NoteHeader_t)) <= Segment.FileSize) {
+    elf::NoteHeader_t Note;
+    memcpy(&Note, Notes + Offset, sizeof(Note));
+    const uint64_t NameOffset = Offset + sizeof(Note);
+    const uint64_t DescriptionOffset = NameOffset + Align(Note.NameSize);
+    const uint64_t End = DescriptionOffset + Align(Note.DescriptionSize);
+    if (End > Segment.FileSize) {
+      return;
     }
+
+    const bool IsQemu =
+        Note.NameSize == sizeof(elf::QemuNoteName) &&
+        memcmp(Notes + NameOffset, elf::QemuNoteName, Note.NameSize) == 0;
+    if (IsQemu && Note.DescriptionSize >= (elf::QemuCr3Offset + 8)) {
+      memcpy(&DirectoryTableBase_,
+             Notes + DescriptionOffset + elf::QemuCr3Offset,
+             sizeof(DirectoryTableBase_));
+      return;
+    }
+
+    Offset = End;
+  }
+}
+
+bool KernelDumpParser::BuildPhysmemRawDump() {
+  const uint64_t FileSize = ReaderType_ == ReaderType_t::Pread
+                                ? Reader_->Size()
+                                : FileMap_.ViewSize();
+  Physmem_.AddRun(0, FileSize / Page::Size, 0);
+  Physmem_.Finalize();
+  return true;
+}
+
+bool KernelDumpParser::BuildBitmapIndex() {
+  const uint64_t NumberBits = (DmpHdr_->BmpHeader.Pages / 8) * 8;
+  BitmapIndex_.Build(DmpHdr_->BmpHeader.Bitmap, NumberBits,
+                     DmpHdr_->BmpHeader.FirstPage, NumberThreads_);
+  return true;
+}
+
+bool KernelDumpParser::BuildPhysmemBMPDump() {
+
+  //
+  // The bitmap is split in slices of qwords that are walked by different
+  // threads; the rank index gives the file offset of the first page of every
+  // slice, so they don't depend on each other. The runs of every slice are
+  // stitched back together in order at the end.
+  //
+
+  constexpr uint64_t WordsPerSlice = 0x10'000;
+  std::vector<Physmem_t> Slices(NumberThreads_);
+  ParallelFor(
+      NumberThreads_, BitmapIndex_.NumberWords(), WordsPerSlice,
+      [&](const uint64_t SliceIdx, const uint64_t Begin, const uint64_t End) {
+        if (Begin == End) {
+          return;
+        }
+
+        Physmem_t &Slice = Slices[SliceIdx];
+        uint64_t Page =
+            BitmapIndex_.FirstPage() + (BitmapIndex_.Rank(Begin * 64) * 0x1000);
+
+        //
+        // Walk the bitmap qword per qword, skipping empty ones.
+        //
+
+        for (uint64_t WordIdx = Begin; WordIdx < End; WordIdx++) {
+
+          //
+          // Now walk the bits set in the current qword.
+          //
+
+          for (uint64_t Word = BitmapIndex_.Word(WordIdx); Word != 0;
+               Word &= Word - 1) {
+
+            //
+            // Add the page to the physmem; contiguous pages end up in the
+            // same run.
+            //
+
+            const uint64_t Pfn = (WordIdx * 64) + TrailingZeros(Word);
+            Slice.AddRun(Pfn, 1, Page);
+            Page += 0x1000;
+          }
+        }
+      });
+
+  for (const auto &Slice : Slices) {
+    Physmem_.Append(Slice);
   }
 
+  Physmem_.Finalize();
   return true;
 }
 
@@ -142,7 +619,8 @@ bool KernelDumpParser::BuildPhysmemFullDump() {
   // Walk through the runs.
   //
 
-  uint8_t *RunBase = (uint8_t *)&DmpHdr_->BmpHeader;
+  uint64_t RunBase =
+      uint64_t((uint8_t *)&DmpHdr_->BmpHeader - (uint8_t *)DmpHdr_);
   const uint32_t NumberOfRuns = DmpHdr_->PhysicalMemoryBlockBuffer.NumberOfRuns;
 
   //
@@ -161,55 +639,36 @@ bool KernelDumpParser::BuildPhysmemFullDump() {
     const uint64_t PageCount = Run->PageCount;
 
     //
-    // Walk the pages from the run.
+    // Now one thing to understand is that the Runs structure allows to skip
+    // for holes in memory. Instead of, padding them with empty spaces to
+    // conserve a 1:1 mapping between physical address and file offset, the
+    // Run gives you the base Pfn. This means that we don't have a 1:1 mapping
+    // between file offset and physical addresses so we need to keep track of
+    // where the Run starts in memory and then we can simply access our pages
+    // one after the other.
+    //
+    // If this is not clear enough, here is a small example:
+    //  Run[0]
+    //    BasePage = 1337, PageCount = 2
+    //  Run[1]
+    //    BasePage = 1400, PageCount = 1
+    //
+    // In the above we clearly see that there is a hole between the two runs;
+    // the dump file has 2+1 memory pages. Their Pfns are: 1337+0, 1337+1,
+    // 1400+0.
+    //
+    // Now if we want to get the file offset of those pages we start at Run0:
+    //   Run0 starts at file offset 0x2000 so Page0 is at file offset 0x2000,
+    //   Page1 is at file offset 0x3000. Run1 starts at file offset
+    //   0x2000+(2*0x1000) so Page3 is at file offset
+    //   0x2000+(2*0x1000)+0x1000.
+    //
+    // That is the reason why a page is found at RunBase + (PageIdx * 0x1000)
+    // instead of RunBase + (Pfn * 0x1000); the Physmem_t keeps the whole run
+    // instead of every page.
     //
 
-    for (uint64_t PageIdx = 0; PageIdx < PageCount; PageIdx++) {
-
-      //
-      // Compute the current PFN as well as the actual physical address of the
-      // page.
-      //
-
-      const uint64_t Pfn = BasePage + PageIdx;
-      const uint64_t Pa = Pfn * 0x1000;
-
-      //
-      // Now one thing to understand is that the Runs structure allows to skip
-      // for holes in memory. Instead of, padding them with empty spaces to
-      // conserve a 1:1 mapping between physical address and file offset, the
-      // Run gives you the base Pfn. This means that we don't have a 1:1 mapping
-      // between file offset and physical addresses so we need to keep track of
-      // where the Run starts in memory and then we can simply access our pages
-      // one after the other.
-      //
-      // If this is not clear enough, here is a small example:
-      //  Run[0]
-      //    BasePage = 1337, PageCount = 2
-      //  Run[1]
-      //    BasePage = 1400, PageCount = 1
-      //
-      // In the above we clearly see that there is a hole between the two runs;
-      // the dump file has 2+1 memory pages. Their Pfns are: 1337+0, 1337+1,
-      // 1400+0.
-      //
-      // Now if we want to get the file offset of those pages we start at Run0:
-      //   Run0 starts at file offset 0x2000 so Page0 is at file offset 0x2000,
-      //   Page1 is at file offset 0x3000. Run1 starts at file offset
-      //   0x2000+(2*0x1000) so Page3 is at file offset
-      //   0x2000+(2*0x1000)+0x1000.
-      //
-      // That is the reason why the computation below is RunBase + (PageIdx *
-      // 0x1000) instead of RunBase + (Pfn * 0x1000).
-
-      const uint8_t *PageBase = RunBase + (PageIdx * 0x1000);
-
-      //
-      // Map the Pfn to a page.
-      //
-
-      Physmem_.try_emplace(Pa, PageBase);
-    }
+    Physmem_.AddRun(BasePage, PageCount, RunBase);
 
     //
     // Move the run base past all the pages in the current run.
@@ -218,6 +677,7 @@ bool KernelDumpParser::BuildPhysmemFullDump() {
     RunBase += PageCount * 0x1000;
   }
 
+  Physmem_.Finalize();
   return true;
 }
 
@@ -234,13 +694,31 @@ uint64_t KernelDumpParser::PhyRead8(const uint64_t PhysicalAddress) const {
     return 0;
   }
 
-  return *reinterpret_cast<const uint64_t *>(PhysicalPage +
-                                             Page::Offset(PhysicalAddress));
+  const uint64_t Value = *reinterpret_cast<const uint64_t *>(
+      PhysicalPage + Page::Offset(PhysicalAddress));
+  ReleasePhysicalPage(Page::Align(PhysicalAddress));
+  return Value;
 }
 
-const Physmem_t &KernelDumpParser::GetPhysmem() { return Physmem_; }
+const Physmem_t &KernelDumpParser::GetPhysmem() {
+
+  //
+  // Build the physmem the first time somebody asks for it.
+  //
+
+  if (!PhysmemBuilt_ && DumpType_ == DumpType_t::BMPDump) {
+    BuildPhysmemBMPDump();
+  }
+
+  PhysmemBuilt_ = true;
+  return Physmem_;
+}
 
 void KernelDumpParser::ShowContextRecord(const uint32_t Prefix = 0) const {
+  if (DmpHdr_ == nullptr) {
+    return;
+  }
+
   const CONTEXT &Context = DmpHdr_->ContextRecord;
   printf("%*srax=%016" PRIx64 " rbx=%016" PRIx64 " rcx=%016" PRIx64 "\n",
          Prefix, "", Context.Rax, Context.Rbx, Context.Rcx);
@@ -315,39 +793,98 @@ void KernelDumpParser::ShowContextRecord(const uint32_t Prefix = 0) const {
 }
 
 void KernelDumpParser::ShowExceptionRecord(const uint32_t Prefix = 0) const {
-  DmpHdr_->Exception.Show(Prefix);
+  if (DmpHdr_ != nullptr) {
+    DmpHdr_->Exception.Show(Prefix);
+  }
 }
 
 void KernelDumpParser::ShowAllStructures(const uint32_t Prefix = 0) const {
-  DmpHdr_->Show(Prefix);
+  if (DmpHdr_ != nullptr) {
+    DmpHdr_->Show(Prefix);
+  }
 }
 
 uint64_t KernelDumpParser::GetDirectoryTableBase() const {
-  return DmpHdr_->DirectoryTableBase;
+  return DirectoryTableBase_;
+}
+
+uint64_t KernelDumpParser::GetPsLoadedModuleList() const {
+  return DmpHdr_ == nullptr ? 0 : DmpHdr_->PsLoadedModuleList;
+}
+
+std::optional<uint64_t>
+KernelDumpParser::FindPhysicalPage(const uint64_t PhysicalAddress) const {
+  if (DumpType_ == DumpType_t::BMPDump && !Nested_) {
+    if (Page::Offset(PhysicalAddress) != 0) {
+      return std::nullopt;
+    }
+
+    return BitmapIndex_.Find(PhysicalAddress / Page::Size);
+  }
+
+  return Physmem_.Find(PhysicalAddress);
 }
 
 const uint8_t *
 KernelDumpParser::GetPhysicalPage(const uint64_t PhysicalAddress) const {
 
   //
-  // Attempt to find the physical address.
+  // Attempt to find the physical address; if it doesn't exist then nullptr is
+  // returned. Otherwise we get a pointer to the content of the page.
   //
 
-  const Physmem_t::const_iterator Pair = Physmem_.find(PhysicalAddress);
+  const auto Offset = FindPhysicalPage(PhysicalAddress);
+  if (!Offset) {
+    return nullptr;
+  }
 
-  //
-  // If it doesn't exist then return nullptr.
-  //
+  if (ReaderType_ == ReaderType_t::Pread) {
+    return PageCache_.Get(*Offset, *Reader_);
+  }
 
-  if (Pair == Physmem_.end()) {
-    return nullptr;
+  return View_ + *Offset;
+}
+
+void KernelDumpParser::PrefetchPhysicalPage(
+    const uint64_t PhysicalAddress) const {
+  const auto Offset = FindPhysicalPage(PhysicalAddress);
+  if (!Offset) {
+    return;
   }
 
-  //
-  // Otherwise we return a pointer to the content of the page.
-  //
+  if (ReaderType_ == ReaderType_t::Pread) {
+    Reader_->WillNeed(*Offset, Page::Size);
+  } else {
+    FileMap_.WillNeed(*Offset, Page::Size);
+  }
+}
+
+void KernelDumpParser::ReleasePhysicalPage(
+    const uint64_t PhysicalAddress) const {
+  if (ReaderType_ != ReaderType_t::Pread) {
+    return;
+  }
+
+  const auto Offset = FindPhysicalPage(PhysicalAddress);
+  if (Offset) {
+    PageCache_.Release(*Offset);
+  }
+}
+
+PageCacheStats_t KernelDumpParser::GetPageCacheStats() const {
+  if (ReaderType_ != ReaderType_t::Pread) {
+    return {};
+  }
+
+  return PageCache_.Stats();
+}
+
+ParseStats_t KernelDumpParser::GetParseStats() const { return ParseStats_; }
 
-  return Pair->second;
+uint64_t KernelDumpParser::GetMemoryUsage() const {
+  return Headers_.capacity() + Physmem_.MemoryUsage() +
+         BitmapIndex_.MemoryUsage() +
+         (GetPageCacheStats().NumberPages * 0x1000);
 }
 
 uint64_t
@@ -449,4 +986,4 @@ KernelDumpParser::GetVirtualPage(const uint64_t VirtualAddress,
 
   return GetPhysicalPage(PhysicalAddress);
 }
-} // namespace kdmpparser
\ No newline at end of file
+} // namespace kdmpparser
@@ -1,14 +1,820 @@
 // Axel '0vercl0k' Souchet - February 15 2019
 #pragma once
 
+#include "elf.h"
 #include "filemap.h"
 #include "kdmp-parser-structs.h"
+#if defined(KDMP_BGZF)
+#include "bgzf.h"
+#endif
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdint>
-#include <unordered_map>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__AVX512VPOPCNTDQ__)
+#include <immintrin.h>
+#endif
 
 namespace kdmpparser {
 
-using Physmem_t = std::unordered_map<uint64_t, const uint8_t *>;
+//
+// Count the number of bits set in a qword.
+//
+
+inline uint64_t PopCount(const uint64_t Value) {
+#if defined(_MSC_VER)
+  return __popcnt64(Value);
+#else
+  return __builtin_popcountll(Value);
+#endif
+}
+
+//
+// Count the number of trailing zero bits in a non-zero qword.
+//
+
+inline uint64_t TrailingZeros(const uint64_t Value) {
+#if defined(_MSC_VER)
+  unsigned long Index = 0;
+  _BitScanForward64(&Index, Value);
+  return Index;
+#else
+  return __builtin_ctzll(Value);
+#endif
+}
+
+//
+// Split [0, NumberItems) into NumberThreads slices of contiguous items and run
+// Body(SliceIdx, Begin, End) on each of them in its own thread; the calling
+// thread handles the first slice. The boundaries of the slices are multiples
+// of Granularity.
+//
+
+template <typename Body_t>
+void ParallelFor(const uint64_t NumberThreads, const uint64_t NumberItems,
+                 const uint64_t Granularity, Body_t &&Body) {
+  const uint64_t NumberUnits = (NumberItems + Granularity - 1) / Granularity;
+  const uint64_t NumberSlices =
+      std::max(uint64_t(1), std::min(NumberThreads, NumberUnits));
+  const auto SliceBegin = [&](const uint64_t SliceIdx) {
+    return std::min(NumberItems,
+                    ((NumberUnits * SliceIdx) / NumberSlices) * Granularity);
+  };
+
+  std::vector<std::thread> Threads;
+  for (uint64_t SliceIdx = 1; SliceIdx < NumberSlices; SliceIdx++) {
+    Threads.emplace_back(Body, SliceIdx, SliceBegin(SliceIdx),
+                         SliceBegin(SliceIdx + 1));
+  }
+
+  Body(uint64_t(0), uint64_t(0), SliceBegin(1));
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+}
+
+//
+// BMP dumps describe the pages they contain with a bitmap indexed by PFN; the
+// pages are stored one after the other in the file, in PFN order. The index
+// below is a rank index: it keeps the number of bits set before every block
+// of 512 bits, so that the file offset of a PFN (its rank in the bitmap) is
+// one table lookup plus the popcount of at most 8 qwords. This is computed
+// without ever materializing a map of all the pages.
+//
+
+class BitmapIndex_t {
+public:
+  //
+  // Number of bits / qwords per block.
+  //
+
+  static constexpr uint64_t BitsPerBlock = 512;
+  static constexpr uint64_t WordsPerBlock = BitsPerBlock / 64;
+
+private:
+  //
+  // The bitmap, its size in bits and the file offset of the first page.
+  //
+
+  const uint8_t *Bitmap_ = nullptr;
+  uint64_t NumberBits_ = 0;
+  uint64_t NumberWords_ = 0;
+  uint64_t FirstPage_ = 0;
+
+  //
+  // Number of bits set before every block.
+  //
+
+  std::vector<uint64_t> Ranks_;
+
+  //
+  // Count the bits set in the first NumberWords qwords of a block, as well as
+  // the bits of the next qword that are below the Mask.
+  //
+
+  uint64_t BlockRank(const uint64_t BlockIdx, const uint64_t NumberWords,
+                     const uint64_t Mask) const {
+    const uint64_t FirstWord = BlockIdx * WordsPerBlock;
+    uint64_t Rank = 0;
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512F__)
+    if ((FirstWord + WordsPerBlock) <= NumberWords_) {
+      const __mmask8 Lanes = __mmask8((1U << NumberWords) - 1);
+      const __m512i Words = _mm512_loadu_si512(Bitmap_ + (FirstWord * 8));
+      const __m512i Counts = _mm512_maskz_popcnt_epi64(Lanes, Words);
+      return uint64_t(_mm512_reduce_add_epi64(Counts)) +
+             PopCount(Word(FirstWord + NumberWords) & Mask);
+    }
+#endif
+
+    for (uint64_t WordIdx = 0; WordIdx < NumberWords; WordIdx++) {
+      Rank += PopCount(Word(FirstWord + WordIdx));
+    }
+
+    if (Mask != 0) {
+      Rank += PopCount(Word(FirstWord + NumberWords) & Mask);
+    }
+
+    return Rank;
+  }
+
+public:
+  //
+  // Read a qword of the bitmap; the bitmap isn't necessarily aligned and its
+  // last qword might be partial.
+  //
+
+  uint64_t Word(const uint64_t WordIdx) const {
+    uint64_t Value = 0;
+    const uint64_t Offset = WordIdx * sizeof(Value);
+    const uint64_t NumberBytes = (NumberBits_ + 7) / 8;
+    if ((Offset + sizeof(Value)) <= NumberBytes) {
+      memcpy(&Value, Bitmap_ + Offset, sizeof(Value));
+      return Value;
+    }
+
+    if (Offset >= NumberBytes) {
+      return 0;
+    }
+
+    memcpy(&Value, Bitmap_ + Offset, NumberBytes - Offset);
+    const uint64_t LastBits = NumberBits_ - (WordIdx * 64);
+    if (LastBits < 64) {
+      Value &= (1ULL << LastBits) - 1;
+    }
+
+    return Value;
+  }
+
+  //
+  // Build the rank index; the blocks are split across threads that count
+  // their slice on their own, and the slices are shifted by the number of
+  // bits set before them once they are all counted.
+  //
+
+  void Build(const uint8_t *Bitmap, const uint64_t NumberBits,
+             const uint64_t FirstPage, const uint64_t NumberThreads = 1) {
+    Bitmap_ = Bitmap;
+    NumberBits_ = NumberBits;
+    NumberWords_ = (NumberBits + 63) / 64;
+    FirstPage_ = FirstPage;
+
+    const uint64_t NumberBlocks =
+        (NumberBits + BitsPerBlock - 1) / BitsPerBlock;
+    Ranks_.resize(NumberBlocks);
+
+    //
+    // A thread is only worth it for large enough slices.
+    //
+
+    constexpr uint64_t BlocksPerSlice = 0x1'000;
+    std::vector<uint64_t> SliceRanks(NumberThreads + 1, 0);
+    ParallelFor(NumberThreads, NumberBlocks, BlocksPerSlice,
+                [&](const uint64_t SliceIdx, const uint64_t Begin,
+                    const uint64_t End) {
+                  uint64_t Rank = 0;
+                  for (uint64_t BlockIdx = Begin; BlockIdx < End; BlockIdx++) {
+                    Ranks_[BlockIdx] = Rank;
+                    Rank += BlockRank(BlockIdx, WordsPerBlock, 0);
+                  }
+
+                  SliceRanks[SliceIdx + 1] = Rank;
+                });
+
+    for (uint64_t SliceIdx = 1; SliceIdx <= NumberThreads; SliceIdx++) {
+      SliceRanks[SliceIdx] += SliceRanks[SliceIdx - 1];
+    }
+
+    ParallelFor(NumberThreads, NumberBlocks, BlocksPerSlice,
+                [&](const uint64_t SliceIdx, const uint64_t Begin,
+                    const uint64_t End) {
+                  const uint64_t SliceRank = SliceRanks[SliceIdx];
+                  if (SliceRank == 0) {
+                    return;
+                  }
+
+                  for (uint64_t BlockIdx = Begin; BlockIdx < End; BlockIdx++) {
+                    Ranks_[BlockIdx] += SliceRank;
+                  }
+                });
+  }
+
+  //
+  // Is this PFN in the dump?
+  //
+
+  bool Has(const uint64_t Pfn) const {
+    if (Pfn >= NumberBits_) {
+      return false;
+    }
+
+    return ((Word(Pfn / 64) >> (Pfn % 64)) & 1) == 1;
+  }
+
+  //
+  // Number of bits set before a PFN; this is its index in the file.
+  //
+
+  uint64_t Rank(const uint64_t Pfn) const {
+    const uint64_t BlockIdx = Pfn / BitsPerBlock;
+    const uint64_t WordInBlock = (Pfn % BitsPerBlock) / 64;
+    const uint64_t Mask = (1ULL << (Pfn % 64)) - 1;
+    return Ranks_[BlockIdx] + BlockRank(BlockIdx, WordInBlock, Mask);
+  }
+
+  //
+  // Find the file offset of the page of a PFN, if it is in the dump.
+  //
+
+  std::optional<uint64_t> Find(const uint64_t Pfn) const {
+    if (!Has(Pfn)) {
+      return std::nullopt;
+    }
+
+    return FirstPage_ + (Rank(Pfn) * 0x1000);
+  }
+
+  uint64_t NumberBits() const { return NumberBits_; }
+  uint64_t NumberWords() const { return NumberWords_; }
+  uint64_t FirstPage() const { return FirstPage_; }
+
+  //
+  // Number of bytes of memory used by the index (the bitmap lives in the
+  // dump).
+  //
+
+  uint64_t MemoryUsage() const { return Ranks_.capacity() * sizeof(uint64_t); }
+};
+
+//
+// The physical memory available in a dump is described by runs of contiguous
+// physical pages that are also contiguous in the file. The runs are kept sorted
+// by PFN so that looking up a physical address is a binary search over a small
+// array instead of a hash lookup in a huge map. Pages are designated by their
+// offset in the file.
+//
+
+class Physmem_t {
+public:
+  struct Run_t {
+    uint64_t BasePage;
+    uint64_t PageCount;
+    uint64_t Offset;
+  };
+
+  using key_type = uint64_t;
+  using mapped_type = uint64_t;
+  using value_type = std::pair<key_type, mapped_type>;
+
+  //
+  // Iterate over every (physical address, file offset) pair in ascending
+  // order.
+  //
+
+  class Iterator_t {
+    const Run_t *Run_ = nullptr;
+    uint64_t PageIdx_ = 0;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Physmem_t::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    Iterator_t() = default;
+    Iterator_t(const Run_t *Run, const uint64_t PageIdx)
+        : Run_(Run), PageIdx_(PageIdx) {}
+
+    value_type operator*() const {
+      return {(Run_->BasePage + PageIdx_) * 0x1000,
+              Run_->Offset + (PageIdx_ * 0x1000)};
+    }
+
+    Iterator_t &operator++() {
+      if (++PageIdx_ == Run_->PageCount) {
+        Run_++;
+        PageIdx_ = 0;
+      }
+
+      return *this;
+    }
+
+    Iterator_t operator++(int) {
+      Iterator_t Old = *this;
+      ++*this;
+      return Old;
+    }
+
+    bool operator==(const Iterator_t &Other) const {
+      return Run_ == Other.Run_ && PageIdx_ == Other.PageIdx_;
+    }
+
+    bool operator!=(const Iterator_t &Other) const { return !(*this == Other); }
+  };
+
+private:
+  //
+  // The runs, sorted by base page.
+  //
+
+  std::vector<Run_t> Runs_;
+
+  //
+  // Total number of pages.
+  //
+
+  uint64_t NumberPages_ = 0;
+
+public:
+  //
+  // Add a run of pages; it gets merged with the previous run if they are
+  // contiguous both in physical memory and in the file.
+  //
+
+  void AddRun(const uint64_t BasePage, const uint64_t PageCount,
+              const uint64_t Offset) {
+    if (PageCount == 0) {
+      return;
+    }
+
+    NumberPages_ += PageCount;
+    if (!Runs_.empty()) {
+      Run_t &Last = Runs_.back();
+      if ((Last.BasePage + Last.PageCount) == BasePage &&
+          (Last.Offset + (Last.PageCount * 0x1000)) == Offset) {
+        Last.PageCount += PageCount;
+        return;
+      }
+    }
+
+    Runs_.push_back({BasePage, PageCount, Offset});
+  }
+
+  //
+  // Add the runs of another physmem that come after the ones of this one.
+  //
+
+  void Append(const Physmem_t &Other) {
+    for (const auto &Run : Other.Runs_) {
+      AddRun(Run.BasePage, Run.PageCount, Run.Offset);
+    }
+  }
+
+  //
+  // Sort the runs once they have all been added.
+  //
+
+  void Finalize() {
+    std::sort(Runs_.begin(), Runs_.end(), [](const Run_t &A, const Run_t &B) {
+      return A.BasePage < B.BasePage;
+    });
+  }
+
+  //
+  // Find the file offset of the page backing a page-aligned physical address.
+  //
+
+  std::optional<uint64_t> Find(const uint64_t PhysicalAddress) const {
+    if ((PhysicalAddress & 0xfff) != 0) {
+      return std::nullopt;
+    }
+
+    const uint64_t Pfn = PhysicalAddress / 0x1000;
+    auto Run = std::upper_bound(
+        Runs_.begin(), Runs_.end(), Pfn,
+        [](const uint64_t Pfn, const Run_t &Run) { return Pfn < Run.BasePage; });
+
+    if (Run == Runs_.begin()) {
+      return std::nullopt;
+    }
+
+    Run--;
+    const uint64_t PageIdx = Pfn - Run->BasePage;
+    if (PageIdx >= Run->PageCount) {
+      return std::nullopt;
+    }
+
+    return Run->Offset + (PageIdx * 0x1000);
+  }
+
+  const std::vector<Run_t> &Runs() const { return Runs_; }
+
+  size_t size() const { return size_t(NumberPages_); }
+
+  //
+  // Number of bytes of memory used by the runs.
+  //
+
+  uint64_t MemoryUsage() const { return Runs_.capacity() * sizeof(Run_t); }
+
+  Iterator_t begin() const { return Iterator_t(Runs_.data(), 0); }
+
+  Iterator_t end() const {
+    return Iterator_t(Runs_.data() + Runs_.size(), 0);
+  }
+};
+
+//
+// Statistics of the page cache.
+//
+
+struct PageCacheStats_t {
+  uint64_t Hits = 0;
+  uint64_t Misses = 0;
+  uint64_t Evictions = 0;
+  uint64_t NumberPages = 0;
+  uint64_t Capacity = 0;
+};
+
+//
+// How long the phases of the parsing took: mapping the file (or reading its
+// headers) and building the index of the physical memory.
+//
+
+struct ParseStats_t {
+  std::chrono::nanoseconds Map = {};
+  std::chrono::nanoseconds Physmem = {};
+};
+
+//
+// Pages read from a dump that isn't mapped in memory. The cache is sharded by
+// file offset so that threads reading different pages rarely contend on the
+// same lock, and every shard holds a fixed number of pages that get recycled
+// with the CLOCK algorithm. Pages handed out are pinned until they are
+// released; pinned pages are never evicted, so a shard that only has pinned
+// pages grows past its capacity instead of invalidating a pointer.
+//
+
+//
+// A flat open-addressing hash table from a page index to a small value; it is
+// used to find the cached pages, on every page lookup. A key and its value are
+// packed in a single qword (a null qword being an empty bucket) so that the
+// table is one allocation and a lookup is a linear probe through adjacent
+// qwords, which mostly stays in one cache line. The load is kept under a half
+// and erasing shifts the following entries back instead of leaving
+// tombstones.
+//
+
+class FlatPageMap_t {
+public:
+  static constexpr uint64_t ValueBits = 24;
+  static constexpr uint64_t MaxValue = (1ULL << ValueBits) - 1;
+  static constexpr uint64_t MaxKey = (1ULL << (64 - ValueBits)) - 2;
+
+private:
+  std::vector<uint64_t> Buckets_;
+  uint64_t Size_ = 0;
+  uint64_t Shift_ = 64;
+
+  static uint64_t Pack(const uint64_t Key, const uint64_t Value) {
+    return ((Key + 1) << ValueBits) | Value;
+  }
+
+  static uint64_t KeyOf(const uint64_t Bucket) {
+    return (Bucket >> ValueBits) - 1;
+  }
+
+  uint64_t Mask() const { return Buckets_.size() - 1; }
+
+  uint64_t Home(const uint64_t Key) const {
+    return (Key * 0x9e'37'79'b9'7f'4a'7c'15ULL) >> Shift_;
+  }
+
+  //
+  // Find the bucket of a key, or the empty bucket it would go in.
+  //
+
+  uint64_t Probe(const uint64_t Key) const {
+    uint64_t Idx = Home(Key);
+    while (Buckets_[Idx] != 0 && KeyOf(Buckets_[Idx]) != Key) {
+      Idx = (Idx + 1) & Mask();
+    }
+
+    return Idx;
+  }
+
+  void Grow() {
+    std::vector<uint64_t> Old(std::max(size_t(16), Buckets_.size() * 2), 0);
+    std::swap(Old, Buckets_);
+    Shift_ = 64 - TrailingZeros(Buckets_.size());
+    for (const uint64_t Bucket : Old) {
+      if (Bucket != 0) {
+        Buckets_[Probe(KeyOf(Bucket))] = Bucket;
+      }
+    }
+  }
+
+public:
+  std::optional<uint64_t> Find(const uint64_t Key) const {
+    if (Size_ == 0) {
+      return std::nullopt;
+    }
+
+    const uint64_t Bucket = Buckets_[Probe(Key)];
+    if (Bucket == 0) {
+      return std::nullopt;
+    }
+
+    return Bucket & MaxValue;
+  }
+
+  //
+  // Insert or replace the value of a key; the key has to be at most MaxKey
+  // and the value at most MaxValue.
+  //
+
+  void Insert(const uint64_t Key, const uint64_t Value) {
+    if (((Size_ + 1) * 2) > Buckets_.size()) {
+      Grow();
+    }
+
+    uint64_t &Bucket = Buckets_[Probe(Key)];
+    if (Bucket == 0) {
+      Size_++;
+    }
+
+    Bucket = Pack(Key, Value);
+  }
+
+  void Erase(const uint64_t Key) {
+    if (Size_ == 0) {
+      return;
+    }
+
+    uint64_t Hole = Probe(Key);
+    if (Buckets_[Hole] == 0) {
+      return;
+    }
+
+    //
+    // Move back the entries after the hole that can't be found anymore
+    // without it: the ones whose home isn't between the hole and them.
+    //
+
+    Size_--;
+    for (uint64_t Idx = (Hole + 1) & Mask(); Buckets_[Idx] != 0;
+         Idx = (Idx + 1) & Mask()) {
+      const uint64_t Distance = (Idx - Home(KeyOf(Buckets_[Idx]))) & Mask();
+      if (Distance >= ((Idx - Hole) & Mask())) {
+        Buckets_[Hole] = Buckets_[Idx];
+        Hole = Idx;
+      }
+    }
+
+    Buckets_[Hole] = 0;
+  }
+
+  uint64_t size() const { return Size_; }
+
+  //
+  // Number of bytes of memory used by the buckets.
+  //
+
+  uint64_t MemoryUsage() const {
+    return Buckets_.capacity() * sizeof(uint64_t);
+  }
+};
+
+class PageCache_t {
+  static constexpr uint64_t NumberShards = 64;
+
+  struct Slot_t {
+    uint64_t Offset = 0;
+    uint64_t Pins = 0;
+    bool Referenced = false;
+    uint8_t *Page = nullptr;
+    std::unique_ptr<uint8_t[]> Spilled;
+  };
+
+  struct Shard_t {
+    std::mutex Lock;
+    FlatPageMap_t Slots;
+    std::vector<Slot_t> Ring;
+    size_t Hand = 0;
+    PageCacheStats_t Stats;
+  };
+
+  std::array<Shard_t, NumberShards> Shards_;
+  uint64_t PagesPerShard_ = 1;
+
+  //
+  // The pages of the slots live in an arena allocated on the first miss (the
+  // capacity is set after construction), every shard getting PagesPerShard_
+  // of them. The slots a shard grows past its capacity, when all of its pages
+  // are pinned, get pages of their own.
+  //
+
+  std::once_flag ArenaOnce_;
+  PageArena_t Arena_;
+
+  uint8_t *PageOf(Shard_t &Shard, const size_t SlotIdx) {
+    std::call_once(ArenaOnce_, [&]() {
+      Arena_.Allocate(NumberShards * PagesPerShard_ * 0x1000);
+    });
+
+    Slot_t &Slot = Shard.Ring[SlotIdx];
+    if (Arena_.Base() != nullptr && SlotIdx < PagesPerShard_) {
+      const uint64_t ShardIdx = &Shard - Shards_.data();
+      const uint64_t PageIdx = (ShardIdx * PagesPerShard_) + SlotIdx;
+      return Arena_.Base() + (PageIdx * 0x1000);
+    }
+
+    Slot.Spilled = std::make_unique<uint8_t[]>(0x1000);
+    return Slot.Spilled.get();
+  }
+
+  Shard_t &ShardOf(const uint64_t Offset) {
+    return Shards_[(Offset / 0x1000) % NumberShards];
+  }
+
+  //
+  // Find a slot for a new page in a shard: a free one if the shard isn't full,
+  // otherwise the first unpinned page that hasn't been referenced since the
+  // hand last went over it.
+  //
+
+  size_t Allocate(Shard_t &Shard) {
+    if (Shard.Ring.size() < PagesPerShard_) {
+      Shard.Ring.emplace_back();
+      return Shard.Ring.size() - 1;
+    }
+
+    for (size_t Step = 0; Step < (2 * Shard.Ring.size()); Step++) {
+      const size_t SlotIdx = Shard.Hand;
+      Slot_t &Slot = Shard.Ring[SlotIdx];
+      Shard.Hand = (Shard.Hand + 1) % Shard.Ring.size();
+      if (Slot.Pins != 0) {
+        continue;
+      }
+
+      if (Slot.Referenced) {
+        Slot.Referenced = false;
+        continue;
+      }
+
+      Shard.Slots.Erase(Slot.Offset / 0x1000);
+      Shard.Stats.Evictions++;
+      return SlotIdx;
+    }
+
+    Shard.Ring.emplace_back();
+    return Shard.Ring.size() - 1;
+  }
+
+public:
+  //
+  // Default capacity, in pages.
+  //
+
+  static constexpr uint64_t DefaultNumberPages = 0x4000;
+
+  explicit PageCache_t(const uint64_t NumberPages = DefaultNumberPages) {
+    SetCapacity(NumberPages);
+  }
+
+  //
+  // Set the number of pages the cache can hold; this needs to be done before
+  // it is used. Every shard holds the same number of pages and at least one,
+  // so the capacity is rounded down to a multiple of NumberShards and is at
+  // least NumberShards pages (see Capacity).
+  //
+
+  void SetCapacity(const uint64_t NumberPages) {
+    PagesPerShard_ = std::clamp(NumberPages / NumberShards, uint64_t(1),
+                                FlatPageMap_t::MaxValue);
+  }
+
+  //
+  // Get the number of pages the cache can hold.
+  //
+
+  uint64_t Capacity() const { return NumberShards * PagesPerShard_; }
+
+  //
+  // Get the page at a file offset, reading it if it isn't in the cache. The
+  // page is pinned until Release is called.
+  //
+
+  const uint8_t *Get(const uint64_t Offset, const Reader_t &Reader) {
+    Shard_t &Shard = ShardOf(Offset);
+    std::lock_guard<std::mutex> Lock(Shard.Lock);
+    if (const auto &SlotIdx = Shard.Slots.Find(Offset / 0x1000)) {
+      Slot_t &Slot = Shard.Ring[*SlotIdx];
+      Slot.Pins++;
+      Slot.Referenced = true;
+      Shard.Stats.Hits++;
+      return Slot.Page;
+    }
+
+    Shard.Stats.Misses++;
+    const size_t SlotIdx = Allocate(Shard);
+    Slot_t &Slot = Shard.Ring[SlotIdx];
+    if (Slot.Page == nullptr) {
+      Slot.Page = PageOf(Shard, SlotIdx);
+    }
+
+    if (!Reader.Read(Offset, Slot.Page, 0x1000)) {
+      Slot.Pins = 0;
+      Slot.Referenced = false;
+      Slot.Offset = ~0ULL;
+      return nullptr;
+    }
+
+    Slot.Offset = Offset;
+    Slot.Pins = 1;
+    Slot.Referenced = true;
+    Shard.Slots.Insert(Offset / 0x1000, SlotIdx);
+    return Slot.Page;
+  }
+
+  //
+  // Unpin a page returned by Get.
+  //
+
+  void Release(const uint64_t Offset) {
+    Shard_t &Shard = ShardOf(Offset);
+    std::lock_guard<std::mutex> Lock(Shard.Lock);
+    const auto &SlotIdx = Shard.Slots.Find(Offset / 0x1000);
+    if (!SlotIdx) {
+      return;
+    }
+
+    Slot_t &Slot = Shard.Ring[*SlotIdx];
+    if (Slot.Pins != 0) {
+      Slot.Pins--;
+    }
+  }
+
+  PageCacheStats_t Stats() {
+    PageCacheStats_t Stats;
+    for (auto &Shard : Shards_) {
+      std::lock_guard<std::mutex> Lock(Shard.Lock);
+      Stats.Hits += Shard.Stats.Hits;
+      Stats.Misses += Shard.Stats.Misses;
+      Stats.Evictions += Shard.Stats.Evictions;
+      Stats.NumberPages += Shard.Ring.size();
+    }
+
+    Stats.Capacity = Capacity();
+
+    return Stats;
+  }
+};
+
+//
+// How the dump is accessed: mapped in memory, or read with explicit reads
+// into a page cache. Compressed dumps are always read.
+//
+
+enum class ReaderType_t { Mmap, Pread };
+
+//
+// Where a range of physical memory lives in the file of a live target.
+//
+
+struct MemoryRegion_t {
+  uint64_t PhysicalAddress = 0;
+  uint64_t Offset = 0;
+  uint64_t Size = 0;
+};
+
+//
+// The second stage of the translation of the addresses of a guest: Intel's
+// EPT or AMD's nested page tables.
+//
+
+enum class NestedPaging_t { Ept, Npt };
 
 struct BugCheckParameters_t {
   uint32_t BugCheckCode;
@@ -23,12 +829,38 @@ private:
 
   FileMap_t FileMap_;
 
+  //
+  // When the dump isn't mapped, we read it with explicit reads (decompressing
+  // it along the way if it is compressed): the headers (including the bitmap
+  // of BMP dumps) are read once and the pages are read on demand into a
+  // bounded page cache.
+  //
+
+  ReaderType_t ReaderType_ = ReaderType_t::Mmap;
+  std::unique_ptr<Reader_t> Reader_;
+  std::vector<uint8_t> Headers_;
+  mutable PageCache_t PageCache_;
+
   //
   // Header of the crash-dump.
   //
 
   HEADER64 *DmpHdr_ = nullptr;
 
+  //
+  // The type of the dump and its directory table base; memory snapshots
+  // might not have one.
+  //
+
+  DumpType_t DumpType_ = DumpType_t::FullDump;
+  uint64_t DirectoryTableBase_ = 0;
+
+  //
+  // The base of the view when the file is mapped.
+  //
+
+  const uint8_t *View_ = nullptr;
+
   //
   // File path to the crash-dump.
   //
@@ -36,17 +868,65 @@ private:
   const char *PathFile_ = nullptr;
 
   //
-  // Mapping between physical addresses / page data.
+  // Mapping between physical addresses / page data. For BMP dumps, this is
+  // only built when the user asks for it; page lookups go through the
+  // bitmap index instead.
   //
 
   Physmem_t Physmem_;
+  bool PhysmemBuilt_ = false;
+  bool Nested_ = false;
+  BitmapIndex_t BitmapIndex_;
+  uint64_t NumberThreads_ = 1;
+
+  //
+  // The timings of the parsing.
+  //
+
+  ParseStats_t ParseStats_;
 
 public:
   //
-  // Actually do the parsing of the file.
+  // Actually do the parsing of the file; the page lookup structures are
+  // built by NumberThreads threads.
+  //
+
+  bool Parse(const char *PathFile,
+             const ReaderType_t ReaderType = ReaderType_t::Mmap,
+             const uint64_t CacheSize = PageCache_t::DefaultNumberPages,
+             const uint64_t NumberThreads = 1);
+
+  //
+  // Parse a dump read through a reader provided by the user (like a reader
+  // over a browser Blob); its content is read with explicit reads into the
+  // page cache like with ReaderType_t::Pread. Name is only used to tell the
+  // raw snapshots apart by their extension.
+  //
+
+  bool ParseReader(const char *Name, std::unique_ptr<Reader_t> Reader,
+                   const uint64_t CacheSize = PageCache_t::DefaultNumberPages);
+
+  //
+  // Read the physical memory of a live target out of a file where its
+  // regions live at known offsets, like the /proc/<pid>/mem of the QEMU
+  // process running a guest. The pages are always read with explicit reads
+  // into the page cache; they aren't read again while they are cached.
+  //
+
+  bool ParseLive(const char *PathFile,
+                 const std::vector<MemoryRegion_t> &Regions,
+                 const uint64_t CacheSize = PageCache_t::DefaultNumberPages);
+
+  //
+  // Turn the parser into a view of the physical memory of a guest of the
+  // host the dump comes from: the guest physical addresses are translated
+  // through the EPT (or the nested page tables) at Pointer, which is an EPT
+  // pointer or an nCR3. The whole second stage is walked once and folded into
+  // the physmem, so that looking up a guest physical page costs the same as
+  // looking up a host one. The guests don't have a directory table base.
   //
 
-  bool Parse(const char *PathFile);
+  bool Nest(const uint64_t Pointer, const NestedPaging_t Type);
 
   //
   // Give the Context record to the user.
@@ -96,12 +976,56 @@ public:
 
   const uint8_t *GetPhysicalPage(const uint64_t PhysicalAddress) const;
 
+  //
+  // Let the OS know that a physical page is about to be read, so that it can
+  // page it in in the background.
+  //
+
+  void PrefetchPhysicalPage(const uint64_t PhysicalAddress) const;
+
+  //
+  // Let the parser know that a page returned by GetPhysicalPage isn't used
+  // anymore. When the dump isn't mapped, pages stay in the cache for as long
+  // as somebody uses them; pages that are never released simply stay in
+  // memory.
+  //
+
+  void ReleasePhysicalPage(const uint64_t PhysicalAddress) const;
+
+  //
+  // Get the statistics of the page cache; they are all zero when the dump is
+  // mapped.
+  //
+
+  PageCacheStats_t GetPageCacheStats() const;
+
+  //
+  // Get how long the phases of Parse took.
+  //
+
+  ParseStats_t GetParseStats() const;
+
+  //
+  // Get the number of bytes of memory the parser uses on its own: the
+  // headers, the page lookup structures and the page cache. A mapped dump is
+  // paged in and out by the OS and isn't accounted for.
+  //
+
+  uint64_t GetMemoryUsage() const;
+
   //
   // Get the directory table base.
   //
 
   uint64_t GetDirectoryTableBase() const;
 
+  //
+  // Get the address of the list of the loaded kernel modules; zero when the
+  // dump doesn't have a header.
+  //
+
+  uint64_t GetPsLoadedModuleList() const;
+
   //
   // Translate a virtual address to physical address using a directory table
   // base.
@@ -124,6 +1048,57 @@ private:
 
   uint64_t PhyRead8(const uint64_t PhysicalAddress) const;
 
+  //
+  // Find the file offset of a physical page.
+  //
+
+  std::optional<uint64_t>
+  FindPhysicalPage(const uint64_t PhysicalAddress) const;
+
+  //
+  // Get Size bytes at Offset in the headers of the file; they are read if
+  // the file isn't mapped.
+  //
+
+  const uint8_t *GetHeaderBytes(const uint64_t Offset, const uint64_t Size);
+
+  //
+  // Walk a table of the second stage of a guest translation and add the
+  // pages it maps to the physmem of the guest.
+  //
+
+  void WalkNested(const NestedPaging_t Type, const uint64_t TableAddress,
+                  const uint64_t Level, const uint64_t GuestBase,
+                  Physmem_t &Guest) const;
+
+  //
+  // Is the file a raw copy of the physical memory? Those don't have any
+  // header, so they are recognized by their extension (.raw or .mem).
+  //
+
+  static bool IsRaw(const char *PathFile);
+
+  //
+  // Build the physmem of an ELF core out of its PT_LOAD segments, and find
+  // the directory table base in the QEMU notes.
+  //
+
+  bool BuildPhysmemElfDump();
+
+  //
+  // Get the directory table base of the first vCPU out of the QEMU notes of
+  // a PT_NOTE segment.
+  //
+
+  void FindQemuDirectoryTableBase(const elf::ProgramHeader_t &Segment);
+
+  //
+  // Build the physmem of a raw copy of the physical memory: a single run
+  // starting at physical address 0.
+  //
+
+  bool BuildPhysmemRawDump();
+
   //
   // Build a map of physical addresses / page data pointers for full dump.
   //
@@ -136,6 +1111,12 @@ private:
 
   bool BuildPhysmemBMPDump();
 
+  //
+  // Build the bitmap index for BMP dump.
+  //
+
+  bool BuildBitmapIndex();
+
   //
   // Parse the DMP_HEADER.
   //
@@ -147,5 +1128,17 @@ private:
   //
 
   bool MapFile();
+
+  //
+  // Is the file compressed with gzip?
+  //
+
+  static bool IsCompressed(const char *PathFile);
+
+  //
+  // Open the file and read its headers, when not mapping it.
+  //
+
+  bool ReadHeaders();
 };
 } // namespace kdmpparser
@@ -5,6 +5,8 @@
 #define ARCH_X86
 #elif defined(__amd64__) || defined(_M_X64)
 #define ARCH_X64
+#elif defined(__wasm__)
+#define ARCH_WASM
 #else
 #error Platform not supported.
 #endif
@@ -13,6 +15,14 @@
 #define WINDOWS
 #define SYSTEM_PLATFORM "Windows"
 
+//
+// The min and max macros of windows.h break std::min and std::max.
+//
+
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+
 #include <windows.h>
 #if defined ARCH_X86
 #define WINDOWS_X86
@@ -38,6 +48,14 @@
 #define LINUX_X64
 #endif
 
+#elif defined(__EMSCRIPTEN__)
+
+//
+// Emscripten emulates the POSIX APIs the Linux code paths use.
+//
+
+#define LINUX
+#define SYSTEM_PLATFORM "Emscripten"
 #else
 #error Platform not supported.
 #endif